@@ -0,0 +1,128 @@
+// Measures how many telemetry frames reach the ground through a lossy LoRa link with the forward error correction of PacketFec.hpp,
+// against the airtime the parity frames add, for a few group sizes and loss patterns.
+// Build from this folder with: g++ -std=gnu++17 -O2 -I ../include FecSimulator.cpp -o FecSimulator
+// Frames are built like the ones the firmware sends, numbered by the transmitter and followed by the parity frames of their group,
+// so the decoder sees the same byte stream the ground station would.
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+#include "PacketFec.hpp"
+#include "LinkRateController.hpp"
+
+constexpr uint32_t number_frames = 200000;
+constexpr LoraSetting setting = { 9, 125000, 5 };
+constexpr uint16_t parity_header_length = 5; // Fields of the FEC_PARITY message before the parity bytes.
+constexpr uint16_t frame_overhead = 12; // MAVLink 2 header and CRC.
+
+struct Code {
+    const char* name;
+    uint8_t data_frames; // Zero for no correction.
+    uint8_t parity_frames;
+};
+
+/// @brief Loss model with a good and a bad state, which gives the bursts of losses seen when the boat turns or passes behind an obstacle.
+struct Channel {
+    const char* name;
+    float loss_good;
+    float loss_bad;
+    float good_to_bad;
+    float bad_to_good;
+    bool is_bad = false;
+
+    bool IsLost(std::mt19937& generator) {
+        std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+        is_bad = is_bad ? distribution(generator) >= bad_to_good : distribution(generator) < good_to_bad;
+        return distribution(generator) < (is_bad ? loss_bad : loss_good);
+    }
+};
+
+// Payload lengths of the telemetry messages, in the proportion they are sent.
+const std::vector<uint8_t> payload_lengths = { 28, 28, 28, 40, 40, 16, 33, 53, 76 };
+
+std::vector<uint8_t> BuildFrame(std::mt19937& generator, uint8_t seq) {
+    uint8_t length = payload_lengths[generator() % payload_lengths.size()];
+    std::vector<uint8_t> frame(length + frame_overhead);
+    frame[0] = 0xFD;
+    frame[1] = length;
+    frame[4] = seq;
+    frame[5] = 1;
+    frame[6] = 191;
+    for (size_t i = 7; i < frame.size(); i++) frame[i] = generator();
+    return frame;
+}
+
+struct Result {
+    double delivered; // Fraction of the data frames available at the ground, received or rebuilt.
+    double overhead; // Airtime of the parity frames relative to the airtime of the data frames.
+};
+
+Result Simulate(const Code& code, Channel channel, uint32_t seed) {
+    std::mt19937 generator(seed);
+    static PacketFec::Decoder decoder; // Static, since it keeps a copy of every sequence number.
+    decoder = PacketFec::Decoder();
+    PacketFec::Encoder encoder;
+    if (code.data_frames) encoder.Configure(code.data_frames, code.parity_frames);
+
+    uint8_t seq = 0;
+    uint32_t delivered = 0;
+    double data_airtime = 0.0, parity_airtime = 0.0;
+    std::vector<std::vector<uint8_t>> sent(256); // Last frame sent with each sequence number, to check the rebuilt ones.
+    uint32_t wrong = 0;
+
+    auto SendParity = [&]() {
+        for (uint8_t i = 0; i < encoder.GetNumberParity(); i++) {
+            PacketFec::Parity parity = encoder.GetParity(i);
+            seq++; // Parity frames take a sequence number as well.
+            parity_airtime += LoraAirtime(setting, frame_overhead + parity_header_length + parity.length);
+            if (channel.IsLost(generator)) continue;
+            decoder.ReceiveParity(parity, [&](const uint8_t* frame, uint16_t length) {
+                if (std::vector<uint8_t>(frame, frame + length) == sent[frame[4]]) delivered++;
+                else wrong++;
+            });
+        }
+        encoder.Reset();
+    };
+
+    for (uint32_t n = 0; n < number_frames; n++) {
+        std::vector<uint8_t> frame = BuildFrame(generator, seq++);
+        sent[frame[4]] = frame;
+        data_airtime += LoraAirtime(setting, frame.size());
+        if (!channel.IsLost(generator)) {
+            delivered++;
+            decoder.ReceiveData(frame.data(), frame.size());
+        }
+        if (code.data_frames && encoder.Add(frame.data(), frame.size())) SendParity();
+    }
+    if (code.data_frames && encoder.Flush()) SendParity();
+    if (wrong) std::cerr << code.name << ", " << channel.name << ": " << wrong << " frames rebuilt wrong\n";
+    return { (double)delivered / number_frames, parity_airtime / data_airtime };
+}
+
+int main() {
+    const std::vector<Code> codes = {
+        { "none", 0, 0 }, { "K=4 M=1", 4, 1 }, { "K=8 M=1", 8, 1 }, { "K=8 M=2", 8, 2 }, { "K=16 M=2", 16, 2 }, { "K=16 M=4", 16, 4 }, { "K=8 M=4", 8, 4 }
+    };
+    const std::vector<Channel> channels = {
+        { "1% random", 0.01f, 0.01f, 0.0f, 1.0f },
+        { "5% random", 0.05f, 0.05f, 0.0f, 1.0f },
+        { "10% random", 0.10f, 0.10f, 0.0f, 1.0f },
+        { "20% random", 0.20f, 0.20f, 0.0f, 1.0f },
+        { "5% in bursts", 0.01f, 0.50f, 0.02f, 0.20f },
+        { "15% in bursts", 0.02f, 0.60f, 0.05f, 0.20f }
+    };
+
+    std::cout << "Frames delivered to the ground, with the airtime added by the parity frames at SF" << (int)setting.spreading_factor
+              << " BW" << setting.bandwidth / 1000 << "k CR4/" << (int)setting.coding_rate << "\n\n";
+    std::cout << std::left << std::setw(12) << "code" << std::setw(10) << "airtime";
+    for (const Channel& channel : channels) std::cout << std::setw(15) << channel.name;
+    std::cout << "\n" << std::fixed;
+
+    for (const Code& code : codes) {
+        std::vector<Result> results;
+        for (const Channel& channel : channels) results.push_back(Simulate(code, channel, 1234));
+        std::cout << std::setw(12) << code.name << std::setw(10) << std::setprecision(1) << ("+" + std::to_string((int)(100.0 * results[0].overhead + 0.5)) + "%");
+        for (const Result& result : results) std::cout << std::setw(15) << std::setprecision(2) << 100.0 * result.delivered;
+        std::cout << "\n";
+    }
+}
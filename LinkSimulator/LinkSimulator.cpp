@@ -0,0 +1,554 @@
+// Simulates the LoRa link from the serial port of the main ESP32 to the ground station, to compare telemetry scheduling, forward error
+// correction and modulation settings without going out on the water.
+// Build from this folder with: g++ -std=gnu++17 -O2 -I ../include LinkSimulator.cpp -o LinkSimulator
+// Run with: ./LinkSimulator --duration 3600 --fec 8,1 --adaptive --good-time 30 --bad-time 3
+// The telemetry streams of the firmware are generated at their rates and go through a copy of the serial transmitter task: the transmit
+// queue, the STREAM_STAMPS and TIME_SYNC messages, and the parity frames of PacketFec.hpp, with the timings of the firmware. Frames then
+// cross the serial port to the LoRa board, wait in its queue for the radio and the duty cycle limit, and go on air for the airtime of the
+// setting in use. The channel is a Gilbert-Elliott model, a good and a bad state each with its own loss and SNR, and a frame is also lost
+// when its SNR falls under the demodulation floor of the spreading factor. With --adaptive, the LoRa board reports the link every 5 s
+// and LinkRateController.hpp chooses the setting, as the firmware does. The ground parses the received bytes and rebuilds lost frames
+// from the parity frames.
+// Reports the goodput, the latency percentiles from sample to ground, and the delivery of each message type.
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+#include "LinkRateController.hpp"
+#include "MavlinkFrameParser.hpp"
+#include "PacketFec.hpp"
+
+// Messages of MavlinkExtensions.hpp, repeated here since that header needs the dialect of the firmware build.
+constexpr uint32_t msg_id_fec_parity = 53007;
+constexpr uint32_t msg_id_stream_stamps = 53010;
+constexpr uint32_t msg_id_time_sync = 53011;
+constexpr uint8_t stamps_length = 53;
+constexpr uint8_t time_sync_length = 14;
+constexpr uint8_t parity_header_length = 5; // Fields of the FEC_PARITY message before the parity bytes.
+constexpr uint8_t max_stamps = 8;
+constexpr uint8_t system_id = 1;
+constexpr uint8_t component_id = 191; // MAV_COMP_ID_ONBOARD_COMPUTER
+
+int CrcExtra(uint32_t msgid) {
+    switch (msgid) {
+        case msg_id_fec_parity: return 188;
+        case msg_id_stream_stamps: return 186;
+        case msg_id_time_sync: return 218;
+        default: return 0; // The simulated telemetry is built with a CRC extra of 0.
+    }
+}
+
+// Timings of the serial transmitter task.
+constexpr uint32_t fec_max_group_age = 2000; // ms
+constexpr uint32_t stamps_max_age = 1000; // ms
+constexpr uint32_t time_sync_interval = 10000; // ms
+constexpr size_t transmit_queue_length = 8;
+
+/// @brief Telemetry the firmware sends over LoRa when the IP path is down. Payload lengths of the messages of the arariboat dialect are
+/// estimates, since the dialect is not part of this repository.
+struct Source {
+    const char* name;
+    uint32_t msgid;
+    uint8_t payload_length;
+    uint32_t interval; // ms
+    uint8_t count; // Messages each time, such as one per channel.
+    bool is_optional; // Only sent on request, such as the chunks of a transient capture.
+};
+
+const std::vector<Source> sources = {
+    { "instrumentation_summary", 53013, 46, 5000, 1, false },
+    { "temperatures", 3, 12, 10750, 1, false },
+    { "gps_info", 2, 28, 7000, 1, false },
+    { "control_system", 1, 16, 6000, 1, false },
+    { "aux_system", 5, 8, 8000, 1, false },
+    { "pump_status", 53003, 33, 8000, 1, false },
+    { "current_spectrum", 53002, 53, 5000, 2, false },
+    { "capture_chunk", 53001, 76, 250, 1, true },
+};
+
+struct Options {
+    double duration = 3600.0; // s
+    LoraSetting setting = { 9, 125000, 5 };
+    bool is_adaptive = false;
+    uint8_t fec_data = 0; // Zero for no correction.
+    uint8_t fec_parity = 0;
+    float duty_cycle = 100.0f; // Percentage of the time the radio may be on air.
+    uint32_t baud = 115200;
+    size_t board_queue = 16; // Frames the LoRa board holds while the radio is busy.
+    float loss_good = 0.01f;
+    float loss_bad = 0.5f;
+    float good_time = 60.0f; // s. Mean time in each state.
+    float bad_time = 5.0f;
+    float snr_good = 8.0f; // dB at 125 kHz.
+    float snr_bad = -8.0f;
+    float snr_deviation = 2.0f; // dB. Spread of the SNR of single frames around the one of the state.
+    float rate_scale = 1.0f; // Multiplies the rate of every stream.
+    bool is_capture = false;
+    uint32_t seed = 1234;
+};
+
+/// @brief Gilbert-Elliott channel in continuous time: the state lasts an exponentially distributed time, so bursts keep their length in
+/// seconds whatever the rate of frames.
+class Channel {
+public:
+    Channel(const Options& options, std::mt19937& generator) : options(options), generator(generator) { Dwell(0.0); }
+
+    /// @brief Whether a frame sent with a setting and ending at a time reaches the ground, and at what SNR.
+    bool IsReceived(double time, const LoraSetting& setting, float& snr) {
+        while (time >= state_end) {
+            is_bad = !is_bad;
+            Dwell(state_end);
+        }
+        std::normal_distribution<float> noise(0.0f, options.snr_deviation);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        snr = (is_bad ? options.snr_bad : options.snr_good) - 10.0f * log10f(setting.bandwidth / 125000.0f) + noise(generator);
+        if (snr < LinkRateController::DemodulationFloor(setting.spreading_factor)) return false;
+        return uniform(generator) >= (is_bad ? options.loss_bad : options.loss_good);
+    }
+
+    bool IsBad() const { return is_bad; }
+
+private:
+    const Options& options;
+    std::mt19937& generator;
+    bool is_bad = false;
+    double state_end = 0.0; // ms
+
+    void Dwell(double start) {
+        std::exponential_distribution<double> dwell(1.0 / (1000.0 * (is_bad ? options.bad_time : options.good_time)));
+        state_end = start + dwell(generator);
+    }
+};
+
+struct TypeStatistics {
+    std::string name;
+    uint32_t msgid;
+    uint64_t offered = 0;
+    uint64_t queue_dropped = 0; // Transmit queue of the firmware full.
+    uint64_t board_dropped = 0; // Queue of the LoRa board full.
+    uint64_t sent = 0; // On air.
+    uint64_t received = 0;
+    uint64_t recovered = 0; // Rebuilt from parity frames.
+    uint64_t payload_bytes = 0; // Delivered.
+};
+
+struct Sample {
+    size_t type;
+    double created; // ms
+};
+
+struct SerialFrame {
+    size_t record; // Index of the frame among all the frames written.
+    double arrival; // ms. When the last byte reaches the LoRa board.
+};
+
+class Simulation {
+public:
+    explicit Simulation(const Options& options) : options(options), generator(options.seed), channel(options, generator) {
+        for (const Source& source : sources) types.push_back({ source.name, source.msgid });
+        stamps_type = AddType("stream_stamps", msg_id_stream_stamps);
+        time_sync_type = AddType("time_sync", msg_id_time_sync);
+        parity_type = AddType("fec_parity", msg_id_fec_parity);
+        if (options.fec_data) encoder.Configure(options.fec_data, options.fec_parity);
+        if (options.is_adaptive) {
+            controller.SetAutomatic(0);
+        } else {
+            controller.SetManual(options.setting, 0);
+        }
+        board_setting = controller.GetSetting();
+        command_setting = board_setting;
+        std::uniform_real_distribution<double> phase(0.0, 1.0);
+        for (const Source& source : sources) next_source.push_back(phase(generator) * source.interval / options.rate_scale);
+    }
+
+    void Run() {
+        double end = options.duration * 1000.0;
+        for (double now = 0.0; now < end; now += 1.0) {
+            Generate(now);
+            Transmit(now);
+            Board(now);
+            Report(now);
+        }
+    }
+
+    void Print() const {
+        double seconds = options.duration;
+        printf("Duration %.0f s, %s, FEC %s, duty cycle %.0f%%, channel bad %.0f s of every %.0f s\n", seconds,
+               options.is_adaptive ? "adaptive data rate" : SettingName(options.setting).c_str(),
+               options.fec_data ? (std::to_string(options.fec_data) + "+" + std::to_string(options.fec_parity)).c_str() : "off",
+               options.duty_cycle, options.bad_time, options.good_time + options.bad_time);
+
+        uint64_t telemetry_bytes = 0, telemetry_offered = 0, telemetry_delivered = 0;
+        printf("\n%-24s %9s %9s %9s %9s %9s %9s %9s\n", "message", "offered", "q dropped", "b dropped", "on air", "received", "rebuilt", "delivered");
+        for (size_t i = 0; i < types.size(); i++) {
+            const TypeStatistics& type = types[i];
+            if (!type.offered && !type.sent) continue;
+            uint64_t delivered = type.received + type.recovered;
+            printf("%-24s %9llu %9llu %9llu %9llu %9llu %9llu %8.1f%%\n", type.name.c_str(), (unsigned long long)type.offered,
+                   (unsigned long long)type.queue_dropped, (unsigned long long)type.board_dropped, (unsigned long long)type.sent,
+                   (unsigned long long)type.received, (unsigned long long)type.recovered, type.offered ? 100.0 * delivered / type.offered : 0.0);
+            if (i < sources.size()) {
+                telemetry_bytes += type.payload_bytes;
+                telemetry_offered += type.offered;
+                telemetry_delivered += delivered;
+            }
+        }
+
+        std::vector<float> sorted = latencies;
+        std::sort(sorted.begin(), sorted.end());
+        auto Percentile = [&](double p) { return sorted.empty() ? 0.0f : sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))]; };
+        printf("\nTelemetry delivered %.2f%%, goodput %.1f B/s of payload, %.1f B/s on air, radio on air %.1f%% of the time\n",
+               telemetry_offered ? 100.0 * telemetry_delivered / telemetry_offered : 0.0, telemetry_bytes / seconds, air_bytes / seconds,
+               100.0 * airtime / (seconds * 1000.0));
+        printf("Samples identified by their stamps %.2f%%\n", telemetry_offered ? 100.0 * samples_identified / telemetry_offered : 0.0);
+        printf("Latency from sample to ground: p50 %.0f ms, p90 %.0f ms, p99 %.0f ms, max %.0f ms\n", Percentile(0.5), Percentile(0.9),
+               Percentile(0.99), sorted.empty() ? 0.0f : sorted.back());
+        printf("Waiting for the duty cycle %.1f%% of the time, FEC groups rebuilt %u, failed %u\n", 100.0 * duty_wait / (seconds * 1000.0),
+               decoder.GetStatistics().groups_recovered, decoder.GetStatistics().groups_failed);
+        if (options.is_adaptive) {
+            printf("Setting changes %u, time at each setting:\n", setting_changes);
+            for (uint8_t i = 0; i < LinkRateController::number_rungs; i++) {
+                if (time_at_rung[i] > 0.0) printf("  %-16s %6.1f%%\n", SettingName(controller.GetRung(i)).c_str(), 100.0 * time_at_rung[i] / (seconds * 1000.0));
+            }
+        }
+    }
+
+private:
+    const Options& options;
+    std::mt19937 generator;
+    Channel channel;
+    std::vector<TypeStatistics> types;
+    size_t stamps_type, time_sync_type, parity_type;
+    std::vector<double> next_source;
+
+    // Firmware side.
+    std::deque<Sample> transmit_queue;
+    PacketFec::Encoder encoder;
+    uint8_t seq = 0;
+    double group_start = 0.0;
+    uint8_t stamped_seqs[max_stamps];
+    uint8_t stamps_count = 0;
+    double stamps_start = 0.0;
+    double time_sync_timer = 0.0;
+    double serial_free = 0.0; // When the last byte written so far leaves the serial port.
+    LinkRateController controller;
+
+    // LoRa board.
+    std::deque<SerialFrame> serial_line;
+    std::deque<SerialFrame> board_queue;
+    LoraSetting board_setting;
+    double command_arrival = -1.0; // When the LORA_PARAMS command in flight reaches the LoRa board.
+    LoraSetting command_setting;
+    bool is_on_air = false;
+    SerialFrame on_air;
+    LoraSetting on_air_setting;
+    double air_end = 0.0;
+    double duty_ready = 0.0;
+    uint32_t packets_received = 0;
+    uint32_t packets_lost = 0;
+    float last_snr = 0.0f;
+    double report_timer = 0.0;
+
+    // Ground.
+    MavlinkFrameParser::Parser parser;
+    PacketFec::Decoder decoder;
+    // Every frame written, to account for the frames the ground receives or rebuilds. Sequence numbers wrap while frames wait on the
+    // LoRa board, so a rebuilt frame is only matched with the last frame written with its number when their bytes agree.
+    struct Record {
+        std::vector<uint8_t> bytes;
+        size_t type;
+        double created;
+        bool is_delivered;
+        bool is_telemetry;
+    };
+    std::vector<Record> records;
+    size_t last_record[256] = {};
+
+    std::vector<float> latencies;
+    double air_bytes = 0.0;
+    double airtime = 0.0;
+    double duty_wait = 0.0;
+    uint64_t samples_identified = 0;
+    uint32_t setting_changes = 0;
+    double time_at_rung[LinkRateController::number_rungs] = {};
+
+    size_t AddType(const char* name, uint32_t msgid) {
+        types.push_back({ name, msgid });
+        return types.size() - 1;
+    }
+
+    static std::string SettingName(const LoraSetting& setting) {
+        return "SF" + std::to_string(setting.spreading_factor) + " BW" + std::to_string(setting.bandwidth / 1000) + "k CR4/" +
+               std::to_string(setting.coding_rate);
+    }
+
+    void Generate(double now) {
+        for (size_t i = 0; i < sources.size(); i++) {
+            const Source& source = sources[i];
+            if (now < next_source[i]) continue;
+            next_source[i] += source.interval / options.rate_scale;
+            if (source.is_optional && !options.is_capture) continue;
+            for (uint8_t n = 0; n < source.count; n++) {
+                types[i].offered++;
+                if (transmit_queue.size() >= transmit_queue_length) {
+                    types[i].queue_dropped++;
+                    continue;
+                }
+                transmit_queue.push_back({ i, now });
+            }
+        }
+    }
+
+    /// @brief The serial transmitter task, which blocks while the serial port drains.
+    void Transmit(double now) {
+        if (serial_free > now) return;
+        if (!transmit_queue.empty()) {
+            Sample sample = transmit_queue.front();
+            transmit_queue.pop_front();
+            uint8_t frame_seq = seq;
+            SendFrame(BuildTelemetry(sample.type), sample.type, sample.created, true, now);
+            if (!stamps_count) stamps_start = now;
+            stamped_seqs[stamps_count] = frame_seq;
+            if (++stamps_count == max_stamps) SendStamps(now);
+        }
+        if (stamps_count && now - stamps_start >= stamps_max_age) SendStamps(now);
+        if (now - time_sync_timer >= time_sync_interval) {
+            time_sync_timer = now;
+            std::vector<uint8_t> payload(time_sync_length);
+            for (uint8_t& byte : payload) byte = generator();
+            SendFrame(payload, time_sync_type, now, false, now);
+        }
+        if (options.fec_data && !encoder.IsEmpty() && now - group_start >= fec_max_group_age && encoder.Flush()) SendParity(now);
+    }
+
+    std::vector<uint8_t> BuildTelemetry(size_t type) {
+        std::vector<uint8_t> payload(sources[type].payload_length);
+        for (uint8_t& byte : payload) byte = generator();
+        payload.back() |= 1; // Not trimmed.
+        return payload;
+    }
+
+    void SendStamps(double now) {
+        // Each entry holds the sequence number of a frame, and the stream and sample of its content, which the ground only needs to find here.
+        std::vector<uint8_t> payload(stamps_length, 0);
+        uint8_t* frame_seqs = &payload[4 + 2 * max_stamps + 2 * max_stamps + 1];
+        for (uint8_t i = 0; i < stamps_length - 8 - 4; i++) payload[i] = generator();
+        payload[4 + 4 * max_stamps] = stamps_count;
+        for (uint8_t i = 0; i < max_stamps; i++) {
+            frame_seqs[i] = i < stamps_count ? stamped_seqs[i] : 0;
+            frame_seqs[max_stamps + i] = i < stamps_count ? 1 : 0; // Stream.
+        }
+        stamps_count = 0;
+        SendFrame(payload, stamps_type, now, false, now);
+    }
+
+    void SendFrame(const std::vector<uint8_t>& payload, size_t type, double created, bool is_telemetry, double now) {
+        uint8_t frame[MavlinkFrameParser::max_frame_length];
+        uint16_t length = MavlinkFrameParser::Build(frame, seq, system_id, component_id, types[type].msgid, payload.data(), payload.size(),
+                                                    CrcExtra(types[type].msgid));
+        if (!options.fec_data) {
+            Write(frame, length, type, created, is_telemetry, now);
+            return;
+        }
+        if (!PacketFec::Encoder::IsProtectable(frame, length)) {
+            if (encoder.Flush()) SendParity(now);
+            length = MavlinkFrameParser::Build(frame, seq, system_id, component_id, types[type].msgid, payload.data(), payload.size(),
+                                               CrcExtra(types[type].msgid));
+            Write(frame, length, type, created, is_telemetry, now);
+            return;
+        }
+        if (encoder.IsEmpty()) group_start = now;
+        Write(frame, length, type, created, is_telemetry, now);
+        if (encoder.Add(frame, length)) SendParity(now);
+    }
+
+    void SendParity(double now) {
+        for (uint8_t i = 0; i < encoder.GetNumberParity(); i++) {
+            const PacketFec::Parity& parity = encoder.GetParity(i);
+            uint8_t payload[parity_header_length + sizeof(parity.data)] = { parity.group, parity.first_seq, parity.data_frames, parity.parity_frames, parity.index };
+            memcpy(payload + parity_header_length, parity.data, parity.length);
+            uint8_t frame[MavlinkFrameParser::max_frame_length];
+            uint16_t length = MavlinkFrameParser::Build(frame, seq, system_id, component_id, msg_id_fec_parity, payload,
+                                                        parity_header_length + parity.length, CrcExtra(msg_id_fec_parity));
+            Write(frame, length, parity_type, now, false, now);
+        }
+        encoder.Reset();
+    }
+
+    void Write(const uint8_t* frame, uint16_t length, size_t type, double created, bool is_telemetry, double now) {
+        if (type >= sources.size()) types[type].offered++; // Link messages are offered as they are written.
+        last_record[seq] = records.size();
+        records.push_back({ std::vector<uint8_t>(frame, frame + length), type, created, false, is_telemetry });
+        seq++;
+        serial_free = std::max(serial_free, now) + length * 10000.0 / options.baud;
+        serial_line.push_back({ records.size() - 1, serial_free });
+    }
+
+    void Board(double now) {
+        while (!serial_line.empty() && serial_line.front().arrival <= now) {
+            if (board_queue.size() >= options.board_queue) {
+                types[records[serial_line.front().record].type].board_dropped++;
+            } else {
+                board_queue.push_back(serial_line.front());
+            }
+            serial_line.pop_front();
+        }
+        if (command_arrival >= 0.0 && now >= command_arrival) {
+            board_setting = command_setting;
+            command_arrival = -1.0;
+        }
+
+        if (is_on_air && now >= air_end) {
+            is_on_air = false;
+            float snr;
+            if (channel.IsReceived(now, on_air_setting, snr)) {
+                packets_received++;
+                last_snr = snr;
+                Ground(on_air.record, now);
+            } else {
+                packets_lost++;
+            }
+        }
+        if (is_on_air || board_queue.empty()) return;
+        if (now < duty_ready) {
+            duty_wait += 1.0;
+            return;
+        }
+        on_air = board_queue.front();
+        board_queue.pop_front();
+        on_air_setting = board_setting;
+        const Record& record = records[on_air.record];
+        float frame_airtime = LoraAirtime(board_setting, record.bytes.size());
+        is_on_air = true;
+        air_end = now + frame_airtime;
+        duty_ready = air_end + frame_airtime * (100.0f / options.duty_cycle - 1.0f);
+        airtime += frame_airtime;
+        air_bytes += record.bytes.size();
+        types[record.type].sent++;
+    }
+
+    void Ground(size_t index, double now) {
+        const std::vector<uint8_t>& bytes = records[index].bytes;
+        parser.Parse(bytes.data(), bytes.size(), CrcExtra, [&](const MavlinkFrameParser::Frame& frame) {
+            if (frame.msgid == msg_id_fec_parity) {
+                types[parity_type].received++;
+                PacketFec::Parity parity = {};
+                parity.group = frame.payload[0];
+                parity.first_seq = frame.payload[1];
+                parity.data_frames = frame.payload[2];
+                parity.parity_frames = frame.payload[3];
+                parity.index = frame.payload[4];
+                parity.length = frame.payload_length - parity_header_length;
+                memcpy(parity.data, frame.payload + parity_header_length, parity.length);
+                decoder.ReceiveParity(parity, [&](const uint8_t* rebuilt, uint16_t rebuilt_length) {
+                    size_t match = last_record[rebuilt[4]];
+                    if (records[match].bytes == std::vector<uint8_t>(rebuilt, rebuilt + rebuilt_length)) Deliver(match, now, true);
+                });
+                return;
+            }
+            decoder.ReceiveData(frame.data, frame.length);
+            Deliver(index, now, false);
+        });
+    }
+
+    void Deliver(size_t index, double now, bool is_recovered) {
+        Record& record = records[index];
+        if (record.is_delivered) return;
+        const uint8_t* frame = record.bytes.data();
+        size_t length = record.bytes.size();
+        record.is_delivered = true;
+        TypeStatistics& type = types[record.type];
+        (is_recovered ? type.recovered : type.received)++;
+        type.payload_bytes += frame[1];
+        if (record.is_telemetry) latencies.push_back((float)(now - record.created));
+        if (record.type == stamps_type) {
+            // Samples are identified when their stamps arrive; a stamp can only name frames sent before it, which are already accounted for.
+            uint8_t count = length > MavlinkFrameParser::v2_header_length + 4 + 4 * max_stamps ? frame[MavlinkFrameParser::v2_header_length + 4 + 4 * max_stamps] : 0;
+            const uint8_t* frame_seqs = frame + MavlinkFrameParser::v2_header_length + 4 + 4 * max_stamps + 1;
+            for (uint8_t i = 0; i < count && i < max_stamps; i++) {
+                const Record& stamped = records[last_record[frame_seqs[i]]];
+                if (stamped.is_delivered && stamped.is_telemetry) samples_identified++;
+            }
+        }
+    }
+
+    /// @brief Link reports of the LoRa board, which the firmware feeds to the data rate controller, and the LORA_PARAMS commands back.
+    void Report(double now) {
+        int8_t rung = controller.GetRungIndex();
+        if (rung >= 0) time_at_rung[rung] += 1.0;
+        if (!options.is_adaptive) return;
+        bool must_send = false;
+        if (now - report_timer >= 5000.0) {
+            report_timer = now;
+            LinkRateController::Report report = { packets_received, packets_lost, -100.0f, last_snr, board_setting };
+            must_send = controller.Update(report, (uint32_t)now);
+        }
+        must_send = controller.Poll((uint32_t)now) || must_send;
+        if (must_send) {
+            if (controller.GetSetting() != command_setting) setting_changes++;
+            command_setting = controller.GetSetting();
+            command_arrival = now + 500.0; // Over the serial port and the uplink, which is not simulated.
+        }
+    }
+};
+
+bool ParsePair(const char* text, uint8_t& first, uint8_t& second) {
+    int a, b;
+    if (sscanf(text, "%d,%d", &a, &b) != 2) return false;
+    first = a;
+    second = b;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        bool has_value = i + 1 < argc;
+        const char* value = has_value ? argv[i + 1] : "";
+        if (option == "--adaptive") { options.is_adaptive = true; continue; }
+        if (option == "--capture") { options.is_capture = true; continue; }
+        if (!has_value) option = "--help";
+        if (option == "--duration") options.duration = atof(value);
+        else if (option == "--sf") options.setting.spreading_factor = atoi(value);
+        else if (option == "--bw") options.setting.bandwidth = atoi(value) * 1000;
+        else if (option == "--cr") options.setting.coding_rate = atoi(value);
+        else if (option == "--fec") {
+            if (!ParsePair(value, options.fec_data, options.fec_parity) || options.fec_data < 1 || options.fec_data > PacketFec::max_data_frames ||
+                options.fec_parity < 1 || options.fec_parity > PacketFec::max_parity_frames) option = "--help";
+        }
+        else if (option == "--duty") options.duty_cycle = atof(value);
+        else if (option == "--baud") options.baud = atoi(value);
+        else if (option == "--board-queue") options.board_queue = atoi(value);
+        else if (option == "--loss-good") options.loss_good = atof(value) / 100.0f;
+        else if (option == "--loss-bad") options.loss_bad = atof(value) / 100.0f;
+        else if (option == "--good-time") options.good_time = atof(value);
+        else if (option == "--bad-time") options.bad_time = atof(value);
+        else if (option == "--snr-good") options.snr_good = atof(value);
+        else if (option == "--snr-bad") options.snr_bad = atof(value);
+        else if (option == "--rate") options.rate_scale = atof(value);
+        else if (option == "--seed") options.seed = atoi(value);
+        else option = "--help";
+        if (option == "--help") {
+            fprintf(stderr,
+                    "Usage: %s [--duration s] [--sf 7-12] [--bw kHz] [--cr 5-8] [--adaptive] [--fec K,M] [--duty %%] [--baud rate]\n"
+                    "          [--board-queue frames] [--loss-good %%] [--loss-bad %%] [--good-time s] [--bad-time s]\n"
+                    "          [--snr-good dB] [--snr-bad dB] [--rate factor] [--capture] [--seed n]\n", argv[0]);
+            return 1;
+        }
+        i++;
+    }
+    if (options.duty_cycle <= 0.0f || options.duty_cycle > 100.0f || options.rate_scale <= 0.0f) {
+        fprintf(stderr, "The duty cycle must be within 0 and 100%%, and the rate factor positive\n");
+        return 1;
+    }
+
+    static Simulation simulation(options); // Static, since the decoder keeps a copy of the recent frames.
+    simulation.Run();
+    simulation.Print();
+}
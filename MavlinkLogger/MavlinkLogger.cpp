@@ -0,0 +1,408 @@
+// Decodes the MAVLink stream of the boat into one folder per message, with one file per field, for the analysis of a race.
+// Build from this folder with: g++ -std=gnu++17 -O2 -I ../include MavlinkLogger.cpp -o MavlinkLogger
+// Run with: ./MavlinkLogger --serial /dev/ttyUSB0 --baud 921600 --definitions arariboat.xml --out race
+//       or: ./MavlinkLogger --udp 14550 --out race
+//       or: ./MavlinkLogger --file capture.mav --out race
+// Messages are described by their MAVLink XML definitions: the dialect of the boat, and the XML kept in the comments of
+// MavlinkExtensions.hpp, which is read by default. The layout on the wire and the CRC extra of each message are worked out from
+// its definition as Mavgen does, so the frames are checked and decoded without generated code. Frames of messages without a definition
+// are counted, and left out of the logs.
+// The parser hands over the frames in place in the read buffer, and each field is copied once, into a file mapped in memory that grows in
+// large steps, so the logger keeps up with a 921600 baud stream with a small fraction of a core.
+// Each column is a raw little endian array, named after the field, next to a columns.txt listing the type and the number of values of
+// each. Every message also gets the time it was received by the host, in us since the Unix epoch, and the header of its frame.
+// With numpy: np.fromfile("race/INSTRUMENTATION/battery_voltage.bin", np.float32)
+// The debug text the firmware prints between the frames is skipped. A summary of the stream is printed every few seconds.
+// POSIX only.
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "MavlinkFrameParser.hpp"
+
+struct FieldType {
+    const char* name;
+    uint8_t size;
+    const char* numpy; // Type of the column for numpy.
+};
+
+const FieldType field_types[] = {
+    { "uint64_t", 8, "uint64" }, { "int64_t", 8, "int64" }, { "double", 8, "float64" },
+    { "uint32_t", 4, "uint32" }, { "int32_t", 4, "int32" }, { "float", 4, "float32" },
+    { "uint16_t", 2, "uint16" }, { "int16_t", 2, "int16" },
+    { "uint8_t", 1, "uint8" }, { "int8_t", 1, "int8" }, { "char", 1, "uint8" },
+};
+
+struct Field {
+    std::string name;
+    const FieldType* type;
+    uint8_t count; // Values of an array, or 1.
+    bool is_extension; // After <extensions/>: sent after the other fields, in the order defined, and left out of the CRC extra.
+    uint8_t offset; // In the payload.
+};
+
+struct Message {
+    uint32_t id;
+    std::string name;
+    std::vector<Field> fields; // In the order of the wire.
+    uint8_t crc_extra;
+    uint16_t length;
+};
+
+/// @brief Reads the message definitions of a MAVLink XML file, or of the XML in the comments of a header. Tags are found line by line,
+/// which is how both are written.
+bool LoadDefinitions(const std::string& path, std::unordered_map<uint32_t, Message>& messages) {
+    std::ifstream file(path);
+    if (!file) return false;
+    auto Attribute = [](const std::string& line, const char* name) {
+        std::string key = std::string(name) + "=\"";
+        size_t start = line.find(key);
+        if (start == std::string::npos) return std::string();
+        start += key.size();
+        return line.substr(start, line.find('"', start) - start);
+    };
+
+    Message message;
+    bool is_open = false;
+    bool is_extension = false;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.find("<message ") != std::string::npos) {
+            message = Message();
+            message.id = std::stoul(Attribute(line, "id"));
+            message.name = Attribute(line, "name");
+            is_open = true;
+            is_extension = false;
+        } else if (is_open && line.find("<extensions") != std::string::npos) {
+            is_extension = true;
+        } else if (is_open && line.find("<field ") != std::string::npos) {
+            std::string type = Attribute(line, "type");
+            Field field = { Attribute(line, "name"), nullptr, 1, is_extension, 0 };
+            size_t bracket = type.find('[');
+            if (bracket != std::string::npos) {
+                field.count = std::stoi(type.substr(bracket + 1));
+                type = type.substr(0, bracket);
+            }
+            if (type == "uint8_t_mavlink_version") type = "uint8_t";
+            for (const FieldType& candidate : field_types) {
+                if (type == candidate.name) field.type = &candidate;
+            }
+            if (!field.type) {
+                fprintf(stderr, "%s: unknown type %s of %s.%s\n", path.c_str(), type.c_str(), message.name.c_str(), field.name.c_str());
+                return false;
+            }
+            message.fields.push_back(field);
+        } else if (is_open && line.find("</message>") != std::string::npos) {
+            is_open = false;
+            // Fields go on the wire from the largest type to the smallest, keeping the order of the definition among equal sizes.
+            std::stable_sort(message.fields.begin(), message.fields.end(), [](const Field& a, const Field& b) {
+                if (a.is_extension != b.is_extension) return !a.is_extension;
+                return !a.is_extension && a.type->size > b.type->size;
+            });
+            std::string header = message.name + " ";
+            uint16_t crc = MavlinkFrameParser::Crc((const uint8_t*)header.data(), header.size());
+            uint16_t offset = 0;
+            for (Field& field : message.fields) {
+                field.offset = offset;
+                offset += field.type->size * field.count;
+                if (field.is_extension) continue;
+                std::string text = std::string(field.type->name) + " " + field.name + " ";
+                crc = MavlinkFrameParser::Crc((const uint8_t*)text.data(), text.size(), crc);
+                if (field.count > 1) crc = MavlinkFrameParser::Crc(&field.count, 1, crc);
+            }
+            message.crc_extra = (crc & 0xFF) ^ (crc >> 8);
+            message.length = offset;
+            messages[message.id] = message;
+        }
+    }
+    return true;
+}
+
+/// @brief Array of values appended to a file mapped in memory, which grows in steps so the file is seldom remapped.
+class Column {
+public:
+    bool Open(const std::string& path) {
+        fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        return fd >= 0;
+    }
+
+    void Append(const void* data, size_t length) {
+        if (size + length > capacity) Grow(size + length);
+        memcpy(map + size, data, length);
+        size += length;
+    }
+
+    Column() = default;
+    Column(const Column&) = delete;
+    Column& operator=(const Column&) = delete;
+
+    /// @brief Writes the values appended so far to the file. The file keeps the size of the mapping, padded with zeros, until the column is
+    /// closed and trimmed to its values.
+    void Sync() {
+        if (map) msync(map, size, MS_ASYNC);
+    }
+
+    ~Column() {
+        if (map) munmap(map, capacity);
+        if (fd >= 0) {
+            if (ftruncate(fd, size) != 0) perror("ftruncate");
+            close(fd);
+        }
+    }
+
+private:
+    static constexpr size_t growth = 1 << 20; // Bytes.
+    int fd = -1;
+    uint8_t* map = nullptr;
+    size_t size = 0;
+    size_t capacity = 0;
+
+    void Grow(size_t needed) {
+        size_t new_capacity = std::max(capacity * 2, ((needed + growth - 1) / growth) * growth);
+        if (map) munmap(map, capacity);
+        if (ftruncate(fd, new_capacity) != 0) {
+            perror("ftruncate");
+            exit(1);
+        }
+        void* address = mmap(nullptr, new_capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED) {
+            perror("mmap");
+            exit(1);
+        }
+        map = static_cast<uint8_t*>(address);
+        capacity = new_capacity;
+    }
+};
+
+/// @brief Columns of one message, created with its first frame.
+struct Table {
+    const Message* message;
+    Column time; // us since the Unix epoch, when the host received the frame.
+    Column seq;
+    Column system_id;
+    Column component_id;
+    std::vector<Column> fields;
+    uint64_t frames = 0;
+    uint64_t last_frames = 0; // At the last summary.
+};
+
+class Logger {
+public:
+    std::unordered_map<uint32_t, Message> messages;
+    std::string output;
+
+    /// @brief Decodes the next bytes of the stream, received at a time given in us since the Unix epoch.
+    void Receive(const uint8_t* data, size_t length, int64_t time) {
+        parser.Parse(data, length, [&](uint32_t msgid) {
+            auto it = messages.find(msgid);
+            return it == messages.end() ? -1 : (int)it->second.crc_extra;
+        }, [&](const MavlinkFrameParser::Frame& frame) {
+            Table* table = GetTable(frame.msgid);
+            if (!table) {
+                unknown[frame.msgid]++;
+                return;
+            }
+            table->frames++;
+            if (output.empty()) return;
+            table->time.Append(&time, sizeof(time));
+            table->seq.Append(&frame.seq, 1);
+            table->system_id.Append(&frame.system_id, 1);
+            table->component_id.Append(&frame.component_id, 1);
+            // MAVLink 2 trims the zeros at the end of the payload, which are put back here.
+            uint8_t payload[256] = {};
+            memcpy(payload, frame.payload, frame.payload_length);
+            const std::vector<Field>& fields = table->message->fields;
+            for (size_t i = 0; i < fields.size(); i++) {
+                table->fields[i].Append(payload + fields[i].offset, fields[i].type->size * fields[i].count);
+            }
+        });
+    }
+
+    void PrintSummary(double interval) {
+        const MavlinkFrameParser::Statistics& statistics = parser.GetStatistics();
+        fprintf(stderr, "\n%.1f kB/s, %llu frames, %llu bad CRC, %llu bytes of text or noise\n", (statistics.bytes - last_bytes) / interval / 1000.0,
+                (unsigned long long)statistics.frames, (unsigned long long)statistics.bad_crc, (unsigned long long)statistics.skipped);
+        last_bytes = statistics.bytes;
+        std::vector<Table*> sorted;
+        for (auto& entry : tables) sorted.push_back(entry.second.get());
+        std::sort(sorted.begin(), sorted.end(), [](const Table* a, const Table* b) { return a->message->name < b->message->name; });
+        for (Table* table : sorted) {
+            fprintf(stderr, "  %-28s %10llu %8.2f Hz\n", table->message->name.c_str(), (unsigned long long)table->frames,
+                    (table->frames - table->last_frames) / interval);
+            table->last_frames = table->frames;
+        }
+        for (auto& entry : unknown) fprintf(stderr, "  %-28u %10llu  no definition\n", entry.first, (unsigned long long)entry.second);
+    }
+
+    void Sync() {
+        for (auto& entry : tables) {
+            Table& table = *entry.second;
+            table.time.Sync();
+            table.seq.Sync();
+            table.system_id.Sync();
+            table.component_id.Sync();
+            for (Column& column : table.fields) column.Sync();
+        }
+    }
+
+    uint64_t GetBytes() const { return parser.GetStatistics().bytes; }
+
+private:
+    MavlinkFrameParser::Parser parser;
+    std::unordered_map<uint32_t, std::unique_ptr<Table>> tables;
+    std::unordered_map<uint32_t, uint64_t> unknown;
+    uint64_t last_bytes = 0;
+
+    Table* GetTable(uint32_t msgid) {
+        auto it = tables.find(msgid);
+        if (it != tables.end()) return it->second.get();
+        auto message = messages.find(msgid);
+        if (message == messages.end()) return nullptr;
+
+        auto table = std::make_unique<Table>();
+        table->message = &message->second;
+        if (!output.empty()) {
+            std::string folder = output + "/" + message->second.name;
+            mkdir(folder.c_str(), 0755);
+            std::ofstream schema(folder + "/columns.txt");
+            schema << "time int64 1\nseq uint8 1\nsystem_id uint8 1\ncomponent_id uint8 1\n";
+            bool is_open = table->time.Open(folder + "/time.bin") && table->seq.Open(folder + "/seq.bin") &&
+                           table->system_id.Open(folder + "/system_id.bin") && table->component_id.Open(folder + "/component_id.bin");
+            table->fields = std::vector<Column>(message->second.fields.size());
+            for (size_t i = 0; i < message->second.fields.size(); i++) {
+                const Field& field = message->second.fields[i];
+                schema << field.name << " " << field.type->numpy << " " << (int)field.count << "\n";
+                is_open = table->fields[i].Open(folder + "/" + field.name + ".bin") && is_open;
+            }
+            if (!is_open) {
+                perror(folder.c_str());
+                exit(1);
+            }
+        }
+        return (tables[msgid] = std::move(table)).get();
+    }
+};
+
+int64_t NowUnixMicros() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+/// @brief Opens a serial port or pty in raw mode, or a file holding a capture.
+int OpenSerial(const char* path, int baud) {
+    int fd = open(path, O_RDONLY | O_NOCTTY);
+    if (fd < 0 || !isatty(fd)) return fd;
+    termios options;
+    tcgetattr(fd, &options);
+    cfmakeraw(&options);
+    speed_t speed = baud == 9600 ? B9600 : baud == 57600 ? B57600 : baud == 230400 ? B230400 : baud == 460800 ? B460800
+                  : baud == 921600 ? B921600 : baud == 2000000 ? B2000000 : B115200;
+    cfsetispeed(&options, speed);
+    cfsetospeed(&options, speed);
+    tcsetattr(fd, TCSANOW, &options);
+    return fd;
+}
+
+volatile sig_atomic_t is_running = 1;
+
+int main(int argc, char** argv) {
+    const char* serial_path = nullptr;
+    const char* file_path = nullptr;
+    int baud = 921600;
+    int udp_port = 0;
+    double summary_interval = 5.0;
+    std::vector<std::string> definitions;
+    static Logger logger;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        if (option == "--serial") serial_path = argv[i + 1];
+        else if (option == "--file") file_path = argv[i + 1];
+        else if (option == "--baud") baud = atoi(argv[i + 1]);
+        else if (option == "--udp") udp_port = atoi(argv[i + 1]);
+        else if (option == "--out") logger.output = argv[i + 1];
+        else if (option == "--definitions") definitions.push_back(argv[i + 1]);
+        else if (option == "--summary") summary_interval = atof(argv[i + 1]);
+        else {
+            fprintf(stderr, "Usage: %s (--serial device [--baud rate] | --udp port | --file capture) [--definitions xml]... [--out folder] "
+                            "[--summary s]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (!!serial_path + !!file_path + !!udp_port != 1 || summary_interval <= 0.0) {
+        fprintf(stderr, "Give one of --serial, --udp or --file, and a positive summary interval\n");
+        return 1;
+    }
+    if (definitions.empty()) definitions.push_back("../include/MavlinkExtensions.hpp");
+    for (const std::string& path : definitions) {
+        if (!LoadDefinitions(path, logger.messages)) {
+            fprintf(stderr, "Cannot read the definitions in %s\n", path.c_str());
+            return 1;
+        }
+    }
+    fprintf(stderr, "%zu message definitions\n", logger.messages.size());
+    if (!logger.output.empty() && mkdir(logger.output.c_str(), 0755) != 0 && errno != EEXIST) {
+        perror(logger.output.c_str());
+        return 1;
+    }
+
+    int fd;
+    if (udp_port) {
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in local = {};
+        local.sin_family = AF_INET;
+        local.sin_port = htons(udp_port);
+        local.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(fd, (const sockaddr*)&local, sizeof(local)) < 0) fd = -1;
+    } else {
+        fd = OpenSerial(serial_path ? serial_path : file_path, baud);
+    }
+    if (fd < 0) {
+        perror(udp_port ? "bind" : (serial_path ? serial_path : file_path));
+        return 1;
+    }
+
+    signal(SIGINT, [](int) { is_running = 0; });
+    signal(SIGTERM, [](int) { is_running = 0; });
+    static uint8_t buffer[1 << 16];
+    auto start = std::chrono::steady_clock::now();
+    auto summary_time = start;
+    while (is_running) {
+        pollfd descriptor = { fd, POLLIN, 0 };
+        if (!file_path && poll(&descriptor, 1, 100) <= 0) continue;
+        ssize_t length = read(fd, buffer, sizeof(buffer)); // A datagram holds whole frames, so it is read the same way.
+        if (length > 0) {
+            logger.Receive(buffer, length, NowUnixMicros());
+        } else if (file_path) {
+            break; // End of the capture.
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - summary_time).count();
+        if (!file_path && elapsed >= summary_interval) {
+            summary_time = now;
+            logger.PrintSummary(elapsed);
+            logger.Sync();
+        }
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    logger.PrintSummary(elapsed);
+    fprintf(stderr, "%.1f MB decoded in %.2f s\n", logger.GetBytes() / 1e6, elapsed);
+    close(fd);
+}
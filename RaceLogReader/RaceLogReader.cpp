@@ -0,0 +1,205 @@
+// Reads the race log the boat keeps on its SD card or in the "racelog" partition of its flash, lists the sessions it holds and exports
+// the frames of a session, a time span or a few message types as a MAVLink stream, which MavlinkLogger turns into columns.
+// Build from this folder with: g++ -std=gnu++17 -O2 -I ../include RaceLogReader.cpp -o RaceLogReader
+// Run with: ./RaceLogReader racelog.bin [--format bin|lz4] [--boot id] [--from ms] [--to ms] [--msgid id]... [--export race.mav]
+// The flash partition is read with: esptool.py read_flash <offset> <size> racelog.bin, with the offset and size of the partition table,
+// or over the network from /log/export of the boat, as stored (format=bin) or as an LZ4 frame (format=lz4), which is decompressed in
+// memory, or beforehand by lz4 -d into an image as stored.
+// An image as stored is mapped in memory and never copied: blocks are found by their index, and the ones outside the span or without the
+// requested types are skipped from their headers alone, so only the blocks exported are read whole. Blocks are put in the order they were
+// written by their sequence number, which also undoes the wrap of the ring on the flash. Blocks torn by a power cut, erased or left from
+// an older pass of the ring fail their CRC and are counted apart.
+// POSIX only.
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <vector>
+#include "RaceLogExport.hpp"
+
+struct Filter {
+    bool has_boot = false;
+    uint32_t boot = 0;
+    uint32_t from = 0; // ms since boot
+    uint32_t to = UINT32_MAX;
+    std::vector<uint32_t> msgids; // Every type when empty.
+
+    bool IsWanted(uint32_t msgid) const {
+        return msgids.empty() || std::find(msgids.begin(), msgids.end(), msgid) != msgids.end();
+    }
+
+    /// @brief Whether a block may hold records that pass, from its header alone.
+    bool MayMatch(const RaceLog::BlockHeader& header) const {
+        if (has_boot && header.boot != boot) return false;
+        if (header.last_time < from || header.first_time > to) return false;
+        if (msgids.empty() || (header.flags & RaceLog::flag_type_overflow)) return true;
+        for (uint8_t i = 0; i < header.number_types && i < RaceLog::max_types; i++) {
+            if (IsWanted(header.types[i].msgid)) return true;
+        }
+        return false;
+    }
+};
+
+struct Session {
+    uint32_t boot;
+    uint32_t first_block;
+    uint32_t blocks = 0;
+    uint32_t records = 0;
+    uint32_t first_time;
+    uint32_t last_time;
+    int64_t first_utc = 0; // Of the first block written with the clock set.
+};
+
+std::string FormatUtc(int64_t utc) {
+    if (!utc) return "unknown";
+    time_t seconds = utc / 1000000;
+    char text[32];
+    strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%SZ", gmtime(&seconds));
+    return text;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s image [--format bin|lz4] [--boot id] [--from ms] [--to ms] [--msgid id]... [--export file]\n", argv[0]);
+        return 1;
+    }
+    const char* image_path = argv[1];
+    const char* export_path = nullptr;
+    bool is_compressed = false;
+    Filter filter;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        if (option == "--boot") {
+            filter.has_boot = true;
+            filter.boot = strtoul(argv[i + 1], nullptr, 0);
+        }
+        else if (option == "--from") filter.from = strtoul(argv[i + 1], nullptr, 0);
+        else if (option == "--to") filter.to = strtoul(argv[i + 1], nullptr, 0);
+        else if (option == "--msgid") filter.msgids.push_back(strtoul(argv[i + 1], nullptr, 0));
+        else if (option == "--export") export_path = argv[i + 1];
+        else if (option == "--format") is_compressed = std::string(argv[i + 1]) == "lz4";
+        else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    int fd = open(image_path, O_RDONLY);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0) {
+        perror(image_path);
+        return 1;
+    }
+    if (!status.st_size) {
+        fprintf(stderr, "%s is empty\n", image_path);
+        return 1;
+    }
+    const uint8_t* image = static_cast<const uint8_t*>(mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0));
+    if (image == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    size_t number_blocks = status.st_size / RaceLog::block_size;
+    // An LZ4 frame, as the boat writes it: the header, then each block preceded by its size, whose top bit marks a block stored as is,
+    // and a size of zero to end.
+    std::vector<uint8_t> decompressed;
+    if (is_compressed) {
+        size_t offset = sizeof(RaceLog::lz4_frame_header);
+        if ((size_t)status.st_size < offset || memcmp(image, RaceLog::lz4_frame_header, offset)) {
+            fprintf(stderr, "%s is not an LZ4 frame of the race log\n", image_path);
+            return 1;
+        }
+        bool is_ended = false;
+        while (offset + 4 <= (size_t)status.st_size) {
+            uint32_t size = image[offset] | image[offset + 1] << 8 | image[offset + 2] << 16 | (uint32_t)image[offset + 3] << 24;
+            offset += 4;
+            if (!size) {
+                is_ended = true;
+                break;
+            }
+            size_t length = size & ~RaceLog::lz4_uncompressed_flag;
+            if (length > RaceLog::block_size || offset + length > (size_t)status.st_size) break;
+            decompressed.resize(decompressed.size() + RaceLog::block_size);
+            uint8_t* block = decompressed.data() + decompressed.size() - RaceLog::block_size;
+            if (size & RaceLog::lz4_uncompressed_flag) {
+                if (length == RaceLog::block_size) memcpy(block, image + offset, length);
+                else memset(block, 0, RaceLog::block_size);
+            } else if (RaceLog::Decompress(image + offset, length, block, RaceLog::block_size) != RaceLog::block_size) {
+                memset(block, 0, RaceLog::block_size);
+            }
+            offset += length;
+        }
+        if (!is_ended) fprintf(stderr, "%s ends with a cut block\n", image_path);
+        image = decompressed.data();
+        number_blocks = decompressed.size() / RaceLog::block_size;
+    }
+    if (!number_blocks) {
+        fprintf(stderr, "%s holds no whole block\n", image_path);
+        return 1;
+    }
+    auto get_block = [&](uint32_t index) { return image + (size_t)index * RaceLog::block_size; };
+    auto get_header = [&](uint32_t index) { return reinterpret_cast<const RaceLog::BlockHeader*>(get_block(index)); };
+
+    // Erased sectors are told apart from damaged blocks by their magic, without reading the whole block.
+    std::vector<uint32_t> order;
+    uint32_t erased = 0, invalid = 0;
+    for (uint32_t i = 0; i < number_blocks; i++) {
+        if (get_header(i)->magic != RaceLog::magic) erased++;
+        else if (!RaceLog::IsValid(get_block(i))) invalid++;
+        else order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return get_header(a)->sequence < get_header(b)->sequence; });
+
+    std::vector<Session> sessions;
+    for (uint32_t index : order) {
+        const RaceLog::BlockHeader& header = *get_header(index);
+        if (sessions.empty() || sessions.back().boot != header.boot) {
+            Session session;
+            session.boot = header.boot;
+            session.first_block = header.sequence;
+            session.first_time = header.first_time;
+            sessions.push_back(session);
+        }
+        Session& session = sessions.back();
+        session.blocks++;
+        session.records += header.records;
+        session.last_time = header.last_time;
+        if (!session.first_utc && header.first_utc) {
+            session.first_utc = header.first_utc - (int64_t)(header.first_time - session.first_time) * 1000;
+        }
+    }
+
+    printf("%zu blocks: %zu valid, %u erased, %u damaged\n", number_blocks, order.size(), erased, invalid);
+    printf("%-10s %10s %8s %10s %12s %12s  %s\n", "boot", "first", "blocks", "records", "from_ms", "to_ms", "start_utc");
+    for (const Session& session : sessions) {
+        printf("0x%08x %10u %8u %10u %12u %12u  %s\n", session.boot, session.first_block, session.blocks, session.records,
+               session.first_time, session.last_time, FormatUtc(session.first_utc).c_str());
+    }
+    if (!export_path) return 0;
+
+    FILE* output = fopen(export_path, "wb");
+    if (!output) {
+        perror(export_path);
+        return 1;
+    }
+    uint32_t read_blocks = 0, exported = 0;
+    for (uint32_t index : order) {
+        if (!filter.MayMatch(*get_header(index))) continue;
+        read_blocks++;
+        RaceLog::ForEachRecord(get_block(index), [&](const RaceLog::RecordHeader& record, const uint8_t* frame, uint16_t length) {
+            uint32_t msgid = frame[0] == 0xFD ? frame[7] | frame[8] << 8 | frame[9] << 16 : frame[5];
+            if (record.time < filter.from || record.time > filter.to || !filter.IsWanted(msgid)) return;
+            fwrite(frame, 1, length, output);
+            exported++;
+        });
+    }
+    fclose(output);
+    printf("Exported %u frames from %u blocks to %s\n", exported, read_blocks, export_path);
+    return 0;
+}
@@ -0,0 +1,109 @@
+// Checks the accuracy and the cost per frame of the SpectrumAnalyzer used by the firmware, against a plain DFT computed in double precision.
+// Build from this folder with: g++ -std=gnu++17 -O2 -I ../include SpectrumBenchmark.cpp -o SpectrumBenchmark
+// The timings are for the host, so they only compare the two methods. On the ESP32, the firmware prints the time taken by each frame in debug builds.
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "SpectrumAnalyzer.hpp"
+
+constexpr uint16_t frame_length = 256;
+constexpr float sample_rate = 250.0f; // Rate of each current channel in the instrumentation reader.
+constexpr float band_edges[] = {1.0f, 10.0f, 30.0f, 60.0f, 125.0f};
+
+using Analyzer = SpectrumAnalyzer<frame_length>;
+
+// Reference one-sided spectrum, with the same mean removal and window as the analyzer.
+void ReferenceTransform(const float* samples, std::vector<double>& real, std::vector<double>& imag) {
+    double mean = 0.0;
+    for (uint16_t n = 0; n < frame_length; n++) mean += samples[n];
+    mean /= frame_length;
+    for (uint16_t k = 0; k <= frame_length / 2; k++) {
+        double sum_real = 0.0, sum_imag = 0.0;
+        for (uint16_t n = 0; n < frame_length; n++) {
+            double window = 0.5 - 0.5 * std::cos(2.0 * M_PI * n / frame_length);
+            double value = (samples[n] - mean) * window;
+            sum_real += value * std::cos(2.0 * M_PI * k * n / frame_length);
+            sum_imag -= value * std::sin(2.0 * M_PI * k * n / frame_length);
+        }
+        real[k] = sum_real;
+        imag[k] = sum_imag;
+    }
+}
+
+// Motor current as seen by the ADS1115: a DC level, a few ripple components and white noise.
+std::vector<float> GenerateFrame(std::mt19937& generator, float dc, const std::vector<std::pair<float, float>>& components, float noise) {
+    std::normal_distribution<float> distribution(0.0f, noise);
+    std::uniform_real_distribution<float> phase_distribution(0.0f, 2.0f * M_PI);
+    std::vector<float> phases;
+    for (size_t i = 0; i < components.size(); i++) phases.push_back(phase_distribution(generator));
+    std::vector<float> frame(frame_length);
+    for (uint16_t n = 0; n < frame_length; n++) {
+        float t = n / sample_rate;
+        float value = dc + distribution(generator);
+        for (size_t i = 0; i < components.size(); i++) {
+            value += components[i].second * std::sin(2.0f * M_PI * components[i].first * t + phases[i]);
+        }
+        frame[n] = value;
+    }
+    return frame;
+}
+
+int main() {
+    static Analyzer analyzer(band_edges); // Static, as on the device, since the tables take a few kilobytes.
+    std::mt19937 generator(1234);
+
+    // Accuracy of the spectrum against the reference, over random frames.
+    std::vector<float> real(frame_length / 2 + 1), imag(frame_length / 2 + 1);
+    std::vector<double> reference_real(frame_length / 2 + 1), reference_imag(frame_length / 2 + 1);
+    double max_error = 0.0, max_magnitude = 0.0;
+    std::uniform_real_distribution<float> frequency_distribution(2.0f, 120.0f);
+    for (int trial = 0; trial < 50; trial++) {
+        std::vector<float> frame = GenerateFrame(generator, 40.0f, {{frequency_distribution(generator), 3.0f}, {frequency_distribution(generator), 1.0f}}, 0.2f);
+        analyzer.Transform(frame.data(), real.data(), imag.data());
+        ReferenceTransform(frame.data(), reference_real, reference_imag);
+        for (uint16_t k = 0; k <= frame_length / 2; k++) {
+            max_error = std::max(max_error, std::hypot(real[k] - reference_real[k], imag[k] - reference_imag[k]));
+            max_magnitude = std::max(max_magnitude, std::hypot(reference_real[k], reference_imag[k]));
+        }
+    }
+    std::cout << std::setprecision(4);
+    std::cout << "Largest bin error relative to the largest bin: " << max_error / max_magnitude << "\n";
+
+    // Frequencies and amplitudes recovered from a known signal.
+    const std::vector<std::pair<float, float>> components = {{23.7f, 4.0f}, {61.2f, 1.5f}, {8.4f, 0.8f}};
+    std::vector<float> frame = GenerateFrame(generator, 55.0f, components, 0.1f);
+    Analyzer::Summary summary = analyzer.Analyze(frame.data(), sample_rate);
+    std::cout << "\nDC: " << summary.dc << " A (expected 55)\n";
+    for (uint8_t i = 0; i < Analyzer::number_peaks; i++) {
+        std::cout << "Peak " << (int)i << ": " << summary.peak_frequency[i] << " Hz, " << summary.peak_amplitude[i] << " A"
+                  << " (expected " << components[i].first << " Hz, " << components[i].second << " A)\n";
+    }
+    for (uint8_t i = 0; i < Analyzer::number_bands; i++) {
+        std::cout << "Band " << band_edges[i] << "-" << band_edges[i + 1] << " Hz: " << summary.band_rms[i] << " A RMS\n";
+    }
+    std::cout << "Expected RMS of each component: ";
+    for (const auto& component : components) std::cout << component.second / std::sqrt(2.0f) << " ";
+    std::cout << "\n";
+
+    // Cost per frame.
+    constexpr int iterations = 20000;
+    volatile float sink = 0.0f; // Keeps the compiler from removing the loops.
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        sink = sink + analyzer.Analyze(frame.data(), sample_rate).dc;
+    }
+    auto analyzer_time = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+    constexpr int reference_iterations = 20;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < reference_iterations; i++) {
+        ReferenceTransform(frame.data(), reference_real, reference_imag);
+        sink = sink + reference_real[1];
+    }
+    auto reference_time = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / reference_iterations;
+
+    std::cout << "\nAnalyzer: " << analyzer_time << " us per frame\nReference DFT: " << reference_time << " us per frame\n";
+}
@@ -0,0 +1,440 @@
+// Merges the two telemetry paths of the boat into one stream without duplicates: the MAVLink frames of the LoRa ground station, read from
+// its serial port, and the UDP datagrams the boat sends through the 4G router.
+// Build from this folder with: g++ -std=gnu++17 -O2 -I ../include TelemetryMerger.cpp -o TelemetryMerger
+// Run with: ./TelemetryMerger --lora /dev/ttyUSB0 --baud 115200 --udp 14550 --forward 127.0.0.1:14560 --out race.mav
+// Every telemetry sample carries the sequence number of its stream on both paths, named by the STREAM_STAMPS messages, so the first copy
+// of a sample is passed on and later ones are dropped. Frames that are not telemetry, such as alarms, are told apart by their content.
+// Lost LoRa frames are rebuilt from the parity frames when the boat has forward error correction on.
+// Every 2 s the merger reports to the boat, over UDP, the samples each path delivered and missed and the echo of the last TIME_SYNC
+// each path carried, which the boat uses to choose the paths of the next frames. A summary of both paths is printed every 5 s.
+// POSIX only.
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "MavlinkFrameParser.hpp"
+#include "PacketFec.hpp"
+#include "TelemetryFanout.hpp"
+
+// Messages of MavlinkExtensions.hpp the merger reads or writes, repeated here since that header needs the dialect of the firmware build.
+// Streams of TelemetryStreams.hpp, which needs the Arduino core.
+constexpr uint8_t number_streams = 10;
+
+constexpr uint32_t msg_id_fec_parity = 53007;
+constexpr uint32_t msg_id_reliable_message = 53008;
+constexpr uint32_t msg_id_reliable_ack = 53009;
+constexpr uint32_t msg_id_stream_stamps = 53010;
+constexpr uint32_t msg_id_time_sync = 53011;
+constexpr uint32_t msg_id_path_report = 53012;
+
+#pragma pack(push, 1)
+struct StreamStamps {
+    uint32_t time_boot_ms;
+    uint16_t stream_seq[8];
+    int16_t sample_offset[8];
+    uint8_t count;
+    uint8_t frame_seq[8];
+    uint8_t stream[8];
+};
+struct TimeSync {
+    uint64_t time_unix_usec;
+    uint32_t time_boot_ms;
+    uint16_t airtime;
+};
+struct PathReport {
+    uint32_t echo_time_boot_ms;
+    uint16_t received;
+    uint16_t lost;
+    uint16_t echo_delay;
+    uint8_t path;
+};
+struct ReliableMessage {
+    uint16_t seq;
+    uint8_t session;
+    uint8_t length;
+    uint8_t frame[225];
+};
+#pragma pack(pop)
+
+int CrcExtra(uint32_t msgid) {
+    switch (msgid) {
+        case 53000: return 235; // ALARM
+        case msg_id_fec_parity: return 188;
+        case msg_id_reliable_message: return 88;
+        case msg_id_reliable_ack: return 24;
+        case msg_id_stream_stamps: return 186;
+        case msg_id_time_sync: return 218;
+        case msg_id_path_report: return 253;
+        default: return -1; // Messages of the dialect pass unchecked; the LoRa ground station checks them already.
+    }
+}
+
+// Messages about the paths themselves, which are not passed on.
+bool IsLinkMessage(uint32_t msgid) {
+    return msgid == msg_id_fec_parity || msgid == msg_id_reliable_ack || msgid == msg_id_stream_stamps || msgid == msg_id_time_sync ||
+           msgid == msg_id_path_report;
+}
+
+uint32_t NowMs() {
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+constexpr uint32_t pending_timeout = 3000; // ms a frame waits for its stamps before it is passed on as if it were not telemetry.
+constexpr uint32_t unstamped_window = 30000; // ms during which a copy of a frame that is not telemetry counts as a duplicate.
+constexpr uint32_t report_interval = 2000; // ms
+constexpr uint32_t summary_interval = 5000; // ms
+
+struct PathState {
+    MavlinkFrameParser::Parser parser;
+    // Frames waiting for the STREAM_STAMPS message that names their sample, by the sequence number of the path.
+    struct Pending {
+        std::vector<uint8_t> frame;
+        uint32_t arrival;
+    };
+    std::unordered_map<uint8_t, Pending> pending;
+    int32_t highest_seq[number_streams];
+    uint32_t time_sync_boot_ms = 0;
+    uint32_t time_sync_arrival = 0;
+    // Since the last report to the boat.
+    uint32_t received = 0;
+    uint32_t lost = 0;
+    // Since the start.
+    uint64_t samples = 0;
+    uint64_t samples_lost = 0;
+    uint64_t first = 0; // Samples this path delivered before the other one, or alone.
+    uint64_t duplicates = 0;
+    uint64_t unstamped = 0;
+
+    PathState() {
+        for (int32_t& seq : highest_seq) seq = -1;
+    }
+};
+
+class Merger {
+public:
+    FILE* output = nullptr;
+    int forward_socket = -1;
+    sockaddr_in forward_address = {};
+
+    PathState paths[NumberTelemetryPaths];
+    PacketFec::Decoder fec_decoder; // Rebuilds the LoRa frames lost, when the boat sends parity frames.
+    uint64_t frames_out = 0;
+
+    Merger() {
+        for (auto& bits : delivered) bits.assign(65536 / 8, 0);
+    }
+
+    /// @brief Takes the bytes received on a path, which may cut frames anywhere.
+    void Receive(TelemetryPath path, const uint8_t* data, size_t length) {
+        auto OnPathFrame = [&](const MavlinkFrameParser::Frame& frame) {
+            if (path == LoraPath && frame.msgid != msg_id_fec_parity) fec_decoder.ReceiveData(frame.data, frame.length);
+            OnFrame(path, frame);
+        };
+        paths[path].parser.Parse(data, length, CrcExtra, OnPathFrame);
+        // Frames rebuilt from the parity frames are whole, and are taken once the parser of the path is done with the buffer, since it
+        // cannot be entered again while it consumes. A rebuilt frame may complete a group in turn, so the list can grow as it is read.
+        for (size_t i = 0; i < recovered.size(); i++) {
+            std::vector<uint8_t> frame = std::move(recovered[i]);
+            recovered_parser.Parse(frame.data(), frame.size(), CrcExtra, OnPathFrame);
+        }
+        recovered.clear();
+    }
+
+    /// @brief Passes on the frames whose stamps never came.
+    void Expire(uint32_t now) {
+        for (uint8_t path = 0; path < NumberTelemetryPaths; path++) {
+            auto& pending = paths[path].pending;
+            for (auto it = pending.begin(); it != pending.end();) {
+                if (now - it->second.arrival < pending_timeout) {
+                    ++it;
+                    continue;
+                }
+                DeliverUnstamped((TelemetryPath)path, it->second.frame.data(), it->second.frame.size(), now);
+                it = pending.erase(it);
+            }
+        }
+        for (auto it = unstamped_seen.begin(); it != unstamped_seen.end();) {
+            it = now - it->second >= unstamped_window ? unstamped_seen.erase(it) : std::next(it);
+        }
+    }
+
+    /// @brief Builds the report of a path for the boat, and starts counting the next interval.
+    uint16_t BuildReport(TelemetryPath path, uint8_t* frame, uint32_t now) {
+        PathState& state = paths[path];
+        PathReport report = {};
+        report.path = path;
+        report.received = state.received > UINT16_MAX ? UINT16_MAX : state.received;
+        report.lost = state.lost > UINT16_MAX ? UINT16_MAX : state.lost;
+        if (state.time_sync_boot_ms) {
+            report.echo_time_boot_ms = state.time_sync_boot_ms;
+            uint32_t delay = now - state.time_sync_arrival;
+            report.echo_delay = delay > UINT16_MAX ? UINT16_MAX : delay;
+        }
+        state.received = 0;
+        state.lost = 0;
+        return MavlinkFrameParser::Build(frame, report_seq++, 255, 190, msg_id_path_report, &report, sizeof(report), CrcExtra(msg_id_path_report));
+    }
+
+    void PrintSummary() const {
+        fprintf(stderr, "\n%-6s %10s %10s %8s %10s %10s %10s\n", "path", "samples", "lost", "loss", "first", "duplicate", "unstamped");
+        for (uint8_t path = 0; path < NumberTelemetryPaths; path++) {
+            const PathState& state = paths[path];
+            double loss = state.samples + state.samples_lost ? 100.0 * state.samples_lost / (state.samples + state.samples_lost) : 0.0;
+            fprintf(stderr, "%-6s %10llu %10llu %7.1f%% %10llu %10llu %10llu\n", TelemetryFanout::GetName((TelemetryPath)path),
+                    (unsigned long long)state.samples, (unsigned long long)state.samples_lost, loss, (unsigned long long)state.first,
+                    (unsigned long long)state.duplicates, (unsigned long long)state.unstamped);
+        }
+        const PacketFec::Decoder::Statistics& fec = fec_decoder.GetStatistics();
+        fprintf(stderr, "merged frames %llu, LoRa frames rebuilt %u, bad CRC lora %llu ip %llu\n", (unsigned long long)frames_out,
+                fec.frames_recovered, (unsigned long long)paths[LoraPath].parser.GetStatistics().bad_crc,
+                (unsigned long long)paths[IpPath].parser.GetStatistics().bad_crc);
+    }
+
+private:
+    std::vector<uint8_t> delivered[number_streams]; // One bit per stream sequence number.
+    std::unordered_map<std::string, uint32_t> unstamped_seen; // Content of recent frames that are not telemetry, and when they were seen.
+    std::vector<std::vector<uint8_t>> recovered; // LoRa frames rebuilt during the parse of a buffer.
+    MavlinkFrameParser::Parser recovered_parser;
+    uint8_t report_seq = 0;
+
+    void OnFrame(TelemetryPath path, const MavlinkFrameParser::Frame& frame) {
+        PathState& state = paths[path];
+        uint32_t now = NowMs();
+        switch (frame.msgid) {
+            case msg_id_stream_stamps: {
+                StreamStamps stamps;
+                frame.Decode(&stamps, sizeof(stamps));
+                for (uint8_t i = 0; i < stamps.count && i < 8; i++) {
+                    if (stamps.stream[i] >= number_streams) continue;
+                    auto it = state.pending.find(stamps.frame_seq[i]);
+                    if (it == state.pending.end()) continue;
+                    DeliverSample(path, stamps.stream[i], stamps.stream_seq[i], it->second.frame);
+                    state.pending.erase(it);
+                }
+                break;
+            }
+            case msg_id_time_sync: {
+                TimeSync time_sync;
+                frame.Decode(&time_sync, sizeof(time_sync));
+                state.time_sync_boot_ms = time_sync.time_boot_ms;
+                state.time_sync_arrival = now;
+                break;
+            }
+            case msg_id_fec_parity: {
+                PacketFec::Parity parity = {};
+                const uint8_t header_length = 5;
+                if (frame.payload_length < header_length) break;
+                parity.group = frame.payload[0];
+                parity.first_seq = frame.payload[1];
+                parity.data_frames = frame.payload[2];
+                parity.parity_frames = frame.payload[3];
+                parity.index = frame.payload[4];
+                parity.length = frame.payload_length - header_length;
+                memcpy(parity.data, frame.payload + header_length, parity.length);
+                fec_decoder.ReceiveParity(parity, [&](const uint8_t* data, uint16_t length) { recovered.emplace_back(data, data + length); });
+                break;
+            }
+            default:
+                if (IsLinkMessage(frame.msgid)) break;
+                // Kept until the stamps say whether it is a telemetry sample. A frame already waiting with the same sequence number is
+                // from a previous wrap, so it had no stamps.
+                auto it = state.pending.find(frame.seq);
+                if (it != state.pending.end()) DeliverUnstamped(path, it->second.frame.data(), it->second.frame.size(), now);
+                state.pending[frame.seq] = { std::vector<uint8_t>(frame.data, frame.data + frame.length), now };
+                break;
+        }
+    }
+
+    void DeliverSample(TelemetryPath path, uint8_t stream, uint16_t seq, const std::vector<uint8_t>& frame) {
+        PathState& state = paths[path];
+        // Samples skipped by this path since the highest one it delivered. Sequence numbers going far back mean the boat restarted.
+        if (state.highest_seq[stream] >= 0) {
+            int16_t gap = (int16_t)(uint16_t)(seq - (uint16_t)state.highest_seq[stream]);
+            if (gap > 1 && gap < 1000) {
+                state.lost += gap - 1;
+                state.samples_lost += gap - 1;
+            }
+            if (gap > 0 || gap < -1000) state.highest_seq[stream] = seq;
+        } else {
+            state.highest_seq[stream] = seq;
+        }
+        state.received++;
+        state.samples++;
+
+        std::vector<uint8_t>& bits = delivered[stream];
+        if (bits[seq / 8] & (1 << (seq % 8))) {
+            state.duplicates++;
+            return;
+        }
+        bits[seq / 8] |= 1 << (seq % 8);
+        uint16_t stale = seq + 32768; // Forgotten, so the sequence numbers of the next wrap are taken as new.
+        bits[stale / 8] &= ~(1 << (stale % 8));
+        state.first++;
+        Output(frame.data(), frame.size());
+    }
+
+    void DeliverUnstamped(TelemetryPath path, const uint8_t* data, size_t length, uint32_t now) {
+        PathState& state = paths[path];
+        MavlinkFrameParser::Parser parser;
+        const uint8_t* content = data;
+        size_t content_length = length;
+        // Reliable envelopes only reach the ground over LoRa, and their content over IP, so the content is what is compared, and what is
+        // passed on, since the envelope is a matter of the link.
+        std::vector<uint8_t> inner;
+        parser.Parse(data, length, CrcExtra, [&](const MavlinkFrameParser::Frame& frame) {
+            if (frame.msgid != msg_id_reliable_message) return;
+            ReliableMessage envelope;
+            frame.Decode(&envelope, sizeof(envelope));
+            inner.assign(envelope.frame, envelope.frame + (envelope.length < sizeof(envelope.frame) ? envelope.length : sizeof(envelope.frame)));
+        });
+        if (!inner.empty()) {
+            content = inner.data();
+            content_length = inner.size();
+        }
+        // Compared without the sequence number, which each path numbers on its own, and the CRC that covers it.
+        std::string key;
+        if (content_length > MavlinkFrameParser::v2_header_length + 2) {
+            key.assign((const char*)content + 5, content_length - 7);
+        }
+        state.unstamped++;
+        auto it = unstamped_seen.find(key);
+        if (it != unstamped_seen.end()) {
+            state.duplicates++;
+            return;
+        }
+        unstamped_seen[key] = now;
+        Output(content, content_length);
+    }
+
+    void Output(const uint8_t* data, size_t length) {
+        frames_out++;
+        if (output) fwrite(data, 1, length, output);
+        if (forward_socket >= 0) sendto(forward_socket, data, length, 0, (const sockaddr*)&forward_address, sizeof(forward_address));
+    }
+};
+
+/// @brief Opens the serial port of the LoRa ground station in raw mode, or a file or pipe holding a capture.
+int OpenLora(const char* path, int baud) {
+    int fd = open(path, O_RDONLY | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0 || !isatty(fd)) return fd;
+    termios options;
+    tcgetattr(fd, &options);
+    cfmakeraw(&options);
+    speed_t speed = baud == 9600 ? B9600 : baud == 57600 ? B57600 : baud == 230400 ? B230400 : baud == 460800 ? B460800 : baud == 921600 ? B921600 : B115200;
+    cfsetispeed(&options, speed);
+    cfsetospeed(&options, speed);
+    tcsetattr(fd, TCSANOW, &options);
+    return fd;
+}
+
+bool ParseAddress(const std::string& text, sockaddr_in& address) {
+    size_t colon = text.rfind(':');
+    if (colon == std::string::npos) return false;
+    address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(atoi(text.c_str() + colon + 1));
+    return inet_pton(AF_INET, text.substr(0, colon).c_str(), &address.sin_addr) == 1;
+}
+
+int main(int argc, char** argv) {
+    const char* lora_path = nullptr;
+    int baud = 115200;
+    int udp_port = 14550;
+    const char* forward = nullptr;
+    const char* output_path = nullptr;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        if (option == "--lora") lora_path = argv[i + 1];
+        else if (option == "--baud") baud = atoi(argv[i + 1]);
+        else if (option == "--udp") udp_port = atoi(argv[i + 1]);
+        else if (option == "--forward") forward = argv[i + 1];
+        else if (option == "--out") output_path = argv[i + 1];
+        else {
+            fprintf(stderr, "Usage: %s [--lora device] [--baud rate] [--udp port] [--forward host:port] [--out file]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    static Merger merger; // Static, since the decoder keeps a copy of the recent frames.
+    if (output_path && !(merger.output = fopen(output_path, "ab"))) {
+        perror(output_path);
+        return 1;
+    }
+    if (forward) {
+        if (!ParseAddress(forward, merger.forward_address)) {
+            fprintf(stderr, "Bad address %s, expected host:port\n", forward);
+            return 1;
+        }
+        merger.forward_socket = socket(AF_INET, SOCK_DGRAM, 0);
+    }
+
+    int lora_fd = -1;
+    if (lora_path && (lora_fd = OpenLora(lora_path, baud)) < 0) {
+        perror(lora_path);
+        return 1;
+    }
+    int udp_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(udp_port);
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(udp_fd, (const sockaddr*)&local, sizeof(local)) < 0) {
+        perror("bind");
+        return 1;
+    }
+
+    sockaddr_in boat = {}; // Source of the last datagram, where the reports go.
+    bool has_boat = false;
+    uint32_t report_timer = NowMs();
+    uint32_t summary_timer = NowMs();
+    uint8_t buffer[65536];
+
+    while (true) {
+        pollfd fds[2] = { { udp_fd, POLLIN, 0 }, { lora_fd, POLLIN, 0 } };
+        poll(fds, lora_fd >= 0 ? 2 : 1, 100);
+
+        if (fds[0].revents & POLLIN) {
+            socklen_t address_length = sizeof(boat);
+            ssize_t length = recvfrom(udp_fd, buffer, sizeof(buffer), 0, (sockaddr*)&boat, &address_length);
+            if (length > 0) {
+                has_boat = true;
+                merger.Receive(IpPath, buffer, length);
+            }
+        }
+        if (lora_fd >= 0 && (fds[1].revents & (POLLIN | POLLHUP))) {
+            ssize_t length = read(lora_fd, buffer, sizeof(buffer));
+            if (length > 0) {
+                merger.Receive(LoraPath, buffer, length);
+            } else if (length == 0 && !isatty(lora_fd)) {
+                close(lora_fd); // End of a capture.
+                lora_fd = -1;
+            }
+        }
+
+        uint32_t now = NowMs();
+        merger.Expire(now);
+        if (now - report_timer >= report_interval) {
+            report_timer = now;
+            for (uint8_t path = 0; path < NumberTelemetryPaths; path++) {
+                uint8_t frame[MavlinkFrameParser::max_frame_length];
+                uint16_t length = merger.BuildReport((TelemetryPath)path, frame, now);
+                if (has_boat) sendto(udp_fd, frame, length, 0, (const sockaddr*)&boat, sizeof(boat));
+            }
+        }
+        if (now - summary_timer >= summary_interval) {
+            summary_timer = now;
+            merger.PrintSummary();
+            if (merger.output) fflush(merger.output);
+        }
+    }
+}
@@ -0,0 +1,158 @@
+#pragma once
+#include <cstdint>
+
+/// @brief Outcome of a request presented to the admission control.
+enum AdmissionDecision : uint8_t {
+    Admitted,
+    ClientOverBudget, // This client has spent its share of the server time.
+    ServerOverBudget, // All clients together have spent what the server may take from the sensor tasks.
+    TooManyConcurrent // Too many responses are still being sent.
+};
+
+/// @brief Bounds the time the web server takes from the sensor tasks, however many clients refresh their dashboards at once.
+/// Every client has a token bucket of handler time, and all clients share a larger one. A request is charged the mean time its route
+/// took so far when it is admitted, and the difference once its handler returns, so each route weighs on the budgets what it really costs:
+/// the HTML page costs many JSON readings. Time spent on a response after its handler, such as a long download sent a piece at a time, is
+/// bounded by the cap on concurrent responses rather than by the budgets.
+/// A request that would overdraw a bucket is shed, with the time until the bucket holds its cost, so the client can retry when it will pass.
+/// The cost charged up front is capped at the smaller burst, so a route that costs more than a bucket can hold still passes once the buckets
+/// are full, and its true cost then overdraws them, which holds the next requests back for as long as it took.
+/// Clients are told apart by their address; when the table is full, the client seen least recently gives way to a new one.
+/// Portable C++ with no allocation and no locking, with the time passed in. Times are in us of handler time, refilled per s of real time.
+template <uint8_t MaxClients, uint8_t MaxRoutes>
+class AdmissionControl {
+public:
+    struct Settings {
+        uint32_t server_rate; // us of handler time per s, for all clients together.
+        uint32_t server_burst; // us
+        uint32_t client_rate; // us of handler time per s, for each client.
+        uint32_t client_burst; // us
+        uint8_t max_concurrent; // Responses being sent at once.
+    };
+
+    struct Route {
+        const char* name;
+        uint32_t mean_cost; // us, moving average of the time its handler took.
+        uint32_t max_cost; // us
+        uint32_t admitted;
+        uint32_t shed;
+    };
+
+    explicit AdmissionControl(const Settings& settings) : settings(settings) {
+        server = { 0, (int32_t)settings.server_burst, 0 };
+    }
+
+    /// @param initial_cost us, charged until the route has been timed.
+    /// @return Index of the route, or MaxRoutes when the table is full, which admits the route without accounting.
+    uint8_t AddRoute(const char* name, uint32_t initial_cost) {
+        if (number_routes >= MaxRoutes) return MaxRoutes;
+        routes[number_routes] = { name, initial_cost, 0, 0, 0 };
+        return number_routes++;
+    }
+
+    /// @brief Decides on a request and, when it is admitted, charges its estimated cost and counts it as a concurrent response until Release().
+    AdmissionDecision Admit(uint8_t route, uint32_t client, uint32_t now) {
+        if (route >= MaxRoutes) return Admitted;
+        Bucket& bucket = GetClient(client, now);
+        Refill(server, settings.server_rate, settings.server_burst, now);
+        Refill(bucket, settings.client_rate, settings.client_burst, now);
+        int32_t cost = GetCharge(route);
+        AdmissionDecision decision = Admitted;
+        if (concurrent >= settings.max_concurrent) decision = TooManyConcurrent;
+        else if (bucket.level < cost) decision = ClientOverBudget;
+        else if (server.level < cost) decision = ServerOverBudget;
+        if (decision != Admitted) {
+            routes[route].shed++;
+            shed[decision]++;
+            return decision;
+        }
+        bucket.level -= cost;
+        server.level -= cost;
+        concurrent++;
+        routes[route].admitted++;
+        return Admitted;
+    }
+
+    /// @brief Charges the difference between the time the handler of an admitted request took and its estimate, and learns the cost of the route.
+    void Account(uint8_t route, uint32_t client, uint32_t cost, uint32_t now) {
+        if (route >= MaxRoutes) return;
+        Route& entry = routes[route];
+        int32_t difference = (int32_t)cost - (int32_t)entry.mean_cost;
+        server.level -= difference;
+        GetClient(client, now).level -= difference;
+        entry.mean_cost = (int32_t)entry.mean_cost + difference / 8;
+        if (cost > entry.max_cost) entry.max_cost = cost;
+    }
+
+    /// @brief Ends a concurrent response. Called once per admitted request, when it has been sent or the client went away.
+    void Release() {
+        if (concurrent) concurrent--;
+    }
+
+    /// @return Seconds after which the request would be admitted, for the Retry-After header of the refusal.
+    uint32_t GetRetryAfter(AdmissionDecision decision, uint8_t route, uint32_t client, uint32_t now) {
+        if (decision == Admitted || route >= MaxRoutes) return 0;
+        if (decision == TooManyConcurrent) return 1;
+        const Bucket& bucket = decision == ClientOverBudget ? GetClient(client, now) : server;
+        uint32_t rate = decision == ClientOverBudget ? settings.client_rate : settings.server_rate;
+        int64_t deficit = (int64_t)GetCharge(route) - bucket.level;
+        return deficit <= 0 ? 1 : (uint32_t)((deficit + rate - 1) / rate);
+    }
+
+    uint8_t GetNumberRoutes() const { return number_routes; }
+    const Route& GetRoute(uint8_t route) const { return routes[route]; }
+    uint8_t GetConcurrent() const { return concurrent; }
+    uint32_t GetShed(AdmissionDecision decision) const { return shed[decision]; }
+
+    /// @return us of handler time left in the shared bucket, negative when overdrawn by a request that took longer than its estimate.
+    int32_t GetServerLevel(uint32_t now) {
+        Refill(server, settings.server_rate, settings.server_burst, now);
+        return server.level;
+    }
+
+private:
+    struct Bucket {
+        uint32_t client;
+        int32_t level; // us
+        uint32_t last_refill; // ms
+    };
+
+    Settings settings;
+    Bucket server;
+    Bucket clients[MaxClients] = {};
+    uint32_t last_seen[MaxClients] = {};
+    uint8_t number_clients = 0;
+    Route routes[MaxRoutes] = {};
+    uint8_t number_routes = 0;
+    uint8_t concurrent = 0;
+    uint32_t shed[TooManyConcurrent + 1] = {};
+
+    /// @return us charged when a request of the route is admitted: its mean cost, at most what a full bucket holds.
+    int32_t GetCharge(uint8_t route) const {
+        uint32_t burst = settings.client_burst < settings.server_burst ? settings.client_burst : settings.server_burst;
+        return routes[route].mean_cost < burst ? routes[route].mean_cost : burst;
+    }
+
+    static void Refill(Bucket& bucket, uint32_t rate, uint32_t burst, uint32_t now) {
+        uint32_t elapsed = now - bucket.last_refill;
+        if (!elapsed) return;
+        int64_t level = bucket.level + (int64_t)elapsed * rate / 1000;
+        bucket.level = level > burst ? burst : level;
+        bucket.last_refill = now;
+    }
+
+    Bucket& GetClient(uint32_t client, uint32_t now) {
+        uint8_t index = 0;
+        for (uint8_t i = 0; i < number_clients; i++) {
+            if (clients[i].client == client) {
+                last_seen[i] = now;
+                return clients[i];
+            }
+            if (now - last_seen[i] > now - last_seen[index]) index = i;
+        }
+        if (number_clients < MaxClients) index = number_clients++;
+        clients[index] = { client, (int32_t)settings.client_burst, now };
+        last_seen[index] = now;
+        return clients[index];
+    }
+};
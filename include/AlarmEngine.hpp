@@ -0,0 +1,187 @@
+#pragma once
+#include <Arduino.h>
+#include <Preferences.h>
+
+// Telemetry fields that alarm rules can watch. Values are stored in the rule table, so new fields must be appended at the end.
+enum AlarmField : uint8_t {
+    BatteryVoltage,
+    MotorCurrent,
+    BatteryCurrent,
+    MpptCurrent,
+    TemperatureMotor,
+    TemperatureBattery,
+    TemperatureMppt,
+    AuxiliaryVoltage,
+    AuxiliaryCurrent,
+    Pumps,
+    PumpDutyCycle, // Highest duty cycle of the bilge pumps over the last hour, in percent.
+    NumberAlarmFields
+};
+
+enum AlarmComparator : uint8_t {
+    Above,
+    Below
+};
+
+enum AlarmSeverity : uint8_t {
+    Warning,
+    Critical
+};
+
+/// @brief Compact description of an alarm condition. 16 bytes each, so the whole table fits in a single NVS blob.
+struct AlarmRule {
+    float threshold; // Value at which the alarm is raised.
+    float hysteresis; // Distance back from the threshold the value must travel before the alarm clears, to avoid toggling around the threshold.
+    uint16_t debounce; // ms the condition must hold before the alarm changes state.
+    uint8_t field; // AlarmField
+    uint8_t comparator; // AlarmComparator
+    uint8_t severity; // AlarmSeverity
+    uint8_t enabled;
+    uint8_t reserved[2];
+};
+
+/// @brief Reported to the transition handler whenever an alarm is raised or cleared.
+struct AlarmEvent {
+    uint8_t rule;
+    uint8_t field;
+    uint8_t severity;
+    bool is_active;
+    float value;
+    float threshold;
+    uint32_t timestamp;
+};
+
+/// @brief Evaluates a table of alarm rules against each sample as it is read. Readers call Check() right after converting a sample,
+/// so a condition is caught on the sample that first meets it rather than on the next periodic telemetry message.
+/// Checking a sample is a loop over a table of a few rules with no allocation, cheap enough for the high-rate motor current stream.
+/// State changes are reported through a handler, which is called from the task that read the sample.
+/// Rules may be changed from another task, such as the web server, while samples are checked. Each rule is copied and its state updated
+/// under a spinlock, and the handler is called once it is released.
+class AlarmEngine {
+public:
+    static constexpr uint8_t max_rules = 16;
+    static constexpr uint32_t max_debounce = UINT16_MAX; // ms, the width of the field in the saved table.
+    using TransitionHandler = void (*)(const AlarmEvent&);
+
+    explicit AlarmEngine(TransitionHandler handler) : handler(handler) {}
+
+    /// @brief Loads the rule table from non volatile memory, or the default rules if none was saved.
+    void Begin() {
+        LoadDefaultRules();
+        Preferences preferences;
+        preferences.begin("alarms", true);
+        if (preferences.getBytesLength("rules") == sizeof(rules)) {
+            preferences.getBytes("rules", rules, sizeof(rules));
+        }
+        preferences.end();
+    }
+
+    /// @brief Evaluates every enabled rule that watches the given field.
+    /// @param field Field the value belongs to.
+    /// @param value Converted sample, in the same unit as the rule thresholds.
+    void Check(AlarmField field, float value) {
+        uint32_t now = millis();
+        for (uint8_t i = 0; i < max_rules; i++) {
+            portENTER_CRITICAL(&mutex);
+            AlarmRule rule = rules[i];
+            if (!rule.enabled || rule.field != field) {
+                portEXIT_CRITICAL(&mutex);
+                continue;
+            }
+
+            AlarmState& state = states[i];
+            bool is_condition_met;
+            if (state.is_active) {
+                // Once raised, the alarm only clears after the value moves back past the threshold by the hysteresis.
+                is_condition_met = rule.comparator == AlarmComparator::Above ? value > rule.threshold - rule.hysteresis : value < rule.threshold + rule.hysteresis;
+            } else {
+                is_condition_met = rule.comparator == AlarmComparator::Above ? value > rule.threshold : value < rule.threshold;
+            }
+
+            bool is_transition = false;
+            if (is_condition_met == state.is_active) {
+                state.is_pending = false;
+            } else {
+                if (!state.is_pending) {
+                    state.is_pending = true;
+                    state.pending_since = now;
+                }
+                if (now - state.pending_since >= rule.debounce) {
+                    state.is_pending = false;
+                    state.is_active = is_condition_met;
+                    is_transition = true;
+                }
+            }
+            portEXIT_CRITICAL(&mutex);
+
+            if (is_transition && handler) {
+                handler({ i, rule.field, rule.severity, is_condition_met, value, rule.threshold, now });
+            }
+        }
+    }
+
+    /// @brief Replaces a rule and saves the table. The state of the rule is reset, so a changed rule is evaluated from scratch.
+    /// @return False if the index or the field is out of range.
+    bool SetRule(uint8_t index, const AlarmRule& rule) {
+        if (index >= max_rules || rule.field >= AlarmField::NumberAlarmFields) return false;
+        AlarmRule table[max_rules];
+        portENTER_CRITICAL(&mutex);
+        rules[index] = rule;
+        states[index] = {};
+        memcpy(table, rules, sizeof(table));
+        portEXIT_CRITICAL(&mutex);
+        Preferences preferences;
+        preferences.begin("alarms", false);
+        preferences.putBytes("rules", table, sizeof(table));
+        preferences.end();
+        return true;
+    }
+
+    /// @return Copy of the rule, or an empty, disabled rule if the index is out of range.
+    AlarmRule GetRule(uint8_t index) {
+        AlarmRule rule = {};
+        if (index >= max_rules) return rule;
+        portENTER_CRITICAL(&mutex);
+        rule = rules[index];
+        portEXIT_CRITICAL(&mutex);
+        return rule;
+    }
+
+    /// @return False if the index is out of range.
+    bool IsActive(uint8_t index) const { return index < max_rules && states[index].is_active; }
+
+    /// @return Number of active alarms with the given severity or above.
+    uint8_t CountActive(AlarmSeverity severity = AlarmSeverity::Warning) {
+        uint8_t count = 0;
+        portENTER_CRITICAL(&mutex);
+        for (uint8_t i = 0; i < max_rules; i++) {
+            if (states[i].is_active && rules[i].severity >= severity) count++;
+        }
+        portEXIT_CRITICAL(&mutex);
+        return count;
+    }
+
+private:
+    struct AlarmState {
+        bool is_active;
+        bool is_pending; // The condition has changed but the debounce time has not elapsed yet.
+        uint32_t pending_since;
+    };
+
+    TransitionHandler handler;
+    portMUX_TYPE mutex = portMUX_INITIALIZER_UNLOCKED;
+    AlarmRule rules[max_rules] = {};
+    AlarmState states[max_rules] = {};
+
+    void LoadDefaultRules() {
+        // Thresholds are a starting point for the 48V drivetrain and the 12V auxiliary battery. Tune them over HTTP for each race.
+        rules[0] = { 80.0f, 5.0f, 3000, AlarmField::TemperatureMotor, AlarmComparator::Above, AlarmSeverity::Critical, true };
+        rules[1] = { 55.0f, 3.0f, 3000, AlarmField::TemperatureBattery, AlarmComparator::Above, AlarmSeverity::Critical, true };
+        rules[2] = { 70.0f, 5.0f, 3000, AlarmField::TemperatureMppt, AlarmComparator::Above, AlarmSeverity::Warning, true };
+        rules[3] = { 42.0f, 1.0f, 2000, AlarmField::BatteryVoltage, AlarmComparator::Below, AlarmSeverity::Critical, true };
+        rules[4] = { 95.0f, 10.0f, 200, AlarmField::MotorCurrent, AlarmComparator::Above, AlarmSeverity::Critical, true };
+        rules[5] = { 11.8f, 0.3f, 5000, AlarmField::AuxiliaryVoltage, AlarmComparator::Below, AlarmSeverity::Warning, true };
+        rules[6] = { 0.5f, 0.0f, 2000, AlarmField::Pumps, AlarmComparator::Above, AlarmSeverity::Warning, true };
+        rules[7] = { 10.0f, 2.0f, 0, AlarmField::PumpDutyCycle, AlarmComparator::Above, AlarmSeverity::Critical, true }; // A dry hull barely runs the pumps.
+    }
+};
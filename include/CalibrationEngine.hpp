@@ -0,0 +1,264 @@
+#pragma once
+#include <Arduino.h>
+#include <Preferences.h>
+
+// Channels with a linear correction applied on top of their sensor model. Values are stored in the calibration table, so new channels must be appended at the end.
+enum CalibrationChannel : uint8_t {
+    BatteryVoltageChannel, // Raw value is the voltage given by the LV-20P model.
+    MotorCurrentChannel, // Raw values are the currents given by the T201 model.
+    BatteryCurrentChannel,
+    MpptCurrentChannel,
+    AuxiliaryVoltageChannel, // Raw value is the voltage at the 4k7/1k divider, from the internal ADC.
+    AuxiliaryCurrentChannel, // Raw value is the ADC count of the ACS712 output.
+    NumberCalibrationChannels
+};
+
+/// @brief Calibrates any channel against reference values measured with an instrument, one point at a time, without stopping the readers.
+/// Readers pass every raw sample through Feed(), which costs a comparison while no calibration runs, and convert it with Apply().
+/// A calibration is a small state machine driven by commands passed to Execute(), so it can be run from HTTP, MAVLink or the serial port alike:
+///   Start on a channel -> [Capture with a reference -> samples are averaged in the background] x N -> Commit fits the points and saves the table.
+/// A single point only corrects the offset; two or more points fit both the slope and the offset by least squares.
+/// The whole table is written to NVS as one blob, which NVS replaces atomically, so a reset halfway through a commit keeps the previous table.
+/// The readers and the commands run on different tasks, so the table, the points and the status are only touched under a spinlock.
+class CalibrationEngine {
+public:
+    static constexpr uint8_t max_points = 8;
+    static constexpr uint16_t default_samples_per_point = 50;
+
+    enum State : uint8_t {
+        Idle,
+        WaitingReference, // Waiting for the next reference value, or for the commit.
+        Sampling // Averaging samples for the point being captured.
+    };
+
+    enum Action : uint8_t {
+        Start,
+        Capture,
+        Commit,
+        Abort
+    };
+
+    enum Result : uint8_t {
+        Ok,
+        InvalidChannel,
+        InvalidState,
+        TooManyPoints,
+        TooFewPoints,
+        DegenerateFit, // All points were taken at the same raw value, so the slope cannot be found.
+        StorageError
+    };
+
+    struct Coefficients {
+        float slope;
+        float intercept;
+    };
+
+    struct Point {
+        float raw; // Average of the raw samples.
+        float reference;
+    };
+
+    struct Status {
+        State state;
+        uint8_t channel;
+        uint8_t number_points;
+        uint32_t samples_collected;
+        uint32_t samples_per_point;
+        Result last_result;
+        float residual; // RMS error of the last fit, in the unit of the channel.
+    };
+
+    using StatusHandler = void (*)(const Status&, const Coefficients&);
+
+    /// @param defaults Coefficients used until a channel is calibrated.
+    /// @param handler Called whenever the state changes, from the task that caused the change.
+    CalibrationEngine(const Coefficients (&defaults)[NumberCalibrationChannels], StatusHandler handler) : handler(handler) {
+        memcpy(table, defaults, sizeof(table));
+    }
+
+    /// @brief Replaces the default coefficients of a channel, such as a calibration saved in an older format. Must be called before Begin().
+    void SetDefault(uint8_t channel, const Coefficients& coefficients) {
+        if (channel < NumberCalibrationChannels) table[channel] = coefficients;
+    }
+
+    /// @brief Loads the calibration table from non volatile memory, or keeps the defaults if none was saved.
+    void Begin() {
+        Preferences preferences;
+        preferences.begin("calibration", true);
+        if (preferences.getBytesLength("table") == sizeof(table)) {
+            preferences.getBytes("table", table, sizeof(table));
+        }
+        preferences.end();
+    }
+
+    /// @brief Applies the correction of a channel to a raw value.
+    float Apply(uint8_t channel, float raw) {
+        portENTER_CRITICAL(&mutex);
+        Coefficients coefficients = table[channel];
+        portEXIT_CRITICAL(&mutex);
+        return coefficients.slope * raw + coefficients.intercept;
+    }
+
+    /// @brief Offers a raw sample to the calibration. Only used while a point of that channel is being captured.
+    void Feed(uint8_t channel, float raw) {
+        if (status.state != State::Sampling || status.channel != channel) return;
+        portENTER_CRITICAL(&mutex);
+        bool is_point_complete = false;
+        if (status.state == State::Sampling && status.channel == channel) {
+            sample_sum += raw;
+            status.samples_collected++;
+            if (status.samples_collected >= status.samples_per_point) {
+                points[status.number_points].raw = sample_sum / status.samples_collected;
+                status.number_points++;
+                status.state = State::WaitingReference;
+                is_point_complete = true;
+            }
+        }
+        portEXIT_CRITICAL(&mutex);
+        if (is_point_complete) Notify(Result::Ok);
+    }
+
+    /// @brief Runs a calibration command. Start discards any calibration in progress.
+    /// @param channel Channel to calibrate, only used by Start.
+    /// @param reference Value measured by the instrument for the point being captured, only used by Capture.
+    /// @param samples_per_point Number of raw samples averaged for each point, only used by Start.
+    Result Execute(Action action, uint8_t channel = 0, float reference = 0.0f, uint32_t samples_per_point = default_samples_per_point) {
+        Result result = Result::Ok;
+        switch (action) {
+            case Action::Start:
+                if (channel >= NumberCalibrationChannels) return Notify(Result::InvalidChannel);
+                portENTER_CRITICAL(&mutex);
+                status = {};
+                status.state = State::WaitingReference;
+                status.channel = channel;
+                status.samples_per_point = samples_per_point ? samples_per_point : default_samples_per_point;
+                portEXIT_CRITICAL(&mutex);
+                return Notify(Result::Ok);
+
+            case Action::Capture:
+                portENTER_CRITICAL(&mutex);
+                if (status.state != State::WaitingReference) {
+                    result = Result::InvalidState;
+                } else if (status.number_points >= max_points) {
+                    result = Result::TooManyPoints;
+                } else {
+                    points[status.number_points].reference = reference;
+                    sample_sum = 0.0f;
+                    status.samples_collected = 0;
+                    status.state = State::Sampling;
+                }
+                portEXIT_CRITICAL(&mutex);
+                return Notify(result);
+
+            case Action::Commit:
+                if (GetStatus().state != State::WaitingReference) return Notify(Result::InvalidState);
+                return Notify(Fit());
+
+            case Action::Abort:
+                portENTER_CRITICAL(&mutex);
+                status.state = State::Idle;
+                portEXIT_CRITICAL(&mutex);
+                return Notify(Result::Ok);
+        }
+        return Result::InvalidState;
+    }
+
+    Status GetStatus() {
+        portENTER_CRITICAL(&mutex);
+        Status copy = status;
+        portEXIT_CRITICAL(&mutex);
+        return copy;
+    }
+
+    Point GetPoint(uint8_t index) {
+        portENTER_CRITICAL(&mutex);
+        Point point = points[index];
+        portEXIT_CRITICAL(&mutex);
+        return point;
+    }
+
+    Coefficients GetCoefficients(uint8_t channel) {
+        portENTER_CRITICAL(&mutex);
+        Coefficients coefficients = table[channel];
+        portEXIT_CRITICAL(&mutex);
+        return coefficients;
+    }
+
+    uint32_t GetVersion() const { return version; } // Changes whenever a calibration is committed.
+
+private:
+    StatusHandler handler;
+    Coefficients table[NumberCalibrationChannels];
+    Point points[max_points] = {};
+    float sample_sum = 0.0f;
+    Status status = {};
+    volatile uint32_t version = 0;
+    portMUX_TYPE mutex = portMUX_INITIALIZER_UNLOCKED;
+
+    Result Notify(Result result) {
+        portENTER_CRITICAL(&mutex);
+        status.last_result = result;
+        Status copy = status;
+        Coefficients coefficients = table[status.channel];
+        portEXIT_CRITICAL(&mutex);
+        if (handler) handler(copy, coefficients);
+        return result;
+    }
+
+    /// @brief Fits the captured points, saves the new table and applies it. The channel keeps its previous coefficients on failure.
+    /// Only called while waiting for a reference, when the readers no longer change the points.
+    Result Fit() {
+        Status fit_status = GetStatus();
+        uint8_t n = fit_status.number_points;
+        if (n == 0) return Result::TooFewPoints;
+        Coefficients table_copy[NumberCalibrationChannels];
+        portENTER_CRITICAL(&mutex);
+        memcpy(table_copy, table, sizeof(table_copy));
+        portEXIT_CRITICAL(&mutex);
+        Coefficients coefficients = table_copy[fit_status.channel];
+
+        if (n == 1) {
+            coefficients.intercept = points[0].reference - coefficients.slope * points[0].raw;
+        } else {
+            float mean_raw = 0.0f, mean_reference = 0.0f;
+            for (uint8_t i = 0; i < n; i++) {
+                mean_raw += points[i].raw;
+                mean_reference += points[i].reference;
+            }
+            mean_raw /= n;
+            mean_reference /= n;
+            float covariance = 0.0f, variance = 0.0f;
+            for (uint8_t i = 0; i < n; i++) {
+                covariance += (points[i].raw - mean_raw) * (points[i].reference - mean_reference);
+                variance += (points[i].raw - mean_raw) * (points[i].raw - mean_raw);
+            }
+            if (variance <= 1e-9f * (1.0f + mean_raw * mean_raw)) return Result::DegenerateFit;
+            coefficients.slope = covariance / variance;
+            coefficients.intercept = mean_reference - coefficients.slope * mean_raw;
+        }
+
+        float squared_error = 0.0f;
+        for (uint8_t i = 0; i < n; i++) {
+            float error = coefficients.slope * points[i].raw + coefficients.intercept - points[i].reference;
+            squared_error += error * error;
+        }
+        float residual = sqrtf(squared_error / n);
+        portENTER_CRITICAL(&mutex);
+        status.residual = residual;
+        portEXIT_CRITICAL(&mutex);
+
+        table_copy[fit_status.channel] = coefficients;
+        Preferences preferences;
+        preferences.begin("calibration", false);
+        size_t written = preferences.putBytes("table", table_copy, sizeof(table_copy));
+        preferences.end();
+        if (written != sizeof(table_copy)) return Result::StorageError;
+
+        portENTER_CRITICAL(&mutex);
+        table[fit_status.channel] = coefficients;
+        status.state = State::Idle;
+        portEXIT_CRITICAL(&mutex);
+        version++;
+        return Result::Ok;
+    }
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <algorithm>
+
+/// @brief Proportional-integral current limiter for the throttle output.
+/// The limiter does not track a current setpoint. It only computes a ceiling for the throttle command, which stays at full scale
+/// while the measured current is below the limit and is pulled down as soon as the current exceeds it. The final output is the
+/// smaller of the pilot's request and the ceiling, so full throttle remains available whenever the motor is not overloaded.
+/// Commands are normalized between 0.0 and 1.0 so the limiter does not depend on the resolution of the output stage.
+class CurrentLimiter {
+public:
+
+    /// @param current_limit Motor current in amperes above which the throttle command starts being reduced.
+    /// @param proportional_gain Reduction of the ceiling per ampere above the limit.
+    /// @param integral_gain Reduction of the ceiling per ampere-second above the limit.
+    CurrentLimiter(float current_limit, float proportional_gain, float integral_gain)
+        : current_limit(current_limit), proportional_gain(proportional_gain), integral_gain(integral_gain) {}
+
+    /// @brief Updates the ceiling with a new current measurement. Should be called once for each new sample from the ADC.
+    /// @param measured_current Motor current in amperes.
+    /// @param elapsed_seconds Time since the previous measurement.
+    /// @return Ceiling for the normalized throttle command.
+    float Update(float measured_current, float elapsed_seconds) {
+        float error = current_limit - measured_current;
+
+        // The integral term is clamped between 0 and 1, which keeps it from winding up while the current is below the limit:
+        // it simply rests at full scale and starts pulling the ceiling down as soon as the current exceeds the limit.
+        integral_term += integral_gain * error * elapsed_seconds;
+        integral_term = std::min(1.0f, std::max(0.0f, integral_term));
+
+        ceiling = integral_term + proportional_gain * error;
+        ceiling = std::min(1.0f, std::max(0.0f, ceiling));
+        return ceiling;
+    }
+
+    /// @brief Applies the current ceiling to the command requested by the pilot.
+    /// @param requested_command Normalized throttle command between 0.0 and 1.0.
+    /// @return The limited command.
+    float Apply(float requested_command) const {
+        return std::min(requested_command, ceiling);
+    }
+
+    /// @brief Returns the limiter to full throttle. Used when the current measurement is lost, so a stale reading does not keep the boat slowed down.
+    void Reset() {
+        integral_term = 1.0f;
+        ceiling = 1.0f;
+    }
+
+    void SetCurrentLimit(float limit) { current_limit = limit; }
+    float GetCurrentLimit() const { return current_limit; }
+    float GetCeiling() const { return ceiling; }
+    bool IsLimiting() const { return ceiling < 1.0f; }
+
+private:
+    float current_limit;
+    float proportional_gain;
+    float integral_gain;
+    float integral_term = 1.0f;
+    float ceiling = 1.0f;
+};
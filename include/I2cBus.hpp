@@ -0,0 +1,231 @@
+#pragma once
+#include <Arduino.h>
+#include <Wire.h>
+
+enum I2cPriority : uint8_t {
+    I2cHighPriority, // Conversions of the fast current readings, which the current limiter and the alarms wait on.
+    I2cNormalPriority,
+    I2cLowPriority, // Transfers that may wait behind any other, such as diagnostics.
+    NumberI2cPriorities
+};
+
+enum I2cStatus : uint8_t {
+    I2cOk,
+    I2cNack, // The device did not acknowledge its address or a byte, which is how a missing device answers.
+    I2cTimeout, // The transfer did not end in time, which is how a slave holding the bus shows.
+    I2cBusError,
+    I2cDeadlineMissed, // Still waiting for the bus at its deadline, so it was dropped without being sent.
+    I2cQueueFull
+};
+
+/// @brief A write of a few bytes followed by a read of a few bytes, such as setting the register pointer of a device and reading the register.
+/// Either part may be empty; a transaction with neither probes the device. The write and the read are separate transfers, each ended by a stop.
+struct I2cTransaction {
+    static constexpr uint8_t max_length = 8;
+
+    uint8_t address;
+    uint8_t write_length;
+    uint8_t write_data[max_length];
+    uint8_t read_length;
+    uint8_t read_data[max_length]; // Filled by the bus.
+    uint32_t deadline; // ms, millis(). A transaction that has not started by then is dropped, as its result would come too late to use.
+    I2cStatus status; // Set by the bus.
+
+    // Kept by the bus while the transaction waits in a queue.
+    SemaphoreHandle_t done;
+    uint32_t submit_time; // us, micros()
+};
+
+/// @brief Sole owner of the Wire bus, which every device on it is reached through, so transfers from several tasks never interleave.
+/// Clients submit transactions with a priority and a deadline and wait for them to be done. A task of its own takes them from one queue
+/// per priority, always the highest first, so a high priority transfer waits behind at most the one transfer already on the wire, which
+/// the timeout of Wire bounds. Clients must not poll a device over the bus while it converts, so that a slow conversion never holds the bus.
+/// A transfer that times out or finds the bus busy means a slave is holding SDA low, typically after a reset in the middle of a read.
+/// The bus is then recovered by clocking SCL by hand until the slave lets SDA go, sending a stop and starting Wire again, and the transfer
+/// is tried once more.
+/// Latency, from submission to the end of the transfer, and errors are counted for each device.
+class I2cBus {
+public:
+    static constexpr uint8_t max_devices = 8;
+    static constexpr uint8_t queue_length = 4; // Per priority.
+
+    struct DeviceStatistics {
+        uint8_t address;
+        uint32_t transactions;
+        uint32_t nacks;
+        uint32_t timeouts;
+        uint32_t bus_errors;
+        uint32_t deadline_misses;
+        uint64_t total_latency; // us, from submission to the end of the transfer.
+        uint32_t max_latency; // us
+        uint32_t max_transfer_time; // us, on the wire.
+    };
+
+    I2cBus(uint8_t sda_pin, uint8_t scl_pin, uint32_t frequency, uint16_t timeout) : sda_pin(sda_pin), scl_pin(scl_pin), frequency(frequency), timeout(timeout) {}
+
+    /// @brief Starts Wire and the task that owns it.
+    /// @param priority Of the task, above every client, so that a client waiting on the bus is not kept from it by the other clients.
+    /// @param core Of the task. The same as the main client, so that handing a transaction over does not wait for the other core.
+    void Begin(UBaseType_t priority, BaseType_t core) {
+        Wire.begin(sda_pin, scl_pin, frequency);
+        Wire.setTimeOut(timeout);
+        for (uint8_t i = 0; i < NumberI2cPriorities; i++) queues[i] = xQueueCreate(queue_length, sizeof(I2cTransaction*));
+        pending = xSemaphoreCreateCounting(NumberI2cPriorities * queue_length, 0);
+        xTaskCreatePinnedToCore(Task, "i2cBus", 3072, this, priority, &task_handle, core);
+    }
+
+    /// @brief Submits a transaction and waits until the bus is done with it, which the timeout of the transfers ahead of it bounds.
+    /// @return Status of the transaction, also kept in it.
+    I2cStatus Transfer(I2cTransaction& transaction, I2cPriority priority) {
+        StaticSemaphore_t semaphore;
+        transaction.done = xSemaphoreCreateBinaryStatic(&semaphore);
+        transaction.submit_time = micros();
+        I2cTransaction* queued = &transaction;
+        if (!task_handle || !xQueueSend(queues[priority], &queued, 0)) {
+            vSemaphoreDelete(transaction.done);
+            queue_full++;
+            return transaction.status = I2cQueueFull;
+        }
+        xSemaphoreGive(pending);
+        xSemaphoreTake(transaction.done, portMAX_DELAY);
+        vSemaphoreDelete(transaction.done);
+        return transaction.status;
+    }
+
+    /// @return True if a device answers at the address.
+    bool Probe(uint8_t address, I2cPriority priority = I2cNormalPriority) {
+        I2cTransaction transaction = { address, 0, {}, 0, {}, millis() + timeout };
+        return Transfer(transaction, priority) == I2cOk;
+    }
+
+    /// @brief Writes a 16-bit register, most significant byte first.
+    I2cStatus WriteRegister(uint8_t address, uint8_t reg, uint16_t value, I2cPriority priority, uint32_t deadline) {
+        I2cTransaction transaction = { address, 3, { reg, (uint8_t)(value >> 8), (uint8_t)(value & 0xFF) }, 0, {}, deadline };
+        return Transfer(transaction, priority);
+    }
+
+    /// @brief Reads a 16-bit register, most significant byte first.
+    I2cStatus ReadRegister(uint8_t address, uint8_t reg, uint16_t& value, I2cPriority priority, uint32_t deadline) {
+        I2cTransaction transaction = { address, 1, { reg }, 2, {}, deadline };
+        if (Transfer(transaction, priority) == I2cOk) value = transaction.read_data[0] << 8 | transaction.read_data[1];
+        return transaction.status;
+    }
+
+    uint8_t GetNumberDevices() const { return number_devices; }
+    const DeviceStatistics& GetDeviceStatistics(uint8_t index) const { return devices[index]; }
+    uint32_t GetRecoveries() const { return recoveries; }
+    uint32_t GetQueueFull() const { return queue_full; }
+    TaskHandle_t GetTaskHandle() const { return task_handle; }
+
+private:
+    uint8_t sda_pin;
+    uint8_t scl_pin;
+    uint32_t frequency;
+    uint16_t timeout; // ms, of each transfer.
+    QueueHandle_t queues[NumberI2cPriorities] = {};
+    SemaphoreHandle_t pending = nullptr; // Counts the transactions in all queues.
+    TaskHandle_t task_handle = nullptr;
+    DeviceStatistics devices[max_devices] = {};
+    uint8_t number_devices = 0;
+    DeviceStatistics other_devices = {}; // Devices past the table share an entry.
+    volatile uint32_t recoveries = 0;
+    volatile uint32_t queue_full = 0;
+
+    static void Task(void* parameter) {
+        I2cBus* bus = static_cast<I2cBus*>(parameter);
+        while (true) {
+            xSemaphoreTake(bus->pending, portMAX_DELAY);
+            I2cTransaction* transaction = nullptr;
+            for (uint8_t i = 0; i < NumberI2cPriorities; i++) {
+                if (xQueueReceive(bus->queues[i], &transaction, 0)) break;
+            }
+            if (transaction) bus->Execute(*transaction);
+        }
+    }
+
+    DeviceStatistics& GetDevice(uint8_t address) {
+        for (uint8_t i = 0; i < number_devices; i++) {
+            if (devices[i].address == address) return devices[i];
+        }
+        if (number_devices >= max_devices) return other_devices;
+        devices[number_devices].address = address;
+        return devices[number_devices++];
+    }
+
+    void Execute(I2cTransaction& transaction) {
+        DeviceStatistics& device = GetDevice(transaction.address);
+        if ((int32_t)(millis() - transaction.deadline) > 0) {
+            device.deadline_misses++;
+            transaction.status = I2cDeadlineMissed;
+        } else {
+            uint32_t start = micros();
+            transaction.status = Send(transaction);
+            if (transaction.status == I2cTimeout || transaction.status == I2cBusError) {
+                if (transaction.status == I2cTimeout) device.timeouts++;
+                else device.bus_errors++;
+                Recover();
+                transaction.status = Send(transaction);
+            }
+            if (transaction.status == I2cNack) device.nacks++;
+            else if (transaction.status == I2cTimeout) device.timeouts++;
+            else if (transaction.status == I2cBusError) device.bus_errors++;
+            uint32_t end = micros();
+            uint32_t latency = end - transaction.submit_time;
+            device.transactions++;
+            device.total_latency += latency;
+            if (latency > device.max_latency) device.max_latency = latency;
+            if (end - start > device.max_transfer_time) device.max_transfer_time = end - start;
+        }
+        xSemaphoreGive(transaction.done);
+    }
+
+    static I2cStatus ToStatus(uint8_t error) {
+        switch (error) {
+            case I2C_ERROR_OK: return I2cOk;
+            case I2C_ERROR_ACK: return I2cNack;
+            case I2C_ERROR_TIMEOUT: return I2cTimeout;
+            default: return I2cBusError;
+        }
+    }
+
+    I2cStatus Send(I2cTransaction& transaction) {
+        if (transaction.write_length || !transaction.read_length) {
+            Wire.beginTransmission(transaction.address);
+            Wire.write(transaction.write_data, transaction.write_length);
+            I2cStatus status = ToStatus(Wire.endTransmission());
+            if (status != I2cOk) return status;
+        }
+        if (!transaction.read_length) return I2cOk;
+        if (Wire.requestFrom(transaction.address, transaction.read_length) != transaction.read_length) return ToStatus(Wire.lastError());
+        for (uint8_t i = 0; i < transaction.read_length; i++) transaction.read_data[i] = Wire.read();
+        return I2cOk;
+    }
+
+    /// @brief Frees a bus held by a slave. Up to nine clocks let a slave caught in the middle of a byte shift it out and release SDA, and a
+    /// stop then ends its transfer. Wire is started again, which gives the pins back to the peripheral.
+    void Recover() {
+        recoveries++;
+        constexpr uint32_t half_period = 5; // us, 100 kHz
+        digitalWrite(scl_pin, HIGH);
+        digitalWrite(sda_pin, HIGH);
+        pinMode(scl_pin, OUTPUT_OPEN_DRAIN);
+        pinMode(sda_pin, INPUT_PULLUP);
+        for (uint8_t i = 0; i < 9 && !digitalRead(sda_pin); i++) {
+            digitalWrite(scl_pin, LOW);
+            delayMicroseconds(half_period);
+            digitalWrite(scl_pin, HIGH);
+            delayMicroseconds(half_period);
+        }
+        // Stop: SDA rises while SCL is high.
+        pinMode(sda_pin, OUTPUT_OPEN_DRAIN);
+        digitalWrite(scl_pin, LOW);
+        digitalWrite(sda_pin, LOW);
+        delayMicroseconds(half_period);
+        digitalWrite(scl_pin, HIGH);
+        delayMicroseconds(half_period);
+        digitalWrite(sda_pin, HIGH);
+        delayMicroseconds(half_period);
+        Wire.begin(sda_pin, scl_pin, frequency);
+        Wire.setTimeOut(timeout);
+    }
+};
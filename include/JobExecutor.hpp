@@ -0,0 +1,153 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+/// @brief Runs the low-rate periodic jobs of the firmware one after the other on a single task, so they share one stack instead of each
+/// keeping its own mostly idle one.
+/// A job is a function called with its context and the time, which does a short piece of work and returns the delay until it wants to run
+/// again. A job that has to wait, for a conversion or a reply, returns the wait and keeps its place in its context, as a state machine, so
+/// the jobs never block each other beyond the length of a piece of work.
+/// Jobs wait in a timer wheel: a ring of slots of one tick each, where a job sits in the slot of its deadline. Each pass visits the slots
+/// of the ticks elapsed since the last one and runs the jobs found due, so the cost of a pass does not grow with the number of jobs waiting.
+/// Another task may wake a job before its deadline with Notify(), which only sets a bit.
+/// Each job is timed, so its run time and how late it ran show which job holds the others up.
+/// Portable C++ with no allocation, with the time passed in and a microsecond clock to time the jobs.
+template <uint8_t MaxJobs, uint16_t NumberSlots = 64>
+class JobExecutor {
+    static_assert(MaxJobs <= 32, "Notifications are bits of a word");
+
+public:
+    /// @return Delay until the next run, in ms, or stop.
+    using JobFunction = uint32_t (*)(void* context, uint32_t now);
+    static constexpr uint32_t stop = UINT32_MAX;
+    static constexpr int8_t invalid_job = -1;
+
+    struct Statistics {
+        const char* name;
+        uint32_t runs;
+        uint64_t total_time; // us
+        uint32_t max_time; // us
+        uint32_t max_lateness; // ms past its deadline when it ran, which is the time other jobs held it up.
+    };
+
+    /// @param tick ms per slot of the wheel, the resolution of the deadlines.
+    /// @param clock Microsecond clock that times the jobs.
+    JobExecutor(uint32_t tick, int64_t (*clock)()) : tick(tick), clock(clock) {
+        for (uint16_t i = 0; i < NumberSlots; i++) heads[i] = invalid_job;
+    }
+
+    /// @brief Adds a job, which first runs after the delay.
+    /// @return Id of the job, or invalid_job when the table is full.
+    int8_t Add(const char* name, JobFunction function, void* context, uint32_t delay, uint32_t now) {
+        if (number_jobs >= MaxJobs) return invalid_job;
+        if (!number_jobs) last_tick = now / tick;
+        int8_t id = number_jobs++;
+        jobs[id] = { function, context, 0, invalid_job, false };
+        statistics[id] = { name, 0, 0, 0, 0 };
+        Schedule(id, now, delay);
+        return id;
+    }
+
+    /// @brief Runs a job at the next pass, ahead of its deadline. Safe to call from any task.
+    void Notify(int8_t id) {
+        if (id >= 0 && id < number_jobs) notifications.fetch_or(1u << id);
+    }
+
+    /// @brief Runs the notified jobs and the jobs whose deadline has come. Called by the executor task.
+    void Run(uint32_t now) {
+        // Jobs run in this pass are put back from the next tick on, so none runs twice in a pass.
+        uint32_t now_tick = now / tick;
+        uint32_t elapsed = now_tick - last_tick;
+        last_tick = now_tick;
+
+        uint32_t notified = notifications.exchange(0);
+        for (int8_t id = 0; id < number_jobs; id++) {
+            if ((notified & (1u << id)) && jobs[id].is_scheduled) {
+                Unlink(id);
+                Execute(id, now);
+            }
+        }
+
+        // After a gap longer than a turn of the wheel, every slot is visited once.
+        uint32_t visits = elapsed < NumberSlots ? elapsed : NumberSlots;
+        for (uint32_t t = now_tick - visits + 1; visits; visits--, t++) {
+            int8_t* link = &heads[t % NumberSlots];
+            while (*link != invalid_job) {
+                int8_t id = *link;
+                if ((int32_t)(jobs[id].deadline - now_tick) > 0) {
+                    link = &jobs[id].next;
+                    continue;
+                }
+                *link = jobs[id].next;
+                jobs[id].is_scheduled = false;
+                Execute(id, now);
+            }
+        }
+    }
+
+    /// @return ms until the next deadline, which is how long the executor task may sleep, or stop when no job is scheduled.
+    uint32_t GetDelay(uint32_t now) const {
+        uint32_t delay = stop;
+        uint32_t now_tick = now / tick;
+        for (int8_t id = 0; id < number_jobs; id++) {
+            if (!jobs[id].is_scheduled) continue;
+            int32_t ticks = jobs[id].deadline - now_tick;
+            uint32_t job_delay = ticks > 0 ? ticks * tick - now % tick : 0;
+            if (job_delay < delay) delay = job_delay;
+        }
+        return delay;
+    }
+
+    uint8_t GetNumberJobs() const { return number_jobs; }
+    const Statistics& GetStatistics(int8_t id) const { return statistics[id]; }
+
+private:
+    struct Job {
+        JobFunction function;
+        void* context;
+        uint32_t deadline; // tick
+        int8_t next; // In the list of its slot.
+        bool is_scheduled;
+    };
+
+    uint32_t tick;
+    int64_t (*clock)();
+    Job jobs[MaxJobs];
+    Statistics statistics[MaxJobs];
+    uint8_t number_jobs = 0;
+    int8_t heads[NumberSlots];
+    uint32_t last_tick = 0; // Last tick whose slot was visited, or is being visited during a pass.
+    std::atomic<uint32_t> notifications{0};
+
+    void Schedule(int8_t id, uint32_t now, uint32_t delay) {
+        if (delay == stop) return;
+        // Rounded up, so a job never runs before its delay. A deadline already visited is put in the next slot.
+        uint32_t deadline = (now + delay + tick - 1) / tick;
+        if (deadline <= last_tick) deadline = last_tick + 1;
+        Job& job = jobs[id];
+        job.deadline = deadline;
+        job.next = heads[deadline % NumberSlots];
+        job.is_scheduled = true;
+        heads[deadline % NumberSlots] = id;
+    }
+
+    void Unlink(int8_t id) {
+        int8_t* link = &heads[jobs[id].deadline % NumberSlots];
+        while (*link != invalid_job && *link != id) link = &jobs[*link].next;
+        if (*link == id) *link = jobs[id].next;
+        jobs[id].is_scheduled = false;
+    }
+
+    void Execute(int8_t id, uint32_t now) {
+        Statistics& entry = statistics[id];
+        uint32_t deadline_time = jobs[id].deadline * tick;
+        if ((int32_t)(now - deadline_time) > (int32_t)entry.max_lateness) entry.max_lateness = now - deadline_time;
+        int64_t start = clock();
+        uint32_t delay = jobs[id].function(jobs[id].context, now);
+        uint32_t time = clock() - start;
+        entry.runs++;
+        entry.total_time += time;
+        if (time > entry.max_time) entry.max_time = time;
+        Schedule(id, now + time / 1000, delay);
+    }
+};
@@ -0,0 +1,232 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+
+/// @brief Modulation settings of the LoRa radio, in the units of the LORA_PARAMS message.
+struct LoraSetting {
+    uint8_t spreading_factor; // 7 to 12. SF6 needs an implicit header, which the LoRa board does not use.
+    int32_t bandwidth; // Hz
+    uint8_t coding_rate; // Denominator of the coding rate, 5 to 8.
+
+    bool operator==(const LoraSetting& other) const {
+        return spreading_factor == other.spreading_factor && bandwidth == other.bandwidth && coding_rate == other.coding_rate;
+    }
+    bool operator!=(const LoraSetting& other) const { return !(*this == other); }
+};
+
+/// @brief Time on air of a LoRa frame, from the formula of the Semtech SX127x datasheet, with an explicit header and the payload CRC on.
+/// @param payload_length Bytes handed to the radio.
+/// @return Airtime in ms.
+inline float LoraAirtime(const LoraSetting& setting, uint16_t payload_length, uint16_t preamble_length = 8) {
+    float symbol_time = (float)(1UL << setting.spreading_factor) * 1000.0f / setting.bandwidth; // ms
+    int32_t low_data_rate = symbol_time > 16.0f ? 1 : 0; // Forced by the radio for long symbols.
+    int32_t numerator = 8 * payload_length - 4 * setting.spreading_factor + 28 + 16;
+    int32_t denominator = 4 * (setting.spreading_factor - 2 * low_data_rate);
+    int32_t payload_symbols = 8;
+    if (numerator > 0) payload_symbols += ((numerator + denominator - 1) / denominator) * setting.coding_rate;
+    return (preamble_length + 4.25f) * symbol_time + payload_symbols * symbol_time;
+}
+
+/// @brief Adaptive data rate for the LoRa link. Picks the fastest modulation that keeps the packet loss reported by the LoRa board under a target.
+/// The candidate settings form a ladder ordered by the airtime of a telemetry frame, from the most robust, which is also the fallback, to the fastest.
+/// The controller steps down one rung as soon as the loss goes over the target or the SNR gets close to the demodulation floor of the spreading factor,
+/// and steps up only when the loss is well under the target and the SNR predicted for the next rung leaves a margin, after a hold-off. A step up that
+/// has to be undone soon after doubles the hold-off of that rung, so a marginal link does not keep bouncing. Without reports for a while, the link
+/// is assumed lost and the controller goes straight to the fallback, which is where the LoRa board and the shore station meet again.
+/// Portable C++ with no allocation and no locking, with the time passed in, so it can be driven by the host channel simulator as well.
+class LinkRateController {
+public:
+    static constexpr uint8_t number_rungs = 9;
+    static constexpr uint16_t reference_frame_length = 64; // Bytes. Typical telemetry frame, used to order the ladder and to report throughput.
+
+    struct Report {
+        uint32_t packets_received; // Counters since the LoRa board started.
+        uint32_t packets_lost;
+        float rssi; // dBm
+        float snr; // dB
+        LoraSetting setting; // Setting the radio is using.
+    };
+
+    struct Settings {
+        float target_loss = 0.05f; // Fraction of packets.
+        float min_margin = 2.5f; // dB above the demodulation floor under which the controller steps down.
+        float step_up_margin = 6.0f; // dB above the floor of the next rung, as predicted from the current SNR, needed to step up.
+        uint32_t settle_time = 5000; // ms after a change during which reports are ignored.
+        uint32_t step_up_holdoff = 20000; // ms of good reports needed before stepping up.
+        uint32_t max_holdoff = 600000; // ms. Cap of the backoff of rungs that failed.
+        uint32_t link_timeout = 30000; // ms without reports after which the fallback is used.
+        uint32_t resend_interval = 2000; // ms between repetitions of a command the LoRa board has not applied yet.
+        uint16_t min_packets = 10; // Packets a loss estimate must be based on before it is trusted.
+    };
+
+    LinkRateController() : LinkRateController(Settings()) {}
+    explicit LinkRateController(const Settings& settings) : settings(settings) {
+        // Candidates in no particular order. They are sorted by airtime so the ladder follows the real cost of a frame.
+        static constexpr LoraSetting candidates[number_rungs] = {
+            { 7, 125000, 5 }, { 12, 125000, 8 }, { 9, 125000, 5 }, { 7, 500000, 5 }, { 11, 125000, 5 },
+            { 8, 125000, 5 }, { 12, 125000, 5 }, { 10, 125000, 5 }, { 7, 250000, 5 }
+        };
+        for (uint8_t i = 0; i < number_rungs; i++) {
+            uint8_t position = i;
+            float airtime = LoraAirtime(candidates[i], reference_frame_length);
+            while (position > 0 && LoraAirtime(ladder[position - 1], reference_frame_length) < airtime) {
+                ladder[position] = ladder[position - 1];
+                position--;
+            }
+            ladder[position] = candidates[i];
+        }
+        for (uint8_t i = 0; i < number_rungs; i++) holdoff[i] = settings.step_up_holdoff;
+        current = ladder[0];
+    }
+
+    /// @brief Feeds a link report from the LoRa board.
+    /// @return True if the LORA_PARAMS command must be sent, either because the setting changed or because the board has not applied it yet.
+    bool Update(const Report& report, uint32_t now) {
+        last_report = now;
+        has_report = true;
+        last_rssi = report.rssi;
+
+        // Counters going backwards mean the LoRa board restarted, so they become the new baseline.
+        bool is_restart = report.packets_received < last_received || report.packets_lost < last_lost;
+        uint32_t received = is_restart ? 0 : report.packets_received - last_received;
+        uint32_t lost = is_restart ? 0 : report.packets_lost - last_lost;
+        last_received = report.packets_received;
+        last_lost = report.packets_lost;
+
+        if (report.setting != current) return Resend(now);
+        is_applied = true;
+        if (now - last_change < settings.settle_time) return false;
+
+        snr = has_snr ? snr + 0.3f * (report.snr - snr) : report.snr;
+        has_snr = true;
+        packets += received + lost;
+        if (received + lost) {
+            float loss_ratio = (float)lost / (received + lost);
+            // The first estimate at a new rung starts from the ratio itself, so one bad report is enough to step back down.
+            loss = packets == received + lost ? loss_ratio : loss + 0.3f * (loss_ratio - loss);
+        }
+        if (!is_automatic || rung < 0) return false;
+
+        bool is_loss_known = packets >= settings.min_packets;
+        if ((is_loss_known && loss > settings.target_loss) || Margin(ladder[rung], snr) < settings.min_margin) {
+            if (rung == 0) return false;
+            // A rung that fails soon after being reached is tried again later and later.
+            if (now - last_change < 2 * holdoff[rung]) {
+                holdoff[rung] = holdoff[rung] * 2 < settings.max_holdoff ? holdoff[rung] * 2 : settings.max_holdoff;
+            }
+            return Select(rung - 1, now);
+        }
+
+        if (rung + 1 < number_rungs && is_loss_known && loss < settings.target_loss / 2 && now - last_change >= holdoff[rung + 1]) {
+            float predicted_snr = snr - 10.0f * log10f((float)ladder[rung + 1].bandwidth / ladder[rung].bandwidth);
+            if (Margin(ladder[rung + 1], predicted_snr) >= settings.step_up_margin) return Select(rung + 1, now);
+        }
+        return false;
+    }
+
+    /// @brief Checks for a lost link and repeats commands the LoRa board has not applied. Call periodically.
+    /// @return True if the LORA_PARAMS command must be sent.
+    bool Poll(uint32_t now) {
+        if (is_automatic && rung > 0 && has_report && now - last_report >= settings.link_timeout) {
+            has_report = false;
+            return Select(0, now);
+        }
+        if (!is_applied) return Resend(now);
+        return false;
+    }
+
+    /// @brief Fixes the setting and stops the automatic control until SetAutomatic() is called.
+    void SetManual(const LoraSetting& setting, uint32_t now) {
+        is_automatic = false;
+        rung = -1;
+        for (uint8_t i = 0; i < number_rungs; i++) {
+            if (ladder[i] == setting) rung = i;
+        }
+        Change(setting, now);
+    }
+
+    /// @brief Resumes the automatic control from the fallback.
+    void SetAutomatic(uint32_t now) {
+        is_automatic = true;
+        for (uint8_t i = 0; i < number_rungs; i++) holdoff[i] = settings.step_up_holdoff;
+        Select(0, now);
+    }
+
+    /// @brief Accounts for a frame written to the LoRa board, to measure how much of the airtime the traffic takes.
+    void RecordFrame(uint16_t length, uint32_t now) {
+        if (now - window_start >= utilization_window) {
+            utilization = airtime_used / (now - window_start);
+            airtime_used = 0.0f;
+            window_start = now;
+        }
+        airtime_used += LoraAirtime(current, length);
+    }
+
+    const LoraSetting& GetSetting() const { return current; }
+    const LoraSetting& GetRung(uint8_t index) const { return ladder[index]; }
+    int8_t GetRungIndex() const { return rung; } // -1 for a manual setting outside the ladder.
+    bool IsAutomatic() const { return is_automatic; }
+    bool IsApplied() const { return is_applied; } // Whether the LoRa board reported using the current setting.
+    float GetLoss() const { return loss; }
+    float GetSnr() const { return snr; }
+    float GetRssi() const { return last_rssi; }
+    float GetMargin() const { return Margin(current, snr); } // dB above the demodulation floor.
+    float GetAirtime(uint16_t length = reference_frame_length) const { return LoraAirtime(current, length); } // ms
+    float GetThroughput() const { return reference_frame_length * 1000.0f / GetAirtime(); } // Bytes per second with the channel fully used.
+    float GetUtilization() const { return utilization; } // Fraction of the time the traffic kept the radio on air.
+
+    /// @brief SNR below which a spreading factor can no longer be demodulated, from the SX127x datasheet.
+    static float DemodulationFloor(uint8_t spreading_factor) { return -5.0f - 2.5f * (spreading_factor - 6); }
+
+private:
+    static constexpr uint32_t utilization_window = 10000; // ms
+
+    Settings settings;
+    LoraSetting ladder[number_rungs];
+    uint32_t holdoff[number_rungs];
+    LoraSetting current;
+    int8_t rung = 0;
+    bool is_automatic = true;
+    bool is_applied = false;
+
+    uint32_t last_change = 0;
+    uint32_t last_command = 0;
+    uint32_t last_report = 0;
+    bool has_report = false;
+    uint32_t last_received = 0;
+    uint32_t last_lost = 0;
+    uint32_t packets = 0;
+    float loss = 0.0f;
+    float snr = 0.0f;
+    bool has_snr = false;
+    float last_rssi = 0.0f;
+
+    float airtime_used = 0.0f;
+    uint32_t window_start = 0;
+    float utilization = 0.0f;
+
+    static float Margin(const LoraSetting& setting, float snr) { return snr - DemodulationFloor(setting.spreading_factor); }
+
+    bool Select(int8_t index, uint32_t now) {
+        // The SNR is measured within the bandwidth of the receiver, so it is carried over to the new bandwidth.
+        if (rung >= 0 && has_snr) snr -= 10.0f * log10f((float)ladder[index].bandwidth / current.bandwidth);
+        rung = index;
+        Change(ladder[index], now);
+        return true;
+    }
+
+    void Change(const LoraSetting& setting, uint32_t now) {
+        current = setting;
+        is_applied = false;
+        last_change = now;
+        last_command = now;
+        packets = 0;
+        loss = 0.0f;
+    }
+
+    bool Resend(uint32_t now) {
+        if (now - last_command < settings.resend_interval) return false;
+        last_command = now;
+        return true;
+    }
+};
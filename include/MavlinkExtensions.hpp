@@ -0,0 +1,579 @@
+#pragma once
+#include <string.h>
+#include "arariboat\mavlink.h"
+
+// Messages that are not part of the mavlink-arariboat dialect yet. They are written in the same layout the Mavgen tool generates,
+// so they can be moved to the dialect once the ground station supports them. The message definitions are kept below in the XML form
+// Mavgen expects, and each CRC extra was computed from that definition the same way Mavgen does, so receivers generated from it interoperate.
+// Ids are taken from the MAVLink 2 range starting at 53000, away from the ids used by the dialect.
+//
+// <message id="53000" name="ALARM">
+//   <field type="uint32_t" name="time_boot_ms">Time the alarm changed state, in ms since boot.</field>
+//   <field type="uint8_t" name="rule">Index of the rule in the alarm table.</field>
+//   <field type="uint8_t" name="field">Telemetry field watched by the rule.</field>
+//   <field type="uint8_t" name="state">1 when the alarm is raised, 0 when it clears.</field>
+//   <field type="uint8_t" name="severity">0 for warnings, 1 for critical conditions.</field>
+//   <field type="float" name="value">Value of the field that caused the change.</field>
+//   <field type="float" name="threshold">Threshold of the rule.</field>
+// </message>
+
+#define MAVLINK_MSG_ID_ALARM 53000
+
+typedef struct __mavlink_alarm_t {
+    uint32_t time_boot_ms;
+    float value;
+    float threshold;
+    uint8_t rule;
+    uint8_t field;
+    uint8_t state;
+    uint8_t severity;
+} mavlink_alarm_t;
+
+#define MAVLINK_MSG_ID_ALARM_LEN 16
+#define MAVLINK_MSG_ID_ALARM_MIN_LEN 16
+#define MAVLINK_MSG_ID_ALARM_CRC 235
+
+static inline uint16_t mavlink_msg_alarm_encode_chan(uint8_t system_id, uint8_t component_id, uint8_t chan, mavlink_message_t* msg, const mavlink_alarm_t* alarm) {
+    memcpy(_MAV_PAYLOAD_NON_CONST(msg), alarm, MAVLINK_MSG_ID_ALARM_LEN);
+    msg->msgid = MAVLINK_MSG_ID_ALARM;
+    return mavlink_finalize_message_chan(msg, system_id, component_id, chan, MAVLINK_MSG_ID_ALARM_MIN_LEN, MAVLINK_MSG_ID_ALARM_LEN, MAVLINK_MSG_ID_ALARM_CRC);
+}
+
+static inline void mavlink_msg_alarm_decode(const mavlink_message_t* msg, mavlink_alarm_t* alarm) {
+    uint8_t len = msg->len < MAVLINK_MSG_ID_ALARM_LEN ? msg->len : MAVLINK_MSG_ID_ALARM_LEN;
+    memset(alarm, 0, MAVLINK_MSG_ID_ALARM_LEN);
+    memcpy(alarm, _MAV_PAYLOAD(msg), len);
+}
+
+// <message id="53001" name="CAPTURE_CHUNK">
+//   <field type="uint32_t" name="trigger_time_ms">Time the capture was triggered, in ms since boot. Identifies the capture.</field>
+//   <field type="uint8_t" name="slot">Capture slot the samples come from.</field>
+//   <field type="uint8_t" name="count">Number of valid samples in this chunk.</field>
+//   <field type="uint16_t" name="offset">Index of the first sample of this chunk within the capture.</field>
+//   <field type="uint16_t" name="total">Number of samples in the capture.</field>
+//   <field type="uint16_t" name="sample_interval_us">Average interval between samples.</field>
+//   <field type="int16_t[16]" name="motor_current">Motor current, in units of 10mA.</field>
+//   <field type="int16_t[16]" name="battery_current">Battery current, in units of 10mA.</field>
+// </message>
+
+#define MAVLINK_MSG_ID_CAPTURE_CHUNK 53001
+
+typedef struct __mavlink_capture_chunk_t {
+    uint32_t trigger_time_ms;
+    uint16_t offset;
+    uint16_t total;
+    uint16_t sample_interval_us;
+    int16_t motor_current[16];
+    int16_t battery_current[16];
+    uint8_t slot;
+    uint8_t count;
+} mavlink_capture_chunk_t;
+
+#define MAVLINK_MSG_ID_CAPTURE_CHUNK_LEN 76
+#define MAVLINK_MSG_ID_CAPTURE_CHUNK_MIN_LEN 76
+#define MAVLINK_MSG_ID_CAPTURE_CHUNK_CRC 239
+#define MAVLINK_MSG_CAPTURE_CHUNK_FIELD_MOTOR_CURRENT_LEN 16
+#define MAVLINK_MSG_CAPTURE_CHUNK_FIELD_BATTERY_CURRENT_LEN 16
+
+static inline uint16_t mavlink_msg_capture_chunk_encode_chan(uint8_t system_id, uint8_t component_id, uint8_t chan, mavlink_message_t* msg, const mavlink_capture_chunk_t* capture_chunk) {
+    memcpy(_MAV_PAYLOAD_NON_CONST(msg), capture_chunk, MAVLINK_MSG_ID_CAPTURE_CHUNK_LEN);
+    msg->msgid = MAVLINK_MSG_ID_CAPTURE_CHUNK;
+    return mavlink_finalize_message_chan(msg, system_id, component_id, chan, MAVLINK_MSG_ID_CAPTURE_CHUNK_MIN_LEN, MAVLINK_MSG_ID_CAPTURE_CHUNK_LEN, MAVLINK_MSG_ID_CAPTURE_CHUNK_CRC);
+}
+
+static inline void mavlink_msg_capture_chunk_decode(const mavlink_message_t* msg, mavlink_capture_chunk_t* capture_chunk) {
+    uint8_t len = msg->len < MAVLINK_MSG_ID_CAPTURE_CHUNK_LEN ? msg->len : MAVLINK_MSG_ID_CAPTURE_CHUNK_LEN;
+    memset(capture_chunk, 0, MAVLINK_MSG_ID_CAPTURE_CHUNK_LEN);
+    memcpy(capture_chunk, _MAV_PAYLOAD(msg), len);
+}
+
+// <message id="53002" name="CURRENT_SPECTRUM">
+//   <field type="uint32_t" name="time_boot_ms">Time the frame ended, in ms since boot.</field>
+//   <field type="uint8_t" name="channel">0 for the motor current, 1 for the battery current.</field>
+//   <field type="float" name="sample_rate">Rate the frame was sampled at, in Hz.</field>
+//   <field type="float" name="dc">Mean current of the frame, in A.</field>
+//   <field type="float[3]" name="peak_frequency">Frequencies of the strongest ripple components, strongest first, in Hz.</field>
+//   <field type="float[3]" name="peak_amplitude">Peak amplitudes of those components, in A.</field>
+//   <field type="float[4]" name="band_rms">RMS current within each analysis band, in A.</field>
+// </message>
+
+#define MAVLINK_MSG_ID_CURRENT_SPECTRUM 53002
+
+typedef struct __mavlink_current_spectrum_t {
+    uint32_t time_boot_ms;
+    float sample_rate;
+    float dc;
+    float peak_frequency[3];
+    float peak_amplitude[3];
+    float band_rms[4];
+    uint8_t channel;
+} mavlink_current_spectrum_t;
+
+#define MAVLINK_MSG_ID_CURRENT_SPECTRUM_LEN 53
+#define MAVLINK_MSG_ID_CURRENT_SPECTRUM_MIN_LEN 53
+#define MAVLINK_MSG_ID_CURRENT_SPECTRUM_CRC 238
+#define MAVLINK_MSG_CURRENT_SPECTRUM_FIELD_PEAK_FREQUENCY_LEN 3
+#define MAVLINK_MSG_CURRENT_SPECTRUM_FIELD_PEAK_AMPLITUDE_LEN 3
+#define MAVLINK_MSG_CURRENT_SPECTRUM_FIELD_BAND_RMS_LEN 4
+
+static inline uint16_t mavlink_msg_current_spectrum_encode_chan(uint8_t system_id, uint8_t component_id, uint8_t chan, mavlink_message_t* msg, const mavlink_current_spectrum_t* current_spectrum) {
+    memcpy(_MAV_PAYLOAD_NON_CONST(msg), current_spectrum, MAVLINK_MSG_ID_CURRENT_SPECTRUM_LEN);
+    msg->msgid = MAVLINK_MSG_ID_CURRENT_SPECTRUM;
+    return mavlink_finalize_message_chan(msg, system_id, component_id, chan, MAVLINK_MSG_ID_CURRENT_SPECTRUM_MIN_LEN, MAVLINK_MSG_ID_CURRENT_SPECTRUM_LEN, MAVLINK_MSG_ID_CURRENT_SPECTRUM_CRC);
+}
+
+static inline void mavlink_msg_current_spectrum_decode(const mavlink_message_t* msg, mavlink_current_spectrum_t* current_spectrum) {
+    uint8_t len = msg->len < MAVLINK_MSG_ID_CURRENT_SPECTRUM_LEN ? msg->len : MAVLINK_MSG_ID_CURRENT_SPECTRUM_LEN;
+    memset(current_spectrum, 0, MAVLINK_MSG_ID_CURRENT_SPECTRUM_LEN);
+    memcpy(current_spectrum, _MAV_PAYLOAD(msg), len);
+}
+
+// <message id="53003" name="PUMP_STATUS">
+//   <field type="uint32_t" name="time_boot_ms">Time of the report, in ms since boot.</field>
+//   <field type="uint8_t" name="state">Bit 1 set while the port pump runs, bit 0 while the starboard pump runs.</field>
+//   <field type="uint32_t[2]" name="on_time">Total time each pump has run, in s. Kept across reboots.</field>
+//   <field type="uint32_t[2]" name="longest_run">Longest single run of each pump, in s.</field>
+//   <field type="uint16_t[2]" name="cycles">Number of times each pump has started.</field>
+//   <field type="float[2]" name="duty_cycle">Percentage of the last hour each pump was on.</field>
+// </message>
+
+#define MAVLINK_MSG_ID_PUMP_STATUS 53003
+
+typedef struct __mavlink_pump_status_t {
+    uint32_t time_boot_ms;
+    uint32_t on_time[2];
+    uint32_t longest_run[2];
+    float duty_cycle[2];
+    uint16_t cycles[2];
+    uint8_t state;
+} mavlink_pump_status_t;
+
+#define MAVLINK_MSG_ID_PUMP_STATUS_LEN 33
+#define MAVLINK_MSG_ID_PUMP_STATUS_MIN_LEN 33
+#define MAVLINK_MSG_ID_PUMP_STATUS_CRC 249
+
+static inline uint16_t mavlink_msg_pump_status_encode_chan(uint8_t system_id, uint8_t component_id, uint8_t chan, mavlink_message_t* msg, const mavlink_pump_status_t* pump_status) {
+    memcpy(_MAV_PAYLOAD_NON_CONST(msg), pump_status, MAVLINK_MSG_ID_PUMP_STATUS_LEN);
+    msg->msgid = MAVLINK_MSG_ID_PUMP_STATUS;
+    return mavlink_finalize_message_chan(msg, system_id, component_id, chan, MAVLINK_MSG_ID_PUMP_STATUS_MIN_LEN, MAVLINK_MSG_ID_PUMP_STATUS_LEN, MAVLINK_MSG_ID_PUMP_STATUS_CRC);
+}
+
+static inline void mavlink_msg_pump_status_decode(const mavlink_message_t* msg, mavlink_pump_status_t* pump_status) {
+    uint8_t len = msg->len < MAVLINK_MSG_ID_PUMP_STATUS_LEN ? msg->len : MAVLINK_MSG_ID_PUMP_STATUS_LEN;
+    memset(pump_status, 0, MAVLINK_MSG_ID_PUMP_STATUS_LEN);
+    memcpy(pump_status, _MAV_PAYLOAD(msg), len);
+}
+
+// <message id="53004" name="CALIBRATION_COMMAND">
+//   <field type="uint8_t" name="action">0 starts a calibration, 1 captures a point, 2 commits the fit and 3 aborts.</field>
+//   <field type="uint8_t" name="channel">Channel to calibrate, used when starting.</field>
+//   <field type="uint16_t" name="samples">Samples averaged for each point, used when starting. 0 for the default.</field>
+//   <field type="float" name="reference">Value measured by the instrument, used when capturing a point.</field>
+// </message>
+
+#define MAVLINK_MSG_ID_CALIBRATION_COMMAND 53004
+
+typedef struct __mavlink_calibration_command_t {
+    float reference;
+    uint16_t samples;
+    uint8_t action;
+    uint8_t channel;
+} mavlink_calibration_command_t;
+
+#define MAVLINK_MSG_ID_CALIBRATION_COMMAND_LEN 8
+#define MAVLINK_MSG_ID_CALIBRATION_COMMAND_MIN_LEN 8
+#define MAVLINK_MSG_ID_CALIBRATION_COMMAND_CRC 101
+
+static inline uint16_t mavlink_msg_calibration_command_encode_chan(uint8_t system_id, uint8_t component_id, uint8_t chan, mavlink_message_t* msg, const mavlink_calibration_command_t* calibration_command) {
+    memcpy(_MAV_PAYLOAD_NON_CONST(msg), calibration_command, MAVLINK_MSG_ID_CALIBRATION_COMMAND_LEN);
+    msg->msgid = MAVLINK_MSG_ID_CALIBRATION_COMMAND;
+    return mavlink_finalize_message_chan(msg, system_id, component_id, chan, MAVLINK_MSG_ID_CALIBRATION_COMMAND_MIN_LEN, MAVLINK_MSG_ID_CALIBRATION_COMMAND_LEN, MAVLINK_MSG_ID_CALIBRATION_COMMAND_CRC);
+}
+
+static inline void mavlink_msg_calibration_command_decode(const mavlink_message_t* msg, mavlink_calibration_command_t* calibration_command) {
+    uint8_t len = msg->len < MAVLINK_MSG_ID_CALIBRATION_COMMAND_LEN ? msg->len : MAVLINK_MSG_ID_CALIBRATION_COMMAND_LEN;
+    memset(calibration_command, 0, MAVLINK_MSG_ID_CALIBRATION_COMMAND_LEN);
+    memcpy(calibration_command, _MAV_PAYLOAD(msg), len);
+}
+
+// <message id="53005" name="CALIBRATION_STATUS">
+//   <field type="uint8_t" name="channel">Channel being calibrated.</field>
+//   <field type="uint8_t" name="state">0 idle, 1 waiting for a reference or the commit, 2 sampling a point.</field>
+//   <field type="uint8_t" name="result">Result of the last command, 0 when it succeeded.</field>
+//   <field type="uint8_t" name="number_points">Points captured so far.</field>
+//   <field type="uint16_t" name="samples_collected">Samples averaged so far for the point being captured.</field>
+//   <field type="uint16_t" name="samples_per_point">Samples averaged for each point.</field>
+//   <field type="float" name="slope">Slope applied to the channel.</field>
+//   <field type="float" name="intercept">Intercept applied to the channel.</field>
+//   <field type="float" name="residual">RMS error of the last fit.</field>
+// </message>
+
+#define MAVLINK_MSG_ID_CALIBRATION_STATUS 53005
+
+typedef struct __mavlink_calibration_status_t {
+    float slope;
+    float intercept;
+    float residual;
+    uint16_t samples_collected;
+    uint16_t samples_per_point;
+    uint8_t channel;
+    uint8_t state;
+    uint8_t result;
+    uint8_t number_points;
+} mavlink_calibration_status_t;
+
+#define MAVLINK_MSG_ID_CALIBRATION_STATUS_LEN 20
+#define MAVLINK_MSG_ID_CALIBRATION_STATUS_MIN_LEN 20
+#define MAVLINK_MSG_ID_CALIBRATION_STATUS_CRC 10
+
+static inline uint16_t mavlink_msg_calibration_status_encode_chan(uint8_t system_id, uint8_t component_id, uint8_t chan, mavlink_message_t* msg, const mavlink_calibration_status_t* calibration_status) {
+    memcpy(_MAV_PAYLOAD_NON_CONST(msg), calibration_status, MAVLINK_MSG_ID_CALIBRATION_STATUS_LEN);
+    msg->msgid = MAVLINK_MSG_ID_CALIBRATION_STATUS;
+    return mavlink_finalize_message_chan(msg, system_id, component_id, chan, MAVLINK_MSG_ID_CALIBRATION_STATUS_MIN_LEN, MAVLINK_MSG_ID_CALIBRATION_STATUS_LEN, MAVLINK_MSG_ID_CALIBRATION_STATUS_CRC);
+}
+
+static inline void mavlink_msg_calibration_status_decode(const mavlink_message_t* msg, mavlink_calibration_status_t* calibration_status) {
+    uint8_t len = msg->len < MAVLINK_MSG_ID_CALIBRATION_STATUS_LEN ? msg->len : MAVLINK_MSG_ID_CALIBRATION_STATUS_LEN;
+    memset(calibration_status, 0, MAVLINK_MSG_ID_CALIBRATION_STATUS_LEN);
+    memcpy(calibration_status, _MAV_PAYLOAD(msg), len);
+}
+
+// <message id="53006" name="LORA_LINK_STATUS">
+//   <field type="uint32_t" name="packets_received">Packets received from the shore station since the LoRa board started.</field>
+//   <field type="uint32_t" name="packets_lost">Packets from the shore station missed since the LoRa board started, found from the gaps in their sequence.</field>
+//   <field type="float" name="rssi">RSSI of the last packets, in dBm.</field>
+//   <field type="float" name="snr">SNR of the last packets, in dB.</field>
+//   <field type="int32_t" name="bandwidth">Bandwidth the radio is using, in Hz.</field>
+//   <field type="uint8_t" name="spreading_factor">Spreading factor the radio is using.</field>
+//   <field type="uint8_t" name="coding_rate">Denominator of the coding rate the radio is using, from 5 to 8.</field>
+// </message>
+
+#define MAVLINK_MSG_ID_LORA_LINK_STATUS 53006
+
+typedef struct __mavlink_lora_link_status_t {
+    uint32_t packets_received;
+    uint32_t packets_lost;
+    float rssi;
+    float snr;
+    int32_t bandwidth;
+    uint8_t spreading_factor;
+    uint8_t coding_rate;
+} mavlink_lora_link_status_t;
+
+#define MAVLINK_MSG_ID_LORA_LINK_STATUS_LEN 22
+#define MAVLINK_MSG_ID_LORA_LINK_STATUS_MIN_LEN 22
+#define MAVLINK_MSG_ID_LORA_LINK_STATUS_CRC 207
+
+static inline uint16_t mavlink_msg_lora_link_status_encode_chan(uint8_t system_id, uint8_t component_id, uint8_t chan, mavlink_message_t* msg, const mavlink_lora_link_status_t* lora_link_status) {
+    memcpy(_MAV_PAYLOAD_NON_CONST(msg), lora_link_status, MAVLINK_MSG_ID_LORA_LINK_STATUS_LEN);
+    msg->msgid = MAVLINK_MSG_ID_LORA_LINK_STATUS;
+    return mavlink_finalize_message_chan(msg, system_id, component_id, chan, MAVLINK_MSG_ID_LORA_LINK_STATUS_MIN_LEN, MAVLINK_MSG_ID_LORA_LINK_STATUS_LEN, MAVLINK_MSG_ID_LORA_LINK_STATUS_CRC);
+}
+
+static inline void mavlink_msg_lora_link_status_decode(const mavlink_message_t* msg, mavlink_lora_link_status_t* lora_link_status) {
+    uint8_t len = msg->len < MAVLINK_MSG_ID_LORA_LINK_STATUS_LEN ? msg->len : MAVLINK_MSG_ID_LORA_LINK_STATUS_LEN;
+    memset(lora_link_status, 0, MAVLINK_MSG_ID_LORA_LINK_STATUS_LEN);
+    memcpy(lora_link_status, _MAV_PAYLOAD(msg), len);
+}
+
+// <message id="53007" name="FEC_PARITY">
+//   <field type="uint8_t" name="group">Counter of the groups of frames, to tell the parity frames of successive groups apart.</field>
+//   <field type="uint8_t" name="first_seq">Sequence number of the first data frame of the group. The data frames of a group have contiguous sequence numbers.</field>
+//   <field type="uint8_t" name="data_frames">Data frames in the group.</field>
+//   <field type="uint8_t" name="parity_frames">Parity frames sent for the group.</field>
+//   <field type="uint8_t" name="index">Row of this parity frame in the code.</field>
+//   <field type="uint8_t[240]" name="data">Parity of the data frames, padded with zeros to the longest one. Trailing zeros are trimmed from the payload.</field>
+// </message>
+
+#define MAVLINK_MSG_ID_FEC_PARITY 53007
+
+typedef struct __mavlink_fec_parity_t {
+    uint8_t group;
+    uint8_t first_seq;
+    uint8_t data_frames;
+    uint8_t parity_frames;
+    uint8_t index;
+    uint8_t data[240];
+} mavlink_fec_parity_t;
+
+#define MAVLINK_MSG_ID_FEC_PARITY_LEN 245
+#define MAVLINK_MSG_ID_FEC_PARITY_MIN_LEN 245
+#define MAVLINK_MSG_ID_FEC_PARITY_CRC 188
+
+static inline uint16_t mavlink_msg_fec_parity_encode_chan(uint8_t system_id, uint8_t component_id, uint8_t chan, mavlink_message_t* msg, const mavlink_fec_parity_t* fec_parity) {
+    memcpy(_MAV_PAYLOAD_NON_CONST(msg), fec_parity, MAVLINK_MSG_ID_FEC_PARITY_LEN);
+    msg->msgid = MAVLINK_MSG_ID_FEC_PARITY;
+    return mavlink_finalize_message_chan(msg, system_id, component_id, chan, MAVLINK_MSG_ID_FEC_PARITY_MIN_LEN, MAVLINK_MSG_ID_FEC_PARITY_LEN, MAVLINK_MSG_ID_FEC_PARITY_CRC);
+}
+
+static inline void mavlink_msg_fec_parity_decode(const mavlink_message_t* msg, mavlink_fec_parity_t* fec_parity) {
+    uint8_t len = msg->len < MAVLINK_MSG_ID_FEC_PARITY_LEN ? msg->len : MAVLINK_MSG_ID_FEC_PARITY_LEN;
+    memset(fec_parity, 0, MAVLINK_MSG_ID_FEC_PARITY_LEN);
+    memcpy(fec_parity, _MAV_PAYLOAD(msg), len);
+}
+
+// <message id="53008" name="RELIABLE_MESSAGE">
+//   <field type="uint16_t" name="seq">Sequence number of the reliable layer, separate from the sequence number of the frame.</field>
+//   <field type="uint8_t" name="session">Session of the sender, which changes whenever it restarts.</field>
+//   <field type="uint8_t" name="length">Bytes of the wrapped frame.</field>
+//   <field type="uint8_t[225]" name="frame">Complete MAVLink frame that must be delivered. Trailing zeros are trimmed from the payload.</field>
+// </message>
+
+#define MAVLINK_MSG_ID_RELIABLE_MESSAGE 53008
+
+typedef struct __mavlink_reliable_message_t {
+    uint16_t seq;
+    uint8_t session;
+    uint8_t length;
+    uint8_t frame[225];
+} mavlink_reliable_message_t;
+
+#define MAVLINK_MSG_ID_RELIABLE_MESSAGE_LEN 229
+#define MAVLINK_MSG_ID_RELIABLE_MESSAGE_MIN_LEN 229
+#define MAVLINK_MSG_ID_RELIABLE_MESSAGE_CRC 88
+
+static inline uint16_t mavlink_msg_reliable_message_encode_chan(uint8_t system_id, uint8_t component_id, uint8_t chan, mavlink_message_t* msg, const mavlink_reliable_message_t* reliable_message) {
+    memcpy(_MAV_PAYLOAD_NON_CONST(msg), reliable_message, MAVLINK_MSG_ID_RELIABLE_MESSAGE_LEN);
+    msg->msgid = MAVLINK_MSG_ID_RELIABLE_MESSAGE;
+    return mavlink_finalize_message_chan(msg, system_id, component_id, chan, MAVLINK_MSG_ID_RELIABLE_MESSAGE_MIN_LEN, MAVLINK_MSG_ID_RELIABLE_MESSAGE_LEN, MAVLINK_MSG_ID_RELIABLE_MESSAGE_CRC);
+}
+
+static inline void mavlink_msg_reliable_message_decode(const mavlink_message_t* msg, mavlink_reliable_message_t* reliable_message) {
+    uint8_t len = msg->len < MAVLINK_MSG_ID_RELIABLE_MESSAGE_LEN ? msg->len : MAVLINK_MSG_ID_RELIABLE_MESSAGE_LEN;
+    memset(reliable_message, 0, MAVLINK_MSG_ID_RELIABLE_MESSAGE_LEN);
+    memcpy(reliable_message, _MAV_PAYLOAD(msg), len);
+}
+
+// <message id="53009" name="RELIABLE_ACK">
+//   <field type="uint16_t" name="base">Lowest reliable sequence number not received yet.</field>
+//   <field type="uint32_t" name="received_mask">Bit i is set when base + 1 + i was received. The clear bits below the highest set bit are the frames to resend.</field>
+//   <field type="uint8_t" name="session">Session of the sender being acknowledged.</field>
+// </message>
+
+#define MAVLINK_MSG_ID_RELIABLE_ACK 53009
+
+typedef struct __mavlink_reliable_ack_t {
+    uint32_t received_mask;
+    uint16_t base;
+    uint8_t session;
+} mavlink_reliable_ack_t;
+
+#define MAVLINK_MSG_ID_RELIABLE_ACK_LEN 7
+#define MAVLINK_MSG_ID_RELIABLE_ACK_MIN_LEN 7
+#define MAVLINK_MSG_ID_RELIABLE_ACK_CRC 24
+
+static inline uint16_t mavlink_msg_reliable_ack_encode_chan(uint8_t system_id, uint8_t component_id, uint8_t chan, mavlink_message_t* msg, const mavlink_reliable_ack_t* reliable_ack) {
+    memcpy(_MAV_PAYLOAD_NON_CONST(msg), reliable_ack, MAVLINK_MSG_ID_RELIABLE_ACK_LEN);
+    msg->msgid = MAVLINK_MSG_ID_RELIABLE_ACK;
+    return mavlink_finalize_message_chan(msg, system_id, component_id, chan, MAVLINK_MSG_ID_RELIABLE_ACK_MIN_LEN, MAVLINK_MSG_ID_RELIABLE_ACK_LEN, MAVLINK_MSG_ID_RELIABLE_ACK_CRC);
+}
+
+static inline void mavlink_msg_reliable_ack_decode(const mavlink_message_t* msg, mavlink_reliable_ack_t* reliable_ack) {
+    uint8_t len = msg->len < MAVLINK_MSG_ID_RELIABLE_ACK_LEN ? msg->len : MAVLINK_MSG_ID_RELIABLE_ACK_LEN;
+    memset(reliable_ack, 0, MAVLINK_MSG_ID_RELIABLE_ACK_LEN);
+    memcpy(reliable_ack, _MAV_PAYLOAD(msg), len);
+}
+
+// <message id="53010" name="STREAM_STAMPS">
+//   <field type="uint32_t" name="time_boot_ms">Time this message was written to the LoRa board, in ms since boot. Sample times are relative to it.</field>
+//   <field type="uint8_t" name="count">Entries used.</field>
+//   <field type="uint8_t[8]" name="frame_seq">Sequence number of each telemetry frame described, as sent on the link.</field>
+//   <field type="uint8_t[8]" name="stream">Telemetry stream of each frame.</field>
+//   <field type="uint16_t[8]" name="stream_seq">Sequence number of each frame within its stream.</field>
+//   <field type="int16_t[8]" name="sample_offset">Time the values of each frame were sampled, in ms relative to time_boot_ms. Saturates at -32768.</field>
+// </message>
+
+#define MAVLINK_MSG_ID_STREAM_STAMPS 53010
+
+typedef struct __mavlink_stream_stamps_t {
+    uint32_t time_boot_ms;
+    uint16_t stream_seq[8];
+    int16_t sample_offset[8];
+    uint8_t count;
+    uint8_t frame_seq[8];
+    uint8_t stream[8];
+} mavlink_stream_stamps_t;
+
+#define MAVLINK_MSG_ID_STREAM_STAMPS_LEN 53
+#define MAVLINK_MSG_ID_STREAM_STAMPS_MIN_LEN 53
+#define MAVLINK_MSG_ID_STREAM_STAMPS_CRC 186
+#define MAVLINK_MSG_STREAM_STAMPS_FIELD_FRAME_SEQ_LEN 8
+#define MAVLINK_MSG_STREAM_STAMPS_FIELD_STREAM_LEN 8
+#define MAVLINK_MSG_STREAM_STAMPS_FIELD_STREAM_SEQ_LEN 8
+#define MAVLINK_MSG_STREAM_STAMPS_FIELD_SAMPLE_OFFSET_LEN 8
+
+static inline uint16_t mavlink_msg_stream_stamps_encode_chan(uint8_t system_id, uint8_t component_id, uint8_t chan, mavlink_message_t* msg, const mavlink_stream_stamps_t* stream_stamps) {
+    memcpy(_MAV_PAYLOAD_NON_CONST(msg), stream_stamps, MAVLINK_MSG_ID_STREAM_STAMPS_LEN);
+    msg->msgid = MAVLINK_MSG_ID_STREAM_STAMPS;
+    return mavlink_finalize_message_chan(msg, system_id, component_id, chan, MAVLINK_MSG_ID_STREAM_STAMPS_MIN_LEN, MAVLINK_MSG_ID_STREAM_STAMPS_LEN, MAVLINK_MSG_ID_STREAM_STAMPS_CRC);
+}
+
+static inline void mavlink_msg_stream_stamps_decode(const mavlink_message_t* msg, mavlink_stream_stamps_t* stream_stamps) {
+    uint8_t len = msg->len < MAVLINK_MSG_ID_STREAM_STAMPS_LEN ? msg->len : MAVLINK_MSG_ID_STREAM_STAMPS_LEN;
+    memset(stream_stamps, 0, MAVLINK_MSG_ID_STREAM_STAMPS_LEN);
+    memcpy(stream_stamps, _MAV_PAYLOAD(msg), len);
+}
+
+// <message id="53011" name="TIME_SYNC">
+//   <field type="uint64_t" name="time_unix_usec">UTC time when the message was written to the LoRa board, in us since the Unix epoch. 0 when unknown.</field>
+//   <field type="uint32_t" name="time_boot_ms">Time the message was written to the LoRa board, in ms since boot.</field>
+//   <field type="uint16_t" name="airtime">Time this message takes on air at the current modulation, in ms, to be subtracted from its time of arrival.</field>
+// </message>
+
+#define MAVLINK_MSG_ID_TIME_SYNC 53011
+
+typedef struct __mavlink_time_sync_t {
+    uint64_t time_unix_usec;
+    uint32_t time_boot_ms;
+    uint16_t airtime;
+} mavlink_time_sync_t;
+
+#define MAVLINK_MSG_ID_TIME_SYNC_LEN 14
+#define MAVLINK_MSG_ID_TIME_SYNC_MIN_LEN 14
+#define MAVLINK_MSG_ID_TIME_SYNC_CRC 218
+
+static inline uint16_t mavlink_msg_time_sync_encode_chan(uint8_t system_id, uint8_t component_id, uint8_t chan, mavlink_message_t* msg, const mavlink_time_sync_t* time_sync) {
+    memcpy(_MAV_PAYLOAD_NON_CONST(msg), time_sync, MAVLINK_MSG_ID_TIME_SYNC_LEN);
+    msg->msgid = MAVLINK_MSG_ID_TIME_SYNC;
+    return mavlink_finalize_message_chan(msg, system_id, component_id, chan, MAVLINK_MSG_ID_TIME_SYNC_MIN_LEN, MAVLINK_MSG_ID_TIME_SYNC_LEN, MAVLINK_MSG_ID_TIME_SYNC_CRC);
+}
+
+static inline void mavlink_msg_time_sync_decode(const mavlink_message_t* msg, mavlink_time_sync_t* time_sync) {
+    uint8_t len = msg->len < MAVLINK_MSG_ID_TIME_SYNC_LEN ? msg->len : MAVLINK_MSG_ID_TIME_SYNC_LEN;
+    memset(time_sync, 0, MAVLINK_MSG_ID_TIME_SYNC_LEN);
+    memcpy(time_sync, _MAV_PAYLOAD(msg), len);
+}
+
+// <message id="53012" name="PATH_REPORT">
+//   <field type="uint8_t" name="path">Path the report is about: 0 for LoRa, 1 for IP. Always sent over IP, by the ground merger.</field>
+//   <field type="uint16_t" name="received">Telemetry samples received over the path since the last report.</field>
+//   <field type="uint16_t" name="lost">Telemetry samples missed on the path since the last report, from the gaps in their stream sequence numbers.</field>
+//   <field type="uint32_t" name="echo_time_boot_ms">time_boot_ms of the last TIME_SYNC received over the path, 0 if none.</field>
+//   <field type="uint16_t" name="echo_delay">Time between the arrival of that TIME_SYNC and this report, in ms.</field>
+// </message>
+
+#define MAVLINK_MSG_ID_PATH_REPORT 53012
+
+typedef struct __mavlink_path_report_t {
+    uint32_t echo_time_boot_ms;
+    uint16_t received;
+    uint16_t lost;
+    uint16_t echo_delay;
+    uint8_t path;
+} mavlink_path_report_t;
+
+#define MAVLINK_MSG_ID_PATH_REPORT_LEN 11
+#define MAVLINK_MSG_ID_PATH_REPORT_MIN_LEN 11
+#define MAVLINK_MSG_ID_PATH_REPORT_CRC 253
+
+static inline uint16_t mavlink_msg_path_report_encode_chan(uint8_t system_id, uint8_t component_id, uint8_t chan, mavlink_message_t* msg, const mavlink_path_report_t* path_report) {
+    memcpy(_MAV_PAYLOAD_NON_CONST(msg), path_report, MAVLINK_MSG_ID_PATH_REPORT_LEN);
+    msg->msgid = MAVLINK_MSG_ID_PATH_REPORT;
+    return mavlink_finalize_message_chan(msg, system_id, component_id, chan, MAVLINK_MSG_ID_PATH_REPORT_MIN_LEN, MAVLINK_MSG_ID_PATH_REPORT_LEN, MAVLINK_MSG_ID_PATH_REPORT_CRC);
+}
+
+static inline void mavlink_msg_path_report_decode(const mavlink_message_t* msg, mavlink_path_report_t* path_report) {
+    uint8_t len = msg->len < MAVLINK_MSG_ID_PATH_REPORT_LEN ? msg->len : MAVLINK_MSG_ID_PATH_REPORT_LEN;
+    memset(path_report, 0, MAVLINK_MSG_ID_PATH_REPORT_LEN);
+    memcpy(path_report, _MAV_PAYLOAD(msg), len);
+}
+
+// <message id="53013" name="INSTRUMENTATION_SUMMARY">
+//   <field type="uint32_t" name="time_boot_ms">End of the window, in ms since boot.</field>
+//   <field type="uint16_t" name="window">Length of the window, in ms.</field>
+//   <field type="int16_t[4]" name="min">Lowest reading of battery voltage, motor current, battery current and MPPT current in the window, in cV or cA.</field>
+//   <field type="int16_t[4]" name="mean">Mean of the readings of each field in the window, in cV or cA.</field>
+//   <field type="int16_t[4]" name="max">Highest reading of each field in the window, in cV or cA.</field>
+//   <field type="int16_t[4]" name="last">Last reading of each field in the window, in cV or cA.</field>
+//   <field type="uint16_t[4]" name="count">Readings of each field in the window. The currents are read far more often than the voltage.</field>
+// </message>
+
+#define MAVLINK_MSG_ID_INSTRUMENTATION_SUMMARY 53013
+
+typedef struct __mavlink_instrumentation_summary_t {
+    uint32_t time_boot_ms;
+    uint16_t window;
+    int16_t min[4];
+    int16_t mean[4];
+    int16_t max[4];
+    int16_t last[4];
+    uint16_t count[4];
+} mavlink_instrumentation_summary_t;
+
+#define MAVLINK_MSG_ID_INSTRUMENTATION_SUMMARY_LEN 46
+#define MAVLINK_MSG_ID_INSTRUMENTATION_SUMMARY_MIN_LEN 46
+#define MAVLINK_MSG_ID_INSTRUMENTATION_SUMMARY_CRC 181
+#define MAVLINK_MSG_INSTRUMENTATION_SUMMARY_FIELD_MIN_LEN 4
+#define MAVLINK_MSG_INSTRUMENTATION_SUMMARY_FIELD_MEAN_LEN 4
+#define MAVLINK_MSG_INSTRUMENTATION_SUMMARY_FIELD_MAX_LEN 4
+#define MAVLINK_MSG_INSTRUMENTATION_SUMMARY_FIELD_LAST_LEN 4
+#define MAVLINK_MSG_INSTRUMENTATION_SUMMARY_FIELD_COUNT_LEN 4
+
+static inline uint16_t mavlink_msg_instrumentation_summary_encode_chan(uint8_t system_id, uint8_t component_id, uint8_t chan, mavlink_message_t* msg, const mavlink_instrumentation_summary_t* instrumentation_summary) {
+    memcpy(_MAV_PAYLOAD_NON_CONST(msg), instrumentation_summary, MAVLINK_MSG_ID_INSTRUMENTATION_SUMMARY_LEN);
+    msg->msgid = MAVLINK_MSG_ID_INSTRUMENTATION_SUMMARY;
+    return mavlink_finalize_message_chan(msg, system_id, component_id, chan, MAVLINK_MSG_ID_INSTRUMENTATION_SUMMARY_MIN_LEN, MAVLINK_MSG_ID_INSTRUMENTATION_SUMMARY_LEN, MAVLINK_MSG_ID_INSTRUMENTATION_SUMMARY_CRC);
+}
+
+static inline void mavlink_msg_instrumentation_summary_decode(const mavlink_message_t* msg, mavlink_instrumentation_summary_t* instrumentation_summary) {
+    uint8_t len = msg->len < MAVLINK_MSG_ID_INSTRUMENTATION_SUMMARY_LEN ? msg->len : MAVLINK_MSG_ID_INSTRUMENTATION_SUMMARY_LEN;
+    memset(instrumentation_summary, 0, MAVLINK_MSG_ID_INSTRUMENTATION_SUMMARY_LEN);
+    memcpy(instrumentation_summary, _MAV_PAYLOAD(msg), len);
+}
+
+// The parser of the dialect only knows the CRC extra of its own messages, so it reports the messages above as having a bad CRC.
+// Received frames are checked again here with the CRC extra of the extension messages.
+
+static inline uint8_t mavlink_extension_get_crc_extra(uint32_t msgid) {
+    switch (msgid) {
+        case MAVLINK_MSG_ID_ALARM: return MAVLINK_MSG_ID_ALARM_CRC;
+        case MAVLINK_MSG_ID_CAPTURE_CHUNK: return MAVLINK_MSG_ID_CAPTURE_CHUNK_CRC;
+        case MAVLINK_MSG_ID_CURRENT_SPECTRUM: return MAVLINK_MSG_ID_CURRENT_SPECTRUM_CRC;
+        case MAVLINK_MSG_ID_PUMP_STATUS: return MAVLINK_MSG_ID_PUMP_STATUS_CRC;
+        case MAVLINK_MSG_ID_CALIBRATION_COMMAND: return MAVLINK_MSG_ID_CALIBRATION_COMMAND_CRC;
+        case MAVLINK_MSG_ID_CALIBRATION_STATUS: return MAVLINK_MSG_ID_CALIBRATION_STATUS_CRC;
+        case MAVLINK_MSG_ID_LORA_LINK_STATUS: return MAVLINK_MSG_ID_LORA_LINK_STATUS_CRC;
+        case MAVLINK_MSG_ID_FEC_PARITY: return MAVLINK_MSG_ID_FEC_PARITY_CRC;
+        case MAVLINK_MSG_ID_RELIABLE_MESSAGE: return MAVLINK_MSG_ID_RELIABLE_MESSAGE_CRC;
+        case MAVLINK_MSG_ID_RELIABLE_ACK: return MAVLINK_MSG_ID_RELIABLE_ACK_CRC;
+        case MAVLINK_MSG_ID_STREAM_STAMPS: return MAVLINK_MSG_ID_STREAM_STAMPS_CRC;
+        case MAVLINK_MSG_ID_TIME_SYNC: return MAVLINK_MSG_ID_TIME_SYNC_CRC;
+        case MAVLINK_MSG_ID_PATH_REPORT: return MAVLINK_MSG_ID_PATH_REPORT_CRC;
+        case MAVLINK_MSG_ID_INSTRUMENTATION_SUMMARY: return MAVLINK_MSG_ID_INSTRUMENTATION_SUMMARY_CRC;
+        default: return 0;
+    }
+}
+
+/// @brief Computes the CRC of a MAVLink 2 frame over its header, its payload and the CRC extra of its message.
+static inline uint16_t mavlink_extension_compute_crc(const mavlink_message_t* msg, uint8_t crc_extra) {
+    const uint8_t header[] = { msg->len, msg->incompat_flags, msg->compat_flags, msg->seq, msg->sysid, msg->compid,
+                               (uint8_t)(msg->msgid & 0xFF), (uint8_t)((msg->msgid >> 8) & 0xFF), (uint8_t)((msg->msgid >> 16) & 0xFF) };
+    uint16_t crc = crc_calculate(header, sizeof(header));
+    crc_accumulate_buffer(&crc, _MAV_PAYLOAD(msg), msg->len);
+    crc_accumulate(crc_extra, &crc);
+    return crc;
+}
+
+/// @brief Checks the CRC of a MAVLink 2 frame carrying one of the extension messages.
+/// @return True if the message is an extension message and its CRC matches.
+static inline bool mavlink_extension_check_crc(const mavlink_message_t* msg) {
+    uint8_t crc_extra = mavlink_extension_get_crc_extra(msg->msgid);
+    if (!crc_extra) return false;
+    uint16_t crc = mavlink_extension_compute_crc(msg, crc_extra);
+    return (crc & 0xFF) == msg->ck[0] && (crc >> 8) == msg->ck[1];
+}
+
+/// @brief Gives an encoded message a new sequence number and updates its CRC, for messages of the dialect and the extension messages alike.
+/// Messages are encoded by many tasks, so the transmitter numbers them again in the order they go out. Signed messages are left as they are.
+/// @return False if the CRC extra of the message is unknown or the message is signed.
+static inline bool mavlink_extension_set_seq(mavlink_message_t* msg, uint8_t seq) {
+    if (msg->incompat_flags & MAVLINK_IFLAG_SIGNED) return false;
+    const mavlink_msg_entry_t* entry = mavlink_get_msg_entry(msg->msgid);
+    uint8_t crc_extra = entry ? entry->crc_extra : mavlink_extension_get_crc_extra(msg->msgid);
+    if (!entry && !crc_extra) return false;
+    msg->seq = seq;
+    uint16_t crc = mavlink_extension_compute_crc(msg, crc_extra);
+    msg->ck[0] = crc & 0xFF;
+    msg->ck[1] = crc >> 8;
+    return true;
+}
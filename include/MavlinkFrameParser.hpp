@@ -0,0 +1,211 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/// @brief Splits a byte stream into MAVLink 1 and 2 frames and checks their CRC, for the host tools that read what the boat sends.
+/// Frames that lie whole within the buffer handed to Parse() are passed to the handler in place, so most frames are never copied; only a frame
+/// cut by the end of a buffer is assembled in the parser, from the bytes kept of the previous call. After a bad frame the parser resumes at the
+/// byte after the start marker, so one corrupted frame costs no more than itself.
+/// The CRC of a frame covers a byte only its dialect knows, the CRC extra of the message, so the caller supplies it. Frames of messages
+/// the caller does not know can still be passed on unchecked, for tools that only route frames.
+/// Portable C++ with no allocation.
+namespace MavlinkFrameParser {
+
+constexpr uint8_t v1_start = 0xFE;
+constexpr uint8_t v2_start = 0xFD;
+constexpr uint8_t v2_header_length = 10; // Start marker to the message id.
+constexpr uint8_t v1_header_length = 6;
+constexpr uint8_t signature_length = 13;
+constexpr uint8_t incompat_flag_signed = 0x01;
+constexpr uint16_t max_frame_length = v2_header_length + 255 + 2 + signature_length;
+
+/// @brief CRC-16/MCRF4XX, the X.25 CRC MAVLink uses, continued from a previous value.
+inline uint16_t Crc(const uint8_t* data, size_t length, uint16_t crc = 0xFFFF) {
+    for (size_t i = 0; i < length; i++) {
+        uint8_t tmp = data[i] ^ (uint8_t)(crc & 0xFF);
+        tmp ^= (uint8_t)(tmp << 4);
+        crc = (crc >> 8) ^ ((uint16_t)tmp << 8) ^ ((uint16_t)tmp << 3) ^ (tmp >> 4);
+    }
+    return crc;
+}
+
+struct Frame {
+    const uint8_t* data; // Whole frame, start marker included. Only valid during the call to the handler.
+    uint16_t length;
+    const uint8_t* payload;
+    uint8_t payload_length; // As sent. MAVLink 2 trims the zeros at the end of the payload, which the receiver puts back.
+    uint8_t seq;
+    uint8_t system_id;
+    uint8_t component_id;
+    uint32_t msgid;
+    bool is_v2;
+    bool is_checked; // False when the CRC extra of the message was unknown, so the CRC could not be checked.
+
+    /// @brief Copies the payload into a message struct, padding it with the zeros MAVLink 2 trimmed.
+    void Decode(void* message, size_t message_length) const {
+        size_t length = payload_length < message_length ? payload_length : message_length;
+        memset(message, 0, message_length);
+        memcpy(message, payload, length);
+    }
+};
+
+struct Statistics {
+    uint64_t bytes;
+    uint64_t frames;
+    uint64_t unchecked; // Frames passed on without a CRC check.
+    uint64_t bad_crc;
+    uint64_t skipped; // Bytes outside any frame: noise, debug text, or the remains of bad frames.
+};
+
+/// @brief Builds a MAVLink 2 frame, with the zeros at the end of the payload trimmed as the reference implementation does.
+/// @param frame Receives up to v2_header_length + payload_length + 2 bytes.
+/// @return Length of the frame.
+inline uint16_t Build(uint8_t* frame, uint8_t seq, uint8_t system_id, uint8_t component_id, uint32_t msgid,
+                      const void* payload, uint8_t payload_length, uint8_t crc_extra) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(payload);
+    while (payload_length > 1 && bytes[payload_length - 1] == 0) payload_length--;
+    frame[0] = v2_start;
+    frame[1] = payload_length;
+    frame[2] = 0;
+    frame[3] = 0;
+    frame[4] = seq;
+    frame[5] = system_id;
+    frame[6] = component_id;
+    frame[7] = msgid & 0xFF;
+    frame[8] = (msgid >> 8) & 0xFF;
+    frame[9] = (msgid >> 16) & 0xFF;
+    memcpy(frame + v2_header_length, bytes, payload_length);
+    uint16_t crc = Crc(frame + 1, v2_header_length - 1 + payload_length);
+    crc = Crc(&crc_extra, 1, crc);
+    frame[v2_header_length + payload_length] = crc & 0xFF;
+    frame[v2_header_length + payload_length + 1] = crc >> 8;
+    return v2_header_length + payload_length + 2;
+}
+
+class Parser {
+public:
+    /// @brief Parses the next bytes of the stream.
+    /// @param crc_extra Called with the message id, returns its CRC extra, or a negative value when the message is unknown.
+    /// @param handler Called with each valid frame, as a const Frame&.
+    /// @param accept_unchecked Passes on the frames of unknown messages instead of dropping them.
+    template <typename CrcExtra, typename Handler>
+    void Parse(const uint8_t* data, size_t length, CrcExtra&& crc_extra, Handler&& handler, bool accept_unchecked = true) {
+        statistics.bytes += length;
+        size_t position = 0;
+
+        // Finish the frame cut by the end of the last buffer, in the parser's own copy.
+        while (pending_length) {
+            size_t needed = FrameLength(pending, pending_length);
+            size_t wanted = needed ? needed : (pending[0] == v2_start ? v2_header_length : v1_header_length);
+            if (pending_length < wanted) {
+                if (position == length) return;
+                size_t take = wanted - pending_length;
+                if (take > length - position) take = length - position;
+                memcpy(pending + pending_length, data + position, take);
+                pending_length += take;
+                position += take;
+                continue;
+            }
+            // After a bad frame, the search for the next one resumes right after its start marker, on the bytes kept and then the buffer.
+            bool is_frame = Check(pending, needed, crc_extra, handler, accept_unchecked);
+            Consume(is_frame ? needed : 1, !is_frame);
+        }
+
+        while (position < length) {
+            const uint8_t* start = data + position;
+            if (*start != v2_start && *start != v1_start) {
+                statistics.skipped++;
+                position++;
+                continue;
+            }
+            size_t available = length - position;
+            size_t needed = FrameLength(start, available);
+            if (!needed || needed > available) {
+                // Cut by the end of the buffer. Kept until the next call.
+                memcpy(pending, start, available);
+                pending_length = available;
+                return;
+            }
+            if (Check(start, needed, crc_extra, handler, accept_unchecked)) {
+                position += needed;
+            } else {
+                statistics.skipped++;
+                position++;
+            }
+        }
+    }
+
+    const Statistics& GetStatistics() const { return statistics; }
+
+private:
+    uint8_t pending[max_frame_length];
+    size_t pending_length = 0;
+    Statistics statistics = {};
+
+    /// @return Length of the frame starting at data, or 0 if its header is not complete yet.
+    static size_t FrameLength(const uint8_t* data, size_t available) {
+        if (data[0] == v2_start) {
+            if (available < v2_header_length) return 0;
+            return v2_header_length + data[1] + 2 + ((data[2] & incompat_flag_signed) ? signature_length : 0);
+        }
+        if (available < v1_header_length) return 0;
+        return v1_header_length + data[1] + 2;
+    }
+
+    template <typename CrcExtra, typename Handler>
+    bool Check(const uint8_t* data, size_t length, CrcExtra& crc_extra, Handler& handler, bool accept_unchecked) {
+        Frame frame;
+        frame.data = data;
+        frame.length = length;
+        frame.is_v2 = data[0] == v2_start;
+        frame.payload_length = data[1];
+        if (frame.is_v2) {
+            if (data[2] & ~incompat_flag_signed) return false; // Unknown incompatibility flags.
+            frame.seq = data[4];
+            frame.system_id = data[5];
+            frame.component_id = data[6];
+            frame.msgid = data[7] | (data[8] << 8) | ((uint32_t)data[9] << 16);
+            frame.payload = data + v2_header_length;
+        } else {
+            frame.seq = data[2];
+            frame.system_id = data[3];
+            frame.component_id = data[4];
+            frame.msgid = data[5];
+            frame.payload = data + v1_header_length;
+        }
+        size_t crc_position = (frame.payload - data) + frame.payload_length;
+        int extra = crc_extra(frame.msgid);
+        frame.is_checked = extra >= 0;
+        if (frame.is_checked) {
+            uint8_t extra_byte = (uint8_t)extra;
+            uint16_t crc = Crc(data + 1, crc_position - 1);
+            crc = Crc(&extra_byte, 1, crc);
+            if ((data[crc_position] | (data[crc_position + 1] << 8)) != crc) {
+                statistics.bad_crc++;
+                return false;
+            }
+        } else if (!accept_unchecked) {
+            return false;
+        } else {
+            statistics.unchecked++;
+        }
+        statistics.frames++;
+        handler(static_cast<const Frame&>(frame));
+        return true;
+    }
+
+    /// @brief Drops the first bytes kept, and the bytes after them up to the next start marker, since a frame may start among them.
+    void Consume(size_t drop, bool is_skipped) {
+        if (is_skipped) statistics.skipped += drop;
+        size_t position = drop;
+        while (position < pending_length && pending[position] != v2_start && pending[position] != v1_start) {
+            statistics.skipped++;
+            position++;
+        }
+        memmove(pending, pending + position, pending_length - position);
+        pending_length -= position;
+    }
+};
+
+} // namespace MavlinkFrameParser
@@ -0,0 +1,161 @@
+#pragma once
+#include <Arduino.h>
+#include <Preferences.h>
+#include <Adafruit_ADS1X15.h>
+#include "I2cBus.hpp"
+
+/// @brief Over-current trip built on the window comparator of the ADS1115.
+/// Each high-rate conversion is started with the comparator thresholds of its channel, so the ADC itself pulls the ALERT pin low as soon as a
+/// conversion lands outside the window. A GPIO interrupt on that pin calls the trip action straight away, which brings the protection latency
+/// down to the conversion time of the ADC plus the interrupt latency, instead of the period of the task that reads the samples.
+/// The time from the start of the tripping conversion to the end of the trip action is measured with the CPU cycle counter. The cycle counter is
+/// local to each core, so conversions must be started from a task pinned to the core the interrupt was attached from.
+class OvercurrentProtection {
+public:
+    static constexpr uint8_t number_channels = 2; // Motor current and battery current.
+    using TripAction = void (*)(); // Called from the interrupt, so it must be placed in IRAM.
+
+    OvercurrentProtection(uint8_t alert_pin, TripAction action) : alert_pin(alert_pin), action(action) {}
+
+    /// @brief Loads the trip currents and attaches the ALERT interrupt to the core of the calling task.
+    /// @param address I2C address of the ADS1115.
+    /// @param bus The ADS1115 is reached through, at high priority.
+    void Begin(uint8_t address, I2cBus& bus) {
+        this->address = address;
+        this->bus = &bus;
+        Preferences preferences;
+        preferences.begin("protection", true);
+        is_enabled = preferences.getBool("enabled", true);
+        trip_current[0] = preferences.getFloat("motor", trip_current[0]);
+        trip_current[1] = preferences.getFloat("battery", trip_current[1]);
+        preferences.end();
+        pinMode(alert_pin, INPUT_PULLUP); // ALERT is an open drain output.
+        attachInterruptArg(digitalPinToInterrupt(alert_pin), OnAlert, this, FALLING);
+    }
+
+    /// @brief Sets the comparator window of a channel, in raw ADC counts. Conversions outside [low, high] trip the protection.
+    void SetWindow(uint8_t channel, int16_t low, int16_t high) {
+        if (channel >= number_channels) return;
+        window_low[channel] = low;
+        window_high[channel] = high;
+    }
+
+    /// @brief Changes the trip settings and saves them. The owner of the ADC converts the currents into comparator windows.
+    void Configure(bool is_enabled, float motor_trip_current, float battery_trip_current) {
+        this->is_enabled = is_enabled;
+        trip_current[0] = motor_trip_current;
+        trip_current[1] = battery_trip_current;
+        Preferences preferences;
+        preferences.begin("protection", false);
+        preferences.putBool("enabled", is_enabled);
+        preferences.putFloat("motor", motor_trip_current);
+        preferences.putFloat("battery", battery_trip_current);
+        preferences.end();
+        settings_version++;
+    }
+
+    /// @brief Starts a single conversion with the comparator armed for the given channel.
+    /// @param mux Input multiplexer setting of the channel.
+    /// @param gain Gain the ADC is configured with, which holds the PGA bits of the configuration register.
+    /// @param rate Data rate bits of the configuration register.
+    void StartConversion(uint8_t channel, uint16_t mux, adsGain_t gain, uint16_t rate) {
+        uint16_t config = ADS1X15_REG_CONFIG_OS_SINGLE | mux | gain | rate | ADS1X15_REG_CONFIG_MODE_SINGLE;
+        if (is_enabled && channel < number_channels) {
+            // Window mode catches over-currents in both directions for the bipolar battery channel. The latched ALERT is released when the conversion is read.
+            config |= ADS1X15_REG_CONFIG_CMODE_WINDOW | ADS1X15_REG_CONFIG_CPOL_ACTVLOW | ADS1X15_REG_CONFIG_CLAT_LATCH | ADS1X15_REG_CONFIG_CQUE_1CONV;
+            WriteRegister(ADS1X15_REG_POINTER_LOWTHRESH, window_low[channel]);
+            WriteRegister(ADS1X15_REG_POINTER_HITHRESH, window_high[channel]);
+            WriteRegister(ADS1X15_REG_POINTER_CONFIG, config);
+            // The conversion starts once the configuration is written, and takes longer than the interrupt needs to see these.
+            active_channel = channel;
+            conversion_start = xthal_get_ccount();
+            is_armed = true;
+        } else {
+            WriteRegister(ADS1X15_REG_POINTER_CONFIG, config | ADS1X15_REG_CONFIG_CQUE_NONE);
+        }
+    }
+
+    /// @return True once the last conversion is done, from the OS bit of the configuration register, or when the ADC could not be read,
+    /// since waiting longer would not help.
+    bool IsConversionDone() {
+        uint16_t config = 0;
+        if (bus->ReadRegister(address, ADS1X15_REG_POINTER_CONFIG, config, I2cHighPriority, millis() + transfer_deadline) != I2cOk) return true;
+        return config & ADS1X15_REG_CONFIG_OS_MASK;
+    }
+
+    /// @brief Reads the result of the last conversion, which also releases the latched ALERT pin.
+    /// The comparator stays armed until the result has been checked against the window, so a conversion that ends outside it trips the
+    /// protection here if the interrupt has not already, such as when the result is read before ALERT was seen.
+    /// @param conversion Result of the conversion, left unchanged when the ADC could not be read.
+    /// @return False when the ADC could not be read, which the bus counts as an error of the device.
+    bool ReadConversion(int16_t& conversion) {
+        uint16_t value = 0;
+        bool is_read = bus->ReadRegister(address, ADS1X15_REG_POINTER_CONVERT, value, I2cHighPriority, millis() + transfer_deadline) == I2cOk;
+        if (is_read) conversion = (int16_t)value;
+        // Other users of the ADC program ALERT as a conversion ready signal, which must not trip the protection, so it is disarmed here.
+        portENTER_CRITICAL(&mutex);
+        if (is_read && is_armed && is_enabled && (conversion < window_low[active_channel] || conversion > window_high[active_channel])) {
+            Trip(xthal_get_ccount());
+        }
+        is_armed = false;
+        portEXIT_CRITICAL(&mutex);
+        return is_read;
+    }
+
+    bool IsEnabled() const { return is_enabled; }
+    float GetTripCurrent(uint8_t channel) const { return trip_current[channel]; }
+    uint32_t GetSettingsVersion() const { return settings_version; } // Changes whenever the trip currents are modified.
+    uint32_t GetTripCount() const { return trip_count; }
+    uint8_t GetTripChannel() const { return trip_channel; }
+    // Latencies in us, from the start of the conversion and from the entry of the interrupt to the end of the trip action.
+    float GetLastLatency() const { return (float)last_latency_cycles / getCpuFrequencyMhz(); }
+    float GetMaxLatency() const { return (float)max_latency_cycles / getCpuFrequencyMhz(); }
+    float GetLastInterruptLatency() const { return (float)last_interrupt_cycles / getCpuFrequencyMhz(); }
+
+private:
+    uint8_t alert_pin;
+    TripAction action;
+    static constexpr uint32_t transfer_deadline = 10; // ms. A conversion started later than this would be read before it is done.
+
+    uint8_t address = 0x48;
+    I2cBus* bus = nullptr;
+    volatile bool is_enabled = true;
+    float trip_current[number_channels] = { 110.0f, 120.0f }; // A
+    volatile uint32_t settings_version = 0;
+    int16_t window_low[number_channels] = { INT16_MIN, INT16_MIN };
+    int16_t window_high[number_channels] = { INT16_MAX, INT16_MAX };
+
+    portMUX_TYPE mutex = portMUX_INITIALIZER_UNLOCKED; // Between the interrupt and the check of the result, which may both trip.
+    volatile bool is_armed = false;
+    volatile uint8_t active_channel = 0;
+    volatile uint32_t conversion_start = 0;
+    volatile uint32_t trip_count = 0;
+    volatile uint8_t trip_channel = 0;
+    volatile uint32_t last_latency_cycles = 0;
+    volatile uint32_t max_latency_cycles = 0;
+    volatile uint32_t last_interrupt_cycles = 0;
+
+    void WriteRegister(uint8_t reg, uint16_t value) {
+        bus->WriteRegister(address, reg, value, I2cHighPriority, millis() + transfer_deadline);
+    }
+
+    static void IRAM_ATTR OnAlert(void* argument) {
+        uint32_t entry = xthal_get_ccount();
+        OvercurrentProtection* self = static_cast<OvercurrentProtection*>(argument);
+        portENTER_CRITICAL_ISR(&self->mutex);
+        if (self->is_armed && self->is_enabled) self->Trip(entry);
+        portEXIT_CRITICAL_ISR(&self->mutex);
+    }
+
+    /// @param entry Cycle count when the trip was detected.
+    void IRAM_ATTR Trip(uint32_t entry) {
+        action();
+        uint32_t done = xthal_get_ccount();
+        is_armed = false;
+        trip_count++;
+        trip_channel = active_channel;
+        last_latency_cycles = done - conversion_start;
+        last_interrupt_cycles = done - entry;
+        if (last_latency_cycles > max_latency_cycles) max_latency_cycles = last_latency_cycles;
+    }
+};
@@ -0,0 +1,332 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+/// @brief Arithmetic in GF(2^8) with the 0x11D polynomial, through log and exp tables built once.
+class GaloisField {
+public:
+    static const GaloisField& Instance() {
+        static const GaloisField field;
+        return field;
+    }
+
+    uint8_t Multiply(uint8_t a, uint8_t b) const { return (a && b) ? exp[log[a] + log[b]] : 0; }
+    uint8_t Divide(uint8_t a, uint8_t b) const { return a ? exp[log[a] + 255 - log[b]] : 0; } // b must not be zero.
+
+    /// @brief destination[i] ^= coefficient * source[i], the inner loop of both the encoder and the decoder.
+    void MultiplyAdd(uint8_t* destination, const uint8_t* source, uint8_t coefficient, uint16_t length) const {
+        if (!coefficient) return;
+        if (coefficient == 1) {
+            for (uint16_t i = 0; i < length; i++) destination[i] ^= source[i];
+            return;
+        }
+        uint16_t log_coefficient = log[coefficient];
+        for (uint16_t i = 0; i < length; i++) {
+            if (source[i]) destination[i] ^= exp[log[source[i]] + log_coefficient];
+        }
+    }
+
+private:
+    uint8_t exp[512];
+    uint16_t log[256];
+
+    GaloisField() {
+        uint16_t value = 1;
+        for (uint16_t i = 0; i < 255; i++) {
+            exp[i] = value;
+            log[value] = i;
+            value <<= 1;
+            if (value & 0x100) value ^= 0x11D;
+        }
+        for (uint16_t i = 255; i < 512; i++) exp[i] = exp[i - 255];
+        log[0] = 0;
+    }
+};
+
+/// @brief Packet level erasure code for the telemetry frames sent over the LoRa link.
+/// Frames are grouped by K and each group is followed by M parity frames, and the receiver rebuilds any M frames lost within a group.
+/// The code is a systematic Reed-Solomon code built from a Cauchy matrix, whose columns are scaled so the first parity row is all ones.
+/// The first parity frame is then the XOR of the group, so M = 1 costs no multiplications, and any K of the K + M frames still rebuild the group.
+/// Data frames are MAVLink 2 frames and are sent unchanged. Their sequence numbers must be contiguous, which the transmitter makes sure of, so a
+/// parity frame only needs the sequence number of the first frame of its group. Frames are padded with zeros to the longest frame of the group,
+/// and a rebuilt frame finds its length in its own header. Rebuilt frames are byte for byte the lost ones, CRC included.
+/// Portable C++ with no allocation, shared by the firmware, which encodes, and the host tools, which decode.
+namespace PacketFec {
+
+constexpr uint8_t max_data_frames = 16;
+constexpr uint8_t max_parity_frames = 4;
+constexpr uint16_t max_frame_length = 240; // Bytes of a protected frame, which must fit in the payload of a parity message. Longer frames are sent unprotected.
+
+/// @brief Coefficient of data frame i in parity frame j.
+/// Cauchy entries 1 / (x_j + y_i), with y_i = i and x_j = 128 + j, divided by the entry of the first row so that row is all ones.
+inline uint8_t Coefficient(uint8_t parity, uint8_t data) {
+    const GaloisField& field = GaloisField::Instance();
+    return field.Divide(128 ^ data, (128 + parity) ^ data);
+}
+
+/// @brief Length of a MAVLink 2 frame from its header, including the signature when present. Zero if the bytes are not a MAVLink 2 frame.
+inline uint16_t FrameLength(const uint8_t* frame) {
+    if (frame[0] != 0xFD) return 0;
+    return 12 + frame[1] + ((frame[2] & 0x01) ? 13 : 0);
+}
+
+struct Parity {
+    uint8_t group; // Counter of the groups, to tell the parity frames of successive groups apart.
+    uint8_t first_seq; // MAVLink sequence number of the first data frame of the group.
+    uint8_t data_frames; // K of this group, which is smaller than the configured K when the group was closed early.
+    uint8_t parity_frames;
+    uint8_t index; // Row of this parity frame.
+    uint16_t length; // Bytes of data used. The rest of the buffer is zero.
+    uint8_t data[max_frame_length];
+};
+
+/// @brief Accumulates the parity of a group as its frames go out, so the frames themselves are not kept.
+class Encoder {
+public:
+    /// @return False if the values are out of range, in which case the configuration is unchanged.
+    /// The group in progress is dropped, so flush it first.
+    bool Configure(uint8_t data_frames, uint8_t parity_frames) {
+        if (data_frames < 1 || data_frames > max_data_frames || parity_frames < 1 || parity_frames > max_parity_frames) return false;
+        this->data_frames = data_frames;
+        this->parity_frames = parity_frames;
+        Reset();
+        return true;
+    }
+
+    /// @brief Whether a frame can be protected. Other frames must be sent after flushing the group, so they do not break its sequence.
+    static bool IsProtectable(const uint8_t* frame, uint16_t length) {
+        return length <= max_frame_length && FrameLength(frame) == length;
+    }
+
+    /// @brief Adds a frame that was just sent to the current group.
+    /// @return True when the group is complete and its parity frames are ready.
+    bool Add(const uint8_t* frame, uint16_t length) {
+        if (count == 0) first_seq = frame[4];
+        for (uint8_t j = 0; j < parity_frames; j++) {
+            GaloisField::Instance().MultiplyAdd(parity[j].data, frame, Coefficient(j, count), length);
+        }
+        if (length > parity_length) parity_length = length;
+        count++;
+        return count == data_frames && Close();
+    }
+
+    /// @brief Closes a partial group, when a long frame has to go out or when the group has waited too long.
+    /// @return True if the group had frames and its parity frames are ready.
+    bool Flush() {
+        return count > 0 && Close();
+    }
+
+    bool IsEmpty() const { return count == 0; }
+    uint8_t GetDataFrames() const { return data_frames; }
+    uint8_t GetParityFrames() const { return parity_frames; }
+    uint8_t GetNumberParity() const { return number_ready; }
+    const Parity& GetParity(uint8_t index) const { return parity[index]; }
+
+    /// @brief Starts a new group once the parity frames of the last one were sent.
+    void Reset() {
+        for (uint8_t j = 0; j < max_parity_frames; j++) memset(parity[j].data, 0, sizeof(parity[j].data));
+        count = 0;
+        parity_length = 0;
+        number_ready = 0;
+    }
+
+private:
+    uint8_t data_frames = 8;
+    uint8_t parity_frames = 1;
+    uint8_t count = 0;
+    uint8_t first_seq = 0;
+    uint8_t group = 0;
+    uint16_t parity_length = 0;
+    uint8_t number_ready = 0;
+    Parity parity[max_parity_frames];
+
+    bool Close() {
+        for (uint8_t j = 0; j < parity_frames; j++) {
+            parity[j].group = group;
+            parity[j].first_seq = first_seq;
+            parity[j].data_frames = count;
+            parity[j].parity_frames = parity_frames;
+            parity[j].index = j;
+            parity[j].length = parity_length;
+        }
+        number_ready = parity_frames;
+        group++;
+        return true;
+    }
+};
+
+/// @brief Keeps the recent data frames and rebuilds the lost ones as the parity frames of their group arrive.
+/// Frames are kept by sequence number, which is unwrapped against the latest frame received, so a frame from a previous wrap of the sequence
+/// is never taken for a frame of the current group. Parity frames follow their group closely, well within half the sequence space.
+class Decoder {
+public:
+    struct Statistics {
+        uint32_t frames_received;
+        uint32_t parity_received;
+        uint32_t frames_recovered;
+        uint32_t groups_complete; // Groups with no frame lost.
+        uint32_t groups_recovered;
+        uint32_t groups_failed; // Groups with more frames lost than parity frames received.
+    };
+
+    /// @brief Keeps a data frame received from the radio.
+    void ReceiveData(const uint8_t* frame, uint16_t length) {
+        uint16_t frame_length = FrameLength(frame);
+        if (!frame_length || frame_length != length) return;
+        uint32_t seq = Unwrap(frame[4]);
+        if (seq > latest_seq) latest_seq = seq;
+        statistics.frames_received++;
+        if (length > max_frame_length) return;
+        Slot& slot = slots[frame[4]];
+        memcpy(slot.data, frame, length);
+        slot.length = length;
+        slot.seq = seq;
+    }
+
+    /// @brief Takes a parity frame and rebuilds what its group lost, if enough parity frames arrived.
+    /// @param on_recovered Called with (const uint8_t* frame, uint16_t length) for each rebuilt frame.
+    template <typename Handler>
+    void ReceiveParity(const Parity& parity, Handler&& on_recovered) {
+        statistics.parity_received++;
+        if (parity.index >= max_parity_frames || parity.data_frames < 1 || parity.data_frames > max_data_frames || parity.length > max_frame_length) return;
+
+        Group& group = groups[parity.group % number_groups];
+        if (!group.is_open || group.id != parity.group || group.first_seq != parity.first_seq) {
+            group = {};
+            group.is_open = true;
+            group.id = parity.group;
+            group.first_seq = parity.first_seq;
+            group.data_frames = parity.data_frames;
+        }
+        if (group.is_done || (group.parity_mask & (1u << parity.index))) return;
+        group.parity_mask |= 1u << parity.index;
+        memcpy(group.parity[parity.index], parity.data, parity.length);
+        memset(group.parity[parity.index] + parity.length, 0, max_frame_length - parity.length);
+        if (parity.length > group.length) group.length = parity.length;
+
+        uint32_t first_seq = Unwrap(group.first_seq);
+        uint8_t missing[max_data_frames];
+        uint8_t number_missing = 0;
+        for (uint8_t i = 0; i < group.data_frames; i++) {
+            if (!IsPresent(first_seq + i)) missing[number_missing++] = i;
+        }
+        if (number_missing == 0) {
+            group.is_done = true;
+            statistics.groups_complete++;
+            return;
+        }
+        uint8_t rows[max_parity_frames];
+        uint8_t number_rows = 0;
+        for (uint8_t j = 0; j < max_parity_frames && number_rows < number_missing; j++) {
+            if (group.parity_mask & (1u << j)) rows[number_rows++] = j;
+        }
+        // The failure is only final once the last parity frame of the group was seen.
+        if (number_rows < number_missing) {
+            if (parity.index == parity.parity_frames - 1) statistics.groups_failed++;
+            return;
+        }
+
+        Recover(group, first_seq, missing, number_missing, rows, on_recovered);
+        group.is_done = true;
+        statistics.groups_recovered++;
+    }
+
+    const Statistics& GetStatistics() const { return statistics; }
+
+private:
+    static constexpr uint8_t number_groups = 8;
+
+    struct Slot {
+        uint8_t data[max_frame_length];
+        uint16_t length;
+        uint32_t seq; // Unwrapped sequence number.
+    };
+
+    struct Group {
+        bool is_open;
+        bool is_done;
+        uint8_t id;
+        uint8_t first_seq;
+        uint8_t data_frames;
+        uint8_t parity_mask;
+        uint16_t length;
+        uint8_t parity[max_parity_frames][max_frame_length];
+    };
+
+    Slot slots[256] = {};
+    Group groups[number_groups] = {};
+    uint32_t latest_seq = 0x10000; // Starts away from zero so the sequence numbers just before the first frame can be unwrapped too.
+    Statistics statistics = {};
+
+    /// @brief Sequence number nearest to the latest one with the given lower byte.
+    uint32_t Unwrap(uint8_t seq) const {
+        return latest_seq + (int8_t)(uint8_t)(seq - (uint8_t)latest_seq);
+    }
+
+    bool IsPresent(uint32_t seq) const {
+        const Slot& slot = slots[(uint8_t)seq];
+        return slot.length && slot.seq == seq;
+    }
+
+    /// @brief Solves for the missing frames. The known frames are first removed from the parity rows, leaving a square system in the
+    /// missing frames, which is inverted by Gauss-Jordan elimination. Any square block of the scaled Cauchy matrix is invertible.
+    template <typename Handler>
+    void Recover(const Group& group, uint32_t first_seq, const uint8_t* missing, uint8_t number_missing, const uint8_t* rows, Handler&& on_recovered) {
+        const GaloisField& field = GaloisField::Instance();
+        uint8_t syndromes[max_parity_frames][max_frame_length];
+        uint8_t matrix[max_parity_frames][max_parity_frames];
+        uint8_t inverse[max_parity_frames][max_parity_frames] = {};
+
+        for (uint8_t r = 0; r < number_missing; r++) {
+            memcpy(syndromes[r], group.parity[rows[r]], group.length);
+            uint8_t next_missing = 0;
+            for (uint8_t i = 0; i < group.data_frames; i++) {
+                if (next_missing < number_missing && missing[next_missing] == i) {
+                    next_missing++;
+                    continue;
+                }
+                const Slot& slot = slots[(uint8_t)(group.first_seq + i)];
+                field.MultiplyAdd(syndromes[r], slot.data, Coefficient(rows[r], i), slot.length);
+            }
+            for (uint8_t c = 0; c < number_missing; c++) matrix[r][c] = Coefficient(rows[r], missing[c]);
+            inverse[r][r] = 1;
+        }
+
+        for (uint8_t c = 0; c < number_missing; c++) {
+            uint8_t pivot = c;
+            while (!matrix[pivot][c]) pivot++;
+            for (uint8_t k = 0; k < number_missing; k++) {
+                uint8_t swap = matrix[c][k]; matrix[c][k] = matrix[pivot][k]; matrix[pivot][k] = swap;
+                swap = inverse[c][k]; inverse[c][k] = inverse[pivot][k]; inverse[pivot][k] = swap;
+            }
+            uint8_t scale = field.Divide(1, matrix[c][c]);
+            for (uint8_t k = 0; k < number_missing; k++) {
+                matrix[c][k] = field.Multiply(matrix[c][k], scale);
+                inverse[c][k] = field.Multiply(inverse[c][k], scale);
+            }
+            for (uint8_t r = 0; r < number_missing; r++) {
+                if (r == c || !matrix[r][c]) continue;
+                uint8_t factor = matrix[r][c];
+                for (uint8_t k = 0; k < number_missing; k++) {
+                    matrix[r][k] ^= field.Multiply(factor, matrix[c][k]);
+                    inverse[r][k] ^= field.Multiply(factor, inverse[c][k]);
+                }
+            }
+        }
+
+        for (uint8_t c = 0; c < number_missing; c++) {
+            uint8_t frame[max_frame_length] = {};
+            for (uint8_t r = 0; r < number_missing; r++) field.MultiplyAdd(frame, syndromes[r], inverse[c][r], group.length);
+            uint16_t length = FrameLength(frame);
+            if (!length || length > group.length) continue; // Not a frame, so the group was not what the parity frames described.
+            Slot& slot = slots[(uint8_t)(first_seq + missing[c])];
+            memcpy(slot.data, frame, length);
+            slot.length = length;
+            slot.seq = first_seq + missing[c];
+            statistics.frames_recovered++;
+            on_recovered(static_cast<const uint8_t*>(frame), length);
+        }
+    }
+};
+
+} // namespace PacketFec
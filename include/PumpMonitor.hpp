@@ -0,0 +1,144 @@
+#pragma once
+#include <Arduino.h>
+#include <Preferences.h>
+
+/// @brief Tracks how often and for how long the bilge pumps run, which is the earliest sign of a leak.
+/// The pump supply voltages are sampled at a high rate and turned into on/off states with hysteresis and a debounce time, so each start and stop
+/// is caught as an edge instead of being sampled with the telemetry. For each pump it keeps the total time on, the number of cycles and the longest run,
+/// which survive reboots, and a duty cycle over a rolling window, which rises when the pumps start cycling more often than usual.
+class PumpMonitor {
+public:
+    static constexpr uint8_t number_pumps = 2; // Port and starboard.
+    static constexpr uint8_t number_bins = 30;
+    static constexpr uint32_t bin_length = 120000; // ms. With 30 bins, the duty cycle covers the last hour.
+
+    struct Counters {
+        uint64_t on_time; // ms
+        uint32_t cycles;
+        uint32_t longest_run; // ms
+    };
+
+    /// @param on_voltage Supply voltage above which a pump is considered on.
+    /// @param off_voltage Supply voltage below which a pump is considered off. The gap between both keeps a sagging battery from counting as cycles.
+    /// @param debounce Time in ms a new state must hold before it is accepted.
+    PumpMonitor(float on_voltage, float off_voltage, uint32_t debounce) : on_voltage(on_voltage), off_voltage(off_voltage), debounce(debounce) {}
+
+    void Begin() {
+        Preferences preferences;
+        preferences.begin("pumps", true);
+        if (preferences.getBytesLength("counters") == sizeof(counters)) {
+            preferences.getBytes("counters", counters, sizeof(counters));
+        }
+        preferences.end();
+        save_timer = millis();
+    }
+
+    /// @brief Feeds a new reading of the supply voltage of a pump.
+    /// @return True if the state of the pump changed.
+    bool Update(uint8_t pump, float voltage, uint32_t now) {
+        if (pump >= number_pumps) return false;
+        PumpState& state = states[pump];
+        AdvanceBins(now);
+
+        // Time on since the last reading is added to the total and to the current bin of the rolling window.
+        if (state.is_on) {
+            uint32_t elapsed = now - state.last_update;
+            counters[pump].on_time += elapsed;
+            bins[pump][current_bin] += elapsed;
+        }
+        state.last_update = now;
+
+        bool is_candidate_on = state.is_on ? voltage > off_voltage : voltage > on_voltage;
+        if (is_candidate_on == state.is_on) {
+            state.pending_since = now;
+            return false;
+        }
+        if (now - state.pending_since < debounce) return false;
+
+        state.is_on = is_candidate_on;
+        if (state.is_on) {
+            state.started_at = now;
+            counters[pump].cycles++;
+        } else {
+            uint32_t run = now - state.started_at;
+            if (run > counters[pump].longest_run) counters[pump].longest_run = run;
+            is_dirty = true;
+        }
+        return true;
+    }
+
+    /// @brief Saves the counters if they changed, no more often than the given interval, to spare the flash.
+    void Save(uint32_t min_interval = 60000) {
+        if (!is_dirty && !IsAnyOn()) return;
+        if (millis() - save_timer < min_interval) return;
+        Write();
+    }
+
+    void Reset() {
+        memset(counters, 0, sizeof(counters));
+        memset(bins, 0, sizeof(bins));
+        Write();
+    }
+
+    /// @return Percentage of the rolling window the pump was on.
+    float GetDutyCycle(uint8_t pump) const {
+        uint32_t on_time = 0;
+        for (uint8_t i = 0; i < number_bins; i++) on_time += bins[pump][i];
+        // The window spans the full bins behind the current one and the elapsed part of the current one. The bins from before a reboot count
+        // as off, so a pump run in the first minutes is measured against the whole window rather than against the uptime, which would
+        // make a single short run look like a leak.
+        uint32_t window = (number_bins - 1) * bin_length + (millis() - bin_start);
+        return 100.0f * on_time / window;
+    }
+
+    float GetMaxDutyCycle() const {
+        float duty_cycle = 0.0f;
+        for (uint8_t i = 0; i < number_pumps; i++) duty_cycle = max(duty_cycle, GetDutyCycle(i));
+        return duty_cycle;
+    }
+
+    bool IsOn(uint8_t pump) const { return states[pump].is_on; }
+    bool IsAnyOn() const { return states[0].is_on || states[1].is_on; }
+    const Counters& GetCounters(uint8_t pump) const { return counters[pump]; }
+    uint32_t GetCurrentRun(uint8_t pump, uint32_t now) const { return states[pump].is_on ? now - states[pump].started_at : 0; } // ms
+
+private:
+    struct PumpState {
+        bool is_on;
+        uint32_t pending_since;
+        uint32_t started_at;
+        uint32_t last_update;
+    };
+
+    float on_voltage;
+    float off_voltage;
+    uint32_t debounce;
+    PumpState states[number_pumps] = {};
+    Counters counters[number_pumps] = {};
+    uint32_t bins[number_pumps][number_bins] = {}; // ms on within each bin.
+    uint8_t current_bin = 0;
+    uint32_t bin_start = 0;
+    uint32_t save_timer = 0;
+    bool is_dirty = false;
+
+    void Write() {
+        save_timer = millis();
+        is_dirty = false;
+        Preferences preferences;
+        preferences.begin("pumps", false);
+        preferences.putBytes("counters", counters, sizeof(counters));
+        preferences.end();
+    }
+
+    /// @brief Moves the rolling window forward, clearing the bins of the intervals that went by.
+    void AdvanceBins(uint32_t now) {
+        uint8_t steps = 0;
+        while (now - bin_start >= bin_length && steps < number_bins) {
+            bin_start += bin_length;
+            current_bin = (current_bin + 1) % number_bins;
+            for (uint8_t i = 0; i < number_pumps; i++) bins[i][current_bin] = 0;
+            steps++;
+        }
+        if (now - bin_start >= bin_length) bin_start = now; // Catch up after a gap longer than the whole window.
+    }
+};
@@ -0,0 +1,241 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/// @brief Complete record of the telemetry of a race, kept on the boat, where nothing is lost to the radio.
+/// The log is a sequence of blocks of one flash sector each, written whole. A block holds records, each a MAVLink frame as encoded by the
+/// firmware with the time and stream sequence number of its sample, and a header that indexes them: the time span of the block, the UTC
+/// of its first record, and for each message type its count and the offset of its first record. Blocks are numbered in the order they
+/// were written, across boots, and end with a CRC-32, so a block torn by a power cut or left from an older pass of a ring is recognized.
+/// The storage is an array of blocks, so a host maps the file or the flash image in memory and reaches any block by its index, then finds
+/// the blocks of a time or a message type from their headers alone.
+/// The writer fills blocks in RAM and hands full ones to the task that writes the storage, keeping a few buffers so a slow write does not
+/// stall the producers. Portable C++ with no allocation and no locking, with the time passed in, shared by the firmware and the host reader.
+namespace RaceLog {
+
+constexpr uint32_t block_size = 4096; // One sector of the SPI flash, which is also the erase unit.
+constexpr uint32_t magic = 0x31474C52; // "RLG1"
+constexpr uint8_t max_types = 10; // Message types indexed per block. More types than this set the overflow flag, and the reader scans.
+constexpr uint8_t flag_type_overflow = 0x01;
+
+struct TypeEntry {
+    uint32_t msgid;
+    uint16_t count;
+    uint16_t first; // Offset of the first record of the type within the records.
+};
+
+struct BlockHeader {
+    uint32_t magic;
+    uint32_t sequence; // Number of the block since the log was created.
+    int64_t first_utc; // UTC of the first record, in us since the Unix epoch, or 0 when the clock was not set.
+    uint32_t boot; // Random number drawn at each boot, which tells the sessions apart.
+    uint32_t first_time; // ms since boot of the first and last records.
+    uint32_t last_time;
+    uint16_t used; // Bytes of records.
+    uint16_t records;
+    uint8_t number_types;
+    uint8_t flags;
+    uint8_t reserved[2];
+    TypeEntry types[max_types];
+    uint32_t reserved_end[2];
+    uint32_t crc; // CRC-32 of the whole block with this field zero.
+};
+static_assert(sizeof(BlockHeader) == 128, "The header is part of the format");
+
+// Followed by the frame, whose length is given by its own header.
+struct RecordHeader {
+    uint32_t time; // Time of the sample, in ms since boot.
+    uint16_t stream_seq;
+    uint8_t stream; // TelemetryStream, or 0xFF for frames that are not telemetry.
+    uint8_t reserved;
+};
+static_assert(sizeof(RecordHeader) == 8, "The record header is part of the format");
+
+constexpr uint32_t records_size = block_size - sizeof(BlockHeader);
+
+/// @brief CRC-32 of IEEE 802.3, as zlib computes it, continued from a previous value.
+inline uint32_t Crc32(const uint8_t* data, size_t length, uint32_t crc = 0) {
+    static constexpr uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = (crc >> 4) ^ table[(crc ^ data[i]) & 0x0F];
+        crc = (crc >> 4) ^ table[(crc ^ (data[i] >> 4)) & 0x0F];
+    }
+    return ~crc;
+}
+
+inline uint32_t BlockCrc(const uint8_t* block) {
+    uint32_t zero = 0;
+    uint32_t crc = Crc32(block, offsetof(BlockHeader, crc));
+    crc = Crc32(reinterpret_cast<const uint8_t*>(&zero), sizeof(zero), crc);
+    return Crc32(block + sizeof(BlockHeader), records_size, crc);
+}
+
+/// @brief Length of a MAVLink 1 or 2 frame from its header, or 0 if it does not start a frame.
+inline uint16_t FrameLength(const uint8_t* frame) {
+    if (frame[0] == 0xFD) return 12 + frame[1] + ((frame[2] & 0x01) ? 13 : 0);
+    if (frame[0] == 0xFE) return 8 + frame[1];
+    return 0;
+}
+
+/// @brief Sets the CRC of a full block before it is written.
+inline void Seal(uint8_t* block) {
+    reinterpret_cast<BlockHeader*>(block)->crc = BlockCrc(block);
+}
+
+/// @brief Whether a block read back from the storage is whole.
+inline bool IsValid(const uint8_t* block) {
+    const BlockHeader* header = reinterpret_cast<const BlockHeader*>(block);
+    return header->magic == magic && header->used <= records_size && header->crc == BlockCrc(block);
+}
+
+/// @brief Calls handler(const RecordHeader&, const uint8_t* frame, uint16_t length) for each record of a valid block.
+template <typename Handler>
+void ForEachRecord(const uint8_t* block, Handler&& handler) {
+    const BlockHeader* header = reinterpret_cast<const BlockHeader*>(block);
+    const uint8_t* records = block + sizeof(BlockHeader);
+    uint32_t offset = 0;
+    while (offset + sizeof(RecordHeader) <= header->used) {
+        RecordHeader record;
+        memcpy(&record, records + offset, sizeof(record));
+        const uint8_t* frame = records + offset + sizeof(record);
+        uint16_t length = FrameLength(frame);
+        if (!length || offset + sizeof(record) + length > header->used) break;
+        handler(static_cast<const RecordHeader&>(record), frame, length);
+        offset += sizeof(record) + length;
+    }
+}
+
+/// @brief Builds the blocks in RAM. Number of buffers is how many full blocks may wait for the storage while the next one fills.
+/// Blocks are handed over unsealed: the storage computes the CRC, so the producers, which may hold a lock around Append(), never pay for it.
+template <uint8_t NumberBuffers>
+class Writer {
+public:
+    struct Statistics {
+        uint32_t records;
+        uint32_t blocks; // Handed to the storage.
+        uint32_t dropped; // Records lost because every buffer was waiting for the storage.
+    };
+
+    explicit Writer(uint32_t boot) : boot(boot) {}
+
+    /// @brief Continues the numbering of the blocks found in the storage.
+    void SetNextSequence(uint32_t sequence) { next_sequence = sequence; }
+
+    /// @brief Adds a frame to the open block, closing it first if the frame does not fit.
+    /// @param utc UTC at the time of the sample, in us since the Unix epoch, or 0 when unknown.
+    /// @param msgid Message id of the frame, for the index of the block.
+    /// @return False if the record was dropped.
+    bool Append(const uint8_t* frame, uint16_t length, uint32_t msgid, uint32_t time, int64_t utc, uint8_t stream, uint16_t stream_seq, uint32_t now) {
+        if (sizeof(RecordHeader) + length > records_size || FrameLength(frame) != length) return false;
+        if (open >= 0 && GetHeader(open).used + sizeof(RecordHeader) + length > records_size) Close();
+        if (open < 0 && !Open(now)) {
+            statistics.dropped++;
+            return false;
+        }
+        uint8_t* block = buffers[open];
+        BlockHeader& header = GetHeader(open);
+        if (!header.records) {
+            header.first_time = time;
+            header.first_utc = utc;
+        }
+        header.last_time = time;
+
+        uint8_t i = 0;
+        while (i < header.number_types && header.types[i].msgid != msgid) i++;
+        if (i < header.number_types) {
+            header.types[i].count++;
+        } else if (header.number_types < max_types) {
+            header.types[header.number_types++] = { msgid, 1, header.used };
+        } else {
+            header.flags |= flag_type_overflow;
+        }
+
+        RecordHeader record = { time, stream_seq, stream, 0 };
+        memcpy(block + sizeof(BlockHeader) + header.used, &record, sizeof(record));
+        memcpy(block + sizeof(BlockHeader) + header.used + sizeof(record), frame, length);
+        header.used += sizeof(record) + length;
+        header.records++;
+        statistics.records++;
+        return true;
+    }
+
+    /// @brief Closes the open block when it has been open for too long, so a power cut loses little. Call periodically.
+    void Poll(uint32_t now, uint32_t max_age) {
+        if (open >= 0 && GetHeader(open).records && now - opened_at >= max_age) Close();
+    }
+
+    /// @return The oldest block waiting for the storage, or nullptr. It stays reserved until Release() is called. Seal() it before writing it.
+    uint8_t* GetReady() {
+        for (uint8_t n = 0; n < NumberBuffers; n++) {
+            uint8_t i = (oldest + n) % NumberBuffers;
+            if (states[i] == Ready) return buffers[i];
+        }
+        return nullptr;
+    }
+
+    /// @brief Frees the block returned by GetReady() once it is written.
+    void Release(const uint8_t* block) {
+        for (uint8_t i = 0; i < NumberBuffers; i++) {
+            if (buffers[i] == block) states[i] = Free;
+        }
+        oldest = (oldest + 1) % NumberBuffers;
+    }
+
+    bool HasOpenRecords() const { return open >= 0 && GetHeader(open).records; }
+    const Statistics& GetStatistics() const { return statistics; }
+    uint32_t GetNextSequence() const { return next_sequence; }
+    uint32_t GetBoot() const { return boot; }
+
+private:
+    enum State : uint8_t { Free, Filling, Ready };
+
+    uint8_t buffers[NumberBuffers][block_size];
+    State states[NumberBuffers] = {};
+    int8_t open = -1;
+    uint8_t oldest = 0;
+    uint32_t next_sequence = 0;
+    uint32_t opened_at = 0;
+    uint32_t boot;
+    Statistics statistics = {};
+
+    BlockHeader& GetHeader(int8_t index) { return *reinterpret_cast<BlockHeader*>(buffers[index]); }
+    const BlockHeader& GetHeader(int8_t index) const { return *reinterpret_cast<const BlockHeader*>(buffers[index]); }
+
+    bool Open(uint32_t now) {
+        // Blocks are filled in turn, so the storage writes them in order.
+        uint8_t candidate = (oldest + CountWaiting()) % NumberBuffers;
+        if (states[candidate] != Free) return false;
+        open = candidate;
+        states[open] = Filling;
+        opened_at = now;
+        memset(buffers[open], 0xFF, block_size); // The value of erased flash, so the unused end costs no programming.
+        BlockHeader& header = GetHeader(open);
+        memset(&header, 0, sizeof(header));
+        header.magic = magic;
+        header.boot = boot;
+        return true;
+    }
+
+    void Close() {
+        BlockHeader& header = GetHeader(open);
+        header.sequence = next_sequence++;
+        states[open] = Ready;
+        open = -1;
+        statistics.blocks++;
+    }
+
+    uint8_t CountWaiting() const {
+        uint8_t count = 0;
+        for (uint8_t i = 0; i < NumberBuffers; i++) {
+            if (states[i] == Ready) count++;
+        }
+        return count;
+    }
+};
+
+} // namespace RaceLog
@@ -0,0 +1,330 @@
+#pragma once
+#include <cstdio>
+#include "RaceLog.hpp"
+
+/// @brief Export of the race log over HTTP, produced a piece at a time into whatever room the web server gives, so a log of any size goes
+/// out through one block of RAM. Blocks are read from the storage one by one, through a function given by the firmware, in the order they
+/// were written.
+/// Three formats: the blocks as stored, which the host reader takes as an image; the same blocks in an LZ4 frame, which the lz4 tool
+/// decompresses back to that image; and CSV, one line per record with the frame in hex.
+/// Each block of the log is an independent block of the frame, compressed with a small hash table and greedy matching. Telemetry frames
+/// repeat most of their bytes from one sample to the next, and the unused end of a block is a single run, so blocks shrink to well under
+/// half. A block that would not shrink goes out uncompressed, flagged as such in its size.
+/// The blocks of an export are those that pass the query when it begins, counted from their headers. The flash ring may overwrite the oldest
+/// of them, or the writer add one, during a long download, so the stored format goes out as exactly that many blocks: a block gone by the time
+/// it is read is replaced by an erased one, which the reader skips, and the length announced stays true.
+/// Portable C++ with no allocation and no locking, shared by the firmware and the host reader.
+namespace RaceLog {
+
+// Compression in the LZ4 block format. The last five bytes are always literals, and no match starts in the last twelve, as the format requires.
+constexpr uint8_t compression_hash_bits = 10;
+
+inline uint32_t ReadWord(const uint8_t* data) {
+    uint32_t word;
+    memcpy(&word, data, sizeof(word));
+    return word;
+}
+
+inline bool EmitSequence(uint8_t* out, size_t& position, size_t capacity, const uint8_t* literals, size_t literal_length, uint16_t offset, size_t match_length) {
+    size_t needed = 1 + literal_length / 255 + 1 + literal_length + (match_length ? 2 + (match_length - 4) / 255 + 1 : 0);
+    if (position + needed > capacity) return false;
+    size_t token = position++;
+    out[token] = (literal_length >= 15 ? 15 : literal_length) << 4;
+    if (literal_length >= 15) {
+        size_t rest = literal_length - 15;
+        for (; rest >= 255; rest -= 255) out[position++] = 255;
+        out[position++] = rest;
+    }
+    memcpy(out + position, literals, literal_length);
+    position += literal_length;
+    if (!match_length) return true;
+
+    out[position++] = offset & 0xFF;
+    out[position++] = offset >> 8;
+    size_t extra = match_length - 4;
+    out[token] |= extra >= 15 ? 15 : extra;
+    if (extra >= 15) {
+        size_t rest = extra - 15;
+        for (; rest >= 255; rest -= 255) out[position++] = 255;
+        out[position++] = rest;
+    }
+    return true;
+}
+
+/// @param table Scratch of 1 << compression_hash_bits entries.
+/// @return Length of the compressed data, or 0 if it does not fit in the capacity.
+inline size_t Compress(const uint8_t* in, size_t length, uint8_t* out, size_t capacity, uint16_t* table) {
+    memset(table, 0, sizeof(uint16_t) << compression_hash_bits);
+    size_t position = 0;
+    size_t anchor = 0;
+    if (length >= 13) {
+        size_t i = 1;
+        while (i < length - 12) {
+            uint32_t word = ReadWord(in + i);
+            uint32_t hash = (word * 2654435761u) >> (32 - compression_hash_bits);
+            size_t candidate = table[hash];
+            table[hash] = i;
+            if (i - candidate > 0xFFFF || ReadWord(in + candidate) != word) {
+                i++;
+                continue;
+            }
+            size_t match_length = 4;
+            while (i + match_length < length - 5 && in[candidate + match_length] == in[i + match_length]) match_length++;
+            if (!EmitSequence(out, position, capacity, in + anchor, i - anchor, i - candidate, match_length)) return 0;
+            i += match_length;
+            anchor = i;
+        }
+    }
+    return EmitSequence(out, position, capacity, in + anchor, length - anchor, 0, 0) ? position : 0;
+}
+
+/// @return Length of the decompressed data, or 0 if the input is damaged or does not fit in the capacity.
+inline size_t Decompress(const uint8_t* in, size_t length, uint8_t* out, size_t capacity) {
+    size_t i = 0;
+    size_t position = 0;
+    auto read_length = [&](size_t value) -> size_t {
+        if (value != 15) return value;
+        uint8_t byte;
+        do {
+            if (i >= length) return SIZE_MAX;
+            byte = in[i++];
+            value += byte;
+        } while (byte == 255);
+        return value;
+    };
+    while (i < length) {
+        uint8_t token = in[i++];
+        size_t literal_length = read_length(token >> 4);
+        if (literal_length > length - i || literal_length > capacity - position) return 0;
+        memcpy(out + position, in + i, literal_length);
+        i += literal_length;
+        position += literal_length;
+        if (i == length) break;
+
+        if (length - i < 2) return 0;
+        size_t offset = in[i] | in[i + 1] << 8;
+        i += 2;
+        size_t match_length = read_length(token & 0x0F);
+        if (match_length == SIZE_MAX || !offset || offset > position || match_length + 4 > capacity - position) return 0;
+        match_length += 4;
+        for (size_t n = 0; n < match_length; n++, position++) out[position] = out[position - offset]; // Overlapping copies repeat a run.
+    }
+    return position;
+}
+
+// LZ4 frame: magic number, then a descriptor of version 1 with independent blocks of up to 64 KB, no checksum and no content size,
+// closed by the checksum byte of the descriptor, the second byte of its XXH32.
+constexpr uint8_t lz4_frame_header[] = { 0x04, 0x22, 0x4D, 0x18, 0x60, 0x40, 0x82 };
+constexpr uint32_t lz4_uncompressed_flag = 0x80000000; // In the size of a block stored as is.
+
+enum ExportFormat : uint8_t {
+    ExportBlocks,
+    ExportCompressed, // LZ4 frame.
+    ExportCsv
+};
+
+struct ExportQuery {
+    ExportFormat format;
+    int64_t from_utc; // us since the Unix epoch. 0 leaves the span open; blocks written before the clock was set only pass an open span.
+    int64_t to_utc;
+    uint32_t first_sequence; // Resumes an export from a block, in any format.
+    uint32_t end_sequence; // Blocks written from here on are left out, so the export is the log as it was when it began.
+};
+
+class Exporter {
+public:
+    /// @brief Reads part of a block of the storage.
+    /// @param position Of the block in the order they were written, from 0.
+    using ReadFunction = bool (*)(uint32_t position, uint32_t offset, uint8_t* data, uint32_t length);
+
+    /// @brief Starts an export and counts the blocks that pass the query, from their headers alone.
+    /// @param number_positions Blocks the storage holds, erased or not.
+    void Begin(const ExportQuery& export_query, uint32_t number_positions, ReadFunction read_function) {
+        query = export_query;
+        positions = number_positions;
+        read = read_function;
+        skipped = 0;
+        position = 0;
+        pending_length = 0;
+        record_offset = 0;
+        is_block_open = false;
+        is_header_sent = query.format == ExportBlocks;
+        is_end_sent = query.format != ExportCompressed;
+
+        number_blocks = 0;
+        first_sequence = 0;
+        BlockHeader header;
+        for (uint32_t i = 0; i < positions; i++) {
+            if (!read(i, 0, reinterpret_cast<uint8_t*>(&header), sizeof(header)) || !IsWanted(header)) continue;
+            if (!number_blocks || header.sequence < first_sequence) first_sequence = header.sequence;
+            number_blocks++;
+        }
+        blocks_left = number_blocks;
+    }
+
+    /// @brief Leaves out the first bytes of the export, to resume an interrupted download of the blocks as stored. Called after Begin(), once
+    /// the count of blocks has shown the download can resume, and before the first Fill().
+    void Skip(uint32_t bytes) { skipped = bytes; }
+
+    /// @return Blocks that passed the query when the export began, which gives the length of an export of the blocks as stored.
+    uint32_t GetNumberBlocks() const { return number_blocks; }
+    /// @return Sequence number of the oldest of those blocks, which with the end of the query tells whether two exports hold the same blocks.
+    uint32_t GetFirstSequence() const { return first_sequence; }
+
+    /// @brief Writes the next bytes of the export.
+    /// @return Bytes written, 0 once the export is over.
+    size_t Fill(uint8_t* out, size_t max_length) {
+        size_t length = 0;
+        while (length < max_length) {
+            if (!pending_length && !Next()) break;
+            size_t count = pending_length < max_length - length ? pending_length : max_length - length;
+            if (skipped) {
+                count = count < skipped ? count : skipped;
+                skipped -= count;
+            } else {
+                memcpy(out + length, pending, count);
+                length += count;
+            }
+            pending += count;
+            pending_length -= count;
+        }
+        return length;
+    }
+
+private:
+    static constexpr size_t max_line_length = 64 + 2 * 280;
+
+    ExportQuery query;
+    ReadFunction read;
+    uint32_t positions;
+    uint32_t position;
+    uint32_t skipped;
+    uint32_t number_blocks;
+    uint32_t first_sequence;
+    uint32_t blocks_left; // Of the stored format, which always gives number_blocks.
+    uint32_t record_offset; // Of the next record of the open block, for CSV.
+    bool is_block_open;
+    bool is_header_sent; // Column names of CSV, or header of the LZ4 frame.
+    bool is_end_sent; // End mark of the LZ4 frame.
+    const uint8_t* pending; // Bytes of the current piece not yet written.
+    size_t pending_length;
+    uint8_t block[block_size];
+    uint8_t output[block_size > max_line_length ? block_size + 4 : max_line_length]; // Compressed block with its size, or a line of CSV.
+    uint16_t table[1 << compression_hash_bits];
+
+    const BlockHeader& GetHeader() const { return *reinterpret_cast<const BlockHeader*>(block); }
+
+    int64_t GetUtc(const BlockHeader& header, uint32_t time) const {
+        return header.first_utc + (int64_t)(time - header.first_time) * 1000;
+    }
+
+    bool IsWanted(const BlockHeader& header) const {
+        if (header.magic != magic || header.sequence < query.first_sequence || header.sequence >= query.end_sequence) return false;
+        if (!query.from_utc && !query.to_utc) return true;
+        if (!header.first_utc) return false;
+        return (!query.from_utc || GetUtc(header, header.last_time) >= query.from_utc) && (!query.to_utc || header.first_utc <= query.to_utc);
+    }
+
+    /// @brief Prepares the next piece of the export.
+    /// @return False once there is nothing left.
+    bool Next() {
+        if (!is_header_sent) {
+            is_header_sent = true;
+            if (query.format == ExportCompressed) return SetPending(lz4_frame_header, sizeof(lz4_frame_header));
+            static constexpr char columns[] = "block,utc_us,time_boot_ms,stream,stream_seq,msgid,frame\n";
+            return SetPending(reinterpret_cast<const uint8_t*>(columns), sizeof(columns) - 1);
+        }
+        while (true) {
+            if (is_block_open && NextRecord()) return true;
+            is_block_open = false;
+            if (!NextBlock()) {
+                if (is_end_sent) return false;
+                is_end_sent = true;
+                static constexpr uint8_t end_mark[4] = {};
+                return SetPending(end_mark, sizeof(end_mark));
+            }
+            if (query.format == ExportBlocks) return SetPending(block, block_size);
+            if (query.format == ExportCompressed) {
+                uint32_t size = Compress(block, block_size, output + 4, block_size - 1, table);
+                uint32_t length = size;
+                if (!size) {
+                    memcpy(output + 4, block, block_size);
+                    length = block_size;
+                    size = block_size | lz4_uncompressed_flag;
+                }
+                for (uint8_t i = 0; i < 4; i++) output[i] = size >> (8 * i);
+                return SetPending(output, length + 4);
+            }
+            is_block_open = true;
+            record_offset = 0;
+        }
+    }
+
+    /// @brief Reads the next block that passes the query into the buffer. Blocks of the stored format that are skipped whole are not read.
+    bool NextBlock() {
+        if (query.format == ExportBlocks) {
+            while (blocks_left) {
+                blocks_left--;
+                // Once the storage runs out of wanted blocks, erased ones make up the count.
+                bool is_read = false;
+                while (!is_read && position < positions) {
+                    uint32_t current = position++;
+                    is_read = read(current, 0, block, sizeof(BlockHeader)) && IsWanted(GetHeader());
+                    if (is_read && skipped < block_size) is_read = read(current, sizeof(BlockHeader), block + sizeof(BlockHeader), records_size);
+                }
+                if (skipped >= block_size) {
+                    skipped -= block_size;
+                    continue;
+                }
+                // Damaged blocks are passed on as they are, for the reader to judge.
+                if (!is_read) memset(block, 0xFF, block_size);
+                return true;
+            }
+            return false;
+        }
+        while (position < positions) {
+            uint32_t current = position++;
+            if (!read(current, 0, block, sizeof(BlockHeader)) || !IsWanted(GetHeader())) continue;
+            if (!read(current, sizeof(BlockHeader), block + sizeof(BlockHeader), records_size) || !IsValid(block)) continue;
+            return true;
+        }
+        return false;
+    }
+
+    /// @brief Writes the line of the next record of the open block that passes the query.
+    bool NextRecord() {
+        const BlockHeader& header = GetHeader();
+        const uint8_t* records = block + sizeof(BlockHeader);
+        while (record_offset + sizeof(RecordHeader) <= header.used) {
+            RecordHeader record;
+            memcpy(&record, records + record_offset, sizeof(record));
+            const uint8_t* frame = records + record_offset + sizeof(record);
+            uint16_t length = FrameLength(frame);
+            if (!length || record_offset + sizeof(record) + length > header.used) return false;
+            record_offset += sizeof(record) + length;
+
+            int64_t utc = header.first_utc ? GetUtc(header, record.time) : 0;
+            if ((query.from_utc && utc < query.from_utc) || (query.to_utc && utc > query.to_utc)) continue;
+            uint32_t msgid = frame[0] == 0xFD ? frame[7] | frame[8] << 8 | (uint32_t)frame[9] << 16 : frame[5];
+            char* line = reinterpret_cast<char*>(output);
+            int line_length = utc ? snprintf(line, max_line_length, "%u,%lld,", header.sequence, (long long)utc) : snprintf(line, max_line_length, "%u,,", header.sequence);
+            line_length += snprintf(line + line_length, max_line_length - line_length, "%u,%u,%u,%u,", record.time, record.stream, record.stream_seq, msgid);
+            static constexpr char digits[] = "0123456789abcdef";
+            for (uint16_t i = 0; i < length; i++) {
+                line[line_length++] = digits[frame[i] >> 4];
+                line[line_length++] = digits[frame[i] & 0x0F];
+            }
+            line[line_length++] = '\n';
+            return SetPending(output, line_length);
+        }
+        return false;
+    }
+
+    bool SetPending(const uint8_t* data, size_t length) {
+        pending = data;
+        pending_length = length;
+        return true;
+    }
+};
+
+} // namespace RaceLog
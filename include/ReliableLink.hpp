@@ -0,0 +1,243 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+/// @brief Selective repeat delivery for the few messages that must not be lost, such as alarms and commands, over a link that otherwise drops frames.
+/// Each reliable frame travels inside an envelope with its own 16-bit sequence number and the session of the sender, which changes on every boot.
+/// The receiver answers every envelope with the lowest sequence number it has not received and a bitmap of the 32 numbers above it, so one
+/// acknowledgement confirms a whole window and names its holes. The sender resends a hole as soon as a later frame is confirmed, and any frame
+/// whose retransmission timeout expires, with the timeout derived from the round trip time the way TCP does it. Round trips are only sampled on
+/// frames sent once, since the acknowledgement of a resent frame cannot be matched to one transmission. Frames are delivered as they arrive,
+/// once each, since alarms and commands stand on their own and are not worth holding back behind a lost one.
+/// Bulk telemetry does not go through this layer and pays nothing for it.
+/// Portable C++ with no allocation and no locking, with the time passed in.
+namespace ReliableLink {
+
+constexpr uint16_t max_frame_length = 224; // Bytes, so the envelope, with its 4 byte header and the 12 bytes of MAVLink 2 framing, is at most the 240 the forward error correction protects.
+constexpr uint8_t ack_window = 32; // Sequence numbers above the base covered by an acknowledgement.
+
+/// @brief Difference between sequence numbers, in the order they wrap.
+inline int16_t SeqDiff(uint16_t a, uint16_t b) { return (int16_t)(uint16_t)(a - b); }
+
+template <uint8_t WindowSize>
+class Sender {
+    static_assert(WindowSize <= ack_window, "Frames in flight must fit in an acknowledgement");
+
+public:
+    struct Statistics {
+        uint32_t sent;
+        uint32_t delivered;
+        uint32_t retransmissions;
+        uint32_t failed; // Frames given up after the last transmission.
+        uint32_t rejected; // Frames refused because the window was full.
+        uint32_t superseded; // Frames given up because a newer frame with the same key was sent.
+    };
+
+    explicit Sender(uint8_t session) : session(session) {}
+
+    /// @brief Takes a frame and transmits it for the first time.
+    /// @param transmit Called with (uint16_t seq, uint8_t session, const uint8_t* frame, uint16_t length) for every transmission.
+    /// @param key Non zero for a frame that replaces the older frames with the same key, such as a setting of which only the last value
+    /// counts. Those still in flight are given up, so none is resent after the new one and delivered out of order, applying a stale value.
+    /// @return False if the window is full or the frame is too long, in which case the caller may still send it unreliably.
+    template <typename Transmit>
+    bool Send(const uint8_t* frame, uint16_t length, uint32_t now, Transmit&& transmit, uint32_t key = 0) {
+        if (length > max_frame_length) return false;
+        if (key) {
+            for (uint8_t i = 0; i < WindowSize; i++) {
+                if (!slots[i].is_used || slots[i].key != key) continue;
+                slots[i].is_used = false;
+                in_flight--;
+                statistics.superseded++;
+            }
+            UpdateOldest();
+        }
+        Slot* slot = nullptr;
+        for (uint8_t i = 0; i < WindowSize && !slot; i++) {
+            if (!slots[i].is_used) slot = &slots[i];
+        }
+        // The oldest frame in flight and the newest must fit in one acknowledgement.
+        if (!slot || (in_flight && SeqDiff(next_seq, oldest_seq) >= ack_window)) {
+            statistics.rejected++;
+            return false;
+        }
+        slot->is_used = true;
+        slot->seq = next_seq++;
+        slot->length = length;
+        slot->transmissions = 0;
+        slot->key = key;
+        memcpy(slot->frame, frame, length);
+        if (!in_flight++) oldest_seq = slot->seq;
+        statistics.sent++;
+        Emit(*slot, now, transmit);
+        return true;
+    }
+
+    /// @brief Takes an acknowledgement, frees the frames it confirms and resends the holes below the newest frame it confirms.
+    template <typename Transmit>
+    void OnAck(uint8_t ack_session, uint16_t base, uint32_t received_mask, uint32_t now, Transmit&& transmit) {
+        if (ack_session != session) return;
+        // Newest sequence number confirmed by the acknowledgement, to tell the holes from the frames still on their way.
+        uint16_t newest = base - 1;
+        for (int8_t bit = ack_window - 1; bit >= 0; bit--) {
+            if (received_mask & (1UL << bit)) {
+                newest = base + 1 + bit;
+                break;
+            }
+        }
+        for (uint8_t i = 0; i < WindowSize; i++) {
+            Slot& slot = slots[i];
+            if (!slot.is_used) continue;
+            int16_t offset = SeqDiff(slot.seq, base);
+            bool is_received = offset < 0 || (offset > 0 && offset <= ack_window && (received_mask & (1UL << (offset - 1))));
+            if (is_received) {
+                if (slot.transmissions == 1) SampleRtt(now - slot.sent_at);
+                slot.is_used = false;
+                in_flight--;
+                statistics.delivered++;
+            } else if (SeqDiff(slot.seq, newest) < 0 && now - slot.sent_at >= srtt) {
+                // A hole: a later frame got through, so this one was lost rather than late. Sent again once per round trip at most.
+                statistics.retransmissions++;
+                Emit(slot, now, transmit);
+            }
+        }
+        UpdateOldest();
+    }
+
+    /// @brief Resends the frames whose timeout expired, doubling the timeout on each attempt. Call periodically.
+    template <typename Transmit>
+    void Poll(uint32_t now, Transmit&& transmit) {
+        for (uint8_t i = 0; i < WindowSize; i++) {
+            Slot& slot = slots[i];
+            if (!slot.is_used) continue;
+            uint32_t timeout = rto << (slot.transmissions - 1);
+            if (timeout > max_rto) timeout = max_rto;
+            if (now - slot.sent_at < timeout) continue;
+            if (slot.transmissions >= max_transmissions) {
+                slot.is_used = false;
+                in_flight--;
+                statistics.failed++;
+                continue;
+            }
+            statistics.retransmissions++;
+            Emit(slot, now, transmit);
+        }
+        UpdateOldest();
+    }
+
+    uint8_t GetInFlight() const { return in_flight; }
+    uint32_t GetRto() const { return rto; } // ms
+    uint32_t GetSrtt() const { return srtt; } // ms
+    const Statistics& GetStatistics() const { return statistics; }
+
+private:
+    static constexpr uint32_t min_rto = 300; // ms
+    static constexpr uint32_t max_rto = 30000; // ms. A frame at SF12 alone takes a few seconds on air.
+    static constexpr uint8_t max_transmissions = 8;
+
+    struct Slot {
+        bool is_used;
+        uint16_t seq;
+        uint16_t length;
+        uint8_t transmissions;
+        uint32_t sent_at;
+        uint32_t key;
+        uint8_t frame[max_frame_length];
+    };
+
+    uint8_t session;
+    uint16_t next_seq = 0;
+    uint16_t oldest_seq = 0;
+    uint8_t in_flight = 0;
+    Slot slots[WindowSize] = {};
+    bool has_rtt = false;
+    uint32_t srtt = 0; // ms
+    uint32_t rttvar = 0; // ms
+    uint32_t rto = 3000; // ms, until the first round trip is measured.
+    Statistics statistics = {};
+
+    template <typename Transmit>
+    void Emit(Slot& slot, uint32_t now, Transmit&& transmit) {
+        slot.transmissions++;
+        slot.sent_at = now;
+        transmit(slot.seq, session, static_cast<const uint8_t*>(slot.frame), slot.length);
+    }
+
+    /// @brief Smoothed round trip and its variation, with the gains of RFC 6298.
+    void SampleRtt(uint32_t rtt) {
+        if (!has_rtt) {
+            srtt = rtt;
+            rttvar = rtt / 2;
+            has_rtt = true;
+        } else {
+            uint32_t deviation = rtt > srtt ? rtt - srtt : srtt - rtt;
+            rttvar = (3 * rttvar + deviation) / 4;
+            srtt = (7 * srtt + rtt) / 8;
+        }
+        rto = srtt + 4 * rttvar;
+        if (rto < min_rto) rto = min_rto;
+        if (rto > max_rto) rto = max_rto;
+    }
+
+    void UpdateOldest() {
+        bool is_first = true;
+        for (uint8_t i = 0; i < WindowSize; i++) {
+            if (!slots[i].is_used) continue;
+            if (is_first || SeqDiff(slots[i].seq, oldest_seq) < 0) oldest_seq = slots[i].seq;
+            is_first = false;
+        }
+    }
+};
+
+/// @brief Tracks the sequence numbers received from the other end, to suppress duplicates and build the acknowledgements.
+class Receiver {
+public:
+    struct Ack {
+        uint8_t session;
+        uint16_t base; // Lowest sequence number not received.
+        uint32_t received_mask; // Bit i set when base + 1 + i was received.
+    };
+
+    /// @brief Records a received envelope. Always answer it with GetAck(), duplicates included, since the last acknowledgement may have been lost.
+    /// @return True the first time a frame is seen, when it must be delivered.
+    bool Receive(uint8_t session, uint16_t seq) {
+        if (!has_session || session != this->session) {
+            // The other end restarted. Its first frame in flight sets the base, since any before it were given up with the old session.
+            has_session = true;
+            this->session = session;
+            base = seq;
+            received_mask = 0;
+        }
+        int16_t offset = SeqDiff(seq, base);
+        if (offset < 0) return false;
+        if (offset > ack_window) {
+            // Too far ahead to track, so the frames in between were given up by the sender.
+            base = seq;
+            received_mask = 0;
+            offset = 0;
+        }
+        if (offset == 0) {
+            bool is_next_received;
+            do {
+                base++;
+                is_next_received = received_mask & 1;
+                received_mask >>= 1;
+            } while (is_next_received);
+            return true;
+        }
+        uint32_t bit = 1UL << (offset - 1);
+        if (received_mask & bit) return false;
+        received_mask |= bit;
+        return true;
+    }
+
+    Ack GetAck() const { return { session, base, received_mask }; }
+
+private:
+    bool has_session = false;
+    uint8_t session = 0;
+    uint16_t base = 0;
+    uint32_t received_mask = 0;
+};
+
+} // namespace ReliableLink
@@ -0,0 +1,188 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+/// @brief A periodic sensor reader put together at compile time from its stages, with no virtual call:
+/// - Driver: bool Begin(), which finds the sensor; uint32_t Request(), which starts a reading and returns the ms to wait for it, 0 when it
+///   can be read at once; bool Read(Sample&), false when the sensor did not answer.
+/// - Converter: Value Convert(const Sample&), from raw counts to physical units.
+/// - Filter: bool Apply(Value&), which smooths the value in place, or returns false to drop the sample; void Reset(), which forgets the
+///   past samples when the sensor is begun again.
+/// - Encoder: void Publish(const Value&, uint32_t sample_time), which keeps the value, checks the alarms and sends the telemetry.
+/// Every pipeline times each stage and counts its errors and drops the same way, and shares the retries: after a few reads in a row fail,
+/// the sensor is begun again, and a sensor that does not begin is tried again after a delay that doubles up to a minute.
+/// Step() does one piece of the work and returns the delay until the next, so a pipeline is a job of the JobExecutor and a wait for a
+/// conversion holds up no other job. Readings start every Period ms.
+/// Portable C++ with no allocation, with the time passed in and a microsecond clock to time the stages.
+
+enum SensorPipelineStage : uint8_t {
+    ReadStage,
+    ConvertStage,
+    FilterStage,
+    PublishStage,
+    NumberSensorPipelineStages
+};
+
+struct SensorPipelineStatistics {
+    struct Stage {
+        uint32_t runs;
+        uint64_t total_time; // us
+        uint32_t max_time; // us
+    };
+
+    const char* name;
+    uint32_t samples; // Published.
+    uint32_t errors; // Reads that failed.
+    uint32_t drops; // Samples the filter refused.
+    uint32_t restarts; // Times the sensor was begun again after it stopped answering.
+    uint32_t begin_failures;
+    Stage stages[NumberSensorPipelineStages];
+};
+
+/// @brief Passes every sample on unchanged.
+struct NoFilter {
+    template <typename Value>
+    bool Apply(Value&) { return true; }
+
+    void Reset() {}
+};
+
+/// @brief Exponential moving average of each float of the value, with the weight of the mean of NumberSamples samples. Starts from the
+/// first sample rather than from zero, so the alarms do not see a ramp after a restart.
+template <typename Value, uint8_t NumberSamples>
+class ExponentialFilter {
+    static_assert(sizeof(Value) % sizeof(float) == 0, "The value must be made of floats");
+    static constexpr uint8_t number_floats = sizeof(Value) / sizeof(float);
+
+public:
+    bool Apply(Value& value) {
+        float input[number_floats];
+        memcpy(input, &value, sizeof(input));
+        for (uint8_t i = 0; i < number_floats; i++) {
+            mean[i] = is_primed ? (input[i] + mean[i] * NumberSamples) / (NumberSamples + 1) : input[i];
+        }
+        is_primed = true;
+        memcpy(&value, mean, sizeof(mean));
+        return true;
+    }
+
+    void Reset() { is_primed = false; }
+
+private:
+    float mean[number_floats];
+    bool is_primed = false;
+};
+
+template <typename Driver, typename Converter, typename Filter, typename Encoder, uint32_t Period>
+class SensorPipeline {
+public:
+    using Sample = typename Driver::Sample;
+    using Value = typename Converter::Value;
+
+    static constexpr uint8_t max_consecutive_errors = 3;
+    static constexpr uint32_t max_backoff = Period > 60000 ? Period : 60000; // ms
+
+    // The stages are reachable, for the commands and settings particular to a sensor.
+    Driver driver;
+    Converter converter;
+    Filter filter;
+    Encoder encoder;
+
+    /// @param clock Microsecond clock that times the stages.
+    SensorPipeline(const char* name, int64_t (*clock)()) : clock(clock) {
+        statistics.name = name;
+    }
+
+    /// @brief Job function of the JobExecutor, with the pipeline as its context.
+    static uint32_t Run(void* pipeline, uint32_t now) {
+        return static_cast<SensorPipeline*>(pipeline)->Step(now);
+    }
+
+    /// @brief Begins the sensor, starts a reading, or reads, converts, filters and publishes the sample once it is ready.
+    /// @return ms until the next step.
+    uint32_t Step(uint32_t now) {
+        switch (state) {
+            case Stopped:
+                if (!driver.Begin()) {
+                    statistics.begin_failures++;
+                    uint32_t delay = backoff;
+                    backoff = backoff < max_backoff / 2 ? backoff * 2 : max_backoff;
+                    return delay;
+                }
+                backoff = Period;
+                filter.Reset(); // Samples from before the sensor stopped answering are stale.
+                state = Idle;
+                [[fallthrough]]; // The first reading starts at once.
+            case Idle:
+                cycle_start = now;
+                wait = driver.Request();
+                if (wait) {
+                    state = Converting;
+                    return wait;
+                }
+                break;
+            case Converting:
+                // Woken early, such as by a notification of the executor.
+                if (now - cycle_start < wait) return wait - (now - cycle_start);
+                break;
+        }
+        state = Idle;
+
+        Sample sample;
+        bool is_read = Time(ReadStage, [&]() { return driver.Read(sample); });
+        if (!is_read) {
+            statistics.errors++;
+            if (++consecutive_errors >= max_consecutive_errors) {
+                consecutive_errors = 0;
+                statistics.restarts++;
+                state = Stopped;
+            }
+            return NextDelay(now);
+        }
+        consecutive_errors = 0;
+
+        Value value = Time(ConvertStage, [&]() { return converter.Convert(sample); });
+        if (!Time(FilterStage, [&]() { return filter.Apply(value); })) {
+            statistics.drops++;
+            return NextDelay(now);
+        }
+        Time(PublishStage, [&]() { encoder.Publish(value, now); return true; });
+        statistics.samples++;
+        return NextDelay(now);
+    }
+
+    const SensorPipelineStatistics& GetStatistics() const { return statistics; }
+
+private:
+    enum State : uint8_t {
+        Stopped,
+        Idle,
+        Converting
+    };
+
+    int64_t (*clock)();
+    SensorPipelineStatistics statistics = {};
+    State state = Stopped;
+    uint32_t cycle_start = 0; // ms, when the reading was requested.
+    uint32_t wait = 0; // ms, for the conversion of the reading.
+    uint32_t backoff = Period; // ms
+    uint8_t consecutive_errors = 0;
+
+    template <typename Function>
+    auto Time(SensorPipelineStage stage, Function function) {
+        int64_t start = clock();
+        auto result = function();
+        uint32_t time = clock() - start;
+        SensorPipelineStatistics::Stage& entry = statistics.stages[stage];
+        entry.runs++;
+        entry.total_time += time;
+        if (time > entry.max_time) entry.max_time = time;
+        return result;
+    }
+
+    /// @return ms until the next reading, Period after the start of this one, which keeps the rate however long the reading took.
+    uint32_t NextDelay(uint32_t now) const {
+        uint32_t elapsed = now - cycle_start;
+        return state == Stopped ? backoff : elapsed < Period ? Period - elapsed : 0;
+    }
+};
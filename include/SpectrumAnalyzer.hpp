@@ -0,0 +1,173 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+
+/// @brief Spectrum of a frame of current samples, reduced to a few numbers that fit in a single telemetry message.
+/// Amplitudes are peak values of each sinusoidal component and band values are the RMS of the signal within the band, both in the unit of the samples.
+template <uint8_t NumberPeaks, uint8_t NumberBands>
+struct SpectrumSummary {
+    float dc; // Mean of the frame, removed before the transform.
+    float peak_frequency[NumberPeaks]; // Hz, strongest first. Zero when fewer peaks were found.
+    float peak_amplitude[NumberPeaks];
+    float band_rms[NumberBands];
+};
+
+/// @brief Radix-2 FFT of real frames of length N, followed by the extraction of the dominant frequencies and the energy within fixed bands.
+/// A real frame is transformed as a complex frame of half the length, with the even samples as the real part and the odd samples as the imaginary part,
+/// and the two interleaved spectra are separated afterwards, which halves the work compared to a complex transform of the full frame.
+/// The Hann window, the twiddle factors and the bit reversal permutation are computed once by the constructor, so a frame costs no trigonometry.
+/// Portable C++ with no allocation, shared by the firmware and the host benchmark in SpectrumBenchmark/.
+template <uint16_t N, uint8_t NumberPeaks = 3, uint8_t NumberBands = 4>
+class SpectrumAnalyzer {
+    static_assert(N >= 8 && (N & (N - 1)) == 0, "Frame length must be a power of two");
+
+public:
+    static constexpr uint16_t frame_length = N;
+    static constexpr uint8_t number_peaks = NumberPeaks;
+    static constexpr uint8_t number_bands = NumberBands;
+    using Summary = SpectrumSummary<NumberPeaks, NumberBands>;
+
+    /// @param band_edges Limits of the bands in Hz, in increasing order. Band i spans [band_edges[i], band_edges[i + 1]).
+    explicit SpectrumAnalyzer(const float (&band_edges)[NumberBands + 1]) {
+        for (uint8_t i = 0; i <= NumberBands; i++) this->band_edges[i] = band_edges[i];
+
+        window_power = 0.0f;
+        for (uint16_t n = 0; n < N; n++) {
+            window[n] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * n / N);
+            window_power += window[n] * window[n];
+        }
+        for (uint16_t k = 0; k < half; k++) {
+            twiddle_real[k] = cosf(2.0f * (float)M_PI * k / N);
+            twiddle_imag[k] = -sinf(2.0f * (float)M_PI * k / N);
+        }
+        uint8_t bits = 0;
+        while ((1u << bits) < half) bits++;
+        for (uint16_t i = 0; i < half; i++) {
+            uint16_t reversed = 0;
+            for (uint8_t b = 0; b < bits; b++) {
+                if (i & (1u << b)) reversed |= 1u << (bits - 1 - b);
+            }
+            bit_reverse[i] = reversed;
+        }
+    }
+
+    /// @brief Computes the one-sided spectrum of a frame, after removing its mean and applying the window.
+    /// @param samples N samples taken at a constant rate.
+    /// @param real Receives the real parts of bins 0 to N/2.
+    /// @param imag Receives the imaginary parts of bins 0 to N/2.
+    /// @return Mean of the frame.
+    float Transform(const float* samples, float* real, float* imag) {
+        float mean = 0.0f;
+        for (uint16_t n = 0; n < N; n++) mean += samples[n];
+        mean /= N;
+
+        // Pack the even and odd samples into a complex frame of half the length, already in bit reversed order.
+        for (uint16_t i = 0; i < half; i++) {
+            uint16_t j = bit_reverse[i];
+            work_real[j] = (samples[2 * i] - mean) * window[2 * i];
+            work_imag[j] = (samples[2 * i + 1] - mean) * window[2 * i + 1];
+        }
+
+        // Iterative butterflies. The twiddles of the half length transform are every other entry of the table.
+        for (uint16_t size = 2; size <= half; size <<= 1) {
+            uint16_t span = size >> 1;
+            uint16_t stride = (half / size) * 2;
+            for (uint16_t start = 0; start < half; start += size) {
+                for (uint16_t k = 0; k < span; k++) {
+                    float wr = twiddle_real[k * stride];
+                    float wi = twiddle_imag[k * stride];
+                    uint16_t a = start + k;
+                    uint16_t b = a + span;
+                    float tr = work_real[b] * wr - work_imag[b] * wi;
+                    float ti = work_real[b] * wi + work_imag[b] * wr;
+                    work_real[b] = work_real[a] - tr;
+                    work_imag[b] = work_imag[a] - ti;
+                    work_real[a] += tr;
+                    work_imag[a] += ti;
+                }
+            }
+        }
+
+        // Separate the spectra of the even and odd samples and combine them into the spectrum of the real frame.
+        for (uint16_t k = 0; k <= half; k++) {
+            uint16_t a = k % half;
+            uint16_t b = (half - k) % half;
+            float even_real = 0.5f * (work_real[a] + work_real[b]);
+            float even_imag = 0.5f * (work_imag[a] - work_imag[b]);
+            float odd_real = 0.5f * (work_imag[a] + work_imag[b]);
+            float odd_imag = -0.5f * (work_real[a] - work_real[b]);
+            float wr = k < half ? twiddle_real[k] : -1.0f;
+            float wi = k < half ? twiddle_imag[k] : 0.0f;
+            real[k] = even_real + odd_real * wr - odd_imag * wi;
+            imag[k] = even_imag + odd_real * wi + odd_imag * wr;
+        }
+        return mean;
+    }
+
+    /// @brief Transforms a frame and reduces its spectrum to the dominant frequencies and the RMS within each band.
+    /// @param samples N samples taken at a constant rate.
+    /// @param sample_rate Rate the samples were taken at, in Hz.
+    Summary Analyze(const float* samples, float sample_rate) {
+        Summary summary = {};
+        summary.dc = Transform(samples, spectrum_real, spectrum_imag);
+
+        for (uint16_t k = 0; k <= half; k++) {
+            power[k] = spectrum_real[k] * spectrum_real[k] + spectrum_imag[k] * spectrum_imag[k];
+        }
+
+        // Parseval's theorem corrected for the window: each one-sided bin holds 2|X|^2 / (N * sum(w^2)) of the mean square of the signal.
+        float bin_width = sample_rate / N;
+        float power_scale = 2.0f / (N * window_power);
+        for (uint8_t band = 0; band < NumberBands; band++) {
+            float energy = 0.0f;
+            for (uint16_t k = 1; k < half; k++) {
+                float frequency = k * bin_width;
+                if (frequency >= band_edges[band] && frequency < band_edges[band + 1]) energy += power[k];
+            }
+            summary.band_rms[band] = sqrtf(energy * power_scale);
+        }
+
+        // Local maxima of the spectrum, strongest first. Bin 1 is skipped since the window spreads whatever is left of the mean into it.
+        // The frequency of each peak is refined by fitting a parabola through the log magnitudes of the peak bin and its neighbours.
+        uint8_t number_found = 0;
+        for (uint16_t k = 2; k < half; k++) {
+            if (power[k] <= power[k - 1] || power[k] < power[k + 1] || power[k] == 0.0f) continue;
+            uint8_t position = number_found;
+            while (position > 0 && power[k] > power[peak_bins[position - 1]]) position--;
+            if (position >= NumberPeaks) continue;
+            for (uint8_t i = (number_found < NumberPeaks ? number_found : NumberPeaks - 1); i > position; i--) peak_bins[i] = peak_bins[i - 1];
+            peak_bins[position] = k;
+            if (number_found < NumberPeaks) number_found++;
+        }
+
+        for (uint8_t i = 0; i < number_found; i++) {
+            uint16_t k = peak_bins[i];
+            float left = 0.5f * logf(power[k - 1] + 1e-20f);
+            float center = 0.5f * logf(power[k]);
+            float right = 0.5f * logf(power[k + 1] + 1e-20f);
+            float denominator = left - 2.0f * center + right;
+            float offset = denominator != 0.0f ? 0.5f * (left - right) / denominator : 0.0f;
+            float magnitude = expf(center - 0.25f * (left - right) * offset);
+            summary.peak_frequency[i] = (k + offset) * bin_width;
+            summary.peak_amplitude[i] = 2.0f * magnitude / window_gain;
+        }
+        return summary;
+    }
+
+private:
+    static constexpr uint16_t half = N / 2;
+    static constexpr float window_gain = N / 2.0f; // Sum of the Hann window, which scales the magnitude of a sinusoid centred on a bin.
+
+    float band_edges[NumberBands + 1];
+    float window[N];
+    float window_power;
+    float twiddle_real[half];
+    float twiddle_imag[half];
+    uint16_t bit_reverse[half];
+    float work_real[half];
+    float work_imag[half];
+    float spectrum_real[half + 1];
+    float spectrum_imag[half + 1];
+    float power[half + 1];
+    uint16_t peak_bins[NumberPeaks];
+};
@@ -0,0 +1,216 @@
+#pragma once
+#include <Arduino.h>
+#include "driver/rmt.h" // Remote control peripheral, used here as a general purpose waveform generator.
+
+enum BlinkRate : uint32_t {
+    Slow = 2000,
+    Medium = 1000,
+    Fast = 300,
+    Pulse = 100, // Pulse is a special value that will make the LED blink fast and then return to the previous blink rate.
+    Alarm = 1, // Special value that sounds the buzzer continuously until AlarmCleared is posted, overriding every other pattern.
+    AlarmCleared = 0
+};
+
+/// @brief Drives the status LED and the buzzer from the RMT peripheral, which plays the patterns back without any CPU involvement.
+/// Blink rates are compiled into RMT items and looped by the hardware. Pulses are played once on top of the current rate as overlays,
+/// after which a one-shot software timer restores the looping pattern. All the work happens in the FreeRTOS timer service task,
+/// so there is no dedicated task waking up to toggle pins.
+/// Tasks post events with Post(), which only pushes them to a queue. Overlays are played in the order they were posted and never dropped
+/// while the queue has room; a change of rate takes effect immediately, or as soon as the overlay being played is over.
+/// An active alarm takes priority over both and keeps its own pattern until it is cleared.
+class StatusIndicator {
+public:
+    StatusIndicator(uint8_t led_pin, uint8_t buzzer_pin) : led_pin(led_pin), buzzer_pin(buzzer_pin) {}
+
+    void Begin() {
+        ConfigureChannel(led_channel, led_pin);
+        ConfigureChannel(buzzer_channel, buzzer_pin);
+        event_queue = xQueueCreate(event_queue_length, sizeof(BlinkRate));
+        timer = xTimerCreate("status", 1, pdFALSE, this, [](TimerHandle_t timer) {
+            static_cast<StatusIndicator*>(pvTimerGetTimerID(timer))->ProcessEvents();
+        });
+        Post(BlinkRate::Slow);
+    }
+
+    /// @brief Queues a status event. Safe to call from any task; never blocks.
+    /// Alarm events skip ahead of the queue and interrupt any overlay being played, so the buzzer sounds right away.
+    /// @return False if the queue is full and the event could not be posted.
+    bool Post(BlinkRate event) {
+        if (!event_queue) return false;
+        bool is_alarm = event == BlinkRate::Alarm || event == BlinkRate::AlarmCleared;
+        if (!(is_alarm ? xQueueSendToFront(event_queue, &event, 0) : xQueueSend(event_queue, &event, 0))) {
+            dropped_events++;
+            return false;
+        }
+        // Wake the timer service task to process the event, unless an overlay is playing, in which case it will be picked up once the overlay ends.
+        // The period is set back to one tick, since the last overlay left the timer with its own length.
+        if (is_alarm || !xTimerIsTimerActive(timer)) {
+            xTimerChangePeriod(timer, 1, 0);
+        }
+        return true;
+    }
+
+    uint32_t GetDroppedEvents() const { return dropped_events; }
+
+private:
+    static constexpr rmt_channel_t led_channel = RMT_CHANNEL_0;
+    static constexpr rmt_channel_t buzzer_channel = RMT_CHANNEL_1;
+    static constexpr uint8_t rmt_clock_divider = 100; // The 1MHz reference clock divided by 100 gives ticks of 100us.
+    static constexpr uint32_t rmt_ticks_per_ms = 10;
+    static constexpr uint32_t rmt_max_ticks = 32767; // Durations are 15-bit fields in each half of an RMT item.
+    static constexpr uint8_t max_items = 64; // One block of RMT memory per channel.
+    static constexpr uint8_t event_queue_length = 16;
+
+    // Buzzer rhythm played while the LED blinks fast, which signals a fault. Each step lasts one blink period.
+    static constexpr uint8_t fault_buzzer_pattern[] = {1, 0, 1, 0, 1, 0, 0, 0};
+    static constexpr uint8_t pulse_pattern[] = {1, 0, 1, 0, 1, 0, 1, 0};
+    static constexpr uint32_t pulse_step = 50; // ms
+    static constexpr uint8_t alarm_buzzer_pattern[] = {1, 1, 1, 0};
+    static constexpr uint8_t alarm_led_pattern[] = {1, 0};
+    static constexpr uint32_t alarm_step = 100; // ms
+
+    uint8_t led_pin;
+    uint8_t buzzer_pin;
+    QueueHandle_t event_queue = nullptr;
+    TimerHandle_t timer = nullptr;
+    BlinkRate blink_rate = BlinkRate::Slow;
+    bool is_alarm_active = false;
+    // Patterns currently played by each channel, so a looping pattern is not restarted when it is already playing.
+    BlinkRate led_pattern = BlinkRate::AlarmCleared;
+    BlinkRate buzzer_pattern = BlinkRate::AlarmCleared;
+    volatile uint32_t dropped_events = 0;
+    // Items of the pattern of each channel, kept here rather than on the small stack of the timer service task, which plays them.
+    rmt_item32_t items[buzzer_channel + 1][max_items];
+
+    void ConfigureChannel(rmt_channel_t channel, uint8_t pin) {
+        rmt_config_t config = {};
+        config.rmt_mode = RMT_MODE_TX;
+        config.channel = channel;
+        config.gpio_num = (gpio_num_t)pin;
+        config.mem_block_num = 1;
+        config.clk_div = rmt_clock_divider;
+        config.tx_config.loop_en = false;
+        config.tx_config.carrier_en = false;
+        config.tx_config.idle_output_en = true;
+        config.tx_config.idle_level = RMT_IDLE_LEVEL_LOW;
+        rmt_config(&config);
+        rmt_set_source_clk(channel, RMT_BASECLK_REF); // Reference clock allows long durations and does not change with the CPU frequency.
+        rmt_driver_install(channel, 0, 0);
+    }
+
+    /// @brief Compiles a sequence of levels of equal duration into RMT items. Consecutive steps at the same level are merged and
+    /// durations longer than a single item field are split, so slow patterns take as little memory as fast ones.
+    /// @return Number of items written.
+    static uint8_t CompileSequence(const uint8_t* levels, size_t number_steps, uint32_t step_ms, rmt_item32_t* items) {
+        uint8_t number_items = 0;
+        bool is_first_half = true;
+        auto Append = [&](uint8_t level, uint32_t ticks) {
+            if (number_items == max_items) return;
+            if (is_first_half) {
+                items[number_items].level0 = level;
+                items[number_items].duration0 = ticks;
+                items[number_items].level1 = level;
+                items[number_items].duration1 = 0;
+            } else {
+                items[number_items].level1 = level;
+                items[number_items].duration1 = ticks;
+                number_items++;
+            }
+            is_first_half = !is_first_half;
+        };
+
+        size_t step = 0;
+        while (step < number_steps) {
+            uint8_t level = levels[step];
+            uint32_t ticks = 0;
+            while (step < number_steps && levels[step] == level) {
+                ticks += step_ms * rmt_ticks_per_ms;
+                step++;
+            }
+            while (ticks > rmt_max_ticks) {
+                Append(level, rmt_max_ticks);
+                ticks -= rmt_max_ticks;
+            }
+            Append(level, ticks);
+        }
+
+        // A zero duration in the second half marks the end of the sequence, so an odd half is padded with a short low level instead.
+        if (!is_first_half && number_items < max_items) {
+            items[number_items].level1 = 0;
+            items[number_items].duration1 = 1;
+            number_items++;
+        }
+        return number_items;
+    }
+
+    void Play(rmt_channel_t channel, const uint8_t* levels, size_t number_steps, uint32_t step_ms, bool loop) {
+        uint8_t number_items = CompileSequence(levels, number_steps, step_ms, items[channel]);
+        rmt_tx_stop(channel);
+        rmt_set_tx_loop_mode(channel, loop);
+        rmt_write_items(channel, items[channel], number_items, false);
+    }
+
+    static void Silence(rmt_channel_t channel) {
+        rmt_tx_stop(channel);
+        rmt_set_tx_loop_mode(channel, false);
+        rmt_set_idle_level(channel, true, RMT_IDLE_LEVEL_LOW);
+    }
+
+    void PlayBlinkRate() {
+        constexpr uint8_t blink_pattern[] = {1, 0};
+        if (led_pattern != blink_rate) {
+            led_pattern = blink_rate;
+            Play(led_channel, blink_pattern, sizeof(blink_pattern), blink_rate, true);
+        }
+        if (buzzer_pattern != blink_rate) {
+            buzzer_pattern = blink_rate;
+            if (blink_rate == BlinkRate::Fast) {
+                Play(buzzer_channel, fault_buzzer_pattern, sizeof(fault_buzzer_pattern), blink_rate, true);
+            } else {
+                Silence(buzzer_channel);
+            }
+        }
+    }
+
+    void PlayAlarm() {
+        if (led_pattern != BlinkRate::Alarm) {
+            led_pattern = BlinkRate::Alarm;
+            Play(led_channel, alarm_led_pattern, sizeof(alarm_led_pattern), alarm_step, true);
+        }
+        if (buzzer_pattern != BlinkRate::Alarm) {
+            buzzer_pattern = BlinkRate::Alarm;
+            Play(buzzer_channel, alarm_buzzer_pattern, sizeof(alarm_buzzer_pattern), alarm_step, true);
+        }
+    }
+
+    /// @brief Runs in the timer service task, either right after an event is posted or when an overlay has finished playing.
+    void ProcessEvents() {
+        BlinkRate event;
+        while (xQueueReceive(event_queue, &event, 0)) {
+            switch (event) {
+                case BlinkRate::Alarm:
+                    is_alarm_active = true;
+                    break;
+                case BlinkRate::AlarmCleared:
+                    is_alarm_active = false;
+                    break;
+                case BlinkRate::Pulse:
+                    if (is_alarm_active) break; // Pulses only report routine activity, so they are not played over an alarm.
+                    // Events still in the queue are processed when the timer expires at the end of the overlay.
+                    led_pattern = BlinkRate::Pulse;
+                    Play(led_channel, pulse_pattern, sizeof(pulse_pattern), pulse_step, false);
+                    xTimerChangePeriod(timer, pdMS_TO_TICKS(sizeof(pulse_pattern) * pulse_step), 0);
+                    return;
+                default:
+                    blink_rate = event;
+                    break;
+            }
+        }
+        // The queue is empty, so either the last overlay has ended or only the rate changed. In both cases the looping pattern is put back.
+        if (is_alarm_active) {
+            PlayAlarm();
+        } else {
+            PlayBlinkRate();
+        }
+    }
+};
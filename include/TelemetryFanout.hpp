@@ -0,0 +1,109 @@
+#pragma once
+#include <cstdint>
+
+// Independent paths from the boat to the shore. Values are sent in the PATH_REPORT message.
+enum TelemetryPath : uint8_t {
+    LoraPath, // MAVLink over the serial port to the LoRa board.
+    IpPath, // MAVLink over UDP, through the 4G router.
+    NumberTelemetryPaths
+};
+
+enum FanoutPolicy : uint8_t {
+    AllPaths, // Every sample goes out on every path that is available, for the data that must survive a dead zone of either link.
+    BestPath, // Only on the healthiest path, for bulky or low value data.
+    LoraPathOnly, // For data condensed to fit the LoRa link, which the IP path carries in full in another stream.
+    IpPathOnly // For data sent at a rate only the IP path can carry.
+};
+
+/// @brief Chooses the paths each telemetry frame is sent on, from the health of each path.
+/// A path is available when its transport is ready, and healthy when a report on it arrived recently. Loss comes from the reports of the ground,
+/// which counts the gaps in the stream sequence numbers each path delivers. The link reports of the LoRa board count the frames it received from
+/// the ground, the other direction, so they are kept out of it. Latency is half the
+/// round trip of the TIME_SYNC messages the ground echoes over IP; for LoRa, the IP half of the trip is taken out.
+/// The best path is the healthy one with clearly lower loss or, at similar loss, clearly lower latency. It only changes when the other path is
+/// better by a margin, so the traffic does not swing between paths on noise. While no path is known to be healthy, every frame goes out on
+/// every available path, so nothing is lost to a wrong guess.
+/// Portable C++ with no allocation and no locking, with the time passed in.
+class TelemetryFanout {
+public:
+    struct Health {
+        bool is_available;
+        bool has_report;
+        float loss; // Fraction of samples.
+        float latency; // ms, one way.
+        uint32_t last_report; // ms
+    };
+
+    TelemetryFanout() {
+        for (uint8_t i = 0; i < NumberTelemetryPaths; i++) paths[i] = {};
+        paths[LoraPath].is_available = true;
+    }
+
+    void SetAvailable(TelemetryPath path, bool is_available) { paths[path].is_available = is_available; }
+
+    void OnLoss(TelemetryPath path, float loss, uint32_t now) {
+        Health& health = paths[path];
+        health.loss = health.has_report ? health.loss + 0.3f * (loss - health.loss) : loss;
+        health.has_report = true;
+        health.last_report = now;
+    }
+
+    void OnLatency(TelemetryPath path, float latency, uint32_t now) {
+        Health& health = paths[path];
+        health.latency = health.latency > 0.0f ? health.latency + 0.3f * (latency - health.latency) : latency;
+        health.last_report = now;
+    }
+
+    /// @return Bit i set when the frame must go out on path i.
+    uint8_t Select(FanoutPolicy policy, uint32_t now) {
+        uint8_t available = 0;
+        for (uint8_t i = 0; i < NumberTelemetryPaths; i++) {
+            if (paths[i].is_available) available |= 1 << i;
+        }
+        if (policy == AllPaths) return available;
+        if (policy == LoraPathOnly) return available & (1 << LoraPath);
+        if (policy == IpPathOnly) return available & (1 << IpPath);
+        int8_t best = UpdateBest(now);
+        return best < 0 ? available : (1 << best);
+    }
+
+    /// @return Healthy path the best path policy uses, or -1 while no path is known to be healthy.
+    int8_t GetBest(uint32_t now) { return UpdateBest(now); }
+
+    bool IsHealthy(TelemetryPath path, uint32_t now) const {
+        const Health& health = paths[path];
+        return health.is_available && health.has_report && now - health.last_report < report_timeout;
+    }
+
+    const Health& GetHealth(TelemetryPath path) const { return paths[path]; }
+
+    static const char* GetName(TelemetryPath path) {
+        static constexpr const char* names[NumberTelemetryPaths] = { "lora", "ip" };
+        return path < NumberTelemetryPaths ? names[path] : "none";
+    }
+
+private:
+    static constexpr uint32_t report_timeout = 15000; // ms without reports after which a path is no longer trusted.
+    static constexpr float loss_margin = 0.05f; // Loss lower by this much makes a path better.
+    static constexpr float latency_ratio = 0.7f; // At similar loss, latency lower than this fraction makes a path better.
+
+    Health paths[NumberTelemetryPaths];
+    int8_t best = -1;
+
+    bool IsBetter(uint8_t candidate, uint8_t current) const {
+        const Health& a = paths[candidate];
+        const Health& b = paths[current];
+        if (a.loss < b.loss - loss_margin) return true;
+        if (a.loss > b.loss + loss_margin) return false;
+        return a.latency > 0.0f && b.latency > 0.0f && a.latency < latency_ratio * b.latency;
+    }
+
+    int8_t UpdateBest(uint32_t now) {
+        if (best >= 0 && !IsHealthy((TelemetryPath)best, now)) best = -1;
+        for (uint8_t i = 0; i < NumberTelemetryPaths; i++) {
+            if (i == best || !IsHealthy((TelemetryPath)i, now)) continue;
+            if (best < 0 || IsBetter(i, best)) best = i;
+        }
+        return best;
+    }
+};
@@ -0,0 +1,139 @@
+#pragma once
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "arariboat\mavlink.h"
+#include "arariboat\SystemData.hpp"
+#include "TelemetryStreams.hpp"
+
+/// @brief The one description of the telemetry of each subsystem, from which its MAVLink message, its JSON route and its card on the HTML page
+/// are produced, so they cannot disagree. The frames of the race log are the MAVLink messages, so they follow as well.
+/// A field is named once, by its member in the MAVLink message, which is also its member in SystemData and its key in the JSON. Adding a
+/// sensor whose field is in the dialect is one line in the list of its subsystem.
+/// The lists expand into constant tables of field descriptors, with the offset and type of each field, and serializing a subsystem is a loop
+/// over its table, with no string built per field.
+
+// Fields of each subsystem: X(member, label on the HTML page, decimals on the HTML page).
+#define CONTROL_SYSTEM_FIELDS(X) \
+    X(dac_output, "DAC Output", 2) \
+    X(potentiometer_signal, "Potentiometer Signal", 2)
+
+#define INSTRUMENTATION_SYSTEM_FIELDS(X) \
+    X(battery_voltage, "Battery Voltage", 2) \
+    X(motor_current, "Motor Current", 2) \
+    X(battery_current, "Battery Current", 2) \
+    X(mppt_current, "MPPT Current", 2)
+
+#define GPS_SYSTEM_FIELDS(X) \
+    X(latitude, "Latitude", 6) \
+    X(longitude, "Longitude", 6) \
+    X(speed, "Speed", 2) \
+    X(course, "Course", 2) \
+    X(satellites_visible, "Satellites", 0)
+
+#define AUXILIARY_SYSTEM_FIELDS(X) \
+    X(pumps, "Pump Mask", 0) \
+    X(current, "Auxiliary Current", 2) \
+    X(voltage, "Auxiliary Voltage", 2)
+
+#define TEMPERATURE_SYSTEM_FIELDS(X) \
+    X(temperature_motor, "Motor Temperature", 2) \
+    X(temperature_battery, "Battery Temperature", 2) \
+    X(temperature_mppt, "MPPT Temperature", 2)
+
+// Subsystems, in the order of the HTML page: X(name, MAVLink message, member of SystemData, encoder of the message, stream, route, title, fields).
+#define TELEMETRY_SUBSYSTEMS(X) \
+    X(Control, mavlink_control_system_t, controlSystem, mavlink_msg_control_system_encode_chan, ControlStream, "/control-system", "Control System Data", CONTROL_SYSTEM_FIELDS) \
+    X(Instrumentation, mavlink_instrumentation_t, instrumentationSystem, mavlink_msg_instrumentation_encode_chan, InstrumentationStream, "/instrumentation-system", "Instrumentation System Data", INSTRUMENTATION_SYSTEM_FIELDS) \
+    X(Gps, mavlink_gps_info_t, gpsSystem, mavlink_msg_gps_info_encode_chan, GpsStream, "/gps-system", "GPS System Data", GPS_SYSTEM_FIELDS) \
+    X(Auxiliary, mavlink_aux_system_t, auxiliarySystem, mavlink_msg_aux_system_encode_chan, AuxiliaryStream, "/auxiliary-system", "Auxiliary System Data", AUXILIARY_SYSTEM_FIELDS) \
+    X(Temperature, mavlink_temperatures_t, temperatureSystem, mavlink_msg_temperatures_encode_chan, TemperatureStream, "/temperature-system", "Temperature System Data", TEMPERATURE_SYSTEM_FIELDS)
+
+enum TelemetryFieldType : uint8_t {
+    FloatField,
+    Uint8Field
+};
+
+template <typename T> struct TelemetryFieldTypeOf;
+template <> struct TelemetryFieldTypeOf<float> { static constexpr TelemetryFieldType value = FloatField; };
+template <> struct TelemetryFieldTypeOf<uint8_t> { static constexpr TelemetryFieldType value = Uint8Field; };
+
+struct TelemetryField {
+    const char* name;
+    const char* label;
+    uint16_t offset; // In the MAVLink message.
+    TelemetryFieldType type;
+    uint8_t decimals;
+};
+
+struct TelemetrySubsystem {
+    const char* route;
+    const char* title;
+    TelemetryStream stream;
+    const TelemetryField* fields;
+    uint8_t number_fields;
+    const void* (*get_data)(); // The message in SystemData.
+    uint16_t (*encode)(mavlink_message_t* message, const void* data);
+};
+
+enum TelemetrySubsystemId : uint8_t {
+#define TELEMETRY_SUBSYSTEM_ID(name, type, member, encoder, stream, route, title, fields) name##Subsystem,
+    TELEMETRY_SUBSYSTEMS(TELEMETRY_SUBSYSTEM_ID)
+#undef TELEMETRY_SUBSYSTEM_ID
+    NumberTelemetrySubsystems
+};
+
+#define TELEMETRY_FIELD(member, label, decimals) \
+    { #member, label, offsetof(Message, member), TelemetryFieldTypeOf<decltype(Message::member)>::value, decimals },
+#define TELEMETRY_FIELD_TABLE(name, type, member, encoder, stream, route, title, fields) \
+    struct name##TelemetryFields { \
+        using Message = type; \
+        static constexpr TelemetryField table[] = { fields(TELEMETRY_FIELD) }; \
+    };
+TELEMETRY_SUBSYSTEMS(TELEMETRY_FIELD_TABLE)
+#undef TELEMETRY_FIELD_TABLE
+#undef TELEMETRY_FIELD
+
+#define TELEMETRY_SUBSYSTEM(name, type, member, encoder, stream, route, title, fields) \
+    { route, title, stream, name##TelemetryFields::table, sizeof(name##TelemetryFields::table) / sizeof(TelemetryField), \
+      []() -> const void* { return &systemData.member; }, \
+      [](mavlink_message_t* message, const void* data) -> uint16_t { \
+          return encoder(1, MAV_COMP_ID_ONBOARD_COMPUTER, MAVLINK_COMM_0, message, static_cast<const type*>(data)); \
+      } },
+inline constexpr TelemetrySubsystem telemetry_subsystems[NumberTelemetrySubsystems] = {
+    TELEMETRY_SUBSYSTEMS(TELEMETRY_SUBSYSTEM)
+};
+#undef TELEMETRY_SUBSYSTEM
+
+inline float GetTelemetryField(const TelemetryField& field, const void* data) {
+    const uint8_t* address = static_cast<const uint8_t*>(data) + field.offset;
+    if (field.type == Uint8Field) return *address;
+    float value;
+    memcpy(&value, address, sizeof(value));
+    return value;
+}
+
+/// @brief Encodes the current values of a subsystem, as kept in SystemData, into its MAVLink message.
+inline uint16_t EncodeTelemetrySubsystem(const TelemetrySubsystem& subsystem, mavlink_message_t* message) {
+    return subsystem.encode(message, subsystem.get_data());
+}
+
+/// @brief Adds every field of a subsystem to a JSON document, keyed by its name, which the document keeps as a pointer.
+inline void WriteTelemetryJson(const TelemetrySubsystem& subsystem, JsonDocument& doc) {
+    const void* data = subsystem.get_data();
+    for (uint8_t i = 0; i < subsystem.number_fields; i++) {
+        const TelemetryField& field = subsystem.fields[i];
+        if (field.type == Uint8Field) doc[field.name] = (uint8_t)GetTelemetryField(field, data);
+        else doc[field.name] = GetTelemetryField(field, data);
+    }
+}
+
+/// @brief Prints a subsystem as a card of the HTML page.
+inline void PrintTelemetryCard(const TelemetrySubsystem& subsystem, Print& out, const char* card_class) {
+    const void* data = subsystem.get_data();
+    out.printf("<div class='card %s'><h2>%s</h2>", card_class, subsystem.title);
+    for (uint8_t i = 0; i < subsystem.number_fields; i++) {
+        const TelemetryField& field = subsystem.fields[i];
+        out.printf("<p>%s: %.*f</p>", field.label, field.decimals, GetTelemetryField(field, data));
+    }
+    out.print("</div>");
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <Arduino.h>
+
+// Kinds of telemetry, each numbered on its own so the ground can count what it missed of each one, whichever path it came through.
+// Values are sent in the STREAM_STAMPS message, so new streams must be appended at the end.
+enum TelemetryStream : uint8_t {
+    InstrumentationStream,
+    TemperatureStream,
+    GpsStream,
+    ControlStream,
+    AuxiliaryStream,
+    PumpStream,
+    SpectrumStream,
+    CaptureStream,
+    CalibrationStream,
+    InstrumentationSummaryStream, // Minimum, mean, maximum and last instrumentation reading of each window, for LoRa.
+    NumberTelemetryStreams,
+    UnstampedStream = 0xFF // Alarms, commands and link control, which are not telemetry.
+};
+
+/// @brief Sequence numbers and sample times of each telemetry stream, and the number of frames seen at each hop on the way out.
+/// A stream is published once per sample, which gives it its next sequence number. The same number is then carried by the MAVLink frame
+/// and by the HTTP responses that show the sample, so the ground can match both paths and count the samples each one lost.
+/// The hops are counted per stream: encoded, queued for the serial port or dropped because the queue was full, written to the LoRa board,
+/// served over HTTP, and sent to the ground over UDP or dropped on the way. The difference between two successive hops is where frames are lost.
+class TelemetryStreams {
+public:
+    enum Hop : uint8_t {
+        Encoded,
+        Queued,
+        QueueDropped,
+        Transmitted, // Written to the LoRa board.
+        ServedIp, // Shown in an HTTP response.
+        IpSent, // Sent to the ground over UDP.
+        IpDropped, // Meant for the ground over UDP, but the queue was full or the network was down.
+        NumberHops
+    };
+
+    struct Latest {
+        uint16_t seq; // Sequence number of the latest sample, which is the number of samples published minus one.
+        uint32_t sample_time; // ms since boot.
+        bool is_valid;
+    };
+
+    /// @brief Gives a new sample of a stream its sequence number.
+    /// @param sample_time Time the values were sampled, in ms since boot.
+    uint16_t Publish(TelemetryStream stream, uint32_t sample_time) {
+        if (stream >= NumberTelemetryStreams) return 0;
+        portENTER_CRITICAL(&mutex);
+        Latest& latest = latests[stream];
+        latest.seq = latest.is_valid ? latest.seq + 1 : 0;
+        latest.sample_time = sample_time;
+        latest.is_valid = true;
+        counters[stream][Encoded]++;
+        uint16_t seq = latest.seq;
+        portEXIT_CRITICAL(&mutex);
+        return seq;
+    }
+
+    void Count(TelemetryStream stream, Hop hop) {
+        if (stream >= NumberTelemetryStreams) return;
+        portENTER_CRITICAL(&mutex);
+        counters[stream][hop]++;
+        portEXIT_CRITICAL(&mutex);
+    }
+
+    Latest GetLatest(TelemetryStream stream) {
+        portENTER_CRITICAL(&mutex);
+        Latest latest = latests[stream];
+        portEXIT_CRITICAL(&mutex);
+        return latest;
+    }
+
+    uint32_t GetCount(TelemetryStream stream, Hop hop) const { return counters[stream][hop]; }
+
+    static const char* GetName(TelemetryStream stream) {
+        static constexpr const char* names[NumberTelemetryStreams] = {
+            "instrumentation", "temperature", "gps", "control", "auxiliary", "pumps", "spectrum", "capture", "calibration", "instrumentation_summary"
+        };
+        return stream < NumberTelemetryStreams ? names[stream] : "unstamped";
+    }
+
+    static const char* GetHopName(Hop hop) {
+        static constexpr const char* names[NumberHops] = { "encoded", "queued", "queue_dropped", "transmitted", "served_ip", "ip_sent", "ip_dropped" };
+        return names[hop];
+    }
+
+private:
+    Latest latests[NumberTelemetryStreams] = {};
+    uint32_t counters[NumberTelemetryStreams][NumberHops] = {};
+    portMUX_TYPE mutex = portMUX_INITIALIZER_UNLOCKED;
+};
@@ -0,0 +1,179 @@
+#pragma once
+#include <Arduino.h>
+#include <Preferences.h>
+#include "rom/gpio.h" // GPIO matrix routines in ROM, callable from interrupts.
+#include "soc/gpio_struct.h"
+
+// Comment out to go back to the 8-bit DAC, for boards that do not have the RC filter fitted at the throttle output.
+#define THROTTLE_OUTPUT_LEDC
+
+/// @brief Analog throttle signal sent to the motor controller, through the 0-5V amplifier on the control board.
+/// The LEDC backend generates a 12-bit PWM signal at 19.5kHz, which the RC filter (10k/1uF, 16Hz cutoff) turns into a DC level
+/// with about 16 times the resolution of the built-in 8-bit DAC. The hardware timer keeps the signal going without any CPU involvement.
+/// A calibration table maps the PWM duty cycle to the voltage measured at the motor controller input, which corrects the gain and offset
+/// of the amplifier as well as any non-linearity. Commands are normalized between 0.0 and 1.0 of the maximum controller input voltage.
+/// One task owns the output and makes every call but Trip(), which the over-current interrupt may make at any time.
+class ThrottleOutput {
+public:
+    static constexpr uint8_t number_calibration_points = 9; // Evenly spaced duty cycles from 0% to 100%.
+    static constexpr float max_pin_voltage = 3300.0f; // mV
+    static constexpr float max_amplified_voltage = 5000.0f; // mV
+
+    explicit ThrottleOutput(uint8_t pin) : pin(pin) {
+        // Default table assumes an ideal amplifier until the output is calibrated with a multimeter.
+        for (uint8_t i = 0; i < number_calibration_points; i++) {
+            calibration_table[i] = max_amplified_voltage * i / (number_calibration_points - 1);
+        }
+    }
+
+    void Begin() {
+        #ifdef THROTTLE_OUTPUT_LEDC
+        ledcSetup(ledc_channel, ledc_frequency, ledc_resolution_bits);
+        ledcAttachPin(pin, ledc_channel);
+        #endif
+        LoadCalibration();
+        Write(0.0f);
+    }
+
+    /// @brief Sets the throttle signal.
+    /// @param command Normalized command, where 1.0 corresponds to the maximum controller input voltage.
+    void Write(float command) {
+        if (is_holding || is_tripped) return;
+        command = constrain(command, 0.0f, 1.0f);
+        uint32_t duty = CommandToDuty(command);
+        if (duty == current_duty && !is_write_forced) return;
+        WriteDuty(duty);
+    }
+
+    /// @brief Sets the ceiling of the current limiter, which also caps the duty cycle held for calibration.
+    /// @param limiter_ceiling Normalized command above which the current limiter pulls the output down.
+    void SetCeiling(float limiter_ceiling) {
+        ceiling = constrain(limiter_ceiling, 0.0f, 1.0f);
+        if (is_holding && !is_tripped) WriteHeldDuty();
+    }
+
+    /// @brief Cuts the throttle signal at once. Safe to call from an interrupt, so the over-current protection can act without waiting for a task.
+    /// Commands are ignored until ResetTrip() is called.
+    void IRAM_ATTR Trip() {
+        is_tripped = true;
+        #ifdef THROTTLE_OUTPUT_LEDC
+        // ledcWrite() takes a mutex, so instead the pin is taken away from the LEDC peripheral and driven low through the GPIO matrix.
+        gpio_matrix_out(pin, SIG_GPIO_OUT_IDX, false, false);
+        if (pin < 32) {
+            GPIO.out_w1tc = 1UL << pin;
+        } else {
+            GPIO.out1_w1tc.val = 1UL << (pin - 32);
+        }
+        #else
+        dacWrite(pin, 0);
+        #endif
+    }
+
+    /// @brief Returns the output to the throttle commands after a trip, starting from zero.
+    void ResetTrip() {
+        if (!is_tripped) return;
+        #ifdef THROTTLE_OUTPUT_LEDC
+        ledcWrite(ledc_channel, 0);
+        ledcAttachPin(pin, ledc_channel);
+        #endif
+        current_duty = 0;
+        is_write_forced = true; // The pin is driven low, whatever duty was written last.
+        is_tripped = false;
+    }
+
+    bool IsTripped() const { return is_tripped; }
+    bool IsHolding() const { return is_holding; }
+
+    /// @brief Records the voltage measured at the motor controller input for one of the calibration points and saves the table.
+    /// @param point Index of the calibration point, which corresponds to a duty cycle of point / (number_calibration_points - 1).
+    /// @param measured_voltage Voltage in mV measured with a multimeter while the output is held at that duty cycle.
+    /// @return False if the index is out of range.
+    bool SetCalibrationPoint(uint8_t point, float measured_voltage) {
+        if (point >= number_calibration_points) return false;
+        calibration_table[point] = measured_voltage;
+        Preferences preferences;
+        preferences.begin("throttle", false);
+        preferences.putBytes("table", calibration_table, sizeof(calibration_table));
+        preferences.end();
+        return true;
+    }
+
+    /// @brief Holds the output at the raw duty cycle of a calibration point, so its voltage can be measured. Commands are ignored until Release() is called.
+    /// The boat must be out of the water or the motor disconnected while calibrating, since the encoder no longer controls the output.
+    /// The held duty cycle stays under the ceiling of the current limiter, and a trip still cuts it.
+    void HoldCalibrationPoint(uint8_t point) {
+        if (point >= number_calibration_points) return;
+        held_duty = max_duty * point / (number_calibration_points - 1);
+        is_holding = true;
+        if (!is_tripped) WriteHeldDuty();
+    }
+
+    /// @brief Returns control of the output to the throttle commands. The held duty cycle stays on the pin until the next command.
+    void Release() {
+        is_holding = false;
+        is_write_forced = true;
+    }
+
+    float GetCalibrationPoint(uint8_t point) const { return point < number_calibration_points ? calibration_table[point] : 0.0f; }
+    uint32_t GetDuty() const { return current_duty; }
+    uint32_t GetMaxDuty() const { return max_duty; }
+    float GetPinVoltage() const { return max_pin_voltage * current_duty / max_duty; } // mV
+
+private:
+    #ifdef THROTTLE_OUTPUT_LEDC
+    static constexpr uint8_t ledc_channel = 0;
+    static constexpr uint8_t ledc_resolution_bits = 12;
+    static constexpr uint32_t ledc_frequency = 19531; // 80MHz APB clock / 2^12 is the highest frequency available at 12 bits.
+    static constexpr uint32_t max_duty = (1 << ledc_resolution_bits) - 1;
+    #else
+    static constexpr uint32_t max_duty = 255; // 8-bit DAC
+    #endif
+
+    uint8_t pin;
+    uint32_t current_duty = 0;
+    uint32_t held_duty = 0;
+    float ceiling = 1.0f; // Of the current limiter.
+    bool is_write_forced = true; // Until the first command is written.
+    volatile bool is_holding = false;
+    volatile bool is_tripped = false;
+    float calibration_table[number_calibration_points];
+
+    void WriteDuty(uint32_t duty) {
+        current_duty = duty;
+        is_write_forced = false;
+        #ifdef THROTTLE_OUTPUT_LEDC
+        ledcWrite(ledc_channel, duty);
+        #else
+        dacWrite(pin, duty);
+        #endif
+    }
+
+    void WriteHeldDuty() {
+        uint32_t duty = std::min(held_duty, CommandToDuty(ceiling));
+        if (duty != current_duty || is_write_forced) WriteDuty(duty);
+    }
+
+    void LoadCalibration() {
+        Preferences preferences;
+        preferences.begin("throttle", true);
+        if (preferences.getBytesLength("table") == sizeof(calibration_table)) {
+            preferences.getBytes("table", calibration_table, sizeof(calibration_table));
+        }
+        preferences.end();
+    }
+
+    /// @brief Finds the duty cycle that produces the commanded voltage by linear interpolation between the calibration points.
+    /// The table is expected to increase monotonically. Commands beyond the last point saturate at full duty.
+    uint32_t CommandToDuty(float command) const {
+        float target_voltage = command * max_amplified_voltage;
+        if (target_voltage <= calibration_table[0]) return 0;
+        for (uint8_t i = 1; i < number_calibration_points; i++) {
+            if (target_voltage <= calibration_table[i]) {
+                float segment = (target_voltage - calibration_table[i - 1]) / (calibration_table[i] - calibration_table[i - 1]);
+                float duty_fraction = (i - 1 + segment) / (number_calibration_points - 1);
+                return (uint32_t)(duty_fraction * max_duty + 0.5f);
+            }
+        }
+        return max_duty;
+    }
+};
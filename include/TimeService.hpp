@@ -0,0 +1,111 @@
+#pragma once
+#include <cstdint>
+
+/// @brief UTC clock built on the microsecond timer of the board, disciplined to the best time source available.
+/// The clock keeps a base, the UTC at a local time, and the drift of the local oscillator, so UTC is extrapolated between measurements.
+/// Each measurement of UTC is compared with the extrapolation, and the difference corrects the base by a fraction and the drift by a smaller one,
+/// which is a phase locked loop of the second order: noise is averaged out while a constant drift is cancelled. A difference too large
+/// to be noise, such as the first measurement or a new source that disagrees, steps the clock instead.
+/// Sources are ranked: the PPS pulse of the GPS, paired with the second the NMEA sentences name, is good to a few microseconds; the NMEA
+/// sentences alone to tens of milliseconds, since they leave the receiver some time after the second they describe; and SNTP over WiFi
+/// to a few milliseconds. A source is only used while every better one is silent.
+/// Portable C++ with no allocation and no locking, with the local time passed in.
+class TimeService {
+public:
+    enum Source : uint8_t {
+        NoSource,
+        SntpSource,
+        NmeaSource,
+        PpsSource,
+        NumberSources
+    };
+
+    /// @brief Feeds a measurement of UTC.
+    /// @param local_us Local time at which UTC was utc_us, in us since boot.
+    /// @param utc_us UTC in us since the Unix epoch.
+    /// @return False if the measurement was ignored because a better source is active.
+    bool Discipline(int64_t local_us, int64_t utc_us, Source source) {
+        if (source == NoSource || source >= NumberSources) return false;
+        if (this->source != NoSource && source < this->source && local_us - last_update < source_timeout) return false;
+        if (source != this->source) has_previous = false; // The drift is only estimated between measurements of one source.
+
+        int64_t error = has_sync ? utc_us - ToUtc(local_us) : 0;
+        if (!has_sync || error > step_threshold || error < -step_threshold) {
+            base_local = local_us;
+            base_utc = utc_us;
+            steps++;
+            has_sync = true;
+            has_previous = false;
+        } else {
+            const Gains& gains = source_gains[source];
+            if (has_previous && local_us > last_update) {
+                drift += gains.frequency * (double)error / (double)(local_us - last_update);
+                if (drift > max_drift) drift = max_drift;
+                if (drift < -max_drift) drift = -max_drift;
+            }
+            base_utc = ToUtc(local_us) + (int64_t)(gains.phase * error);
+            base_local = local_us;
+            jitter += ((error < 0 ? -error : error) - jitter) / 8;
+        }
+        offset = error;
+        last_update = local_us;
+        has_previous = true;
+        this->source = source;
+        return true;
+    }
+
+    /// @return UTC in us since the Unix epoch at a local time, or 0 before the first measurement.
+    int64_t ToUtc(int64_t local_us) const {
+        if (!has_sync) return 0;
+        int64_t elapsed = local_us - base_local;
+        return base_utc + elapsed + (int64_t)(elapsed * drift);
+    }
+
+    bool IsSynchronized() const { return has_sync; }
+    Source GetSource() const { return source; }
+    int64_t GetOffset() const { return offset; } // us. UTC minus the clock at the last measurement, before the correction.
+    float GetDrift() const { return (float)(drift * 1e6); } // ppm. Positive when the local oscillator runs slow.
+    int64_t GetJitter() const { return jitter; } // us. Average size of the corrections.
+    int64_t GetLastUpdate() const { return last_update; } // Local time of the last measurement used, in us since boot.
+    uint32_t GetSteps() const { return steps; }
+
+    static const char* GetSourceName(Source source) {
+        static constexpr const char* names[NumberSources] = { "none", "sntp", "nmea", "pps" };
+        return source < NumberSources ? names[source] : "none";
+    }
+
+    /// @brief Converts a UTC date and time, as given by the GPS, to us since the Unix epoch.
+    static int64_t UnixMicros(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second, uint32_t microsecond = 0) {
+        // Days since the epoch of a proleptic Gregorian date, with the year starting in March so the leap day comes last.
+        int32_t y = (int32_t)year - (month <= 2 ? 1 : 0);
+        int32_t era = (y >= 0 ? y : y - 399) / 400;
+        int32_t year_of_era = y - era * 400;
+        int32_t day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+        int32_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+        int64_t days = (int64_t)era * 146097 + day_of_era - 719468;
+        return ((days * 86400 + hour * 3600 + minute * 60 + second) * 1000000LL) + microsecond;
+    }
+
+private:
+    struct Gains {
+        double phase; // Fraction of the error removed from the base at each measurement.
+        double frequency; // Fraction of the error over the interval added to the drift.
+    };
+    // The noisier the source, the more measurements are averaged. SNTP is read from the system clock, which is itself stepped by the
+    // SNTP client, so it says nothing about the drift.
+    static constexpr Gains source_gains[NumberSources] = { { 0.0, 0.0 }, { 0.5, 0.0 }, { 0.1, 0.01 }, { 0.5, 0.1 } };
+    static constexpr int64_t step_threshold = 200000; // us
+    static constexpr int64_t source_timeout = 5000000; // us without measurements after which a worse source is used.
+    static constexpr double max_drift = 500e-6; // Well beyond any crystal, to bound the effect of a bad measurement.
+
+    bool has_sync = false;
+    bool has_previous = false;
+    Source source = NoSource;
+    int64_t base_local = 0;
+    int64_t base_utc = 0;
+    double drift = 0.0; // Fraction by which the local clock runs slow.
+    int64_t offset = 0;
+    int64_t jitter = 0;
+    int64_t last_update = 0;
+    uint32_t steps = 0;
+};
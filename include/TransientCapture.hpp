@@ -0,0 +1,179 @@
+#pragma once
+#include <Arduino.h>
+
+/// @brief Oscilloscope-style capture of the motor and battery currents around a trigger event.
+/// Every high-rate sample goes into a circular pre-trigger buffer. When the trigger condition is met, sampling continues until the post-trigger
+/// window is complete and the window around the event is then copied into one of the capture slots, where it stays until it is overwritten
+/// by a newer capture. Only the captures leave the board, so the drivetrain can be watched at full rate without streaming every sample.
+/// Add() is called by a single producer, the instrumentation reader. Slots are read by the server task and locked while a download is in progress.
+class TransientCapture {
+public:
+    static constexpr uint8_t number_channels = 2; // Motor current and battery current.
+    static constexpr uint16_t buffer_length = 512; // Samples kept in the circular buffer, which bounds the pre plus post trigger window.
+    static constexpr uint8_t number_slots = 2;
+
+    enum TriggerType : uint8_t {
+        Threshold, // Fires when the channel rises above the level.
+        Slope // Fires when the channel changes by more than the level, in amperes per millisecond, between two samples.
+    };
+
+    enum CaptureState : uint8_t {
+        Disarmed,
+        Armed,
+        Triggered
+    };
+
+    struct TriggerConfig {
+        uint8_t channel;
+        uint8_t type; // TriggerType
+        float level;
+        uint16_t pre_trigger; // ms kept before the event.
+        uint16_t post_trigger; // ms kept after the event.
+        bool is_auto_rearm; // Arms again after each capture, otherwise a single capture is taken.
+    };
+
+    // Values are stored in units of 10mA to halve the memory used, which still covers +/-327A.
+    struct Sample {
+        uint32_t timestamp; // us
+        int16_t values[number_channels];
+    };
+
+    struct Slot {
+        bool is_valid;
+        volatile bool is_locked; // Set while the slot is being downloaded, so a new capture does not overwrite it.
+        uint32_t trigger_timestamp; // us
+        uint16_t trigger_index; // Index of the sample that met the trigger condition.
+        uint16_t number_samples;
+        TriggerConfig config;
+        Sample samples[buffer_length];
+    };
+
+    void Arm(const TriggerConfig& trigger_config) {
+        config = trigger_config;
+        pre_trigger_samples = 0;
+        state = CaptureState::Armed;
+    }
+
+    void Disarm() { state = CaptureState::Disarmed; }
+
+    /// @brief Adds a sample to the circular buffer and evaluates the trigger.
+    /// @param values Currents in amperes, in the order of the channels.
+    /// @param timestamp Time of the sample in microseconds.
+    void Add(const float (&values)[number_channels], uint32_t timestamp) {
+        Sample& sample = buffer[head];
+        sample.timestamp = timestamp;
+        for (uint8_t i = 0; i < number_channels; i++) {
+            sample.values[i] = constrain(values[i] * 100.0f, (float)INT16_MIN, (float)INT16_MAX);
+        }
+        uint16_t index = head;
+        head = (head + 1) % buffer_length;
+        if (count < buffer_length) count++;
+
+        switch (state) {
+            case CaptureState::Armed:
+                if (IsTriggered(index)) {
+                    trigger_index = index;
+                    // Count how many buffered samples fall inside the pre-trigger window. The rest of the buffer is left for the post-trigger samples.
+                    uint32_t pre_trigger_us = (uint32_t)config.pre_trigger * 1000;
+                    pre_trigger_samples = 0;
+                    while (pre_trigger_samples + 1 < count && pre_trigger_samples < buffer_length / 2) {
+                        const Sample& previous = buffer[(index + buffer_length - pre_trigger_samples - 1) % buffer_length];
+                        if (timestamp - previous.timestamp > pre_trigger_us) break;
+                        pre_trigger_samples++;
+                    }
+                    post_trigger_samples = 0;
+                    state = CaptureState::Triggered;
+                }
+                break;
+            case CaptureState::Triggered:
+                post_trigger_samples++;
+                if (timestamp - buffer[trigger_index].timestamp >= (uint32_t)config.post_trigger * 1000 ||
+                    pre_trigger_samples + 1 + post_trigger_samples == buffer_length) {
+                    Store();
+                    state = config.is_auto_rearm ? CaptureState::Armed : CaptureState::Disarmed;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    /// @brief Locks a slot for reading. The caller must call Unlock() once done.
+    /// @return The slot, or nullptr if the index is out of range, the slot holds no capture or it is already being read.
+    const Slot* Lock(uint8_t index) {
+        if (index >= number_slots) return nullptr;
+        portENTER_CRITICAL(&slot_mutex);
+        bool is_available = slots[index].is_valid && !slots[index].is_locked;
+        if (is_available) slots[index].is_locked = true;
+        portEXIT_CRITICAL(&slot_mutex);
+        return is_available ? &slots[index] : nullptr;
+    }
+
+    void Unlock(uint8_t index) {
+        if (index < number_slots) slots[index].is_locked = false;
+    }
+
+    const Slot& GetSlot(uint8_t index) const { return slots[index]; }
+    CaptureState GetState() const { return state; }
+    const TriggerConfig& GetConfig() const { return config; }
+    uint32_t GetNumberCaptures() const { return number_captures; }
+    uint32_t GetDroppedCaptures() const { return dropped_captures; }
+
+private:
+    Sample buffer[buffer_length];
+    uint16_t head = 0;
+    uint16_t count = 0;
+    volatile CaptureState state = CaptureState::Disarmed;
+    TriggerConfig config = {};
+    uint16_t trigger_index = 0;
+    uint16_t pre_trigger_samples = 0;
+    uint16_t post_trigger_samples = 0;
+    uint8_t next_slot = 0;
+    uint32_t number_captures = 0;
+    uint32_t dropped_captures = 0;
+    Slot slots[number_slots] = {};
+    portMUX_TYPE slot_mutex = portMUX_INITIALIZER_UNLOCKED;
+
+    bool IsTriggered(uint16_t index) const {
+        float value = buffer[index].values[config.channel] / 100.0f;
+        if (config.type == TriggerType::Threshold) {
+            return value > config.level;
+        }
+        if (count < 2) return false;
+        const Sample& previous = buffer[(index + buffer_length - 1) % buffer_length];
+        float elapsed_ms = (buffer[index].timestamp - previous.timestamp) / 1000.0f;
+        if (elapsed_ms <= 0.0f) return false;
+        float slope = (value - previous.values[config.channel] / 100.0f) / elapsed_ms;
+        return fabsf(slope) > config.level;
+    }
+
+    /// @brief Copies the window around the trigger into the next unlocked slot, oldest first.
+    void Store() {
+        Slot* slot = nullptr;
+        portENTER_CRITICAL(&slot_mutex);
+        for (uint8_t i = 0; i < number_slots && !slot; i++) {
+            uint8_t candidate = (next_slot + i) % number_slots;
+            if (!slots[candidate].is_locked) {
+                slot = &slots[candidate];
+                slot->is_valid = false; // Readers cannot lock the slot while it is being filled.
+                next_slot = (candidate + 1) % number_slots;
+            }
+        }
+        portEXIT_CRITICAL(&slot_mutex);
+        if (!slot) {
+            dropped_captures++;
+            return;
+        }
+
+        uint16_t first = (trigger_index + buffer_length - pre_trigger_samples) % buffer_length;
+        slot->number_samples = pre_trigger_samples + 1 + post_trigger_samples;
+        for (uint16_t i = 0; i < slot->number_samples; i++) {
+            slot->samples[i] = buffer[(first + i) % buffer_length];
+        }
+        slot->trigger_index = pre_trigger_samples;
+        slot->trigger_timestamp = buffer[trigger_index].timestamp;
+        slot->config = config;
+        slot->is_valid = true;
+        number_captures++;
+    }
+};
@@ -0,0 +1,53 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+/// @brief Minimum, mean, maximum and last value of each field of a telemetry message over a window, for the links too slow to carry every sample.
+/// Each reading updates the statistics of its field as it arrives, so the memory taken is the same whatever the number of readings, and fields
+/// read at different rates are each summarized over all their readings. The mean is kept as a running mean rather than a sum, so it does not
+/// lose precision over long windows of fast readings.
+/// Portable C++ with no allocation and no locking, with the time passed in.
+template <size_t N>
+class WindowAggregator {
+public:
+    struct Field {
+        float min;
+        float mean;
+        float max;
+        float last;
+        uint32_t count; // Readings in the window. The other members are meaningless while it is 0.
+    };
+
+    explicit WindowAggregator(uint32_t now = 0) { Reset(now); }
+
+    /// @brief Adds a reading of a field. Readings that are not a number, as given by a sensor that failed, are left out.
+    void Add(size_t field, float value) {
+        if (field >= N || std::isnan(value)) return;
+        Field& f = fields[field];
+        f.count++;
+        if (f.count == 1) {
+            f.min = f.max = f.mean = value;
+        } else {
+            if (value < f.min) f.min = value;
+            if (value > f.max) f.max = value;
+            f.mean += (value - f.mean) / f.count;
+        }
+        f.last = value;
+    }
+
+    const Field& Get(size_t field) const { return fields[field]; }
+
+    /// @return Time since the start of the window, in ms.
+    uint32_t GetElapsed(uint32_t now) const { return now - start; }
+
+    /// @brief Starts a new window.
+    void Reset(uint32_t now) {
+        for (size_t i = 0; i < N; i++) fields[i] = {};
+        start = now;
+    }
+
+private:
+    Field fields[N];
+    uint32_t start;
+};
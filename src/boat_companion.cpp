@@ -2,6 +2,7 @@
 #include <WiFi.h> // Main library for WiFi connectivity, also used by AsyncWebServer.
 #include <ArduinoJson.h> // Library for parsing and generating JSON for data exchange between the boat and the ground station via HTTP.
 #include <unordered_map> // Hashtable for storing WiFi credentials.
+#include <memory> // Shared flag that ends a download exactly once.
 #include "HTTPClient.h" // HTTP client for sending requests to a listening server.
 #include "HttpClientFunctions.hpp" // Auxiliary functions for sending HTTP requests.
 #include "Husarnet.h" // IPV6 for ESP32 to enable peer-to-peer communication between devices inside a Husarnet network.
@@ -15,8 +16,36 @@
 #include "Adafruit_ADS1X15.h" // 16-bit high-linearity with programmable gain amplifier Analog-Digital Converter for measuring current and voltage.
 #include <SPI.h> // Required for the ADS1115 ADC.
 #include <Wire.h> // Required for the ADS1115 ADC and communication with the LoRa board.
+#include "I2cBus.hpp" // Owner of the Wire bus, which serves the transfers of every task by priority.
 #include <Encoder.h> // Rotary encoder library.
 #include <Preferences.h> // Non-volatile storage for storing the state of the boat.
+#include "CurrentLimiter.hpp" // PI controller that caps the throttle output when the motor current exceeds a limit.
+#include "ThrottleOutput.hpp" // 12-bit PWM throttle signal with calibration table.
+#include "StatusIndicator.hpp" // Status LED and buzzer patterns played back by the RMT peripheral.
+#include "MavlinkExtensions.hpp" // Messages not yet part of the arariboat dialect, such as alarms.
+#include "AlarmEngine.hpp" // Alarm rules evaluated on every sample.
+#include "TransientCapture.hpp" // Pre-trigger capture of current transients.
+#include "SpectrumAnalyzer.hpp" // FFT of the current ripple.
+#include "OvercurrentProtection.hpp" // Over-current trip from the comparator of the ADS1115.
+#include "PumpMonitor.hpp" // Bilge pump run time and duty cycle.
+#include "CalibrationEngine.hpp" // Multi-point calibration of the analog channels.
+#include "LinkRateController.hpp" // Adaptive data rate of the LoRa link.
+#include "PacketFec.hpp" // Parity frames that let the ground station rebuild lost telemetry frames.
+#include "ReliableLink.hpp" // Acknowledged delivery of alarms and commands.
+#include "TelemetryStreams.hpp" // Per-stream sequence numbers and hop counters.
+#include "TimeService.hpp" // UTC clock disciplined by the GPS.
+#include "TelemetryFanout.hpp" // Choice of the paths to the shore each telemetry frame takes.
+#include "WindowAggregator.hpp" // Minimum, mean, maximum and last reading over a window, for the LoRa link.
+#include <WiFiUdp.h> // Telemetry over IP to the ground merger.
+#include <esp_timer.h> // 64-bit microsecond timer the UTC clock is built on.
+#include "RaceLog.hpp" // Blocks of the on-board race log.
+#include "RaceLogExport.hpp" // Download of the race log over HTTP.
+#include "AdmissionControl.hpp" // Budgets of the web server, which keep it from starving the sensor tasks.
+#include "TelemetrySchema.hpp" // Fields of each subsystem, from which its MAVLink message, JSON and HTML are produced.
+#include <esp_partition.h> // Flash partition that holds the race log when there is no SD card.
+#include <SD.h> // Optional SD card for the race log.
+#include "JobExecutor.hpp" // Cooperative executor of the low-rate periodic jobs.
+#include "SensorPipeline.hpp" // Sensor readers put together from a driver, a converter, a filter and a publisher.
 
 #define DEBUG // Uncomment to enable debug messages.
 #ifdef DEBUG
@@ -31,31 +60,428 @@ const char* hostnameGlobal = "placa-velha";
 // The handle is initialized to nullptr to avoid the task being created before the setup() function.
 // Each handle is then assigned to the task created in the setup() function.
 
-TaskHandle_t ledBlinkerTaskHandle = nullptr;
-TaskHandle_t wifiConnectionTaskHandle = nullptr;
 TaskHandle_t serverTaskHandle = nullptr;
 TaskHandle_t vpnConnectionTaskHandle = nullptr;
 TaskHandle_t serialReaderTaskHandle = nullptr;
-TaskHandle_t temperatureReaderTaskHandle = nullptr;
+TaskHandle_t serialTransmitterTaskHandle = nullptr;
 TaskHandle_t gpsReaderTaskHandle = nullptr;
 TaskHandle_t instrumentationReaderTaskHandle = nullptr;
-TaskHandle_t auxiliaryReaderTaskHandle = nullptr;
 TaskHandle_t encoderControlTaskHandle = nullptr;
-TaskHandle_t highWaterMeasurerTaskHandle = nullptr;
+TaskHandle_t spectrumAnalyzerTaskHandle = nullptr;
+TaskHandle_t ipTransmitterTaskHandle = nullptr;
+TaskHandle_t raceLogTaskHandle = nullptr;
+TaskHandle_t i2cBusTaskHandle = nullptr;
+TaskHandle_t jobExecutorTaskHandle = nullptr; // Runs the WiFi connection, the sensor pipelines and the stack measurer as jobs.
 
 // Array of pointers to the task handles. This allows to iterate over the array and perform operations on all tasks, such as resuming, suspending or reading free stack memory.
-TaskHandle_t* taskHandles[] = { &ledBlinkerTaskHandle, &wifiConnectionTaskHandle, &serverTaskHandle, &vpnConnectionTaskHandle, &serialReaderTaskHandle, 
-                                &temperatureReaderTaskHandle, &gpsReaderTaskHandle, &instrumentationReaderTaskHandle, 
-                                &auxiliaryReaderTaskHandle, &encoderControlTaskHandle, &highWaterMeasurerTaskHandle};
+TaskHandle_t* taskHandles[] = { &serverTaskHandle, &vpnConnectionTaskHandle, &serialReaderTaskHandle, &serialTransmitterTaskHandle,
+                                &gpsReaderTaskHandle, &instrumentationReaderTaskHandle, 
+                                &encoderControlTaskHandle, &spectrumAnalyzerTaskHandle, &ipTransmitterTaskHandle, &raceLogTaskHandle, &i2cBusTaskHandle, &jobExecutorTaskHandle};
 
 constexpr auto taskHandlesSize = sizeof(taskHandles) / sizeof(taskHandles[0]); // Get the number of elements in the array.
 
-enum BlinkRate : uint32_t {
-    Slow = 2000,
-    Medium = 1000,
-    Fast = 300,
-    Pulse = 100 // Pulse is a special value that will make the LED blink fast and then return to the previous blink rate.
+// Status LED and buzzer. Tasks post events here to change the blink rate of the LED in order to communicate the status of the boat.
+StatusIndicator statusIndicator(2, 26); // Built-in LED pin for the ESP32 DevKit board and buzzer pin.
+
+// Throttle signal to the motor controller, owned by the encoder control task. Global so that the interrupt of the over-current protection
+// can trip it, and the web server read its state.
+ThrottleOutput throttleOutput(25);
+
+// Steps of the calibration of the throttle output, passed by the web server to the encoder control task, which applies them.
+enum ThrottleCalibrationAction : uint8_t {
+    ThrottleHoldPoint,
+    ThrottleSetPoint,
+    ThrottleRelease
+};
+
+struct ThrottleCalibrationRequest {
+    ThrottleCalibrationAction action;
+    uint8_t point;
+    float voltage; // mV, for ThrottleSetPoint.
+};
+
+QueueHandle_t throttleCalibrationQueue = nullptr;
+volatile bool isEncoderAtZero = false; // Published by the encoder control task. A calibration point is only held from zero throttle.
+
+// Called from the ALERT interrupt of the ADS1115 when a current leaves the comparator window.
+void IRAM_ATTR TripThrottle() {
+    throttleOutput.Trip();
+}
+
+// Over-current protection of the motor and battery channels. The ALERT pin of the ADS1115 is wired to GPIO27.
+OvercurrentProtection overcurrentProtection(27, TripThrottle);
+
+// The default Wire pins, 21(SDA) and 22(SCL), at 100 kHz. A transfer taking longer than 50 ms means a slave is holding the bus.
+I2cBus i2cBus(21, 22, 100000, 50);
+
+// UTC clock shared by every task, disciplined by the GPS reader and, while the GPS has no fix, by SNTP over WiFi. The PPS output of the
+// NEO-6M is not wired on the current board. Wire it to a free GPIO, such as GPIO4, and set the pin here to time the clock to the microsecond.
+// The GPS reader task is disabled in setup(), as it was before the clock, so for now only SNTP sets the clock and the NMEA and PPS sources
+// stay unused; /time reports the source in use.
+constexpr int8_t gps_pps_pin = -1;
+TimeService timeService;
+portMUX_TYPE timeMutex = portMUX_INITIALIZER_UNLOCKED;
+int64_t ppsTime = 0; // Local time of the last PPS edge, in us since boot.
+
+void IRAM_ATTR OnPps() {
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL_ISR(&timeMutex);
+    ppsTime = now;
+    portEXIT_CRITICAL_ISR(&timeMutex);
+}
+
+/// @brief UTC time in us since the Unix epoch, or 0 until a time source has been seen. Safe to call from any task.
+int64_t NowUtcUs() {
+    int64_t local = esp_timer_get_time();
+    portENTER_CRITICAL(&timeMutex);
+    int64_t utc = timeService.ToUtc(local);
+    portEXIT_CRITICAL(&timeMutex);
+    return utc;
+}
+
+/// @brief Feeds a measurement of UTC to the clock, which ignores it if a better source is active.
+/// @param local_us Time of the measurement, from esp_timer_get_time().
+void DisciplineClock(int64_t local_us, int64_t utc_us, TimeService::Source source) {
+    portENTER_CRITICAL(&timeMutex);
+    TimeService::Source previous = timeService.GetSource();
+    timeService.Discipline(local_us, utc_us, source);
+    TimeService::Source current = timeService.GetSource();
+    portEXIT_CRITICAL(&timeMutex);
+    if (current != previous) {
+        DEBUG_PRINTF("\n[TIME]Clock disciplined by %s\n", TimeService::GetSourceName(current));
+    }
+}
+
+// Bilge pump analytics, fed by the auxiliary reader. Pumps are on above 10V at their supply and off below 8V, after holding for 100ms.
+PumpMonitor pumpMonitor(10.0f, 8.0f, 100);
+
+// Latest motor current reading from the high-rate ADC stream, along with the time it was taken.
+struct MotorCurrentSample {
+    float current;
+    uint32_t timestamp;
+};
+
+// Single element queue used as a mailbox: the instrumentation reader overwrites it with each new sample and the encoder control task peeks the most recent one.
+QueueHandle_t motorCurrentQueue = nullptr;
+
+// Pre-trigger capture of the motor and battery currents, fed by the instrumentation reader. Kept global, and out of the task stack, due to its size.
+TransientCapture transientCapture;
+
+// High-rate current samples on their way to the spectrum analyzer task, which runs on the other core.
+struct CurrentSamplePair {
+    float motor_current;
+    float battery_current;
+    uint32_t timestamp; // us
+};
+QueueHandle_t spectrumSampleQueue = nullptr;
+uint32_t spectrumFrameTime = 0; // Time taken to analyze the last frame of both channels, in us.
+
+// Capture being streamed over mavlink, one chunk at a time. A negative slot means no stream is in progress.
+int8_t captureStreamSlot = -1;
+uint16_t captureStreamOffset = 0;
+
+// Sequence numbers and sample times of the telemetry streams, and the frames counted at each hop on the way to the ground.
+TelemetryStreams telemetryStreams;
+
+// Outgoing mavlink messages wait here until the serial transmitter task writes them to the LoRa board.
+// Tasks never write telemetry to the serial port directly, so a message that needs to go out first can be placed at the front of the queue.
+// Telemetry carries the stamp of its sample along, which the transmitter reports in the STREAM_STAMPS message once the frame is numbered.
+struct OutgoingFrame {
+    mavlink_message_t message;
+    TelemetryStream stream;
+    uint16_t stream_seq;
+    uint32_t sample_time; // ms since boot.
+};
+QueueHandle_t transmitQueue = nullptr;
+uint32_t transmitQueueDrops = 0;
+
+/// @brief Time a sample was taken relative to the STREAM_STAMPS message that describes it, saturated to the range of the field.
+int16_t SampleOffset(uint32_t sample_time, uint32_t time_boot_ms) {
+    int32_t offset = (int32_t)(sample_time - time_boot_ms);
+    return offset < INT16_MIN ? INT16_MIN : (offset > INT16_MAX ? INT16_MAX : offset);
+}
+
+/// @brief Queues a frame to be sent to the LoRa board. Never blocks; the frame is dropped if the queue is full.
+bool QueueFrame(const OutgoingFrame& frame, bool is_priority) {
+    BaseType_t result = is_priority ? xQueueSendToFront(transmitQueue, &frame, 0) : xQueueSendToBack(transmitQueue, &frame, 0);
+    if (result != pdPASS) {
+        transmitQueueDrops++;
+        return false;
+    }
+    return true;
+}
+
+/// @brief Queues a mavlink message to be sent to the LoRa board. Never blocks; the message is dropped if the queue is full.
+/// @param message Encoded message. It is copied into the queue.
+/// @param is_priority Places the message at the front of the queue, ahead of routine telemetry. Used for alarms and commands.
+void SendMavlinkMessage(const mavlink_message_t& message, bool is_priority = false) {
+    OutgoingFrame frame;
+    frame.message = message;
+    frame.stream = UnstampedStream;
+    QueueFrame(frame, is_priority);
+}
+
+// Race log: every telemetry frame and alarm, as encoded for the links, kept on the boat so the whole race can be analysed afterwards, whatever
+// the radio lost. Frames are logged at the rate they are sampled, before any link drops them, and the fast current readings at 10 Hz, one
+// in 25 of the 250 Hz samples, whether a link is up or not. The writer fills blocks in RAM, and the race log task writes full ones to an
+// SD card when one is wired, or else to the "racelog" data partition of partitions.csv, used as a ring of 48 blocks.
+// The fast readings take about 360 B/s, 36 B a frame, and the other streams about 100 B/s, so a block fills every 9 s and the ring keeps
+// the last 7 minutes or so, far from a whole race, which needs the SD card: the flash has no room for a larger partition next to both OTA
+// slots. Each sector of the ring is erased once a pass, every 7 minutes, so its 100000 rated erase cycles last about 16 months of logging.
+// Logging starts once the task has found where the previous boot left off, so the blocks keep counting across boots.
+constexpr int8_t sd_card_cs_pin = -1; // Chip select of the SD card on the VSPI bus. No card on the current board.
+RaceLog::Writer<3> raceLog(esp_random());
+portMUX_TYPE raceLogMutex = portMUX_INITIALIZER_UNLOCKED;
+volatile bool isRaceLogEnabled = false;
+const char* raceLogStorage = "none"; // Where the race log task writes: "sd", "flash" or "none".
+uint32_t raceLogCapacity = 0; // Blocks the flash partition holds. 0 on the SD card, which grows as needed.
+uint32_t raceLogWriteErrors = 0;
+constexpr const char* race_log_file_name = "/racelog.bin";
+const esp_partition_t* raceLogPartition = nullptr; // Set when the log is on the flash.
+volatile uint32_t raceLogNextIndex = 0; // Block of the partition written next, which holds the oldest block once the ring is full. Under raceLogMutex.
+
+// State of the download of the race log, served by the web server a piece at a time. The exporter holds the buffers, so there is one
+// export at a time.
+RaceLog::Exporter raceLogExporter;
+volatile bool isRaceLogExportBusy = false;
+uint32_t raceLogExportOldest = 0; // Index in the partition of the first block of the export.
+File raceLogExportFile;
+
+/// @brief Reads part of a block of the race log for the exporter, by its position in the order the blocks were written.
+bool ReadRaceLogExport(uint32_t position, uint32_t offset, uint8_t* data, uint32_t length) {
+    if (raceLogPartition) {
+        uint32_t index = (raceLogExportOldest + position) % raceLogCapacity;
+        return esp_partition_read(raceLogPartition, index * RaceLog::block_size + offset, data, length) == ESP_OK;
+    }
+    return raceLogExportFile.seek(position * RaceLog::block_size + offset) && raceLogExportFile.read(data, length) == length;
+}
+
+/// @brief Adds a frame to the race log. Never blocks; the frame is dropped if every buffer is waiting for the storage.
+void LogFrame(const mavlink_message_t& message, uint8_t stream, uint16_t stream_seq, uint32_t sample_time) {
+    if (!isRaceLogEnabled) return;
+    uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+    uint16_t len = mavlink_msg_to_send_buffer(buffer, &message);
+    int64_t utc = NowUtcUs();
+    portENTER_CRITICAL(&raceLogMutex);
+    raceLog.Append(buffer, len, message.msgid, sample_time, utc, stream, stream_seq, millis());
+    portEXIT_CRITICAL(&raceLogMutex);
+}
+
+// The second path to the shore: MAVLink over UDP to the ground merger, through the 4G router. Frames wait here for the IP transmitter task.
+// The merger takes each sample from whichever path delivers it first, by the sequence number of its stream, which both paths carry.
+QueueHandle_t ipTransmitQueue = nullptr;
+bool isIpTelemetryEnabled = false;
+IPAddress groundAddress;
+uint16_t groundPort = 14550;
+volatile uint32_t ipSettingsVersion = 0;
+
+// Health of both paths, and the policy of each stream: the data needed to run the boat goes out on both paths, so a dead zone of
+// either link does not leave a gap, while bulky or slow changing data only takes the best path. Instrumentation is split by capacity:
+// the IP path gets every sample, and LoRa a summary of each window.
+TelemetryFanout telemetryFanout;
+portMUX_TYPE fanoutMutex = portMUX_INITIALIZER_UNLOCKED;
+constexpr FanoutPolicy stream_policies[NumberTelemetryStreams] = {
+    IpPathOnly, // Instrumentation
+    BestPath, // Temperature
+    AllPaths, // GPS
+    AllPaths, // Control
+    BestPath, // Auxiliary
+    AllPaths, // Pumps
+    BestPath, // Spectrum
+    BestPath, // Capture
+    AllPaths, // Calibration
+    LoraPathOnly // Instrumentation summary
+};
+
+/// @brief Queues a new sample of a telemetry stream on the paths its policy selects, numbered within its stream and stamped with the time
+/// it was sampled.
+/// @param sample_time Time the values were read, in ms since boot, which may be well before the message is encoded.
+void SendTelemetry(const mavlink_message_t& message, TelemetryStream stream, uint32_t sample_time) {
+    OutgoingFrame frame;
+    frame.message = message;
+    frame.stream = stream;
+    frame.stream_seq = telemetryStreams.Publish(stream, sample_time);
+    frame.sample_time = sample_time;
+    LogFrame(message, stream, frame.stream_seq, sample_time);
+
+    portENTER_CRITICAL(&fanoutMutex);
+    uint8_t paths = telemetryFanout.Select(stream_policies[stream], millis());
+    portEXIT_CRITICAL(&fanoutMutex);
+    if (paths & (1 << LoraPath)) {
+        telemetryStreams.Count(stream, QueueFrame(frame, false) ? TelemetryStreams::Queued : TelemetryStreams::QueueDropped);
+    }
+    if ((paths & (1 << IpPath)) && xQueueSendToBack(ipTransmitQueue, &frame, 0) != pdPASS) {
+        telemetryStreams.Count(stream, TelemetryStreams::IpDropped);
+    }
+}
+
+/// @brief Sends the current values of a subsystem, as kept in SystemData, as a sample of its stream.
+void SendTelemetrySubsystem(TelemetrySubsystemId id, uint32_t sample_time) {
+    const TelemetrySubsystem& subsystem = telemetry_subsystems[id];
+    mavlink_message_t message;
+    EncodeTelemetrySubsystem(subsystem, &message);
+    SendTelemetry(message, subsystem.stream, sample_time);
+}
+
+bool IsIpPathAvailable() {
+    portENTER_CRITICAL(&fanoutMutex);
+    bool is_available = telemetryFanout.GetHealth(IpPath).is_available;
+    portEXIT_CRITICAL(&fanoutMutex);
+    return is_available;
+}
+
+/// @brief Sends a message that is not telemetry, such as an alarm, to the ground merger as well, when the IP path is up.
+void SendIpMessage(const mavlink_message_t& message) {
+    if (!IsIpPathAvailable()) return;
+    OutgoingFrame frame;
+    frame.message = message;
+    frame.stream = UnstampedStream;
+    xQueueSendToFront(ipTransmitQueue, &frame, 0);
+}
+
+/// @brief Adds the sequence number and sample time of the latest sample of a stream to an HTTP response, which counts as a frame served over IP.
+/// The numbers are the ones the LoRa frames carry, so the ground can match both paths.
+void AddStreamStamp(JsonDocument& doc, TelemetryStream stream) {
+    TelemetryStreams::Latest latest = telemetryStreams.GetLatest(stream);
+    if (latest.is_valid) {
+        doc["seq"] = latest.seq;
+        doc["sample_time_ms"] = latest.sample_time;
+    }
+    telemetryStreams.Count(stream, TelemetryStreams::ServedIp);
+}
+
+// Reliable delivery of alarms and commands, in both directions. Telemetry does not go through it. The session changes on every boot, so the
+// other end can tell a restart from old duplicates. The sender is shared by every task that raises alarms, hence the mutex, which is never held
+// for longer than it takes to queue a few frames.
+ReliableLink::Sender<8> reliableSender(esp_random());
+ReliableLink::Receiver reliableReceiver; // Only used by the serial reader.
+SemaphoreHandle_t reliableMutex = nullptr;
+
+/// @brief Wraps a frame in a reliable envelope and queues it ahead of the telemetry. Called by the sender for each transmission.
+void TransmitReliableFrame(uint16_t seq, uint8_t session, const uint8_t* frame, uint16_t length) {
+    mavlink_reliable_message_t envelope = { seq, session, (uint8_t)length };
+    memcpy(envelope.frame, frame, length);
+    mavlink_message_t message;
+    mavlink_msg_reliable_message_encode_chan(1, MAV_COMP_ID_ONBOARD_COMPUTER, MAVLINK_COMM_0, &message, &envelope);
+    SendMavlinkMessage(message, true);
+}
+
+/// @brief Sends a message that must reach the other end, resending it until it is acknowledged. Waits for the sender while another task
+/// queues frames, which is short and bounded by a timeout; when that runs out or the window is full, the message goes out once, ahead of the
+/// telemetry, as it would without the reliable layer.
+/// @param is_setting True for a setting of which only the last value counts, which replaces the messages of the same id still in flight.
+void SendReliableMessage(const mavlink_message_t& message, bool is_setting = false) {
+    constexpr TickType_t lock_timeout = pdMS_TO_TICKS(50);
+    uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+    uint16_t len = mavlink_msg_to_send_buffer(buffer, &message);
+    bool is_sent = false;
+    if (xSemaphoreTake(reliableMutex, lock_timeout) == pdTRUE) {
+        is_sent = reliableSender.Send(buffer, len, millis(), TransmitReliableFrame, is_setting ? message.msgid : 0);
+        xSemaphoreGive(reliableMutex);
+    }
+    if (!is_sent) {
+        SendMavlinkMessage(message, true);
+    }
+}
+
+// Adaptive data rate of the LoRa link, fed by the link reports of the LoRa board. The controller does no locking of its own, and is used
+// by the serial tasks and the server, so every call goes through this lock. Calls never block or do I/O.
+LinkRateController linkRateController;
+portMUX_TYPE linkRateMutex = portMUX_INITIALIZER_UNLOCKED;
+bool isLoraCrcEnabled = true;
+
+// Forward error correction of the frames sent to the LoRa board. The server changes the settings and the transmitter applies them between groups.
+bool isFecEnabled = false;
+uint8_t fecDataFrames = 8;
+uint8_t fecParityFrames = 1;
+volatile uint32_t fecSettingsVersion = 0;
+uint32_t fecGroupsSent = 0;
+uint32_t fecParitySent = 0;
+
+/// @brief Asks the LoRa board to switch to a new modulation, ahead of any queued telemetry.
+void SendLoraParams(const LoraSetting& setting) {
+    mavlink_message_t msg;
+    mavlink_lora_params_t lora_params = { setting.bandwidth, setting.spreading_factor, setting.coding_rate, isLoraCrcEnabled };
+    mavlink_msg_lora_params_encode(1, 200, &msg, &lora_params);
+    SendReliableMessage(msg, true); // A retransmission of an older setting must not follow this one.
+}
+
+// Rule table checked by each reader task as soon as a sample is converted. Transitions are handled by OnAlarmTransition.
+void OnAlarmTransition(const AlarmEvent& event);
+AlarmEngine alarmEngine(OnAlarmTransition);
+
+/// @brief Sends an alarm message ahead of any queued telemetry and sounds the buzzer while any alarm is active.
+/// Called from the reader task that evaluated the sample, so it must not block.
+void OnAlarmTransition(const AlarmEvent& event) {
+    mavlink_message_t message;
+    mavlink_alarm_t alarm = { event.timestamp, event.value, event.threshold, event.rule, event.field, event.is_active, event.severity };
+    mavlink_msg_alarm_encode_chan(1, MAV_COMP_ID_ONBOARD_COMPUTER, MAVLINK_COMM_0, &message, &alarm);
+    SendReliableMessage(message);
+    SendIpMessage(message);
+    LogFrame(message, UnstampedStream, 0, event.timestamp);
+    statusIndicator.Post(alarmEngine.CountActive() ? BlinkRate::Alarm : BlinkRate::AlarmCleared);
+    DEBUG_PRINTF("\n[ALARM]Rule %d %s: value %.2f, threshold %.2f\n", event.rule, event.is_active ? "raised" : "cleared", event.value, event.threshold);
+}
+
+/// @brief Reports each change of the calibration state machine to the ground station and to the serial monitor.
+void OnCalibrationStatus(const CalibrationEngine::Status& status, const CalibrationEngine::Coefficients& coefficients) {
+    mavlink_calibration_status_t calibration_status = {};
+    calibration_status.channel = status.channel;
+    calibration_status.state = status.state;
+    calibration_status.result = status.last_result;
+    calibration_status.number_points = status.number_points;
+    calibration_status.samples_collected = min<uint32_t>(status.samples_collected, UINT16_MAX); // The message keeps 16 bits.
+    calibration_status.samples_per_point = min<uint32_t>(status.samples_per_point, UINT16_MAX);
+    calibration_status.slope = coefficients.slope;
+    calibration_status.intercept = coefficients.intercept;
+    calibration_status.residual = status.residual;
+
+    mavlink_message_t message;
+    mavlink_msg_calibration_status_encode_chan(1, MAV_COMP_ID_ONBOARD_COMPUTER, MAVLINK_COMM_0, &message, &calibration_status);
+    SendTelemetry(message, CalibrationStream, millis());
+    DEBUG_PRINTF("\n[CALIBRATION]Channel %d: state %d, result %d, %d points, slope %.6f, intercept %.4f\n",
+                 status.channel, status.state, status.last_result, status.number_points, coefficients.slope, coefficients.intercept);
+}
+
+// Linear corrections of every analog channel, applied on top of the sensor models. These defaults hold until a channel is calibrated.
+constexpr CalibrationEngine::Coefficients calibration_defaults[NumberCalibrationChannels] = {
+    { 1.0f, 0.0f }, // Battery voltage
+    { 1.0f, 0.0f }, // Motor current
+    { 1.0f, -0.3f }, // Battery current, offset measured on the bench.
+    { 1.0f, 0.0f }, // MPPT current
+    { 1.3009f, -2.5583f }, // Auxiliary voltage, from a comparison with a multimeter.
+    { 3.3f / 4095 / 0.1f, -2.5f / 0.1f } // Auxiliary current, nominal 100mV/A and 2.5V at zero current of the ACS712-20A.
 };
+CalibrationEngine calibrationEngine(calibration_defaults, OnCalibrationStatus);
+
+/// @brief Sends the next chunk of the capture being streamed, if any. The slot stays locked until the whole capture has been sent.
+void SendCaptureChunk() {
+    if (captureStreamSlot < 0) return;
+    const TransientCapture::Slot& slot = transientCapture.GetSlot(captureStreamSlot);
+    constexpr uint8_t samples_per_chunk = MAVLINK_MSG_CAPTURE_CHUNK_FIELD_MOTOR_CURRENT_LEN;
+
+    mavlink_capture_chunk_t chunk = {};
+    chunk.trigger_time_ms = slot.trigger_timestamp / 1000;
+    chunk.slot = captureStreamSlot;
+    chunk.offset = captureStreamOffset;
+    chunk.total = slot.number_samples;
+    chunk.sample_interval_us = (slot.samples[slot.number_samples - 1].timestamp - slot.samples[0].timestamp) / (slot.number_samples > 1 ? slot.number_samples - 1 : 1);
+    chunk.count = min<uint16_t>(samples_per_chunk, slot.number_samples - captureStreamOffset);
+    for (uint8_t i = 0; i < chunk.count; i++) {
+        chunk.motor_current[i] = slot.samples[captureStreamOffset + i].values[0];
+        chunk.battery_current[i] = slot.samples[captureStreamOffset + i].values[1];
+    }
+
+    mavlink_message_t message;
+    mavlink_msg_capture_chunk_encode_chan(1, MAV_COMP_ID_ONBOARD_COMPUTER, MAVLINK_COMM_0, &message, &chunk);
+    SendTelemetry(message, CaptureStream, slot.samples[captureStreamOffset].timestamp / 1000);
+
+    captureStreamOffset += chunk.count;
+    if (captureStreamOffset >= slot.number_samples) {
+        transientCapture.Unlock(captureStreamSlot);
+        captureStreamSlot = -1;
+    }
+}
 
 enum GPSPrintOptions : uint32_t {
     Off = '0',
@@ -63,105 +489,140 @@ enum GPSPrintOptions : uint32_t {
     Parsed
 };
 
-// Tasks can send notifications here to change the blink rate of the LED in order to communicate the status of the boat.
-void FastBlinkPulse(int pin);
-void LedBlinkerTask(void* parameter) {
-
-    constexpr uint8_t led_pin = 2; // Built-in LED pin for the ESP32 DevKit board.
-    pinMode(led_pin, OUTPUT);
-    uint32_t blink_rate = BlinkRate::Slow;
-    uint32_t previous_blink_rate = blink_rate;
-
-    auto FastBlinkPulse = [](int pin) {
-        for (int i = 0; i < 4; i++) {
-            digitalWrite(pin, HIGH); vTaskDelay(pdMS_TO_TICKS(50));
-            digitalWrite(pin, LOW);  vTaskDelay(pdMS_TO_TICKS(50));
-        }
-    };
+// Cooperative executor of the low-rate periodic jobs, which share its one stack in place of a task each. A job must return within a few
+// ms, so whatever it waits on, such as a conversion or a connection, it waits for by returning the wait and keeping its state.
+// The GPS reader and the encoder control keep their own tasks: the GPS reader timestamps each sentence as it arrives to discipline the clock,
+// and the encoder control is a 20 ms control loop, and neither may wait behind another job.
+// Jobs are added in setup(), before the executor task starts.
+constexpr uint32_t job_executor_tick = 10; // ms, resolution of the deadlines of the jobs.
+JobExecutor<8> jobExecutor(job_executor_tick, esp_timer_get_time);
+int8_t temperatureReaderJobId = JobExecutor<8>::invalid_job;
+volatile bool isProbeScanRequested = false; // Set by the serial command T, done by the temperature reader job on its next run.
+
+// Statistics of the sensor pipelines run as jobs, for /jobs.
+const SensorPipelineStatistics* sensorStatistics[4] = {};
+uint8_t numberSensorStatistics = 0;
+
+/// @brief Adds a sensor pipeline to the executor, named after the pipeline, and lists its statistics.
+template <typename Pipeline>
+int8_t AddSensorJob(Pipeline& pipeline, uint32_t now) {
+    const SensorPipelineStatistics& statistics = pipeline.GetStatistics();
+    if (numberSensorStatistics < sizeof(sensorStatistics) / sizeof(sensorStatistics[0])) sensorStatistics[numberSensorStatistics++] = &statistics;
+    return jobExecutor.Add(statistics.name, Pipeline::Run, &pipeline, 0, now);
+}
 
-    auto BuzzerWrite = [&]() {
-        constexpr uint8_t buzzer_pin = 26;
-        static uint8_t counter = 0;
+/// @brief Runs a job ahead of its deadline, from any task.
+void NotifyJob(int8_t job) {
+    jobExecutor.Notify(job);
+    if (jobExecutorTaskHandle) xTaskNotifyGive(jobExecutorTaskHandle);
+}
 
-        // Define the rhythm pattern
-        constexpr uint8_t pattern[] = {1, 0, 1, 0, 1, 0, 0, 0}; // Example pattern
+/// @brief Runs the jobs that are due, then sleeps until the next deadline or a notification.
+void JobExecutorTask(void* parameter) {
+    while (true) {
+        jobExecutor.Run(millis());
+        uint32_t delay = jobExecutor.GetDelay(millis());
+        ulTaskNotifyTake(pdTRUE, delay == JobExecutor<8>::stop ? portMAX_DELAY : pdMS_TO_TICKS(delay));
+    }
+}
 
-        // Calculate the position within the pattern
-        uint8_t patternSize = sizeof(pattern) / sizeof(pattern[0]);
-        uint8_t patternPosition = counter % patternSize;
+/// @brief Keeps the WiFi connected, trying each known network in turn, and disciplines the UTC clock by SNTP while connected.
+/// Each attempt is polled every 500 ms rather than waited for, so the other jobs keep running while a network is being tried.
+uint32_t WifiConnectionJob(void* parameter, uint32_t now) {
+    constexpr uint32_t attempt_interval = 500; // ms between checks of a connection being attempted.
+    constexpr uint8_t max_attempt_checks = 5;
+    constexpr uint32_t check_interval = 5000; // ms between checks of the connection.
 
-        // Determine the buzzer state based on the pattern
-        bool buzzerState = pattern[patternPosition] != 0;
+    // Store WiFi credentials in a hashtable.
+    static std::unordered_map<const char*, const char*> wifiCredentials = {
+        { "Ursula", "biaviad36" },
+        { "EMobil 1", "faraboia" },
+        { "Innorouter", "innomaker" },
+        { "NITEE", "nitee123" }
+    };
+    static auto network = wifiCredentials.end(); // Network being tried, end() when none is.
+    static uint8_t attempt_checks = 0;
+
+    auto try_network = [&]() {
+        WiFi.begin(network->first, network->second);
+        Serial.printf("\n[WIFI]Trying to connect to %s\n", network->first);
+        attempt_checks = 0;
+        return attempt_interval;
+    };
 
-        if (blink_rate == BlinkRate::Fast) {
-            dacWrite(buzzer_pin, buzzerState ? 150 : 0);
+    if (network != wifiCredentials.end()) {
+        if (WiFi.status() == WL_CONNECTED) {
+            Serial.println("\n[WIFI]Connected to WiFi");
+            configTime(0, 0, "pool.ntp.org", "time.google.com"); // UTC, without time zone or daylight saving.
+            statusIndicator.Post(BlinkRate::Slow);
+            xTaskNotifyGive(vpnConnectionTaskHandle); 
+            xTaskNotifyGive(serverTaskHandle);
+            network = wifiCredentials.end();
+        } else if (++attempt_checks <= max_attempt_checks) {
+            Serial.print(".");
+            return attempt_interval;
         } else {
-            dacWrite(buzzer_pin, 0);
+            Serial.printf("\n[WIFI]Failed to connect to %s\n", network->first);
+            if (++network != wifiCredentials.end()) return try_network();
         }
-        // Increment the counter
-        counter++;
-    };
-  
-    while (true) {
+    } else if (WiFi.status() != WL_CONNECTED) {
+        WiFi.mode(WIFI_STA);
+        statusIndicator.Post(BlinkRate::Fast);
+        network = wifiCredentials.begin();
+        return try_network();
+    }
 
-        static uint32_t previous_blink_time = millis();
-        if (millis() - previous_blink_time > blink_rate) {
-            previous_blink_time = millis();
-            BuzzerWrite();
-            digitalWrite(led_pin, !digitalRead(led_pin));
-        }
-           
-        // Set blink rate to the value received from the notification
-        static uint32_t received_value = BlinkRate::Slow;
-        if (xTaskNotifyWait(0, 0, (uint32_t*)&received_value, 100)) {
-            if (received_value == BlinkRate::Pulse) {
-                FastBlinkPulse(led_pin);
-            } else {
-                blink_rate = received_value;
-            }
-        }
+    // The system clock holds UTC once the SNTP client got an answer. It only disciplines the UTC clock while the GPS is silent.
+    constexpr time_t sntp_valid_after = 1700000000; // Any earlier time means the SNTP client has not synchronized yet.
+    if (WiFi.status() == WL_CONNECTED && time(nullptr) > sntp_valid_after) {
+        struct timeval utc;
+        int64_t local = esp_timer_get_time();
+        gettimeofday(&utc, nullptr);
+        DisciplineClock(local, utc.tv_sec * 1000000LL + utc.tv_usec, TimeService::SntpSource);
     }
+    return check_interval;
 }
 
-void WifiConnectionTask(void* parameter) {
-    
-    // Store WiFi credentials in a hashtable.
-    std::unordered_map<const char*, const char*> wifiCredentials;
-    wifiCredentials["Ursula"] = "biaviad36";
-    wifiCredentials["EMobil 1"] = "faraboia";
-    wifiCredentials["Innorouter"] = "innomaker";
-    wifiCredentials["NITEE"] = "nitee123";
-    
-    while (true) {
-        if (WiFi.status() != WL_CONNECTED) {
-            WiFi.mode(WIFI_STA);
-            xTaskNotify(ledBlinkerTaskHandle, BlinkRate::Fast, eSetValueWithOverwrite);
-            for (auto& wifi : wifiCredentials) {
-                WiFi.begin(wifi.first, wifi.second);
-                Serial.printf("\n[WIFI]Trying to connect to %s\n", wifi.first);
-                int i = 0;
-                while (WiFi.status() != WL_CONNECTED) {
-                    vTaskDelay(pdMS_TO_TICKS(500));
-                    Serial.print(".");
-                    i++;
-                    if (i > 5) {
-                        Serial.printf("\n[WIFI]Failed to connect to %s\n", wifi.first);
-                        break;
-                    }
-                }
-                if (WiFi.status() == WL_CONNECTED) {
-                    Serial.println("\n[WIFI]Connected to WiFi");
-                    xTaskNotify(ledBlinkerTaskHandle, BlinkRate::Slow, eSetValueWithOverwrite);
-                    xTaskNotifyGive(vpnConnectionTaskHandle); 
-                    xTaskNotifyGive(serverTaskHandle);
-                    break;
-                }
-            }          
+// Admission control of the web server. Every handler runs in the task of AsyncTCP, whose priority the library fixes above the reader tasks,
+// so the time it may take from them is bounded here instead: 15% of a core for all clients, 5% for each, and at most 4 responses at once.
+// Requests over budget are refused with 503 and a Retry-After. Only used from the AsyncTCP task, so it needs no lock.
+constexpr uint32_t default_route_cost = 2000; // us. Estimate for a route until it has been timed.
+constexpr uint32_t heavy_route_cost = 20000; // us. Estimate for the HTML page, built as a String.
+AdmissionControl<8, 32> admissionControl({ 150000, 300000, 50000, 100000, 4 });
+
+/// @brief Wraps the handler of a route in the admission control, which times it to learn the cost of the route.
+/// @param initial_cost us. Estimate of the cost of the route until it has been timed.
+ArRequestHandlerFunction WithAdmission(const char* name, uint32_t initial_cost, ArRequestHandlerFunction handler) {
+    uint8_t route = admissionControl.AddRoute(name, initial_cost);
+    return [route, handler](AsyncWebServerRequest *request) {
+        uint32_t client = request->client()->remoteIP();
+        AdmissionDecision decision = admissionControl.Admit(route, client, millis());
+        if (decision != Admitted) {
+            AsyncWebServerResponse* response = request->beginResponse(503, "text/html", "<h1>Boat-Companion</h1><p>Busy, retry later.</p>");
+            response->addHeader("Retry-After", String(admissionControl.GetRetryAfter(decision, route, client, millis())));
+            request->send(response);
+            return;
         }
-        vTaskDelay(pdMS_TO_TICKS(5000));
-    }
+        request->onDisconnect([]() { admissionControl.Release(); });
+        int64_t start = esp_timer_get_time();
+        handler(request);
+        admissionControl.Account(route, client, esp_timer_get_time() - start, millis());
+    };
+}
+
+ArRequestHandlerFunction WithAdmission(const char* name, ArRequestHandlerFunction handler) {
+    return WithAdmission(name, default_route_cost, handler);
 }
 
+/// @brief Calls a function when an admitted request is over, in place of onDisconnect(), which would replace the end of the admission.
+void OnRequestEnd(AsyncWebServerRequest *request, std::function<void()> function) {
+    request->onDisconnect([function]() {
+        function();
+        admissionControl.Release();
+    });
+}
+
+void SaveCurrentLimit(float current_limit);
 void ServerTask(void* parameter) {
 
     // Create an async web server on port 80. This is the default port for HTTP. 
@@ -171,245 +632,887 @@ void ServerTask(void* parameter) {
     // Setup URL routes and attach callback methods to them. A callback method is called when a request is made to the URL.
     // The callbacks must have the signature void(AsyncWebServerRequest *request). Any function with this signature can be used.
     // Preferably, use lambda functions to keep the code in the same place.
-    server.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
+    server.on("/", HTTP_GET, WithAdmission("/", heavy_route_cost, [](AsyncWebServerRequest *request) {
+
+        // The page is printed into the response as it is built, with a card per subsystem from the telemetry schema.
+        AsyncResponseStream* response = request->beginResponseStream("text/html");
+        response->print("<html><head>"
+                        "<title>");
+        response->print(hostnameGlobal);
+        response->print("</title>"
+                        "<style>"
+                        "body { font-family: Arial, sans-serif; background-color: #f7f7f7; margin: 0; padding: 0; }"
+                        ".container { padding: 10px; display: flex; flex-wrap: wrap; }"
+                        ".card { flex: 1 0 calc(50% - 20px); margin: 10px; padding: 10px; border-radius: 10px; box-shadow: 0 2px 5px rgba(0, 0, 0, 0.1); }"
+                        ".blue-card { background-color: #0088cc; color: #fff; }"
+                        ".orange-card { background-color: #ff9800; color: #fff; }"
+                        ".spacer { flex-basis: 100%; height: 10px; }" // Added style for grey spacer
+                        "h1, h2 { color: black; font-weight: bold; margin: 0; padding: 0; width: 100%; }"
+                        "h2 { font-size: 18px; }"
+                        "p { color: #333; }"
+                        "</style>"
+                        "</head><body>"
+                        "<div class='container'>");
 
-        // Function to send the combined HTML response
-        auto sendResponse = [&](const String &htmlContent) {
-            request->send(200, "text/html", htmlContent);
-        };
+        // Create blue card for WiFi info
+        response->printf("<div class='card blue-card'><h1>%s</h1>", hostnameGlobal);
+        response->printf("<p>WiFi connected: %s</p>", WiFi.SSID().c_str());
+        response->printf("<p>IP address: %s</p></div>", WiFi.localIP().toString().c_str());
 
-        // Create the HTML content with raw CSS styles
-        String htmlContent = "<html><head>"
-                            "<title>" + String(hostnameGlobal) + "</title>"
-                            "<style>"
-                            "body { font-family: Arial, sans-serif; background-color: #f7f7f7; margin: 0; padding: 0; }"
-                            ".container { padding: 10px; display: flex; flex-wrap: wrap; }"
-                            ".card { flex: 1 0 calc(50% - 20px); margin: 10px; padding: 10px; border-radius: 10px; box-shadow: 0 2px 5px rgba(0, 0, 0, 0.1); }"
-                            ".blue-card { background-color: #0088cc; color: #fff; }"
-                            ".orange-card { background-color: #ff9800; color: #fff; }"
-                            ".spacer { flex-basis: 100%; height: 10px; }" // Added style for grey spacer
-                            "h1, h2 { color: black; font-weight: bold; margin: 0; padding: 0; width: 100%; }"
-                            "h2 { font-size: 18px; }"
-                            "p { color: #333; }"
-                            "</style>"
-                            "</head><body>"
-                            "<div class='container'>";
+        // Cards of the subsystems, alternating in colour after the blue one.
+        for (uint8_t i = 0; i < NumberTelemetrySubsystems; i++) {
+            PrintTelemetryCard(telemetry_subsystems[i], *response, i % 2 ? "blue-card" : "orange-card");
+        }
 
-        // Create blue card for WiFi info
-        htmlContent += "<div class='card blue-card'>";
-        htmlContent += "<h1>" + String(hostnameGlobal) + "</h1>";
-        htmlContent += "<p>WiFi connected: " + WiFi.SSID() + "</p>";
-        htmlContent += "<p>IP address: " + WiFi.localIP().toString() + "</p>";
-        htmlContent += "</div>";
-
-        // Create orange card for Control System data
-        htmlContent += "<div class='card orange-card'>";
-        htmlContent += "<h2>Control System Data</h2>";
-        htmlContent += "<p>DAC Output: " + String(systemData.controlSystem.dac_output) + "</p>";
-        htmlContent += "<p>Potentiometer Signal: " + String(systemData.controlSystem.potentiometer_signal) + "</p>";
-        htmlContent += "</div>";
-
-        // Create blue card for Instrumentation System data
-        htmlContent += "<div class='card blue-card'>";
-        htmlContent += "<h2>Instrumentation System Data</h2>";
-        htmlContent += "<p>Battery Voltage: " + String(systemData.instrumentationSystem.battery_voltage) + "</p>";
-        htmlContent += "<p>Motor Current: " + String(systemData.instrumentationSystem.motor_current) + "</p>";
-        htmlContent += "<p>Battery Current: " + String(systemData.instrumentationSystem.battery_current) + "</p>";
-        htmlContent += "<p>MPPT Current: " + String(systemData.instrumentationSystem.mppt_current) + "</p>";
-        htmlContent += "</div>";
-
-        // Create orange card for GPS System data
-        htmlContent += "<div class='card orange-card'>";
-        htmlContent += "<h2>GPS System Data</h2>";
-        htmlContent += "<p>Latitude: " + String(systemData.gpsSystem.latitude) + "</p>";
-        htmlContent += "<p>Longitude: " + String(systemData.gpsSystem.longitude) + "</p>";
-        htmlContent += "<p>Speed: " + String(systemData.gpsSystem.speed) + "</p>";
-        htmlContent += "<p>Course: " + String(systemData.gpsSystem.course) + "</p>";
-        htmlContent += "<p>Satellites: " + String(systemData.gpsSystem.satellites_visible) + "</p>";
-        htmlContent += "</div>";
-
-        // Create blue card for Auxiliary System data
-        htmlContent += "<div class='card blue-card'>";
-        htmlContent += "<h2>Auxiliary System Data</h2>";
-        htmlContent += "<p>Pump Mask: " + String(systemData.auxiliarySystem.pumps) + "</p>";
-        htmlContent += "<p>Auxiliary Current: " + String(systemData.auxiliarySystem.current) + "</p>";
-        htmlContent += "<p>Auxiliary Voltage: " + String(systemData.auxiliarySystem.voltage) + "</p>";
-        htmlContent += "</div>";
-
-        // Create orange card for Temperature System data
-        htmlContent += "<div class='card orange-card'>";
-        htmlContent += "<h2>Temperature System Data</h2>";
-        htmlContent += "<p>Motor Temperature: " + String(systemData.temperatureSystem.temperature_motor) + "</p>";
-        htmlContent += "<p>Battery Temperature: " + String(systemData.temperatureSystem.temperature_battery) + "</p>";
-        htmlContent += "<p>MPPT Temperature: " + String(systemData.temperatureSystem.temperature_mppt) + "</p>";
-        htmlContent += "</div>";
-
-        // Add grey spacer between cards
-        htmlContent += "<div class='spacer'></div>";
-
-        // Close the container and HTML content
-        htmlContent += "</div></body></html>";
-
-        // Send the final HTML response to the client
-        sendResponse(htmlContent);
-    });
+        // Add grey spacer between cards, then close the container and HTML content
+        response->print("<div class='spacer'></div></div></body></html>");
+        request->send(response);
+    }));
         
-    server.on("/reset", HTTP_GET, [](AsyncWebServerRequest *request) {
+    server.on("/reset", HTTP_GET, WithAdmission("/reset", [](AsyncWebServerRequest *request) {
         // log reset message
         request->send(200, "text/html", "<h1>Boat-Companion</h1><p>Resetting...</p>");
         vTaskDelay(pdMS_TO_TICKS(1000));
         ESP.restart();
-    });
+    }));
 
-    server.on("/control-system", HTTP_GET, [](AsyncWebServerRequest *request) {
+    server.on("/control-system", HTTP_GET, WithAdmission("/control-system", [](AsyncWebServerRequest *request) {
         
-        float dac_output = systemData.controlSystem.dac_output;
-        float potentiometer_signal = systemData.controlSystem.potentiometer_signal;
+        if (request->hasParam("current_limit")) {
+            float current_limit = request->getParam("current_limit")->value().toFloat();
+            if (current_limit <= 0.0f) {
+                request->send(400, "text/html", "<h1>Boat-Companion</h1><p>Invalid current limit. Must be a positive value in amperes.</p>");
+                return;
+            }
+            SaveCurrentLimit(current_limit);
+        }
 
-        constexpr uint16_t doc_size = 64;
+        constexpr uint16_t doc_size = 128;
         StaticJsonDocument<doc_size> doc;
-        doc["dac_output"] = dac_output;
-        doc["potentiometer_signal"] = potentiometer_signal;
+        WriteTelemetryJson(telemetry_subsystems[ControlSubsystem], doc);
+        AddStreamStamp(doc, ControlStream);
 
         // Send json using char array
         char output[doc_size];
         serializeJson(doc, output);
         request->send(200, "application/json", output);
-    });
-
-    server.on("/instrumentation-system", HTTP_GET, [](AsyncWebServerRequest *request) {
-        
-        // Send system instrumentation data
-        float battery_voltage = systemData.instrumentationSystem.battery_voltage;
-        float motor_current = systemData.instrumentationSystem.motor_current;
-        float battery_current = systemData.instrumentationSystem.battery_current;
-        float mppt_current = systemData.instrumentationSystem.mppt_current;
-        
-        constexpr uint16_t doc_size = 128;
+    }));
+
+    // Calibrates the throttle output against a multimeter at the motor controller input. GET reports the table and the duty cycle on the pin.
+    // With the motor disconnected and the encoder at zero: POST arm, then within 30s POST hold=N, measure the voltage, save it with
+    // POST point=N&voltage=mV, repeat for every point and finish with POST release. Turning the encoder also releases the output.
+    // The encoder control task, which owns the output, applies each step, so the page may show the state from before the last one.
+    static uint32_t throttle_arm_time = 0;
+    static bool is_throttle_armed = false;
+    constexpr uint32_t throttle_arm_timeout = 30000; // ms
+    auto SendThrottleCalibration = [](AsyncWebServerRequest *request) {
+        constexpr uint16_t doc_size = 384;
         StaticJsonDocument<doc_size> doc;
-        doc["battery_voltage"] = battery_voltage;
-        doc["motor_current"] = motor_current;
-        doc["battery_current"] = battery_current;
-        doc["mppt_current"] = mppt_current;
-        
+        doc["duty"] = throttleOutput.GetDuty();
+        doc["max_duty"] = throttleOutput.GetMaxDuty();
+        doc["holding"] = throttleOutput.IsHolding();
+        doc["armed"] = is_throttle_armed && millis() - throttle_arm_time < throttle_arm_timeout;
+        JsonArray table = doc.createNestedArray("table");
+        for (uint8_t i = 0; i < ThrottleOutput::number_calibration_points; i++) {
+            table.add(throttleOutput.GetCalibrationPoint(i));
+        }
+
         // Send json using char array
         char output[doc_size];
         serializeJson(doc, output);
         request->send(200, "application/json", output);
-    });
+    };
 
-    // temperatures
-    server.on("/temperature-system", HTTP_GET, [](AsyncWebServerRequest *request) {
-        
-        // Send temperature data from singleton class
-        float temperature_motor = systemData.temperatureSystem.temperature_motor;
-        float temperature_battery = systemData.temperatureSystem.temperature_battery;
-        float temperature_mppt = systemData.temperatureSystem.temperature_mppt;
-        
-        constexpr uint16_t doc_size = 128;
-        StaticJsonDocument<doc_size> doc;
-        doc["temperature_motor"] = temperature_motor;
-        doc["temperature_battery"] = temperature_battery;
-        doc["temperature_mppt"] = temperature_mppt;
-        
-        // Send json using char array
-        char output[doc_size];
+    server.on("/throttle-calibration", HTTP_GET, WithAdmission("/throttle-calibration", SendThrottleCalibration));
+
+    server.on("/throttle-calibration", HTTP_POST, WithAdmission("/throttle-calibration", [SendThrottleCalibration](AsyncWebServerRequest *request) {
+        // From the form in the body, or from the query string.
+        auto GetParam = [request](const char* name) { return request->hasParam(name, true) ? request->getParam(name, true) : request->getParam(name); };
+        if (!encoderControlTaskHandle) {
+            request->send(503, "text/html", "<h1>Boat-Companion</h1><p>Encoder control not running.</p>");
+            return;
+        }
+
+        ThrottleCalibrationRequest calibration_request = {};
+        if (GetParam("arm")) {
+            throttle_arm_time = millis();
+            is_throttle_armed = true;
+            SendThrottleCalibration(request);
+            return;
+        } else if (GetParam("hold")) {
+            long point = GetParam("hold")->value().toInt();
+            if (point < 0 || point >= ThrottleOutput::number_calibration_points) {
+                request->send(400, "text/html", "<h1>Boat-Companion</h1><p>Invalid calibration point.</p>");
+                return;
+            }
+            if (!is_throttle_armed || millis() - throttle_arm_time >= throttle_arm_timeout) {
+                request->send(409, "text/html", "<h1>Boat-Companion</h1><p>Arm the calibration first.</p>");
+                return;
+            }
+            if (!isEncoderAtZero) {
+                request->send(409, "text/html", "<h1>Boat-Companion</h1><p>Bring the encoder back to zero first.</p>");
+                return;
+            }
+            is_throttle_armed = false; // Each hold is armed on its own.
+            calibration_request = { ThrottleHoldPoint, (uint8_t)point, 0.0f };
+        } else if (GetParam("point") && GetParam("voltage")) {
+            long point = GetParam("point")->value().toInt();
+            if (point < 0 || point >= ThrottleOutput::number_calibration_points) {
+                request->send(400, "text/html", "<h1>Boat-Companion</h1><p>Invalid calibration point.</p>");
+                return;
+            }
+            calibration_request = { ThrottleSetPoint, (uint8_t)point, GetParam("voltage")->value().toFloat() };
+        } else if (GetParam("release")) {
+            is_throttle_armed = false;
+            calibration_request = { ThrottleRelease, 0, 0.0f };
+        } else {
+            request->send(400, "text/html", "<h1>Boat-Companion</h1><p>Expected arm, hold, point and voltage, or release.</p>");
+            return;
+        }
+        if (xQueueSendToBack(throttleCalibrationQueue, &calibration_request, 0) != pdPASS) {
+            request->send(503, "text/html", "<h1>Boat-Companion</h1><p>Busy, retry later.</p>");
+            return;
+        }
+        SendThrottleCalibration(request);
+    }));
+
+    // Lists the alarm rules and their state. A rule is changed by passing its index and the parameters to change,
+    // e.g. /alarms?rule=0&threshold=85&hysteresis=5&debounce=3000. The table is saved to non volatile memory.
+    server.on("/alarms", HTTP_GET, WithAdmission("/alarms", [](AsyncWebServerRequest *request) {
+
+        if (request->hasParam("rule")) {
+            long index = request->getParam("rule")->value().toInt();
+            if (index < 0 || index >= AlarmEngine::max_rules) {
+                request->send(400, "text/html", "<h1>Boat-Companion</h1><p>Invalid rule index.</p>");
+                return;
+            }
+            AlarmRule rule = alarmEngine.GetRule(index);
+            if (request->hasParam("field")) {
+                long field = request->getParam("field")->value().toInt();
+                rule.field = field >= 0 && field < AlarmField::NumberAlarmFields ? field : AlarmField::NumberAlarmFields; // Refused by SetRule.
+            }
+            if (request->hasParam("comparator")) rule.comparator = request->getParam("comparator")->value().equalsIgnoreCase("below") ? AlarmComparator::Below : AlarmComparator::Above;
+            if (request->hasParam("threshold")) rule.threshold = request->getParam("threshold")->value().toFloat();
+            if (request->hasParam("hysteresis")) rule.hysteresis = request->getParam("hysteresis")->value().toFloat();
+            if (request->hasParam("debounce")) {
+                long debounce = request->getParam("debounce")->value().toInt();
+                if (debounce < 0 || debounce > (long)AlarmEngine::max_debounce) {
+                    request->send(400, "text/html", "<h1>Boat-Companion</h1><p>Invalid debounce, at most 65535 ms.</p>");
+                    return;
+                }
+                rule.debounce = debounce;
+            }
+            if (request->hasParam("severity")) rule.severity = request->getParam("severity")->value().equalsIgnoreCase("critical") ? AlarmSeverity::Critical : AlarmSeverity::Warning;
+            if (request->hasParam("enabled")) rule.enabled = request->getParam("enabled")->value().equalsIgnoreCase("true");
+            if (!alarmEngine.SetRule(index, rule)) {
+                request->send(400, "text/html", "<h1>Boat-Companion</h1><p>Invalid alarm field.</p>");
+                return;
+            }
+        }
+
+        DynamicJsonDocument doc(3072);
+        JsonArray rules = doc.createNestedArray("rules");
+        for (uint8_t i = 0; i < AlarmEngine::max_rules; i++) {
+            AlarmRule rule = alarmEngine.GetRule(i);
+            if (!rule.enabled && rule.threshold == 0.0f) continue; // Skip empty slots.
+            JsonObject entry = rules.createNestedObject();
+            entry["rule"] = i;
+            entry["field"] = rule.field;
+            entry["comparator"] = rule.comparator == AlarmComparator::Below ? "below" : "above";
+            entry["threshold"] = rule.threshold;
+            entry["hysteresis"] = rule.hysteresis;
+            entry["debounce"] = rule.debounce;
+            entry["severity"] = rule.severity == AlarmSeverity::Critical ? "critical" : "warning";
+            entry["enabled"] = (bool)rule.enabled;
+            entry["active"] = alarmEngine.IsActive(i);
+        }
+
+        String output;
         serializeJson(doc, output);
         request->send(200, "application/json", output);
-    });
-    
-    server.on("/gps-system", HTTP_GET, [](AsyncWebServerRequest *request) {
-        
-        // Send GPS data from singleton class
-        float latitude = systemData.gpsSystem.latitude;
-        float longitude = systemData.gpsSystem.longitude;
-        float speed = systemData.gpsSystem.speed;
-        float course = systemData.gpsSystem.course;
-        uint8_t satellites = systemData.gpsSystem.satellites_visible;
-
-        constexpr uint16_t doc_size = 200;
-        StaticJsonDocument<doc_size> doc;
-        doc["latitude"] = latitude;
-        doc["longitude"] = longitude;
-        doc["speed"] = speed;
-        doc["course"] = course;
-        doc["satellites"] = satellites;
+    }));
 
-        // Send json using char array
-        char output[doc_size];
+    server.on("/overcurrent", HTTP_GET, WithAdmission("/overcurrent", [](AsyncWebServerRequest *request) {
+
+        if (request->hasParam("enabled") || request->hasParam("motor") || request->hasParam("battery")) {
+            bool is_enabled = request->hasParam("enabled") ? request->getParam("enabled")->value().equalsIgnoreCase("true") : overcurrentProtection.IsEnabled();
+            float motor_trip = request->hasParam("motor") ? request->getParam("motor")->value().toFloat() : overcurrentProtection.GetTripCurrent(0);
+            float battery_trip = request->hasParam("battery") ? request->getParam("battery")->value().toFloat() : overcurrentProtection.GetTripCurrent(1);
+            if (motor_trip <= 0.0f || battery_trip <= 0.0f) {
+                request->send(400, "text/html", "<h1>Boat-Companion</h1><p>Trip currents must be positive.</p>");
+                return;
+            }
+            overcurrentProtection.Configure(is_enabled, motor_trip, battery_trip);
+        }
+
+        StaticJsonDocument<256> doc;
+        doc["enabled"] = overcurrentProtection.IsEnabled();
+        doc["motor"] = overcurrentProtection.GetTripCurrent(0);
+        doc["battery"] = overcurrentProtection.GetTripCurrent(1);
+        doc["trips"] = overcurrentProtection.GetTripCount();
+        doc["last_channel"] = overcurrentProtection.GetTripChannel() == 0 ? "motor" : "battery";
+        doc["last_latency_us"] = overcurrentProtection.GetLastLatency();
+        doc["max_latency_us"] = overcurrentProtection.GetMaxLatency();
+        doc["interrupt_latency_us"] = overcurrentProtection.GetLastInterruptLatency();
+
+        String output;
         serializeJson(doc, output);
         request->send(200, "application/json", output);
+    }));
 
-    });
+    server.on("/pumps", HTTP_GET, WithAdmission("/pumps", [](AsyncWebServerRequest *request) {
 
-    server.on("/auxiliary-system", HTTP_GET, [](AsyncWebServerRequest *request) {
-        // Send control system data from singleton class
-        uint8_t pumps = systemData.auxiliarySystem.pumps;
-        float aux_current = systemData.auxiliarySystem.current;
-        float aux_voltage = systemData.auxiliarySystem.voltage;
-        
-        constexpr uint16_t doc_size = 128;
-        StaticJsonDocument<doc_size> doc;
-        doc["pumps"] = pumps;
-        doc["aux_current"] = aux_current;
-        doc["aux_voltage"] = aux_voltage;
+        if (request->hasParam("reset")) {
+            pumpMonitor.Reset();
+        }
 
-        // Send json using char array
-        char output[doc_size];
+        constexpr const char* pump_names[] = { "port", "starboard" };
+        StaticJsonDocument<384> doc;
+        for (uint8_t i = 0; i < PumpMonitor::number_pumps; i++) {
+            const PumpMonitor::Counters& counters = pumpMonitor.GetCounters(i);
+            JsonObject pump = doc.createNestedObject(pump_names[i]);
+            pump["on"] = pumpMonitor.IsOn(i);
+            pump["on_time_s"] = (uint32_t)(counters.on_time / 1000);
+            pump["cycles"] = counters.cycles;
+            pump["longest_run_s"] = counters.longest_run / 1000;
+            pump["current_run_s"] = pumpMonitor.GetCurrentRun(i, millis()) / 1000;
+            pump["duty_cycle"] = pumpMonitor.GetDutyCycle(i);
+        }
+
+        String output;
         serializeJson(doc, output);
         request->send(200, "application/json", output);
-    });
+    }));
+
+    // State of the UTC clock: the source disciplining it, the last correction and the drift of the local oscillator.
+    server.on("/time", HTTP_GET, WithAdmission("/time", [](AsyncWebServerRequest *request) {
+        int64_t local = esp_timer_get_time();
+        portENTER_CRITICAL(&timeMutex);
+        TimeService clock = timeService;
+        portEXIT_CRITICAL(&timeMutex);
+
+        StaticJsonDocument<384> doc;
+        doc["synchronized"] = clock.IsSynchronized();
+        doc["source"] = TimeService::GetSourceName(clock.GetSource());
+        if (clock.IsSynchronized()) {
+            int64_t utc = clock.ToUtc(local);
+            time_t seconds = utc / 1000000;
+            char text[32];
+            size_t length = strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%S", gmtime(&seconds));
+            snprintf(text + length, sizeof(text) - length, ".%03dZ", (int)(utc % 1000000 / 1000));
+            doc["utc"] = text;
+            doc["offset_us"] = (int32_t)clock.GetOffset();
+            doc["jitter_us"] = (int32_t)clock.GetJitter();
+            doc["drift_ppm"] = clock.GetDrift();
+            doc["steps"] = clock.GetSteps();
+            doc["last_update_s"] = (uint32_t)((local - clock.GetLastUpdate()) / 1000000);
+        }
+        doc["time_boot_ms"] = millis();
 
-    // Send lora_params to Lora radio via serial port Mavlink message
-    server.on("lora-params", HTTP_GET, [](AsyncWebServerRequest *request) {
+        String output;
+        serializeJson(doc, output);
+        request->send(200, "application/json", output);
+    }));
+
+    // Frames of each telemetry stream counted at every hop on the way out, with the latest sequence number and sample time.
+    // The ground compares them with what it received to tell where frames are lost.
+    server.on("/telemetry-stats", HTTP_GET, WithAdmission("/telemetry-stats", [](AsyncWebServerRequest *request) {
+        DynamicJsonDocument doc(2048);
+        doc["time_boot_ms"] = millis();
+        doc["queue_drops"] = transmitQueueDrops;
+        JsonObject streams = doc.createNestedObject("streams");
+        for (uint8_t i = 0; i < NumberTelemetryStreams; i++) {
+            TelemetryStream stream = (TelemetryStream)i;
+            JsonObject entry = streams.createNestedObject(TelemetryStreams::GetName(stream));
+            TelemetryStreams::Latest latest = telemetryStreams.GetLatest(stream);
+            if (latest.is_valid) {
+                entry["seq"] = latest.seq;
+                entry["sample_time_ms"] = latest.sample_time;
+            }
+            for (uint8_t hop = 0; hop < TelemetryStreams::NumberHops; hop++) {
+                entry[TelemetryStreams::GetHopName((TelemetryStreams::Hop)hop)] = telemetryStreams.GetCount(stream, (TelemetryStreams::Hop)hop);
+            }
+        }
+
+        String output;
+        serializeJson(doc, output);
+        request->send(200, "application/json", output);
+    }));
+
+    // Storage of the race log and how far it has got. The log itself is read from the SD card or a dump of the partition with RaceLogReader.
+    server.on("/race-log", HTTP_GET, WithAdmission("/race-log", [](AsyncWebServerRequest *request) {
+        portENTER_CRITICAL(&raceLogMutex);
+        RaceLog::Writer<3>::Statistics statistics = raceLog.GetStatistics();
+        uint32_t next_sequence = raceLog.GetNextSequence();
+        uint32_t boot = raceLog.GetBoot();
+        portEXIT_CRITICAL(&raceLogMutex);
+
+        StaticJsonDocument<384> doc;
+        doc["enabled"] = (bool)isRaceLogEnabled;
+        doc["storage"] = raceLogStorage;
+        doc["capacity_blocks"] = raceLogCapacity;
+        doc["boot"] = boot;
+        doc["next_block"] = next_sequence;
+        doc["records"] = statistics.records;
+        doc["blocks"] = statistics.blocks;
+        doc["dropped"] = statistics.dropped;
+        doc["write_errors"] = raceLogWriteErrors;
+
+        String output;
+        serializeJson(doc, output);
+        request->send(200, "application/json", output);
+    }));
+
+    // Download of the race log, streamed from the storage one block at a time: /log/export?format=bin|lz4|csv&from=&to=&first=
+    // from and to are Unix times in s. bin is the blocks as stored, for RaceLogReader, and honours Range requests, checked against its
+    // ETag with If-Range, so a download cut by the 4G link resumes where it stopped. lz4 is the same blocks in an LZ4 frame, which
+    // lz4 -d turns back into bin, and csv gives one line per frame; both are sent chunked, and resume from a block with first=<sequence>. One export at a time, as the exporter holds the only buffer.
+    server.on("/log/export", HTTP_GET, WithAdmission("/log/export", [](AsyncWebServerRequest *request) {
+        if (!isRaceLogEnabled) {
+            request->send(503, "text/html", "<h1>Boat-Companion</h1><p>Race log disabled.</p>");
+            return;
+        }
+        if (isRaceLogExportBusy) {
+            request->send(503, "text/html", "<h1>Boat-Companion</h1><p>An export is already running.</p>");
+            return;
+        }
+
+        RaceLog::ExportQuery query = {};
+        String format = request->hasParam("format") ? request->getParam("format")->value() : "bin";
+        if (format == "bin") query.format = RaceLog::ExportBlocks;
+        else if (format == "lz4") query.format = RaceLog::ExportCompressed;
+        else if (format == "csv") query.format = RaceLog::ExportCsv;
+        else {
+            request->send(400, "text/html", "<h1>Boat-Companion</h1><p>Format must be bin, lz4 or csv.</p>");
+            return;
+        }
+        if (request->hasParam("from")) query.from_utc = (int64_t)request->getParam("from")->value().toInt() * 1000000;
+        if (request->hasParam("to")) query.to_utc = (int64_t)request->getParam("to")->value().toInt() * 1000000;
+        if (request->hasParam("first")) query.first_sequence = request->getParam("first")->value().toInt();
+        // The end of the query and the oldest block of the ring are taken together, as the race log task moves both.
+        uint32_t oldest_index;
+        portENTER_CRITICAL(&raceLogMutex);
+        query.end_sequence = raceLog.GetNextSequence();
+        oldest_index = raceLogNextIndex;
+        portEXIT_CRITICAL(&raceLogMutex);
+
+        uint32_t number_blocks;
+        if (raceLogPartition) {
+            raceLogExportOldest = oldest_index;
+            number_blocks = raceLogCapacity;
+        } else {
+            raceLogExportFile = SD.open(race_log_file_name, FILE_READ);
+            if (!raceLogExportFile) {
+                request->send(500, "text/html", "<h1>Boat-Companion</h1><p>Cannot open the race log.</p>");
+                return;
+            }
+            number_blocks = raceLogExportFile.size() / RaceLog::block_size;
+        }
+        isRaceLogExportBusy = true;
+        OnRequestEnd(request, []() {
+            if (raceLogExportFile) raceLogExportFile.close();
+            isRaceLogExportBusy = false;
+        });
+
+        AwsResponseFiller filler = [](uint8_t* buffer, size_t max_length, size_t) -> size_t { return raceLogExporter.Fill(buffer, max_length); };
+        AsyncWebServerResponse* response;
+        if (query.format == RaceLog::ExportBlocks) {
+            // Only the open form sent by resuming clients, bytes=<start>-.
+            uint32_t start = 0;
+            if (request->hasHeader("Range")) {
+                String range = request->getHeader("Range")->value();
+                if (range.startsWith("bytes=")) start = range.substring(6).toInt();
+            }
+            // The ETag names the blocks of the export: the end of the query, its oldest block and their number. A client that resumes with
+            // If-Range gets the export up to the same end, and its rest only while its oldest block has not been overwritten and no block
+            // has gone since; otherwise that export again from the start, under the ETag of what is left of it.
+            unsigned long tag_end = 0, tag_first = 0, tag_count = 0;
+            bool is_tagged = request->hasHeader("If-Range")
+                && sscanf(request->getHeader("If-Range")->value().c_str(), "\"%lu-%lu-%lu\"", &tag_end, &tag_first, &tag_count) == 3
+                && tag_end <= query.end_sequence;
+            if (is_tagged) query.end_sequence = tag_end;
+            raceLogExporter.Begin(query, number_blocks, ReadRaceLogExport);
+            if (request->hasHeader("If-Range") && !(is_tagged && raceLogExporter.GetFirstSequence() == tag_first && raceLogExporter.GetNumberBlocks() == tag_count)) {
+                start = 0;
+            }
+            uint32_t total = raceLogExporter.GetNumberBlocks() * RaceLog::block_size;
+            if (start && start >= total) {
+                request->send(416, "text/html", "<h1>Boat-Companion</h1><p>Range past the end of the race log.</p>");
+                return;
+            }
+            raceLogExporter.Skip(start);
+            response = request->beginResponse("application/octet-stream", total - start, filler);
+            if (start) {
+                response->setCode(206);
+                response->addHeader("Content-Range", "bytes " + String(start) + "-" + String(total - 1) + "/" + String(total));
+            }
+            response->addHeader("Accept-Ranges", "bytes");
+            response->addHeader("ETag", "\"" + String(query.end_sequence) + "-" + String(raceLogExporter.GetFirstSequence()) + "-"
+                + String(raceLogExporter.GetNumberBlocks()) + "\"");
+        } else {
+            raceLogExporter.Begin(query, number_blocks, ReadRaceLogExport);
+            response = request->beginChunkedResponse(query.format == RaceLog::ExportCsv ? "text/csv" : "application/octet-stream", filler);
+        }
+        response->addHeader("Content-Disposition", "attachment; filename=racelog." + format);
+        request->send(response);
+    }));
+
+    // Load of the web server: the learned cost of each route, the requests admitted and shed, and what is left of the shared budget.
+    server.on("/server-stats", HTTP_GET, WithAdmission("/server-stats", [](AsyncWebServerRequest *request) {
+        DynamicJsonDocument doc(3072);
+        doc["time_boot_ms"] = millis();
+        doc["concurrent"] = admissionControl.GetConcurrent();
+        doc["budget_us"] = admissionControl.GetServerLevel(millis());
+        doc["shed_client"] = admissionControl.GetShed(ClientOverBudget);
+        doc["shed_server"] = admissionControl.GetShed(ServerOverBudget);
+        doc["shed_concurrent"] = admissionControl.GetShed(TooManyConcurrent);
+        JsonObject routes = doc.createNestedObject("routes");
+        for (uint8_t i = 0; i < admissionControl.GetNumberRoutes(); i++) {
+            const auto& route = admissionControl.GetRoute(i);
+            JsonObject entry = routes.createNestedObject(route.name);
+            entry["mean_us"] = route.mean_cost;
+            entry["max_us"] = route.max_cost;
+            entry["admitted"] = route.admitted;
+            entry["shed"] = route.shed;
+        }
+
+        String output;
+        serializeJson(doc, output);
+        request->send(200, "application/json", output);
+    }));
+
+    // Run time of each job of the executor and the memory left, which shows the heap given back by running the jobs on one stack.
+    server.on("/jobs", HTTP_GET, WithAdmission("/jobs", [](AsyncWebServerRequest *request) {
+        DynamicJsonDocument doc(4096);
+        doc["time_boot_ms"] = millis();
+        doc["free_heap"] = esp_get_free_heap_size();
+        doc["min_free_heap"] = esp_get_minimum_free_heap_size();
+        doc["tasks"] = uxTaskGetNumberOfTasks();
+        doc["executor_free_stack"] = jobExecutorTaskHandle ? uxTaskGetStackHighWaterMark(jobExecutorTaskHandle) : 0;
+        JsonObject jobs = doc.createNestedObject("jobs");
+        for (uint8_t i = 0; i < jobExecutor.GetNumberJobs(); i++) {
+            const auto& job = jobExecutor.GetStatistics(i);
+            JsonObject entry = jobs.createNestedObject(job.name);
+            entry["runs"] = job.runs;
+            entry["mean_us"] = job.runs ? job.total_time / job.runs : 0;
+            entry["max_us"] = job.max_time;
+            entry["max_late_ms"] = job.max_lateness;
+        }
+        // Time of each stage of the sensor pipelines, with their errors, drops and restarts.
+        static constexpr const char* stage_names[NumberSensorPipelineStages] = { "read", "convert", "filter", "publish" };
+        JsonObject sensors = doc.createNestedObject("sensors");
+        for (uint8_t i = 0; i < numberSensorStatistics; i++) {
+            const SensorPipelineStatistics& statistics = *sensorStatistics[i];
+            JsonObject entry = sensors.createNestedObject(statistics.name);
+            entry["samples"] = statistics.samples;
+            entry["errors"] = statistics.errors;
+            entry["drops"] = statistics.drops;
+            entry["restarts"] = statistics.restarts;
+            entry["begin_failures"] = statistics.begin_failures;
+            for (uint8_t stage = 0; stage < NumberSensorPipelineStages; stage++) {
+                const auto& time = statistics.stages[stage];
+                JsonObject stage_entry = entry.createNestedObject(stage_names[stage]);
+                stage_entry["mean_us"] = time.runs ? time.total_time / time.runs : 0;
+                stage_entry["max_us"] = time.max_time;
+            }
+        }
+
+        String output;
+        serializeJson(doc, output);
+        request->send(200, "application/json", output);
+    }));
+
+    // Latency and errors of each device on the I2C bus, and the recoveries of the bus.
+    server.on("/i2c", HTTP_GET, WithAdmission("/i2c", [](AsyncWebServerRequest *request) {
+        StaticJsonDocument<1536> doc;
+        doc["recoveries"] = i2cBus.GetRecoveries();
+        doc["queue_full"] = i2cBus.GetQueueFull();
+        JsonArray devices = doc.createNestedArray("devices");
+        for (uint8_t i = 0; i < i2cBus.GetNumberDevices(); i++) {
+            const I2cBus::DeviceStatistics& device = i2cBus.GetDeviceStatistics(i);
+            JsonObject entry = devices.createNestedObject();
+            entry["address"] = device.address;
+            entry["transactions"] = device.transactions;
+            entry["nacks"] = device.nacks;
+            entry["timeouts"] = device.timeouts;
+            entry["bus_errors"] = device.bus_errors;
+            entry["deadline_misses"] = device.deadline_misses;
+            entry["mean_latency_us"] = device.transactions ? device.total_latency / device.transactions : 0;
+            entry["max_latency_us"] = device.max_latency;
+            entry["max_transfer_us"] = device.max_transfer_time;
+        }
+
+        String output;
+        serializeJson(doc, output);
+        request->send(200, "application/json", output);
+    }));
+
+    // Address of the ground merger, which takes the telemetry over UDP, and the health of both paths to the shore.
+    server.on("/ip-telemetry", HTTP_GET, WithAdmission("/ip-telemetry", [](AsyncWebServerRequest *request) {
+
+        if (request->hasParam("enabled") || request->hasParam("host") || request->hasParam("port")) {
+            IPAddress address = groundAddress;
+            if (request->hasParam("host") && !address.fromString(request->getParam("host")->value())) {
+                request->send(400, "text/html", "<h1>Boat-Companion</h1><p>host must be an IPv4 address.</p>");
+                return;
+            }
+            long port = request->hasParam("port") ? request->getParam("port")->value().toInt() : groundPort;
+            if (port < 1 || port > 65535) {
+                request->send(400, "text/html", "<h1>Boat-Companion</h1><p>port must be between 1 and 65535.</p>");
+                return;
+            }
+            isIpTelemetryEnabled = request->hasParam("enabled") ? request->getParam("enabled")->value().equalsIgnoreCase("true") : isIpTelemetryEnabled;
+            groundAddress = address;
+            groundPort = port;
+            ipSettingsVersion++;
+            Preferences preferences;
+            preferences.begin("iplink", false);
+            preferences.putBool("enabled", isIpTelemetryEnabled);
+            preferences.putString("host", groundAddress.toString());
+            preferences.putUShort("port", groundPort);
+            preferences.end();
+        }
+
+        uint32_t now = millis();
+        portENTER_CRITICAL(&fanoutMutex);
+        TelemetryFanout fanout = telemetryFanout;
+        portEXIT_CRITICAL(&fanoutMutex);
+
+        StaticJsonDocument<512> doc;
+        doc["enabled"] = isIpTelemetryEnabled;
+        doc["host"] = groundAddress.toString();
+        doc["port"] = groundPort;
+        int8_t best = fanout.GetBest(now);
+        doc["best_path"] = best < 0 ? "none" : TelemetryFanout::GetName((TelemetryPath)best);
+        for (uint8_t i = 0; i < NumberTelemetryPaths; i++) {
+            TelemetryPath path = (TelemetryPath)i;
+            const TelemetryFanout::Health& health = fanout.GetHealth(path);
+            JsonObject entry = doc.createNestedObject(TelemetryFanout::GetName(path));
+            entry["available"] = health.is_available;
+            entry["healthy"] = fanout.IsHealthy(path, now);
+            entry["loss"] = health.loss;
+            entry["latency_ms"] = health.latency;
+            if (health.has_report) entry["report_age_s"] = (now - health.last_report) / 1000;
+        }
+
+        String output;
+        serializeJson(doc, output);
+        request->send(200, "application/json", output);
+    }));
+
+    server.on("/fec", HTTP_GET, WithAdmission("/fec", [](AsyncWebServerRequest *request) {
+
+        if (request->hasParam("enabled") || request->hasParam("k") || request->hasParam("m")) {
+            bool is_enabled = request->hasParam("enabled") ? request->getParam("enabled")->value().equalsIgnoreCase("true") : isFecEnabled;
+            long data_frames = request->hasParam("k") ? request->getParam("k")->value().toInt() : fecDataFrames;
+            long parity_frames = request->hasParam("m") ? request->getParam("m")->value().toInt() : fecParityFrames;
+            if (data_frames < 1 || data_frames > PacketFec::max_data_frames || parity_frames < 1 || parity_frames > PacketFec::max_parity_frames) {
+                request->send(400, "text/html", "<h1>Boat-Companion</h1><p>k must be between 1 and " + String(PacketFec::max_data_frames) +
+                                                " and m between 1 and " + String(PacketFec::max_parity_frames) + ".</p>");
+                return;
+            }
+            isFecEnabled = is_enabled;
+            fecDataFrames = data_frames;
+            fecParityFrames = parity_frames;
+            fecSettingsVersion++;
+            Preferences preferences;
+            preferences.begin("fec", false);
+            preferences.putBool("enabled", isFecEnabled);
+            preferences.putUChar("k", fecDataFrames);
+            preferences.putUChar("m", fecParityFrames);
+            preferences.end();
+        }
+
+        StaticJsonDocument<256> doc;
+        doc["enabled"] = isFecEnabled;
+        doc["k"] = fecDataFrames;
+        doc["m"] = fecParityFrames;
+        doc["overhead"] = (float)fecParityFrames / fecDataFrames; // Extra frames per data frame, in a full group.
+        doc["groups"] = fecGroupsSent;
+        doc["parity_frames"] = fecParitySent;
+
+        String output;
+        serializeJson(doc, output);
+        request->send(200, "application/json", output);
+    }));
+
+    server.on("/calibration", HTTP_GET, WithAdmission("/calibration", [](AsyncWebServerRequest *request) {
+
+        if (request->hasParam("action")) {
+            constexpr const char* action_names[] = { "start", "capture", "commit", "abort" };
+            String action_name = request->getParam("action")->value();
+            int8_t action = -1;
+            for (uint8_t i = 0; i < 4; i++) {
+                if (action_name.equalsIgnoreCase(action_names[i])) action = i;
+            }
+            long channel = request->hasParam("channel") ? request->getParam("channel")->value().toInt() : NumberCalibrationChannels;
+            float reference = request->hasParam("reference") ? request->getParam("reference")->value().toFloat() : 0.0f;
+            long samples = request->hasParam("samples") ? request->getParam("samples")->value().toInt() : CalibrationEngine::default_samples_per_point;
+            if (channel < 0 || channel > NumberCalibrationChannels) channel = NumberCalibrationChannels; // Refused by Start.
+            if (samples < 0) {
+                request->send(400, "text/html", "<h1>Boat-Companion</h1><p>Invalid number of samples.</p>");
+                return;
+            }
+            if (action < 0 || (action == CalibrationEngine::Action::Capture && !request->hasParam("reference"))) {
+                request->send(400, "text/html", "<h1>Boat-Companion</h1><p>Invalid calibration action or missing reference.</p>");
+                return;
+            }
+            if (calibrationEngine.Execute((CalibrationEngine::Action)action, channel, reference, samples) != CalibrationEngine::Result::Ok) {
+                request->send(400, "text/html", "<h1>Boat-Companion</h1><p>Calibration command rejected, check the status for the reason.</p>");
+                return;
+            }
+        }
+
+        constexpr const char* state_names[] = { "idle", "waiting_reference", "sampling" };
+        constexpr const char* result_names[] = { "ok", "invalid_channel", "invalid_state", "too_many_points", "too_few_points", "degenerate_fit", "storage_error" };
+        CalibrationEngine::Status status = calibrationEngine.GetStatus();
+        StaticJsonDocument<1024> doc;
+        doc["state"] = state_names[status.state];
+        doc["channel"] = status.channel;
+        doc["samples_collected"] = status.samples_collected;
+        doc["samples_per_point"] = status.samples_per_point;
+        doc["last_result"] = result_names[status.last_result];
+        doc["residual"] = status.residual;
+        JsonArray points = doc.createNestedArray("points");
+        for (uint8_t i = 0; i < status.number_points; i++) {
+            JsonObject point = points.createNestedObject();
+            CalibrationEngine::Point calibration_point = calibrationEngine.GetPoint(i);
+            point["raw"] = calibration_point.raw;
+            point["reference"] = calibration_point.reference;
+        }
+        JsonArray channels = doc.createNestedArray("channels");
+        for (uint8_t i = 0; i < NumberCalibrationChannels; i++) {
+            CalibrationEngine::Coefficients coefficients = calibrationEngine.GetCoefficients(i);
+            JsonObject entry = channels.createNestedObject();
+            entry["slope"] = coefficients.slope;
+            entry["intercept"] = coefficients.intercept;
+        }
+
+        String output;
+        serializeJson(doc, output);
+        request->send(200, "application/json", output);
+    }));
+
+    server.on("/capture", HTTP_GET, WithAdmission("/capture", [](AsyncWebServerRequest *request) {
+
+        if (request->hasParam("arm")) {
+            TransientCapture::TriggerConfig config = transientCapture.GetConfig();
+            if (request->hasParam("channel")) config.channel = request->getParam("channel")->value().toInt();
+            if (request->hasParam("trigger")) config.type = request->getParam("trigger")->value().equalsIgnoreCase("slope") ? TransientCapture::TriggerType::Slope : TransientCapture::TriggerType::Threshold;
+            if (request->hasParam("level")) config.level = request->getParam("level")->value().toFloat();
+            if (request->hasParam("pre")) config.pre_trigger = request->getParam("pre")->value().toInt();
+            if (request->hasParam("post")) config.post_trigger = request->getParam("post")->value().toInt();
+            if (request->hasParam("rearm")) config.is_auto_rearm = request->getParam("rearm")->value().equalsIgnoreCase("true");
+            if (config.channel >= TransientCapture::number_channels) {
+                request->send(400, "text/html", "<h1>Boat-Companion</h1><p>Invalid capture channel.</p>");
+                return;
+            }
+            transientCapture.Arm(config);
+        } else if (request->hasParam("disarm")) {
+            transientCapture.Disarm();
+        }
+
+        if (request->hasParam("stream")) {
+            uint8_t index = request->getParam("stream")->value().toInt();
+            if (captureStreamSlot >= 0 || !transientCapture.Lock(index)) {
+                request->send(409, "text/html", "<h1>Boat-Companion</h1><p>Capture not available or a stream is already in progress.</p>");
+                return;
+            }
+            // The instrumentation reader sends the chunks and unlocks the slot after the last one.
+            captureStreamOffset = 0;
+            captureStreamSlot = index;
+        }
+
+        constexpr const char* state_names[] = { "disarmed", "armed", "triggered" };
+        const TransientCapture::TriggerConfig& config = transientCapture.GetConfig();
+        StaticJsonDocument<768> doc;
+        doc["state"] = state_names[transientCapture.GetState()];
+        doc["channel"] = config.channel;
+        doc["trigger"] = config.type == TransientCapture::TriggerType::Slope ? "slope" : "threshold";
+        doc["level"] = config.level;
+        doc["pre"] = config.pre_trigger;
+        doc["post"] = config.post_trigger;
+        doc["rearm"] = config.is_auto_rearm;
+        doc["captures"] = transientCapture.GetNumberCaptures();
+        doc["dropped"] = transientCapture.GetDroppedCaptures();
+        JsonArray slots = doc.createNestedArray("slots");
+        for (uint8_t i = 0; i < TransientCapture::number_slots; i++) {
+            const TransientCapture::Slot& slot = transientCapture.GetSlot(i);
+            JsonObject entry = slots.createNestedObject();
+            entry["valid"] = slot.is_valid;
+            entry["locked"] = (bool)slot.is_locked;
+            entry["trigger_time"] = slot.trigger_timestamp;
+            entry["samples"] = slot.number_samples;
+        }
+
+        String output;
+        serializeJson(doc, output);
+        request->send(200, "application/json", output);
+    }));
+
+    server.on("/capture-data", HTTP_GET, WithAdmission("/capture-data", [](AsyncWebServerRequest *request) {
+
+        uint8_t index = request->hasParam("slot") ? request->getParam("slot")->value().toInt() : 0;
+        const TransientCapture::Slot* slot = transientCapture.Lock(index);
+        if (!slot) {
+            request->send(404, "text/html", "<h1>Boat-Companion</h1><p>Capture not available.</p>");
+            return;
+        }
+
+        // The capture is written as CSV a few rows at a time, so the whole table never sits in memory. Times are relative to the trigger.
+        // The slot stays locked until the last row is written or the client goes away, so a new capture cannot overwrite it halfway through.
+        // Both ends share whether it was given back, so it is unlocked only once and never from under the next download of the slot.
+        std::shared_ptr<bool> is_unlocked = std::make_shared<bool>(false);
+        auto Unlock = [index, is_unlocked]() {
+            if (*is_unlocked) return;
+            *is_unlocked = true;
+            transientCapture.Unlock(index);
+        };
+        OnRequestEnd(request, Unlock);
+        uint16_t row = 0;
+        bool is_header_sent = false;
+        AsyncWebServerResponse* response = request->beginChunkedResponse("text/csv", [slot, Unlock, row, is_header_sent](uint8_t* buffer, size_t max_length, size_t) mutable -> size_t {
+            size_t length = 0;
+            if (!is_header_sent) {
+                length += snprintf((char*)buffer, max_length, "time_us,motor_current,battery_current\n");
+                is_header_sent = true;
+            }
+            constexpr size_t max_row_length = 40;
+            while (row < slot->number_samples && max_length - length > max_row_length) {
+                const TransientCapture::Sample& sample = slot->samples[row];
+                length += snprintf((char*)buffer + length, max_length - length, "%d,%.2f,%.2f\n", (int32_t)(sample.timestamp - slot->trigger_timestamp), sample.values[0] / 100.0f, sample.values[1] / 100.0f);
+                row++;
+            }
+            if (length == 0) Unlock();
+            return length;
+        });
+        request->send(response);
+    }));
+
+    // Current values of the other subsystems, one route each, with the fields of the telemetry schema. Control has its own route above,
+    // which also sets the current limit.
+    for (uint8_t i = 0; i < NumberTelemetrySubsystems; i++) {
+        const TelemetrySubsystem* subsystem = &telemetry_subsystems[i];
+        if (i == ControlSubsystem) continue;
+        server.on(subsystem->route, HTTP_GET, WithAdmission(subsystem->route, [subsystem](AsyncWebServerRequest *request) {
+            constexpr uint16_t doc_size = 256;
+            StaticJsonDocument<doc_size> doc;
+            WriteTelemetryJson(*subsystem, doc);
+            AddStreamStamp(doc, subsystem->stream);
+
+            // Send json using char array
+            char output[doc_size];
+            serializeJson(doc, output);
+            request->send(200, "application/json", output);
+        }));
+    }
+
+    // Shows the state of the adaptive data rate of the LoRa link. Any of the modulation parameters fixes the setting and disables the adaptation,
+    // which is resumed with auto=true.
+    server.on("/lora-params", HTTP_GET, WithAdmission("/lora-params", [](AsyncWebServerRequest *request) {
         
         String response_message = "<h1>Boat-Companion</h1>";
-        int bandwidth;
-        uint8_t codingRate4;
-        uint8_t spreadingFactor;
-        uint8_t crc;
+        portENTER_CRITICAL(&linkRateMutex);
+        LoraSetting setting = linkRateController.GetSetting();
+        portEXIT_CRITICAL(&linkRateMutex);
+        bool is_manual = false;
         
+        // Values are checked at the full width of the parameter, before they are narrowed into the setting.
         if (request->hasParam("codingRate4")) {
-            codingRate4 = request->getParam("codingRate4")->value().toInt();
-            if (codingRate4 < 5 || codingRate4 > 8) {
+            long coding_rate = request->getParam("codingRate4")->value().toInt();
+            if (coding_rate < 5 || coding_rate > 8) {
                 response_message += "<p>Invalid coding rate 4 value. Must be between 5 and 8.</p>";
                 request->send(400, "text/html", response_message);
                 return;
             }
+            setting.coding_rate = coding_rate;
+            is_manual = true;
         }
 
         if (request->hasParam("bandwidth")) {
-            bandwidth = request->getParam("bandwidth")->value().toInt();
+            long bandwidth = request->getParam("bandwidth")->value().toInt();
             if (bandwidth < 7E3 || bandwidth > 500E3) {
                 response_message += "<p>Invalid bandwidth value. Must be between 7E3 and 500E3.</p>";
                 request->send(400, "text/html", response_message);
                 return;
             }
-            response_message += "<p>Bandwidth set to " + String(bandwidth) + "</p>";
+            setting.bandwidth = bandwidth;
+            is_manual = true;
         }
 
         if (request->hasParam("spreadingFactor")) {
-            spreadingFactor = request->getParam("spreadingFactor")->value().toInt();
-            if (spreadingFactor < 6 || spreadingFactor > 12) {
-                response_message += "<p>Invalid spreading factor value. Must be between 6 and 12.</p>";
+            long spreading_factor = request->getParam("spreadingFactor")->value().toInt();
+            if (spreading_factor < 7 || spreading_factor > 12) {
+                // SF6 needs an implicit header, which the LoRa board does not use.
+                response_message += "<p>Invalid spreading factor value. Must be between 7 and 12.</p>";
                 request->send(400, "text/html", response_message);
                 return;
             }
-            response_message += "<p>Spreading factor set to " + String(spreadingFactor) + "</p>";
+            setting.spreading_factor = spreading_factor;
+            is_manual = true;
         }
 
         if (request->hasParam("crc")) {
-            crc = request->getParam("crc")->value().equalsIgnoreCase("true");
-            response_message += "<p>CRC set to " + String(crc) + "</p>";
+            isLoraCrcEnabled = request->getParam("crc")->value().equalsIgnoreCase("true");
+            is_manual = true;
         }
 
-        mavlink_message_t msg;
-        mavlink_lora_params_t lora_params = { bandwidth, spreadingFactor, codingRate4, crc };
-        mavlink_msg_lora_params_encode(1, 200, &msg, &lora_params);
-        uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
-        uint16_t len = mavlink_msg_to_send_buffer(buffer, &msg);
-        Serial.write(buffer, len);
-    });
+        bool is_automatic = request->hasParam("auto") && request->getParam("auto")->value().equalsIgnoreCase("true");
+        portENTER_CRITICAL(&linkRateMutex);
+        if (is_automatic) {
+            linkRateController.SetAutomatic(millis());
+        } else if (is_manual) {
+            linkRateController.SetManual(setting, millis());
+        }
+        setting = linkRateController.GetSetting();
+        LinkRateController status = linkRateController;
+        portEXIT_CRITICAL(&linkRateMutex);
+        if (is_automatic || is_manual) {
+            SendLoraParams(setting);
+        }
+
+        StaticJsonDocument<1536> doc;
+        doc["mode"] = status.IsAutomatic() ? "auto" : "manual";
+        doc["spreadingFactor"] = setting.spreading_factor;
+        doc["bandwidth"] = setting.bandwidth;
+        doc["codingRate4"] = setting.coding_rate;
+        doc["crc"] = isLoraCrcEnabled;
+        doc["applied"] = status.IsApplied();
+        doc["rung"] = status.GetRungIndex();
+        doc["loss"] = status.GetLoss();
+        doc["snr"] = status.GetSnr();
+        doc["rssi"] = status.GetRssi();
+        doc["margin"] = status.GetMargin();
+        doc["airtime_ms"] = status.GetAirtime();
+        doc["throughput"] = status.GetThroughput();
+        doc["utilization"] = status.GetUtilization();
+        xSemaphoreTake(reliableMutex, portMAX_DELAY);
+        ReliableLink::Sender<8>::Statistics reliable_statistics = reliableSender.GetStatistics();
+        JsonObject reliable = doc.createNestedObject("reliable");
+        reliable["in_flight"] = reliableSender.GetInFlight();
+        reliable["srtt_ms"] = reliableSender.GetSrtt();
+        reliable["rto_ms"] = reliableSender.GetRto();
+        xSemaphoreGive(reliableMutex);
+        reliable["sent"] = reliable_statistics.sent;
+        reliable["delivered"] = reliable_statistics.delivered;
+        reliable["retransmissions"] = reliable_statistics.retransmissions;
+        reliable["failed"] = reliable_statistics.failed;
+        reliable["rejected"] = reliable_statistics.rejected;
+        reliable["superseded"] = reliable_statistics.superseded;
+        JsonArray ladder = doc.createNestedArray("ladder");
+        for (uint8_t i = 0; i < LinkRateController::number_rungs; i++) {
+            const LoraSetting& rung = status.GetRung(i);
+            JsonObject entry = ladder.createNestedObject();
+            entry["spreadingFactor"] = rung.spreading_factor;
+            entry["bandwidth"] = rung.bandwidth;
+            entry["codingRate4"] = rung.coding_rate;
+            entry["airtime_ms"] = LoraAirtime(rung, LinkRateController::reference_frame_length);
+        }
+
+        String output;
+        serializeJson(doc, output);
+        request->send(200, "application/json", output);
+    }));
 
     //Wait for notification from WiFi connection task before starting the server.
     ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
@@ -456,59 +1559,457 @@ void ServerTask(void* parameter) {
             client->close();
         }, nullptr);
 
-        client->onConnect([targetURL, ipv6](void* arg, AsyncClient* client) {
-            Serial.println("Connected");
-            String fullURL = "GET " + targetURL + " HTTP/1.1\r\nHost: [" + ipv6.toString() + "]\r\nConnection: close\r\n\r\n";
-            Serial.printf("Sending request: %s\n", fullURL.c_str());
-            client->write(fullURL.c_str(), strlen(fullURL.c_str()));
-        }, nullptr);
+        client->onConnect([targetURL, ipv6](void* arg, AsyncClient* client) {
+            Serial.println("Connected");
+            String fullURL = "GET " + targetURL + " HTTP/1.1\r\nHost: [" + ipv6.toString() + "]\r\nConnection: close\r\n\r\n";
+            Serial.printf("Sending request: %s\n", fullURL.c_str());
+            client->write(fullURL.c_str(), strlen(fullURL.c_str()));
+        }, nullptr);
+
+        client->onDisconnect([](void* arg, AsyncClient* client) {
+            Serial.println("Disconnected");
+            client->close();
+            delete client;
+        }, nullptr);
+
+        client->onTimeout([](void* arg, AsyncClient* client, int32_t time) {
+            Serial.printf("Timeout: %d\n", time);
+            client->close();
+        }, nullptr);
+
+        client->onAck([](void* arg, AsyncClient* client, size_t len, int32_t time) {
+            Serial.printf("Ack: %d\n", time);
+            
+        }, nullptr);
+
+        client->onData([](void* arg, AsyncClient* client, void* data, size_t len) {
+            Serial.printf("Data: %s\n", (char*)data);
+        }, nullptr);
+
+        client->connect(ipv6, 80);
+
+        #endif
+    }
+}
+
+void VPNConnectionTask(void* parameter) {
+
+    // The use of a VPN is to allow this device to be accessed from the public internet without port forwarding or paying for a static IPV4 address.
+    // It accomplishes this by creating a virtual network between all devices that are connected to it, taking advantage of IPv6 addressing.
+    // Each device is assigned a unique IPv6 address that can be used to access it from anywhere in the world.
+    // The Husarnet VPN is free for up to 5 devices.
+    // By attaching a router with a SIM slot on the boat, messages can be exchanged by both the internet, using HTTP or WebSockets, and the LoRa radio.
+
+    // Husarnet VPN configuration parameters
+    const char* hostName = hostnameGlobal; // Host name can be used to access the device instead of typing IPV6 address
+    const char* husarnetJoinCode = "fc94:b01d:1803:8dd8:b293:5c7d:7639:932a/6xGMdTUA3N8RT2FzprVMEi";
+    const char* dashboardURL = "default";
+
+    // Wait for notification that WiFi is connected before starting the VPN.
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    Husarnet.selfHostedSetup(dashboardURL);
+    Husarnet.join(husarnetJoinCode, hostName);
+    Husarnet.start();
+    vTaskDelete(NULL); // Delete this task after VPN is connected
+}
+
+/// @brief Writes queued mavlink messages to the serial port connected to the LoRa board.
+/// Runs at a higher priority than the reader tasks, so that a priority message is written as soon as the message on the wire is finished.
+/// @param parameter Unused. Just here to comply with the task function signature.
+/// Every frame is numbered again as it goes out, so the sequence on the wire is contiguous, which the parity frames rely on to name their group.
+/// With forward error correction on, parity frames follow each group of frames, or a partial group that waited too long or is followed by a frame too long to protect.
+void SerialTransmitterTask(void* parameter) {
+    
+    constexpr uint32_t fec_max_group_age = 2000; // ms. Bounds the wait for the parity of a group when the telemetry is slow.
+    constexpr uint32_t stamps_max_age = 1000; // ms. Bounds the wait for the stamps of a frame when the telemetry is slow.
+    constexpr uint32_t time_sync_interval = 10000; // ms
+    constexpr uint8_t max_stamps = MAVLINK_MSG_STREAM_STAMPS_FIELD_FRAME_SEQ_LEN;
+    OutgoingFrame frame;
+    uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+    uint8_t seq = 0;
+    PacketFec::Encoder encoder;
+    uint32_t settings_version = UINT32_MAX;
+    uint32_t group_start = 0;
+
+    // Stamps of the telemetry frames written since the last STREAM_STAMPS message. One message describes several frames, so the
+    // telemetry itself keeps its format and the stamps cost a fraction of the airtime a field in every frame would.
+    mavlink_stream_stamps_t stamps = {};
+    uint32_t stamp_sample_times[max_stamps];
+    uint32_t stamps_start = 0;
+    uint32_t time_sync_timer = 0;
+
+    auto Write = [&](mavlink_message_t& message) {
+        mavlink_extension_set_seq(&message, seq++);
+        uint16_t len = mavlink_msg_to_send_buffer(buffer, &message);
+        Serial.write(buffer, len);
+        portENTER_CRITICAL(&linkRateMutex);
+        linkRateController.RecordFrame(len, millis());
+        portEXIT_CRITICAL(&linkRateMutex);
+        return len;
+    };
+
+    auto SendParity = [&]() {
+        mavlink_message_t parity_message;
+        for (uint8_t i = 0; i < encoder.GetNumberParity(); i++) {
+            const PacketFec::Parity& parity = encoder.GetParity(i);
+            mavlink_fec_parity_t fec_parity = { parity.group, parity.first_seq, parity.data_frames, parity.parity_frames, parity.index };
+            memcpy(fec_parity.data, parity.data, parity.length);
+            mavlink_msg_fec_parity_encode_chan(1, MAV_COMP_ID_ONBOARD_COMPUTER, MAVLINK_COMM_0, &parity_message, &fec_parity);
+            Write(parity_message);
+        }
+        fecGroupsSent++;
+        fecParitySent += encoder.GetNumberParity();
+        encoder.Reset();
+    };
+
+    /// Writes a frame, adding it to the group protected by the parity frames when the forward error correction is on.
+    auto SendFrame = [&](mavlink_message_t& message) {
+        if (!isFecEnabled) {
+            Write(message);
+            return;
+        }
+        // The length does not depend on the sequence number, so it is known before the frame is numbered.
+        uint16_t len = mavlink_msg_to_send_buffer(buffer, &message);
+        if (!PacketFec::Encoder::IsProtectable(buffer, len)) {
+            if (encoder.Flush()) SendParity();
+            Write(message);
+            return;
+        }
+        if (encoder.IsEmpty()) group_start = millis();
+        len = Write(message);
+        if (encoder.Add(buffer, len)) SendParity();
+    };
+
+    auto SendStamps = [&]() {
+        stamps.time_boot_ms = millis();
+        for (uint8_t i = 0; i < stamps.count; i++) {
+            stamps.sample_offset[i] = SampleOffset(stamp_sample_times[i], stamps.time_boot_ms);
+        }
+        mavlink_message_t stamps_message;
+        mavlink_msg_stream_stamps_encode_chan(1, MAV_COMP_ID_ONBOARD_COMPUTER, MAVLINK_COMM_0, &stamps_message, &stamps);
+        SendFrame(stamps_message);
+        stamps = {};
+    };
+
+    auto SendTimeSync = [&]() {
+        portENTER_CRITICAL(&linkRateMutex);
+        float airtime = linkRateController.GetAirtime(MAVLINK_MSG_ID_TIME_SYNC_LEN + MAVLINK_NUM_NON_PAYLOAD_BYTES);
+        portEXIT_CRITICAL(&linkRateMutex);
+        mavlink_time_sync_t time_sync = { (uint64_t)NowUtcUs(), millis(), (uint16_t)airtime };
+        mavlink_message_t time_sync_message;
+        mavlink_msg_time_sync_encode_chan(1, MAV_COMP_ID_ONBOARD_COMPUTER, MAVLINK_COMM_0, &time_sync_message, &time_sync);
+        SendFrame(time_sync_message);
+    };
+
+    while (true) {
+        bool has_message = xQueueReceive(transmitQueue, &frame, pdMS_TO_TICKS(fec_max_group_age / 4));
+
+        if (fecSettingsVersion != settings_version) {
+            settings_version = fecSettingsVersion;
+            if (encoder.Flush()) SendParity();
+            encoder.Configure(fecDataFrames, fecParityFrames);
+        }
+
+        if (has_message) {
+            uint8_t frame_seq = seq;
+            SendFrame(frame.message);
+            if (frame.stream != UnstampedStream) {
+                telemetryStreams.Count(frame.stream, TelemetryStreams::Transmitted);
+                if (!stamps.count) stamps_start = millis();
+                stamps.frame_seq[stamps.count] = frame_seq;
+                stamps.stream[stamps.count] = frame.stream;
+                stamps.stream_seq[stamps.count] = frame.stream_seq;
+                stamp_sample_times[stamps.count] = frame.sample_time;
+                if (++stamps.count == max_stamps) SendStamps();
+            }
+        }
+
+        if (stamps.count && millis() - stamps_start >= stamps_max_age) {
+            SendStamps();
+        }
+        if (millis() - time_sync_timer >= time_sync_interval) {
+            time_sync_timer = millis();
+            SendTimeSync();
+        }
+        if (!encoder.IsEmpty() && millis() - group_start >= fec_max_group_age && encoder.Flush()) {
+            SendParity();
+        }
+    }
+}
+
+/// @brief Sends the telemetry chosen for the IP path to the ground merger over UDP, and takes the reports of the merger on the health of both paths.
+/// Each datagram holds one frame, followed for telemetry by a STREAM_STAMPS message naming its stream and sample, so every datagram stands on its own.
+/// Frames are numbered on this path independently of the LoRa link.
+/// @param parameter Unused. Just here to comply with the task function signature.
+void IpTransmitterTask(void* parameter) {
+
+    constexpr uint16_t local_port = 14551; // Where the reports of the merger arrive.
+    constexpr uint32_t time_sync_interval = 2000; // ms. The merger echoes the last one received over each path, which gives the latency of both.
+    WiFiUDP udp;
+    bool is_open = false;
+    uint32_t settings_version = UINT32_MAX;
+    uint8_t seq = 0;
+    uint32_t time_sync_timer = 0;
+    OutgoingFrame frame;
+    uint8_t datagram[2 * MAVLINK_MAX_PACKET_LEN];
+    uint8_t report_buffer[MAVLINK_MAX_PACKET_LEN];
+
+    auto Append = [&](mavlink_message_t& message, uint16_t offset) {
+        mavlink_extension_set_seq(&message, seq++);
+        return (uint16_t)(offset + mavlink_msg_to_send_buffer(datagram + offset, &message));
+    };
 
-        client->onDisconnect([](void* arg, AsyncClient* client) {
-            Serial.println("Disconnected");
-            client->close();
-            delete client;
-        }, nullptr);
+    auto SendDatagram = [&](uint16_t length) {
+        udp.beginPacket(groundAddress, groundPort);
+        udp.write(datagram, length);
+        return udp.endPacket() == 1;
+    };
 
-        client->onTimeout([](void* arg, AsyncClient* client, int32_t time) {
-            Serial.printf("Timeout: %d\n", time);
-            client->close();
-        }, nullptr);
+    auto OnPathReport = [](const mavlink_path_report_t& report) {
+        if (report.path >= NumberTelemetryPaths) return;
+        TelemetryPath path = (TelemetryPath)report.path;
+        uint32_t now = millis();
+        portENTER_CRITICAL(&fanoutMutex);
+        if (report.received + report.lost) {
+            telemetryFanout.OnLoss(path, (float)report.lost / (report.received + report.lost), now);
+        }
+        if (report.echo_time_boot_ms) {
+            // The echo always comes back over IP, so for LoRa the IP half of the round trip is taken out.
+            float round_trip = (float)(now - report.echo_time_boot_ms - report.echo_delay);
+            float ip_latency = telemetryFanout.GetHealth(IpPath).latency;
+            float latency = path == IpPath ? round_trip / 2 : round_trip - (ip_latency > 0.0f ? ip_latency : round_trip / 2);
+            if (latency > 0.0f) telemetryFanout.OnLatency(path, latency, now);
+        }
+        portEXIT_CRITICAL(&fanoutMutex);
+    };
 
-        client->onAck([](void* arg, AsyncClient* client, size_t len, int32_t time) {
-            Serial.printf("Ack: %d\n", time);
-            
-        }, nullptr);
+    while (true) {
+        bool has_frame = xQueueReceive(ipTransmitQueue, &frame, pdMS_TO_TICKS(100));
 
-        client->onData([](void* arg, AsyncClient* client, void* data, size_t len) {
-            Serial.printf("Data: %s\n", (char*)data);
-        }, nullptr);
+        if (settings_version != ipSettingsVersion) {
+            settings_version = ipSettingsVersion;
+            if (is_open) udp.stop();
+            is_open = false;
+        }
+        bool is_ready = isIpTelemetryEnabled && WiFi.status() == WL_CONNECTED;
+        portENTER_CRITICAL(&fanoutMutex);
+        telemetryFanout.SetAvailable(IpPath, is_ready);
+        portEXIT_CRITICAL(&fanoutMutex);
+        if (!is_ready) {
+            if (is_open) udp.stop();
+            is_open = false;
+            if (has_frame && frame.stream != UnstampedStream) telemetryStreams.Count(frame.stream, TelemetryStreams::IpDropped);
+            continue;
+        }
+        if (!is_open) is_open = udp.begin(local_port);
+
+        if (has_frame) {
+            uint16_t length = Append(frame.message, 0);
+            if (frame.stream != UnstampedStream) {
+                mavlink_stream_stamps_t stamps = {};
+                stamps.time_boot_ms = millis();
+                stamps.count = 1;
+                stamps.frame_seq[0] = seq - 1;
+                stamps.stream[0] = frame.stream;
+                stamps.stream_seq[0] = frame.stream_seq;
+                stamps.sample_offset[0] = SampleOffset(frame.sample_time, stamps.time_boot_ms);
+                mavlink_message_t stamps_message;
+                mavlink_msg_stream_stamps_encode_chan(1, MAV_COMP_ID_ONBOARD_COMPUTER, MAVLINK_COMM_0, &stamps_message, &stamps);
+                length = Append(stamps_message, length);
+            }
+            bool is_sent = SendDatagram(length);
+            if (frame.stream != UnstampedStream) {
+                telemetryStreams.Count(frame.stream, is_sent ? TelemetryStreams::IpSent : TelemetryStreams::IpDropped);
+            }
+        }
 
-        client->connect(ipv6, 80);
+        if (millis() - time_sync_timer >= time_sync_interval) {
+            time_sync_timer = millis();
+            mavlink_time_sync_t time_sync = { (uint64_t)NowUtcUs(), millis(), 0 };
+            mavlink_message_t time_sync_message;
+            mavlink_msg_time_sync_encode_chan(1, MAV_COMP_ID_ONBOARD_COMPUTER, MAVLINK_COMM_0, &time_sync_message, &time_sync);
+            SendDatagram(Append(time_sync_message, 0));
+        }
 
-        #endif
+        // Reports of the merger, parsed on a channel of their own.
+        while (int size = udp.parsePacket()) {
+            int length = udp.read(report_buffer, sizeof(report_buffer));
+            mavlink_message_t message;
+            mavlink_status_t status = {};
+            for (int i = 0; i < length && i < size; i++) {
+                uint8_t result = mavlink_frame_char(MAVLINK_COMM_3, report_buffer[i], &message, &status);
+                bool is_valid = result == MAVLINK_FRAMING_OK || (result == MAVLINK_FRAMING_BAD_CRC && mavlink_extension_check_crc(&message));
+                if (is_valid && message.msgid == MAVLINK_MSG_ID_PATH_REPORT) {
+                    mavlink_path_report_t report;
+                    mavlink_msg_path_report_decode(&message, &report);
+                    OnPathReport(report);
+                }
+            }
+        }
     }
 }
 
-void VPNConnectionTask(void* parameter) {
+/// @brief Writes the full blocks of the race log to its storage, and closes the open block once it grows old, so a power cut loses little.
+/// On the SD card, blocks are appended to a file. On the flash, they go round the partition, each sector erased just before it is written,
+/// and the writing resumes after the block with the highest sequence number found at boot. Erasing a sector stalls the code running from flash
+/// on both cores for tens of ms; at the rate blocks fill this costs the readers a few samples a minute, which the SD card avoids.
+/// @param parameter Unused. Just here to comply with the task function signature.
+void RaceLogTask(void* parameter) {
+
+    constexpr uint32_t max_block_age = 30000; // ms
+    constexpr uint32_t poll_interval = 100; // ms
+    static uint8_t block[RaceLog::block_size]; // Read back at boot. Too large for the stack of the task.
+    const RaceLog::BlockHeader* header = reinterpret_cast<const RaceLog::BlockHeader*>(block);
+    const esp_partition_t* partition = nullptr;
+    File file;
+    uint32_t next_index = 0;
+    uint32_t next_sequence = 0;
+
+    if (sd_card_cs_pin >= 0 && SD.begin(sd_card_cs_pin)) {
+        size_t padding = 0;
+        File existing = SD.open(race_log_file_name, FILE_READ);
+        if (existing) {
+            size_t size = existing.size();
+            size_t blocks = size / RaceLog::block_size;
+            if (blocks && existing.seek((blocks - 1) * RaceLog::block_size) && existing.read(block, RaceLog::block_size) == RaceLog::block_size && RaceLog::IsValid(block)) {
+                next_sequence = header->sequence + 1;
+            }
+            // A block torn by a power cut is completed with erased bytes, so the blocks that follow stay aligned for the reader.
+            padding = size % RaceLog::block_size ? RaceLog::block_size - size % RaceLog::block_size : 0;
+            existing.close();
+        }
+        file = SD.open(race_log_file_name, FILE_APPEND);
+        if (file) {
+            memset(block, 0xFF, padding);
+            file.write(block, padding);
+            raceLogStorage = "sd";
+        }
+    }
+    if (!file && (partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "racelog"))) {
+        raceLogCapacity = partition->size / RaceLog::block_size;
+        bool is_found = false;
+        for (uint32_t i = 0; i < raceLogCapacity; i++) {
+            if (esp_partition_read(partition, i * RaceLog::block_size, block, RaceLog::block_size) != ESP_OK || !RaceLog::IsValid(block)) continue;
+            if (!is_found || header->sequence >= next_sequence) {
+                next_sequence = header->sequence + 1;
+                next_index = (i + 1) % raceLogCapacity;
+                is_found = true;
+            }
+        }
+        raceLogStorage = "flash";
+    }
+    if (!file && !partition) {
+        DEBUG_PRINTF("\n[RACELOG]No SD card and no racelog partition. The race log is disabled\n", NULL);
+        raceLogTaskHandle = nullptr;
+        vTaskDelete(NULL);
+    }
+    raceLogPartition = partition;
+    raceLogNextIndex = next_index;
+    DEBUG_PRINTF("\n[RACELOG]Logging to %s from block %u\n", raceLogStorage, next_sequence);
+    portENTER_CRITICAL(&raceLogMutex);
+    raceLog.SetNextSequence(next_sequence);
+    portEXIT_CRITICAL(&raceLogMutex);
+    isRaceLogEnabled = true;
 
-    // The use of a VPN is to allow this device to be accessed from the public internet without port forwarding or paying for a static IPV4 address.
-    // It accomplishes this by creating a virtual network between all devices that are connected to it, taking advantage of IPv6 addressing.
-    // Each device is assigned a unique IPv6 address that can be used to access it from anywhere in the world.
-    // The Husarnet VPN is free for up to 5 devices.
-    // By attaching a router with a SIM slot on the boat, messages can be exchanged by both the internet, using HTTP or WebSockets, and the LoRa radio.
+    while (true) {
+        portENTER_CRITICAL(&raceLogMutex);
+        raceLog.Poll(millis(), max_block_age);
+        uint8_t* ready = raceLog.GetReady();
+        portEXIT_CRITICAL(&raceLogMutex);
+        if (!ready) {
+            vTaskDelay(pdMS_TO_TICKS(poll_interval));
+            continue;
+        }
 
-    // Husarnet VPN configuration parameters
-    const char* hostName = hostnameGlobal; // Host name can be used to access the device instead of typing IPV6 address
-    const char* husarnetJoinCode = "fc94:b01d:1803:8dd8:b293:5c7d:7639:932a/6xGMdTUA3N8RT2FzprVMEi";
-    const char* dashboardURL = "default";
+        RaceLog::Seal(ready);
+        bool is_written;
+        if (partition) {
+            uint32_t offset = next_index * RaceLog::block_size;
+            is_written = esp_partition_erase_range(partition, offset, RaceLog::block_size) == ESP_OK &&
+                         esp_partition_write(partition, offset, ready, RaceLog::block_size) == ESP_OK;
+            next_index = (next_index + 1) % raceLogCapacity;
+        } else {
+            is_written = file.write(ready, RaceLog::block_size) == RaceLog::block_size;
+            file.flush();
+        }
+        if (!is_written) raceLogWriteErrors++;
 
-    // Wait for notification that WiFi is connected before starting the VPN.
-    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        portENTER_CRITICAL(&raceLogMutex);
+        raceLog.Release(ready);
+        raceLogNextIndex = next_index;
+        portEXIT_CRITICAL(&raceLogMutex);
+    }
+}
 
-    Husarnet.selfHostedSetup(dashboardURL);
-    Husarnet.join(husarnetJoinCode, hostName);
-    Husarnet.start();
-    vTaskDelete(NULL); // Delete this task after VPN is connected
+/// @brief Handles the mavlink messages received from the LoRa board.
+void ProcessMavlinkMessage(const mavlink_message_t& message) {
+    switch (message.msgid) {
+        case MAVLINK_MSG_ID_RELIABLE_ACK: {
+            mavlink_reliable_ack_t ack;
+            mavlink_msg_reliable_ack_decode(&message, &ack);
+            xSemaphoreTake(reliableMutex, portMAX_DELAY);
+            reliableSender.OnAck(ack.session, ack.base, ack.received_mask, millis(), TransmitReliableFrame);
+            xSemaphoreGive(reliableMutex);
+            break;
+        }
+        case MAVLINK_MSG_ID_RELIABLE_MESSAGE: {
+            mavlink_reliable_message_t envelope;
+            mavlink_msg_reliable_message_decode(&message, &envelope);
+            bool is_new = reliableReceiver.Receive(envelope.session, envelope.seq);
+
+            // Every envelope is acknowledged, duplicates included, since a duplicate means the last acknowledgement was lost.
+            ReliableLink::Receiver::Ack ack = reliableReceiver.GetAck();
+            mavlink_reliable_ack_t reliable_ack = { ack.received_mask, ack.base, ack.session };
+            mavlink_message_t ack_message;
+            mavlink_msg_reliable_ack_encode_chan(1, MAV_COMP_ID_ONBOARD_COMPUTER, MAVLINK_COMM_0, &ack_message, &reliable_ack);
+            SendMavlinkMessage(ack_message, true);
+
+            if (!is_new) break;
+            // The wrapped frame is parsed with a buffer and a state of its own rather than a shared channel, so it does not disturb the frame
+            // being received from the serial port or any other parser.
+            mavlink_message_t inner;
+            mavlink_message_t parse_buffer;
+            mavlink_status_t parse_status = {};
+            mavlink_status_t status;
+            for (uint8_t i = 0; i < envelope.length && i < sizeof(envelope.frame); i++) {
+                uint8_t result = mavlink_frame_char_buffer(&parse_buffer, &parse_status, envelope.frame[i], &inner, &status);
+                bool is_valid = result == MAVLINK_FRAMING_OK || (result == MAVLINK_FRAMING_BAD_CRC && mavlink_extension_check_crc(&inner));
+                if (is_valid && inner.msgid != MAVLINK_MSG_ID_RELIABLE_MESSAGE) {
+                    ProcessMavlinkMessage(inner);
+                }
+            }
+            break;
+        }
+        case MAVLINK_MSG_ID_CALIBRATION_COMMAND: {
+            mavlink_calibration_command_t command;
+            mavlink_msg_calibration_command_decode(&message, &command);
+            calibrationEngine.Execute((CalibrationEngine::Action)command.action, command.channel, command.reference, command.samples);
+            break;
+        }
+        case MAVLINK_MSG_ID_LORA_LINK_STATUS: {
+            mavlink_lora_link_status_t link_status;
+            mavlink_msg_lora_link_status_decode(&message, &link_status);
+            LinkRateController::Report report = { link_status.packets_received, link_status.packets_lost, link_status.rssi, link_status.snr,
+                                                  { link_status.spreading_factor, link_status.bandwidth, link_status.coding_rate } };
+            portENTER_CRITICAL(&linkRateMutex);
+            bool must_send = linkRateController.Update(report, millis());
+            LoraSetting setting = linkRateController.GetSetting();
+            float loss = linkRateController.GetLoss();
+            float snr = linkRateController.GetSnr();
+            portEXIT_CRITICAL(&linkRateMutex);
+            // This is the loss of the uplink, from the ground to the boat. The loss the fanout weighs the LoRa path by is the downlink's,
+            // which only the path reports of the merger measure.
+            if (must_send) {
+                SendLoraParams(setting);
+                DEBUG_PRINTF("\n[LORA]SF%d, BW %d, CR 4/%d. Loss %.1f%%, SNR %.1fdB\n", setting.spreading_factor, setting.bandwidth, setting.coding_rate,
+                             100.0f * loss, snr);
+            }
+            break;
+        }
+        default:
+            break;
+    }
 }
 
 template <std::size_t N>
@@ -517,9 +2018,22 @@ void SerialReaderTask(void* parameter) {
     
     std::array<uint8_t, 32> buffer = { 0 };
     static size_t bufferIndex = 0;
+    mavlink_message_t message;
+    mavlink_status_t status = {};
     while (true) {
-        if (Serial.available()) {
+        while (Serial.available()) {
             uint8_t receivedChar = Serial.read();
+
+            // Mavlink frames from the LoRa board share the port with the text commands. Commands are plain ASCII,
+            // so a start byte, or any byte while a frame is being parsed, belongs to mavlink.
+            if (receivedChar == MAVLINK_STX || status.parse_state > MAVLINK_PARSE_STATE_IDLE) {
+                uint8_t result = mavlink_frame_char(MAVLINK_COMM_1, receivedChar, &message, &status);
+                if (result == MAVLINK_FRAMING_OK || (result == MAVLINK_FRAMING_BAD_CRC && mavlink_extension_check_crc(&message))) {
+                    ProcessMavlinkMessage(message);
+                }
+                continue;
+            }
+
             switch (receivedChar) {
                 case '\r':
                 case '\n':
@@ -539,6 +2053,18 @@ void SerialReaderTask(void* parameter) {
                     break;
             }
         }
+
+        portENTER_CRITICAL(&linkRateMutex);
+        bool must_send = linkRateController.Poll(millis());
+        LoraSetting setting = linkRateController.GetSetting();
+        portEXIT_CRITICAL(&linkRateMutex);
+        if (must_send) {
+            SendLoraParams(setting);
+        }
+
+        xSemaphoreTake(reliableMutex, portMAX_DELAY);
+        reliableSender.Poll(millis(), TransmitReliableFrame);
+        xSemaphoreGive(reliableMutex);
         vTaskDelay(pdMS_TO_TICKS(10));
     }
 }
@@ -560,7 +2086,7 @@ void ProcessSerialMessage(const std::array<uint8_t, N> &buffer) {
 
                 auto it = blinkRateMap.find(buffer[1]);
                 if (it != blinkRateMap.end()) {
-                    xTaskNotify(ledBlinkerTaskHandle, (uint32_t)it->second, eSetValueWithOverwrite);
+                    statusIndicator.Post(it->second);
                     break;
                 }
                 else {
@@ -587,7 +2113,8 @@ void ProcessSerialMessage(const std::array<uint8_t, N> &buffer) {
         }
 
         case 'T' : {
-            xTaskNotify(temperatureReaderTaskHandle, 1, eSetValueWithOverwrite);
+            isProbeScanRequested = true;
+            NotifyJob(temperatureReaderJobId);
             break;
         }
         case 'G' : {
@@ -597,18 +2124,44 @@ void ProcessSerialMessage(const std::array<uint8_t, N> &buffer) {
         }
 
         case 'C' : {
-            // Try to parse float to send current calibration value to auxiliary reader task
-            float calibration_value = 0.0f;
-            if (sscanf((const char*)&buffer[1], "%f", &calibration_value)) {
-                Serial.printf("\n[SERIAL-CALIBRATION] Value: %f\n", calibration_value);
-                xTaskNotify(auxiliaryReaderTaskHandle, (uint32_t)calibration_value, eSetValueWithOverwrite);
+            // Capture a calibration point at the reference value measured by the instrument, such as C12.35
+            float reference = 0.0f;
+            if (sscanf((const char*)&buffer[1], "%f", &reference) == 1) {
+                Serial.printf("\n[SERIAL-CALIBRATION]Reference: %f\n", reference);
+                calibrationEngine.Execute(CalibrationEngine::Action::Capture, 0, reference);
+            } else {
+                Serial.printf("\nInvalid calibration reference: %s\n", (const char*)&buffer[1]);
+            }
+            break;
+        }
+
+        case 'K' : {
+            // Fit the captured calibration points and save the result
+            calibrationEngine.Execute(CalibrationEngine::Action::Commit);
+            break;
+        }
+
+        case 'X' : {
+            calibrationEngine.Execute(CalibrationEngine::Action::Abort);
+            break;
+        }
+
+        case 'L' : {
+            // Set the motor current limit used by the throttle current limiter, in amperes.
+            float current_limit = 0.0f;
+            if (sscanf((const char*)&buffer[1], "%f", &current_limit) == 1 && current_limit > 0.0f) {
+                SaveCurrentLimit(current_limit);
+            } else {
+                Serial.printf("\nInvalid current limit: %s\n", (const char*)&buffer[1]);
             }
             break;
         }
 
         case 'Q' : {
-            // Send notification to auxiliary reader to start calibration
-            xTaskNotify(auxiliaryReaderTaskHandle, 1, eSetValueWithOverwrite);
+            // Start calibrating a channel, such as Q2 for the battery current. The auxiliary current sensor is calibrated when no channel is given.
+            int channel = CalibrationChannel::AuxiliaryCurrentChannel;
+            sscanf((const char*)&buffer[1], "%d", &channel);
+            calibrationEngine.Execute(CalibrationEngine::Action::Start, channel);
             break;
         }
         
@@ -621,74 +2174,101 @@ void ProcessSerialMessage(const std::array<uint8_t, N> &buffer) {
 }
 
 void DallasDeviceScanIndex(DallasTemperature& sensors);
-void TemperatureReaderTask(void* parameter) {
 
-    //constexpr uint8_t power_pin = 2; // GPIO used to power the temperature probes if testing on the bench
-    constexpr uint8_t temperature_bus_pin = 15; // GPIO used for OneWire communication
-    
-    //pinMode(power_pin, OUTPUT); digitalWrite(power_pin, HIGH); // Set power pin to HIGH to power the temperature probes if testing on the bench
-    OneWire one_wire(temperature_bus_pin); // Setup a one_wire instance to communicate with any devices that use the OneWire protocol
-    DallasTemperature sensors(&one_wire); // Pass our one_wire reference to Dallas Temperature sensor, which uses the OneWire protocol.
-    sensors.begin(); // Scan for devices on the OneWire bus.
-    vTaskDelay(pdMS_TO_TICKS(1000)); // Wait for the probes to power up and initialize
-    
+/// @brief Reads the temperature probes. The conversion is started by Request() and read on a later step rather than waited for, so the
+/// other jobs run during the conversion.
+struct TemperatureDriver {
+    struct Sample {
+        int32_t motor; // 1/128 °C, DEVICE_DISCONNECTED_RAW when the probe does not answer.
+        int32_t battery;
+        int32_t mppt;
+    };
+
+    //static constexpr uint8_t power_pin = 2; // GPIO used to power the temperature probes if testing on the bench
+    static constexpr uint8_t temperature_bus_pin = 15; // GPIO used for OneWire communication
+    static constexpr uint32_t conversion_time = 750; // ms, for the 12-bit resolution of the DS18B20.
+
+    // Given their pin in Begin() rather than at construction, as the pipeline is a global and the pin must not be set up before the core is.
+    OneWire one_wire; // Setup a one_wire instance to communicate with any devices that use the OneWire protocol
+    DallasTemperature sensors; // Pass our one_wire reference to Dallas Temperature sensor, which uses the OneWire protocol.
+
     // Each probe has a unique 8-byte address. Use the scanIndex method to initially find the addresses of the probes. 
     // Then hardcode the addresses into the program. This is done to avoid the overhead of scanning for the addresses every time the function is called.
     // You should then physically label the probes with tags or stripes as to differentiate them.
-
     DeviceAddress thermal_probe_zero = { 0x28, 0x02, 0x45, 0x49, 0xF6, 0x32, 0x3C, 0xC5 }; 
     DeviceAddress thermal_probe_one = { 0x28, 0x1A, 0xCE, 0x49, 0xF6, 0x05, 0x3C, 0xC7};
     DeviceAddress thermal_probe_two = { 0x28, 0xCF, 0x67, 0x49, 0xF6, 0x4D, 0x3C, 0xC5 };
 
-    systemData.temperatureSystem = { DEVICE_DISCONNECTED_C }; // Initialize the temperature system data to DEVICE_DISCONNECTED_C, which is -127.0f
+    bool Begin() {
+        //pinMode(power_pin, OUTPUT); digitalWrite(power_pin, HIGH); // Set power pin to HIGH to power the temperature probes if testing on the bench
+        systemData.temperatureSystem = { DEVICE_DISCONNECTED_C }; // Initialize the temperature system data to DEVICE_DISCONNECTED_C, which is -127.0f
+        one_wire.begin(temperature_bus_pin);
+        sensors.setOneWire(&one_wire);
+        sensors.begin(); // Scan for devices on the OneWire bus.
+        sensors.setWaitForConversion(false); // requestTemperatures() returns once the conversion is started.
+        return sensors.getDeviceCount() > 0; // Tried again until the probes have powered up.
+    }
 
-    while (true) {
+    uint32_t Request() {
+        if (isProbeScanRequested) { // Requested by the serial reader task to scan for new probes
+            isProbeScanRequested = false;
+            DallasDeviceScanIndex(sensors);
+        }
         // Increase task priority
         vTaskPrioritySet(NULL, 5);
         sensors.requestTemperatures(); // Send the command to update temperature readings
         vTaskPrioritySet(NULL, 1);
-        float temperature_motor = sensors.getTempC(thermal_probe_zero);
-        float temperature_battery = sensors.getTempC(thermal_probe_one);
-        float temperature_mppt = sensors.getTempC(thermal_probe_two);
-
-        #ifdef DEBUG_PRINTF
-        if (systemData.debug_print & SystemData::debug_print_flags::Temperature) {
-            if (temperature_motor == DEVICE_DISCONNECTED_C) {
-                DEBUG_PRINTF("\n[Temperature]Motor: Device disconnected\n", NULL);
-            } else {
-                DEBUG_PRINTF("\n[Temperature]Motor: %.2f°C\n", temperature_motor); // [Temperature][First byte of probe address] = value is the format
-                systemData.temperatureSystem.temperature_motor = temperature_motor;
-            }
+        return conversion_time;
+    }
 
-            if (temperature_battery == DEVICE_DISCONNECTED_C) {
-                DEBUG_PRINTF("\n[Temperature]Battery: Device disconnected\n", NULL);
-            } else {
-                DEBUG_PRINTF("\n[Temperature]Battery: %.2f°C\n", temperature_battery);
-                systemData.temperatureSystem.temperature_battery = temperature_battery;
-            }
+    bool Read(Sample& sample) {
+        sample = { sensors.getTemp(thermal_probe_zero), sensors.getTemp(thermal_probe_one), sensors.getTemp(thermal_probe_two) };
+        // The bus only counts as failed when no probe answers, so that one probe lost to a broken wire does not hide the others.
+        return sample.motor != DEVICE_DISCONNECTED_RAW || sample.battery != DEVICE_DISCONNECTED_RAW || sample.mppt != DEVICE_DISCONNECTED_RAW;
+    }
+};
 
-            if (temperature_mppt == DEVICE_DISCONNECTED_C) {
-                DEBUG_PRINTF("\n[Temperature]MPPT: Device disconnected\n", NULL);
-            } else {
-                DEBUG_PRINTF("\n[Temperature]MPPT: %.2f°C\n", temperature_mppt);
-                systemData.temperatureSystem.temperature_mppt = temperature_mppt;
-            }
-        }
-        #endif
+struct TemperatureConverter {
+    struct Value {
+        float motor; // °C, DEVICE_DISCONNECTED_C when the probe does not answer.
+        float battery;
+        float mppt;
+    };
 
-        // Prepare and send a mavlink message
-        mavlink_message_t message;
-        mavlink_temperatures_t temperatures = systemData.temperatureSystem;
-        mavlink_msg_temperatures_encode_chan(1, MAV_COMP_ID_ONBOARD_COMPUTER, MAVLINK_COMM_0, &message, &temperatures);
-        uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
-        uint16_t len = mavlink_msg_to_send_buffer(buffer, &message);
-        Serial.write(buffer, len);
+    static float ToCelsius(int32_t raw) {
+        return raw == DEVICE_DISCONNECTED_RAW ? DEVICE_DISCONNECTED_C : DallasTemperature::rawToCelsius(raw);
+    }
 
-        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10000))) { // Wait for notification from serial reader task to scan for new probes
-            DallasDeviceScanIndex(sensors); 
+    Value Convert(const TemperatureDriver::Sample& sample) {
+        return { ToCelsius(sample.motor), ToCelsius(sample.battery), ToCelsius(sample.mppt) };
+    }
+};
+
+struct TemperaturePublisher {
+    /// @brief Keeps the temperature of a probe that answered and checks its alarm rule. Disconnected probes keep their last temperature
+    /// and are kept out of the alarm rules.
+    void Update(float temperature, float& kept, AlarmField field, const char* name) {
+        if (temperature == DEVICE_DISCONNECTED_C) {
+            if (systemData.debug_print & SystemData::debug_print_flags::Temperature) DEBUG_PRINTF("\n[Temperature]%s: Device disconnected\n", name);
+            return;
         }
+        if (systemData.debug_print & SystemData::debug_print_flags::Temperature) DEBUG_PRINTF("\n[Temperature]%s: %.2f°C\n", name, temperature);
+        kept = temperature;
+        alarmEngine.Check(field, temperature);
     }
-}
+
+    void Publish(const TemperatureConverter::Value& value, uint32_t sample_time) {
+        Update(value.motor, systemData.temperatureSystem.temperature_motor, AlarmField::TemperatureMotor, "Motor");
+        Update(value.battery, systemData.temperatureSystem.temperature_battery, AlarmField::TemperatureBattery, "Battery");
+        Update(value.mppt, systemData.temperatureSystem.temperature_mppt, AlarmField::TemperatureMppt, "MPPT");
+
+        // Prepare and send a mavlink message
+        SendTelemetrySubsystem(TemperatureSubsystem, sample_time);
+    }
+};
+
+using TemperaturePipeline = SensorPipeline<TemperatureDriver, TemperatureConverter, NoFilter, TemperaturePublisher, 10000>;
+TemperaturePipeline temperaturePipeline("temperatureReader", esp_timer_get_time);
 
 /// @brief Auxiliary function to print the 8-byte address of a Dallas Thermal Probe to the serial port
 /// @param device_address 
@@ -738,12 +2318,41 @@ void GpsReaderTask(void* parameter) {
     constexpr uint8_t gps_tx_pin = 17; 
     constexpr int32_t baud_rate = 9600; // Fixed baud rate used by NEO-6M GPS module
     static uint32_t mavlink_timer = 0; // Timer used to send mavlink messages at a fixed rate
+    uint32_t fix_time = 0; // Time the last valid sentence was parsed, which is when the values sent were sampled.
+    constexpr int64_t nmea_delay = 50000; // us. Rough delay between a second and the first sentence that names it, for the NEO-6M at 9600 baud.
+    int64_t sentence_start = 0; // Local time the '$' of the sentence being parsed was read, in us since boot.
+    int64_t last_epoch = 0; // Last second the clock was disciplined with, since the GGA and RMC sentences name the same one.
     Serial2.begin(baud_rate, SERIAL_8N1, gps_rx_pin, gps_tx_pin); // Initialize Serial2 with the chosen baud rate and pins
+    if (gps_pps_pin >= 0) {
+        pinMode(gps_pps_pin, INPUT);
+        attachInterrupt(digitalPinToInterrupt(gps_pps_pin), OnPps, RISING);
+    }
 
     while (true) {
         while (Serial2.available()) {
             // Reads the serial stream from the NEO-6M GPS module and parses it into TinyGPSPlus object if a valid NMEA sentence is received
-            if (gps.encode(Serial2.read())) { 
+            char c = Serial2.read();
+            if (c == '$') sentence_start = esp_timer_get_time();
+            if (gps.encode(c)) { 
+
+                // The time is sent before the receiver has a fix as well, from its own clock, so it is only trusted along with a position.
+                if (gps.time.isUpdated() && gps.date.isValid() && gps.location.isValid() && gps.location.age() < 2000) {
+                    int64_t epoch = TimeService::UnixMicros(gps.date.year(), gps.date.month(), gps.date.day(), gps.time.hour(), gps.time.minute(),
+                                                            gps.time.second(), gps.time.centisecond() * 10000UL);
+                    if (epoch != last_epoch) {
+                        last_epoch = epoch;
+                        // The PPS edge marks the start of the second the sentences that follow it name.
+                        portENTER_CRITICAL(&timeMutex);
+                        int64_t pps_time = ppsTime;
+                        portEXIT_CRITICAL(&timeMutex);
+                        int64_t pps_age = sentence_start - pps_time;
+                        if (gps_pps_pin >= 0 && pps_time && pps_age >= 0 && pps_age < 1000000 && gps.time.centisecond() == 0) {
+                            DisciplineClock(pps_time, epoch, TimeService::PpsSource);
+                        } else {
+                            DisciplineClock(sentence_start - nmea_delay, epoch, TimeService::NmeaSource);
+                        }
+                    }
+                }
 
                 if (gps.location.isValid()) {
                     systemData.gpsSystem.latitude = gps.location.lat();
@@ -763,6 +2372,7 @@ void GpsReaderTask(void* parameter) {
                     systemData.gpsSystem.satellites_visible = gps.satellites.value();
                     //DEBUG_PRINTF("[GPS]Satellites: %d\n", satellites);
                 }
+                fix_time = millis();
 
                 break;
             }
@@ -771,14 +2381,10 @@ void GpsReaderTask(void* parameter) {
         if (millis() - mavlink_timer > 7000) {
             mavlink_timer = millis();
             // Prepare and send mavlink message by encoding the payload into a struct, then encoding the struct into a mavlink message below.
-            mavlink_message_t message;
-            mavlink_msg_gps_info_encode_chan(1, MAV_COMP_ID_ONBOARD_COMPUTER, MAVLINK_COMM_0, &message, &systemData.gpsSystem);
-            uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
-            uint16_t length = mavlink_msg_to_send_buffer(buffer, &message);
-            Serial.write(buffer, length);
-            xTaskNotify(ledBlinkerTaskHandle, BlinkRate::Pulse, eSetValueWithOverwrite); // Notify the LED blinker task that a message is being sent
+            SendTelemetrySubsystem(GpsSubsystem, fix_time);
+            statusIndicator.Post(BlinkRate::Pulse); // Pulse the LED to indicate that a message is being sent
         }           
-        vTaskDelay(pdMS_TO_TICKS(100));
+        vTaskDelay(pdMS_TO_TICKS(10)); // Short, so the start of each sentence is timed within a few ms.
     }
 }
 
@@ -788,6 +2394,7 @@ float CalculateInputVoltage(const float voltage_primary_resistor_drop, const flo
 float LinearCorrection(const float input_value, const float slope, const float intercept);
 float CalculateCurrentLA55(const float pin_voltage, const float sensor_output_ratio, const int32_t burden_resistance);
 float CalculateCurrentT201(float pin_voltage, int low_scale_range, int full_scale_range, int burden_resistance, bool bipolar_mode = false);
+float CalculateVoltageT201(float current, int low_scale_range, int full_scale_range, int burden_resistance, bool bipolar_mode = false);
 void InstrumentationReaderTask(void* parameter) {
 
      // The ADS1115 is a Delta-sigma (ΔΣ) ADC, which is based on the principle of oversampling. The input
@@ -802,7 +2409,8 @@ void InstrumentationReaderTask(void* parameter) {
     // The use of an external ADC, the ADS1115, was chosen to obtain higher resolution and linearity, as well as programmable gain to avoid the need for instrumentation amplifiers.
     // The ADS1115 is a 16-bit ADC with 4 channels. It is used to read the voltage of the battery and the current of motor, the MPPT output and the battery current or auxiliary system current.
     // The ADS1115 has 4 addresses, which are determined by the state of the ADDR pin. Our board has a solder bridge that allows selection between 0x48 and 0x49.
-    // The ADS1115 is connected to the ESP32 via I2C. The ESP32 is the master and the ADS1115 is the slave. It uses the default Wire instance at pins 21(SDA) and 22(SCL) for communication.
+    // The ADS1115 is connected to the ESP32 via I2C. The ESP32 is the master and the ADS1115 is the slave. It uses the default Wire instance at pins 21(SDA) and 22(SCL) for communication,
+    // which only the I2C bus task touches. The Adafruit driver is kept for its gain and its conversion to volts, and every transfer goes through the bus.
 
 
     // Make sure that the ADS1115 is connected to the ESP32 via I2C and that the solder bridge is set to the correct address.
@@ -813,67 +2421,195 @@ void InstrumentationReaderTask(void* parameter) {
     Adafruit_ADS1115 adc; 
     constexpr uint8_t adc_addresses[] = {0x48, 0x49}; // Address is determined by a solder bridge on the instrumentation board.
     adc.setGain(GAIN_FOUR); // Configuring the PGA( Programmable Gain Amplifier) to amplify the signal by 4 times, so that the maximum input voltage is +/- 1.024V
-    adc.setDataRate(RATE_ADS1115_16SPS); // Setting a low data rate to increase the oversampling ratio of the ADC and thus reduce the noise.
     
     bool is_adc_initialized = false;
     
     while (!is_adc_initialized) {
-        xTaskNotify(ledBlinkerTaskHandle, BlinkRate::Fast, eSetValueWithOverwrite); // Blinks the LED to indicate that the ADC is not initialized yet.
+        statusIndicator.Post(BlinkRate::Fast); // Blinks the LED to indicate that the ADC is not initialized yet.
         for (auto address : adc_addresses) {
             Serial.printf("\n[ADS]Trying to initialize ADS1115 at address 0x%x\n", address);
-            if (adc.begin(address)) {
+            if (i2cBus.Probe(address, I2cHighPriority)) {
                 Serial.printf("\n[ADS]ADS1115 successfully initialized at address 0x%x\n", address);
                 is_adc_initialized = true;
-                xTaskNotify(ledBlinkerTaskHandle, BlinkRate::Slow, eSetValueWithOverwrite); // Return LED to default blink rate.
+                overcurrentProtection.Begin(address, i2cBus); // Attaches the ALERT interrupt to this core, which the task is pinned to.
+                statusIndicator.Post(BlinkRate::Slow); // Return LED to default blink rate.
                 break;
             }
             vTaskDelay(pdMS_TO_TICKS(1000));
         }
     }
     
+    // Check and confirm which values of resistors are being used on the board.
+    // Values associated with the voltage sensor.
+    constexpr float voltage_conversion_ratio = 2.50f; // Datasheet gives a reference value of 2.50, but here it is being used an iterative process to find a value that satisfies the conversion measurements.
+    constexpr int32_t voltage_primary_resistance = 5000; // Equivalent resistance connected to primary side of LV-20P voltage sensor / 2 parallel resistors of 10k each.
+    constexpr int32_t voltage_primary_coil_resistance = 250; // Resistance of the primary coil of the LV-20P voltage sensor.
+    constexpr float primary_voltage_divider_ratio  = (float)voltage_primary_coil_resistance / voltage_primary_resistance;
+    constexpr int32_t voltage_burden_resistance = 33; // Burden resistor connected to secondary side of LV-20P voltage sensor.
+
+    // Values associated with current sensors.
+    constexpr int32_t motor_low_scale_range = 0; // Unidirectional reading, which means that the current sensor can only measure positive current.
+    constexpr int32_t motor_full_scale_range = 100; // Selected full scale range of the T201 current sensor for the motor.
+    constexpr int32_t battery_low_scale_range = -25; // Selected full scale range of the T201 current sensor for the battery.
+    constexpr int32_t battery_full_scale_range = 100; // Selected full scale range of the T201 current sensor for the battery.
+    constexpr int32_t mppt_low_scale_range = 100; // Unidirectional reading, which means that the current sensor can only measure positive current.
+    constexpr int32_t mppt_full_scale_range = 100; // Selected full scale range of the T201 current sensor for the MPPT output.
+    constexpr float current_conversion_ratio = 0.001f; // Output Conversion ratio of the LA55-P current sensor.
+    constexpr int32_t motor_burden_resistance = 22;
+    constexpr int32_t battery_burden_resistance = 22;
+    constexpr int32_t mppt_burden_resistance = 10; 
+
+    constexpr uint32_t telemetry_interval = 5000; // Interval between full readings of all channels, which ends the window summarized for LoRa.
+    constexpr uint32_t capture_stream_interval = 250; // Interval between chunks of a capture streamed over mavlink, slow enough to leave room for telemetry on the LoRa link.
+    constexpr uint32_t fast_sample_interval = 100; // Interval between the fast current readings kept in the race log and sent over the IP path, one in 25.
+    uint32_t capture_stream_timer = 0;
+    uint32_t fast_sample_timer = 0;
+
+    // LoRa cannot carry the fast readings, so it gets the minimum, mean, maximum and last reading of each channel over the window between
+    // two full readings instead, which keeps the peaks that a single reading would miss. Fields are indexed by calibration channel.
+    WindowAggregator<MpptCurrentChannel + 1> instrumentation_window(millis());
+    auto Centi = [](float value) { return (int16_t)constrain(roundf(value * 100.0f), (float)INT16_MIN, (float)INT16_MAX); };
+
+    /// @brief Starts a single conversion with the over-current comparator armed for the channel, and waits for it without blocking the CPU.
+    /// A delay of two ticks ends anywhere from one to two ms later, depending on when in the tick it starts, which may be before the 1.2ms
+    /// conversion is done, so the ready bit of the ADC is checked before the result is read.
+    /// @return False when the ADC could not be read.
+    auto ReadChannelDeferred = [&](uint8_t channel, uint16_t mux, int16_t& counts) {
+        overcurrentProtection.StartConversion(channel, mux, adc.getGain(), RATE_ADS1115_860SPS);
+        vTaskDelay(pdMS_TO_TICKS(2));
+        for (uint8_t i = 0; i < 4 && !overcurrentProtection.IsConversionDone(); i++) delayMicroseconds(100);
+        return overcurrentProtection.ReadConversion(counts);
+    };
+
+    /// @brief Reads a channel at the low data rate, which increases the oversampling ratio of the ADC and thus reduces the noise. The 62.5ms
+    /// conversion is waited for without polling the ADC, which leaves the bus free for other transfers, with room for the 10% tolerance of its clock.
+    /// @return False when the ADC could not be read.
+    auto ReadChannelPrecise = [&](uint16_t mux, float& volts) {
+        overcurrentProtection.StartConversion(OvercurrentProtection::number_channels, mux, adc.getGain(), RATE_ADS1115_16SPS);
+        vTaskDelay(pdMS_TO_TICKS(70));
+        int16_t counts;
+        if (!overcurrentProtection.ReadConversion(counts)) return false;
+        volts = adc.computeVolts(counts);
+        return true;
+    };
+
+    /// @brief Offers a raw reading to the calibration engine, which samples it in the background while its channel is being calibrated, and returns the calibrated value.
+    auto Calibrate = [](CalibrationChannel channel, float raw) {
+        calibrationEngine.Feed(channel, raw);
+        return calibrationEngine.Apply(channel, raw);
+    };
+
+    // The comparator works on raw counts, so the trip currents are taken back through the calibration and the sensor model of each channel.
+    // The battery channel is bipolar and trips on currents above the limit in either direction.
+    auto CurrentToCounts = [&](float current, CalibrationChannel channel, int low_scale_range, int full_scale_range, int burden_resistance, bool bipolar_mode) {
+        CalibrationEngine::Coefficients coefficients = calibrationEngine.GetCoefficients(channel);
+        float model_current = (current - coefficients.intercept) / coefficients.slope;
+        float pin_voltage = CalculateVoltageT201(model_current, low_scale_range, full_scale_range, burden_resistance, bipolar_mode);
+        return (int16_t)constrain(pin_voltage / adc.computeVolts(1), (float)INT16_MIN, (float)INT16_MAX);
+    };
+    uint32_t protection_settings_version = UINT32_MAX;
+    uint32_t protection_calibration_version = UINT32_MAX;
+    uint32_t protection_trip_count = 0;
+
     while (true) {
-        // Check and confirm which values of resistors are being used on the board.
-        // Values associated with the voltage sensor.
-        constexpr float voltage_conversion_ratio = 2.50f; // Datasheet gives a reference value of 2.50, but here it is being used an iterative process to find a value that satisfies the conversion measurements.
-        constexpr int32_t voltage_primary_resistance = 5000; // Equivalent resistance connected to primary side of LV-20P voltage sensor / 2 parallel resistors of 10k each.
-        constexpr int32_t voltage_primary_coil_resistance = 250; // Resistance of the primary coil of the LV-20P voltage sensor.
-        constexpr float primary_voltage_divider_ratio  = (float)voltage_primary_coil_resistance / voltage_primary_resistance;
-        constexpr int32_t voltage_burden_resistance = 33; // Burden resistor connected to secondary side of LV-20P voltage sensor.
-
-        // Values associated with current sensors.
-        constexpr int32_t motor_low_scale_range = 0; // Unidirectional reading, which means that the current sensor can only measure positive current.
-        constexpr int32_t motor_full_scale_range = 100; // Selected full scale range of the T201 current sensor for the motor.
-        constexpr int32_t battery_low_scale_range = -25; // Selected full scale range of the T201 current sensor for the battery.
-        constexpr int32_t battery_full_scale_range = 100; // Selected full scale range of the T201 current sensor for the battery.
-        constexpr int32_t mppt_low_scale_range = 100; // Unidirectional reading, which means that the current sensor can only measure positive current.
-        constexpr int32_t mppt_full_scale_range = 100; // Selected full scale range of the T201 current sensor for the MPPT output.
-        constexpr float current_conversion_ratio = 0.001f; // Output Conversion ratio of the LA55-P current sensor.
-        constexpr int32_t motor_burden_resistance = 22;
-        constexpr int32_t battery_burden_resistance = 22;
-        constexpr int32_t mppt_burden_resistance = 10; 
-
-        constexpr float battery_linear_offset = -0.3f;
+
+        // Between telemetry messages, the motor and battery current channels are sampled at the highest data rate. Samples feed the current limiter
+        // through the motor current queue, the alarm rules and the transient capture buffer, so they react within milliseconds instead of waiting for the next telemetry reading.
+        // Conversions are started and then collected once the 1.2ms conversion time at 860SPS has passed, instead of polling the ADC in a busy loop as readADC_SingleEnded does,
+        // which leaves the CPU free for other tasks while the ADC converts. Each pair of channels takes around 4ms, so each channel is sampled at about 250Hz.
+        uint32_t telemetry_timer = millis();
+        while (millis() - telemetry_timer < telemetry_interval) {
+            if (overcurrentProtection.GetSettingsVersion() != protection_settings_version || calibrationEngine.GetVersion() != protection_calibration_version) {
+                protection_settings_version = overcurrentProtection.GetSettingsVersion();
+                protection_calibration_version = calibrationEngine.GetVersion();
+                float motor_trip = overcurrentProtection.GetTripCurrent(0);
+                float battery_trip = overcurrentProtection.GetTripCurrent(1);
+                overcurrentProtection.SetWindow(0, INT16_MIN, CurrentToCounts(motor_trip, MotorCurrentChannel, motor_low_scale_range, motor_full_scale_range, motor_burden_resistance, false));
+                overcurrentProtection.SetWindow(1, CurrentToCounts(-battery_trip, BatteryCurrentChannel, battery_low_scale_range, battery_full_scale_range, battery_burden_resistance, true),
+                                                   CurrentToCounts(battery_trip, BatteryCurrentChannel, battery_low_scale_range, battery_full_scale_range, battery_burden_resistance, true));
+            }
+
+            int16_t motor_counts, battery_counts;
+            bool is_read = ReadChannelDeferred(0, ADS1X15_REG_CONFIG_MUX_SINGLE_1, motor_counts);
+            uint32_t sample_timestamp = micros();
+            is_read = ReadChannelDeferred(1, ADS1X15_REG_CONFIG_MUX_SINGLE_2, battery_counts) && is_read;
+
+            if (overcurrentProtection.GetTripCount() != protection_trip_count) {
+                protection_trip_count = overcurrentProtection.GetTripCount();
+                DEBUG_PRINTF("\n[PROTECTION]%s over-current, throttle cut %.0fus after the start of the conversion (%.1fus in the interrupt)\n",
+                             overcurrentProtection.GetTripChannel() == 0 ? "Motor" : "Battery", overcurrentProtection.GetLastLatency(), overcurrentProtection.GetLastInterruptLatency());
+            }
+
+            // A failed read would pass for zero current and reach the limiter, the alarms and the capture, so the pair is dropped instead.
+            if (!is_read) continue;
+            float fast_motor_current = Calibrate(MotorCurrentChannel, CalculateCurrentT201(adc.computeVolts(motor_counts), motor_low_scale_range, motor_full_scale_range, motor_burden_resistance));
+            float fast_battery_current = Calibrate(BatteryCurrentChannel, CalculateCurrentT201(adc.computeVolts(battery_counts), battery_low_scale_range, battery_full_scale_range, battery_burden_resistance, true));
+
+            MotorCurrentSample sample = { fast_motor_current, millis() };
+            xQueueOverwrite(motorCurrentQueue, &sample);
+            alarmEngine.Check(AlarmField::MotorCurrent, fast_motor_current);
+            alarmEngine.Check(AlarmField::BatteryCurrent, fast_battery_current);
+            transientCapture.Add({ fast_motor_current, fast_battery_current }, sample_timestamp);
+            instrumentation_window.Add(MotorCurrentChannel, fast_motor_current);
+            instrumentation_window.Add(BatteryCurrentChannel, fast_battery_current);
+            CurrentSamplePair pair = { fast_motor_current, fast_battery_current, sample_timestamp };
+            // A full queue means the analyzer fell behind and the sample is lost. The frame is still analyzed, with a gap of a few ms that only
+            // shifts its sample rate slightly; the analyzer starts a new frame only after a gap longer than its max_sample_gap.
+            xQueueSend(spectrumSampleQueue, &pair, 0);
+
+            if (millis() - capture_stream_timer > capture_stream_interval) {
+                capture_stream_timer = millis();
+                SendCaptureChunk();
+            }
+
+            // Kept in the race log whatever the state of the links. Only numbered while the IP path is up, so the samples it could not carry
+            // do not count as lost by the ground; the others go to the log alone, unnumbered.
+            if (millis() - fast_sample_timer >= fast_sample_interval) {
+                fast_sample_timer = millis();
+                mavlink_instrumentation_t instrumentation = systemData.instrumentationSystem;
+                instrumentation.motor_current = fast_motor_current;
+                instrumentation.battery_current = fast_battery_current;
+                mavlink_message_t message;
+                mavlink_msg_instrumentation_encode_chan(1, MAV_COMP_ID_ONBOARD_COMPUTER, MAVLINK_COMM_0, &message, &instrumentation);
+                if (IsIpPathAvailable()) SendTelemetry(message, InstrumentationStream, sample.timestamp);
+                else LogFrame(message, UnstampedStream, 0, sample.timestamp);
+            }
+        }
+        // The telemetry readings are taken at the low data rate, which favours noise performance over speed.
 
         // In the ADS1115 single ended measurements have 15 bits of resolution. Only differential measurements have 16 bits of resolution.
         // As we are using the 4 analog inputs for each of the 4 sensors, single ended measurements are being used in order to access all 4 sensors.
         // When using single ended mode, the maximum output code is 0x7FFF(32767), which corresponds to the full-scale input voltage.
 
-        float battery_pin_voltage = adc.computeVolts(adc.readADC_SingleEnded(0));
-        float motor_current_pin_voltage = adc.computeVolts(adc.readADC_SingleEnded(1));
-        float current_battery_pin_voltage = adc.computeVolts(adc.readADC_SingleEnded(2));
-        float current_mppt_pin_voltage = adc.computeVolts(adc.readADC_SingleEnded(3));
+        // A reading with a channel that could not be read is dropped whole, and the window of the summary runs on to the next one.
+        float battery_pin_voltage, motor_current_pin_voltage, current_battery_pin_voltage, current_mppt_pin_voltage;
+        if (!ReadChannelPrecise(ADS1X15_REG_CONFIG_MUX_SINGLE_0, battery_pin_voltage)
+            || !ReadChannelPrecise(ADS1X15_REG_CONFIG_MUX_SINGLE_1, motor_current_pin_voltage)
+            || !ReadChannelPrecise(ADS1X15_REG_CONFIG_MUX_SINGLE_2, current_battery_pin_voltage)
+            || !ReadChannelPrecise(ADS1X15_REG_CONFIG_MUX_SINGLE_3, current_mppt_pin_voltage)) {
+            continue;
+        }
         //DEBUG_PRINTF("\n[Instrumentation-PIN-VOLTAGE]Battery voltage: %f, Motor voltage: %f, Battery voltage: %f, MPPT voltage: %f\n", battery_pin_voltage, motor_current_pin_voltage, current_battery_pin_voltage, current_mppt_pin_voltage);
 
-        // Calibrate the voltage by comparing the value of voltage_primary_resistor_drop variable against the actual voltage drop on the primary resistor using a multimeter. 
-        // Take multiple readings across different voltages and do a linear regression to find the slope and intercept.
+        // The sensor models give the raw values, which are then corrected by the calibration of each channel. Calibrate a channel by capturing
+        // readings at a few values measured with a multimeter, over HTTP, mavlink or the serial port, and the slope and intercept are fitted to them.
         float voltage_primary_resistor_drop = CalculateVoltagePrimaryResistor(battery_pin_voltage, voltage_conversion_ratio, voltage_primary_resistance, voltage_burden_resistance);
         float battery_voltage = CalculateInputVoltage(voltage_primary_resistor_drop, primary_voltage_divider_ratio);
-        float calibrated_battery_voltage = LinearCorrection(battery_voltage, 1.0f, 0.0f);
+        float calibrated_battery_voltage = Calibrate(BatteryVoltageChannel, battery_voltage);
         
-        float motor_current = CalculateCurrentT201(motor_current_pin_voltage, motor_low_scale_range, motor_full_scale_range, motor_burden_resistance);
-        float battery_current = CalculateCurrentT201(current_battery_pin_voltage, battery_low_scale_range, battery_full_scale_range, battery_burden_resistance, true);
-        battery_current += battery_linear_offset;
-        float current_mppt = CalculateCurrentT201(current_mppt_pin_voltage, mppt_low_scale_range, mppt_full_scale_range, mppt_burden_resistance);
+        float motor_current = Calibrate(MotorCurrentChannel, CalculateCurrentT201(motor_current_pin_voltage, motor_low_scale_range, motor_full_scale_range, motor_burden_resistance));
+        float battery_current = Calibrate(BatteryCurrentChannel, CalculateCurrentT201(current_battery_pin_voltage, battery_low_scale_range, battery_full_scale_range, battery_burden_resistance, true));
+        float current_mppt = Calibrate(MpptCurrentChannel, CalculateCurrentT201(current_mppt_pin_voltage, mppt_low_scale_range, mppt_full_scale_range, mppt_burden_resistance));
+        MotorCurrentSample sample = { motor_current, millis() };
+        xQueueOverwrite(motorCurrentQueue, &sample);
+        alarmEngine.Check(AlarmField::BatteryVoltage, calibrated_battery_voltage);
+        alarmEngine.Check(AlarmField::MotorCurrent, motor_current);
+        alarmEngine.Check(AlarmField::BatteryCurrent, battery_current);
+        alarmEngine.Check(AlarmField::MpptCurrent, current_mppt);
+        instrumentation_window.Add(BatteryVoltageChannel, calibrated_battery_voltage);
+        instrumentation_window.Add(MotorCurrentChannel, motor_current);
+        instrumentation_window.Add(BatteryCurrentChannel, battery_current);
+        instrumentation_window.Add(MpptCurrentChannel, current_mppt);
         if (systemData.debug_print & SystemData::debug_print_flags::Instrumentation) {
 
            // Use this to calibrate the voltage sensor 
@@ -900,16 +2636,25 @@ void InstrumentationReaderTask(void* parameter) {
         systemData.instrumentationSystem.mppt_current = current_mppt;
 
         // Prepare and send Mavlink message
+        SendTelemetrySubsystem(InstrumentationSubsystem, sample.timestamp);
+
+        mavlink_instrumentation_summary_t summary = {};
+        summary.time_boot_ms = millis();
+        summary.window = min(instrumentation_window.GetElapsed(summary.time_boot_ms), (uint32_t)UINT16_MAX);
+        for (uint8_t channel = 0; channel < MAVLINK_MSG_INSTRUMENTATION_SUMMARY_FIELD_COUNT_LEN; channel++) {
+            const auto& field = instrumentation_window.Get(channel);
+            summary.min[channel] = Centi(field.min);
+            summary.mean[channel] = Centi(field.mean);
+            summary.max[channel] = Centi(field.max);
+            summary.last[channel] = Centi(field.last);
+            summary.count[channel] = min(field.count, (uint32_t)UINT16_MAX);
+        }
+        instrumentation_window.Reset(summary.time_boot_ms);
         mavlink_message_t message;
-        mavlink_instrumentation_t instrumentation = systemData.instrumentationSystem;
-        
-        mavlink_msg_instrumentation_encode_chan(1, MAV_COMP_ID_ONBOARD_COMPUTER, MAVLINK_COMM_0, &message, &instrumentation);
-        uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
-        uint16_t len = mavlink_msg_to_send_buffer(buffer, &message);
-        Serial.write(buffer, len);
+        mavlink_msg_instrumentation_summary_encode_chan(1, MAV_COMP_ID_ONBOARD_COMPUTER, MAVLINK_COMM_0, &message, &summary);
+        SendTelemetry(message, InstrumentationSummaryStream, summary.time_boot_ms);
 
-        xTaskNotify(ledBlinkerTaskHandle, BlinkRate::Pulse, eSetValueWithOverwrite); // Blink LED to indicate that a message has been sent.
-        vTaskDelay(pdMS_TO_TICKS(5000));
+        statusIndicator.Post(BlinkRate::Pulse); // Blink LED to indicate that a message has been sent.
     }
 }
 
@@ -988,6 +2733,17 @@ float CalculateCurrentT201(float pin_voltage, int low_scale_range, int full_scal
     return current;    
 }
 
+/// @brief Inverse of CalculateCurrentT201(), used to program thresholds that are compared against the raw readings.
+/// @param current Current at the sensor input, in amperes.
+/// @return Voltage at the ADS1115 pin for that current.
+float CalculateVoltageT201(float current, int low_scale_range, int full_scale_range, int burden_resistance, bool bipolar_mode) {
+    float zero_input_voltage = 4.0f * burden_resistance * 0.001f; // 4mA * burden resistor
+    float full_input_voltage = 20.0f * burden_resistance * 0.001f; // 20mA * burden resistor
+    if (!bipolar_mode) low_scale_range = 0;
+    float slope = (full_scale_range - low_scale_range) / (full_input_voltage - zero_input_voltage);
+    return zero_input_voltage + (current - low_scale_range) / slope;
+}
+
 /// @brief Calibrates a reading by using a linear equation obtained by comparing the readings with a multimeter.
 /// @param input 
 /// @param slope 
@@ -997,19 +2753,53 @@ float LinearCorrection(const float input_value, const float slope, const float i
     return slope * input_value + intercept;
 }
 
+/// @brief Stores a new motor current limit in non volatile memory and notifies the encoder control task to reload it.
+/// @param current_limit Motor current in amperes above which the throttle command is reduced.
+void SaveCurrentLimit(float current_limit) {
+    Preferences preferences;
+    preferences.begin("control", false);
+    preferences.putFloat("current_limit", current_limit);
+    preferences.end();
+    if (encoderControlTaskHandle) {
+        xTaskNotifyGive(encoderControlTaskHandle);
+    }
+}
+
 void EncoderControlTask(void* parameter) {
     
-    constexpr uint8_t dac_pin = 25;
     constexpr uint8_t dataPin = 14;
     constexpr uint8_t clockPin = 12;
 
     Encoder encoder(clockPin, dataPin);
  
+    // With the 12-bit output each encoder step is worth 0.1% of the throttle, around 5mV after the amplifier.
+    // To keep the full range within reach of a few turns, steps are multiplied when the encoder is turned quickly.
+    static int32_t currentPosition = 0;
     static int32_t previousPosition = 0;
-    constexpr uint8_t dac_resolution = 255; // 8-bit DAC
-    constexpr uint8_t max_number_steps = 50;
-    constexpr int16_t max_dac_output_voltage = 3300; // mV
+    constexpr int32_t max_number_steps = 1000;
+    constexpr int32_t fast_turn_threshold = 3; // Steps within a single control interval above which the encoder is considered to be turned quickly.
+    constexpr int32_t fast_turn_multiplier = 10;
     constexpr int16_t max_dac_amplified_output_voltage = 5000; // mV
+
+    // The current limiter caps the throttle command once the motor current exceeds the limit stored in non volatile memory.
+    // Gains were chosen so that an overload of 10A takes away 5% of the throttle immediately and a further 50% per second while it lasts.
+    // The proportional gain must stay below the inverse of the full throttle current, around 1/120A, or the loop oscillates.
+    constexpr float default_current_limit = 80.0f; // A
+    constexpr float limiter_proportional_gain = 0.005f; // Throttle fraction per ampere above the limit.
+    constexpr float limiter_integral_gain = 0.05f; // Throttle fraction per ampere-second above the limit.
+    constexpr uint32_t sample_timeout = 500; // ms. Samples older than this are considered lost and the limiter is released.
+    constexpr uint32_t control_interval = 20; // ms. Matches the sampling interval of the motor current.
+    
+    auto LoadCurrentLimit = [&]() {
+        Preferences preferences;
+        preferences.begin("control", true);
+        float current_limit = preferences.getFloat("current_limit", default_current_limit);
+        preferences.end();
+        return current_limit;
+    };
+
+    CurrentLimiter current_limiter(LoadCurrentLimit(), limiter_proportional_gain, limiter_integral_gain);
+    uint32_t last_sample_timestamp = 0;
     
     static uint32_t print_timer = 0;
     static uint32_t can_print_timer = 0;
@@ -1019,19 +2809,63 @@ void EncoderControlTask(void* parameter) {
     encoder.readAndReset(); // Reset encoder position to zero.
   
     while (true) {
-        int32_t currentPosition = encoder.read();
-        currentPosition = constrain(currentPosition, 0, max_number_steps);
+        int32_t steps = encoder.readAndReset();
+        if (abs(steps) >= fast_turn_threshold) steps *= fast_turn_multiplier;
+        currentPosition = constrain(currentPosition + steps, 0, max_number_steps);
         if (currentPosition != previousPosition) {
             previousPosition = currentPosition;
             can_print_timer = millis();
             can_print = true;
-            uint8_t discrete_output = currentPosition * dac_resolution / max_number_steps;
-            dacWrite(dac_pin, discrete_output);
+        }
+        isEncoderAtZero = currentPosition == 0;
+
+        // Steps of the calibration of the output, from the web server. A point is held only from zero throttle, and turning the encoder
+        // gives the output back to it at once.
+        ThrottleCalibrationRequest calibration_request;
+        while (xQueueReceive(throttleCalibrationQueue, &calibration_request, 0)) {
+            switch (calibration_request.action) {
+                case ThrottleHoldPoint:
+                    if (currentPosition == 0) throttleOutput.HoldCalibrationPoint(calibration_request.point);
+                    break;
+                case ThrottleSetPoint:
+                    throttleOutput.SetCalibrationPoint(calibration_request.point, calibration_request.voltage);
+                    break;
+                case ThrottleRelease:
+                    throttleOutput.Release();
+                    break;
+            }
+        }
+        if (throttleOutput.IsHolding() && currentPosition != 0) {
+            DEBUG_PRINTF("\n[DAC]Encoder turned, calibration released\n", NULL);
+            throttleOutput.Release();
+        }
+
+        // Feed the limiter with each new motor current sample published by the instrumentation reader.
+        MotorCurrentSample sample;
+        if (xQueuePeek(motorCurrentQueue, &sample, 0) && sample.timestamp != last_sample_timestamp) {
+            float elapsed_seconds = last_sample_timestamp ? (sample.timestamp - last_sample_timestamp) / 1000.0f : 0.0f;
+            last_sample_timestamp = sample.timestamp;
+            current_limiter.Update(sample.current, elapsed_seconds);
+        } else if (current_limiter.IsLimiting() && millis() - last_sample_timestamp > sample_timeout) {
+            DEBUG_PRINTF("\n[DAC]Motor current samples lost, releasing current limit\n", NULL);
+            current_limiter.Reset();
+        }
 
-            int32_t output_voltage = currentPosition * max_dac_output_voltage / max_number_steps;
-            systemData.controlSystem.dac_output = (float)output_voltage;
+        // After an over-current trip the throttle starts again from zero, so the operator has to bring it back up.
+        if (throttleOutput.IsTripped()) {
+            DEBUG_PRINTF("\n[DAC]Throttle tripped by the over-current protection, resetting to zero\n", NULL);
+            currentPosition = 0;
+            previousPosition = 0;
+            current_limiter.Reset();
+            throttleOutput.ResetTrip();
         }
 
+        float requested_command = (float)currentPosition / max_number_steps;
+        float limited_command = current_limiter.Apply(requested_command);
+        throttleOutput.SetCeiling(current_limiter.GetCeiling()); // Also limits a duty cycle held for calibration.
+        throttleOutput.Write(limited_command);
+        systemData.controlSystem.dac_output = throttleOutput.GetPinVoltage();
+
         if ((millis() - can_print_timer > 2000) && can_print) {
             // If the encoder has not been moved for 2 seconds, stop printing to the serial port.
             can_print_timer = millis();
@@ -1041,9 +2875,12 @@ void EncoderControlTask(void* parameter) {
         if ((millis() - print_timer > 500) && can_print) {
             // Print the encoder position to the serial port every 500ms if the encoder has been moved until after 2 seconds of inactivity.
             print_timer = millis();
-            DEBUG_PRINTF("\n[DAC]Encoder position: %d%%\n", currentPosition * 100 / max_number_steps); // Print encoder position as a percentage.
-            DEBUG_PRINTF("[DAC]Output: %d mV\n", currentPosition * max_dac_output_voltage / max_number_steps); // Print the output voltage of the DAC.
-            DEBUG_PRINTF("[DAC]Amplified output: %d mV\n", currentPosition * max_dac_amplified_output_voltage / max_number_steps); // Print the amplified output voltage of the DAC.
+            DEBUG_PRINTF("\n[DAC]Encoder position: %.1f%%\n", currentPosition * 100.0f / max_number_steps); // Print encoder position as a percentage.
+            DEBUG_PRINTF("[DAC]Output: %d mV, duty %d/%d\n", (int)throttleOutput.GetPinVoltage(), throttleOutput.GetDuty(), throttleOutput.GetMaxDuty()); // Print the output voltage and duty cycle of the PWM.
+            DEBUG_PRINTF("[DAC]Amplified output: %d mV\n", (int)(limited_command * max_dac_amplified_output_voltage)); // Print the amplified output voltage of the DAC.
+            if (current_limiter.IsLimiting()) {
+                DEBUG_PRINTF("[DAC]Current limited to %.0f%% of throttle\n", current_limiter.GetCeiling() * 100);
+            }
         }
 
         if (millis() - mavlink_timer > mavlink_timer_interval) {
@@ -1051,205 +2888,326 @@ void EncoderControlTask(void* parameter) {
             mavlink_timer = millis();
             DEBUG_PRINTF("\n[DAC]Amplified output: %.2f mV\n", systemData.controlSystem.dac_output);
 
-            mavlink_message_t message;
-            mavlink_control_system_t control_system = systemData.controlSystem;
-
-            mavlink_msg_control_system_encode_chan(1, MAV_COMP_ID_ONBOARD_COMPUTER, MAVLINK_COMM_0, &message, &control_system);
-            uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
-            uint16_t len = mavlink_msg_to_send_buffer(buffer, &message);
-            Serial.write(buffer, len);
+            SendTelemetrySubsystem(ControlSubsystem, mavlink_timer);
         }
 
-        vTaskDelay(pdMS_TO_TICKS(50));
+        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(control_interval))) {
+            // Notification that a new current limit was saved to non volatile memory.
+            current_limiter.SetCurrentLimit(LoadCurrentLimit());
+            Serial.printf("\n[DAC]Current limit set to %.1fA\n", current_limiter.GetCurrentLimit());
+        }
     }
 }
 
-/// @brief Auxiliary task that reads the battery voltage and state of pumps.
+/// @brief Computes the spectrum of the motor and battery current ripple from the high-rate samples, and sends its summary as telemetry.
+/// The DC readings sent by the instrumentation reader hide oscillations of the drivetrain, which show up here as peaks, for instance a
+/// controller hunting around its current limit or a loose connection heating under load. The task is pinned to core 1, away from the
+/// WiFi and TCP stack on core 0, so a frame is analyzed without delaying the network tasks.
 /// @param parameter 
-void AuxiliaryReaderTask(void* parameter) {
+void SpectrumAnalyzerTask(void* parameter) {
     
-    // Read lead-acid battery and pumps voltage through 4k7-1k voltage divider.
-    constexpr uint8_t port_pump_pin = 36;
-    constexpr uint8_t starboard_pump_pin = 39;
-    constexpr uint8_t battery_voltage_pin = 34;
-    constexpr uint8_t battery_current_pin = 35;
-    constexpr float battery_voltage_divider_ratio = 1.0f / (4.7f + 1.0f); // Voltage divider ratio used to measure battery voltage.
-    constexpr float adc_reference_voltage = 3.3f;
-    constexpr uint16_t adc_resolution = 4095; // 12-bit ADC
-    constexpr float battery_max_voltage = 13.8f;
-    constexpr float battery_min_voltage = 11.8f;
-    constexpr float battery_max_voltage_divided = battery_max_voltage * battery_voltage_divider_ratio; 
-    constexpr float battery_min_voltage_divided = battery_min_voltage * battery_voltage_divider_ratio; 
-    constexpr uint16_t number_samples_filter = 4; // Number of samples to use in the moving average filter.
-    constexpr float pump_threshold_voltage = 10.0f; // Voltage at which the pump is considered to be on.
-
-    pinMode(battery_voltage_pin, INPUT);
-    pinMode(port_pump_pin, INPUT);
-    pinMode(starboard_pump_pin, INPUT);
-    pinMode(battery_current_pin, INPUT);
-
-    float aux_battery_voltage = 0.0f;
-    float aux_battery_current = 0.0f;
-    bool port_pump_voltage = 0.0f;
-    bool starboard_pump_voltage = 0.0f;
-
-    /// @brief Read current using ACS712 current sensor.
-    /// @param power_voltage Voltage at the power pin of the ACS712 current sensor.
-    /// @param pin Pin connected to the output pin of the ACS712 current sensor.
-    /// @param sensitivity Sensitivity of the ACS712 current sensor, which is the rise in output voltage per ampere of input current.
-    auto ReadBatteryCurrent = [](uint8_t pin, float calibrated_offset_adc, float calibrated_sensitivity) {
-       
-        float measured_adc = analogRead(pin);
-        float measured_current = (measured_adc - calibrated_offset_adc) * calibrated_sensitivity;
-        return measured_current;
+    constexpr uint16_t frame_length = 256; // About one second of samples at 250Hz, for a resolution of about 1Hz.
+    constexpr float band_edges[] = { 1.0f, 10.0f, 30.0f, 60.0f, 125.0f }; // Hz, up to the Nyquist frequency of the sampling rate.
+    constexpr uint32_t max_sample_gap = 20000; // us. Longer gaps, such as while the slow telemetry readings are taken, break the constant rate a frame needs.
+    constexpr uint32_t publish_interval = 5000; // One summary per channel alongside each telemetry message, which keeps the LoRa link free.
+
+    using Analyzer = SpectrumAnalyzer<frame_length>;
+    static Analyzer analyzer(band_edges); // Static to keep the tables out of the task stack.
+    static float motor_frame[frame_length];
+    static float battery_frame[frame_length];
+    uint16_t number_samples = 0;
+    uint32_t first_timestamp = 0;
+    uint32_t last_timestamp = 0;
+    uint32_t publish_timer = millis();
+
+    while (true) {
+        CurrentSamplePair pair;
+        xQueueReceive(spectrumSampleQueue, &pair, portMAX_DELAY);
+
+        if (number_samples > 0 && pair.timestamp - last_timestamp > max_sample_gap) {
+            number_samples = 0; // Start a new frame.
+        }
+        if (number_samples == 0) first_timestamp = pair.timestamp;
+        last_timestamp = pair.timestamp;
+        motor_frame[number_samples] = pair.motor_current;
+        battery_frame[number_samples] = pair.battery_current;
+        if (++number_samples < frame_length) continue;
+        number_samples = 0;
+
+        uint32_t start = micros();
+        float sample_rate = (frame_length - 1) * 1e6f / (last_timestamp - first_timestamp);
+        Analyzer::Summary summaries[] = { analyzer.Analyze(motor_frame, sample_rate), analyzer.Analyze(battery_frame, sample_rate) };
+        spectrumFrameTime = micros() - start;
+
+        if (millis() - publish_timer < publish_interval) continue;
+        publish_timer = millis();
+
+        for (uint8_t channel = 0; channel < 2; channel++) {
+            const Analyzer::Summary& summary = summaries[channel];
+            mavlink_current_spectrum_t spectrum = {};
+            spectrum.time_boot_ms = millis();
+            spectrum.channel = channel;
+            spectrum.sample_rate = sample_rate;
+            spectrum.dc = summary.dc;
+            memcpy(spectrum.peak_frequency, summary.peak_frequency, sizeof(spectrum.peak_frequency));
+            memcpy(spectrum.peak_amplitude, summary.peak_amplitude, sizeof(spectrum.peak_amplitude));
+            memcpy(spectrum.band_rms, summary.band_rms, sizeof(spectrum.band_rms));
+
+            mavlink_message_t message;
+            mavlink_msg_current_spectrum_encode_chan(1, MAV_COMP_ID_ONBOARD_COMPUTER, MAVLINK_COMM_0, &message, &spectrum);
+            SendTelemetry(message, SpectrumStream, last_timestamp / 1000); // Time of the last sample of the frame.
+
+            DEBUG_PRINTF("\n[SPECTRUM]Channel %d: %.1fHz %.2fA, %.1fHz %.2fA, %.1fHz %.2fA, frame analyzed in %dus\n", channel,
+                         summary.peak_frequency[0], summary.peak_amplitude[0], summary.peak_frequency[1], summary.peak_amplitude[1],
+                         summary.peak_frequency[2], summary.peak_amplitude[2], spectrumFrameTime);
+        }
+    }
+}
+
+// Lead-acid battery and pumps voltage are read through 4k7-1k voltage dividers.
+constexpr uint8_t port_pump_pin = 36;
+constexpr uint8_t starboard_pump_pin = 39;
+constexpr uint8_t battery_voltage_pin = 34;
+constexpr uint8_t battery_current_pin = 35;
+constexpr float battery_voltage_divider_ratio = 1.0f / (4.7f + 1.0f); // Voltage divider ratio used to measure battery voltage.
+constexpr float adc_reference_voltage = 3.3f;
+constexpr uint16_t adc_resolution = 4095; // 12-bit ADC
+constexpr uint32_t auxiliary_send_interval = 8000; // ms
+
+/// @return Voltage before the divider of an ADC reading.
+float ToDividedVoltage(uint16_t counts) {
+    return (counts * adc_reference_voltage) / (adc_resolution * battery_voltage_divider_ratio);
+}
+
+/// @brief Reads the voltage and current of the auxiliary battery.
+struct AuxiliaryBatteryDriver {
+    struct Sample {
+        uint16_t voltage; // ADC counts
+        uint16_t current;
     };
 
-    auto CalibrateCurrentSensor = [](uint8_t pin, float& adc_zero_current_intercept, float& sensitivity_adc_slope, bool& asked_to_calibrate) {
-        // By using non volatile memory, first obtain the calibration factor from the memory. If it is not set, then calibrate the sensor and save the calibration factor to the memory.;
-        // If the calibration factor is not set, then 50 readings are taken and averaged to obtain the average offset voltage when no current is flowing through the sensor.
-        // Then the user is asked to input the current flowing through the sensor for a new set of 50 readings to obtain the average sensitivity of the sensor.
+    bool Begin() {
+        pinMode(battery_voltage_pin, INPUT);
+        pinMode(battery_current_pin, INPUT);
+        return true;
+    }
 
-        Preferences preferences;
-        preferences.begin("aux", false);
-        constexpr float error_value = -1.0f;
-        adc_zero_current_intercept = preferences.getFloat("offset", error_value); 
-        sensitivity_adc_slope = preferences.getFloat("sensitivity", error_value); 
-
-        if ((adc_zero_current_intercept == error_value || sensitivity_adc_slope == error_value) || asked_to_calibrate) {
-
-            auto previous_print_state = systemData.debug_print;
-            systemData.debug_print = systemData.debug_print_flags::Auxiliary;
-            Serial.printf("\n[AUX]Calibrating current sensor\n"
-                            "[AUX]Make sure that no current is flowing through the sensor during initialization\n"
-                            "[AUX]Press 'C' to continue\n");
-            xTaskNotify(ledBlinkerTaskHandle, BlinkRate::Fast, eSetValueWithOverwrite);
-            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
-            
-            asked_to_calibrate = false;
-            float offset_adc_sum = 0.0f;
-            float measured_adc = 0.0f;
-            constexpr uint32_t number_samples = 50;
-            constexpr uint32_t sample_interval = 100;
-            for (uint32_t i = 0; i < number_samples; i++) {
-                offset_adc_sum += analogRead(pin);
-                vTaskDelay(pdMS_TO_TICKS(sample_interval));
-            }
-            adc_zero_current_intercept = offset_adc_sum / number_samples;
-            Serial.printf("\n[AUX]Offset adc: %.2f\n", adc_zero_current_intercept);
-            Serial.printf("\n[AUX]Turn on the current source and input it starting with a 'C'");
-            
-            uint32_t notification_value;
-            while (!xTaskNotifyWait(0, ULONG_MAX, &notification_value, 8000)) {
-                Serial.printf("\n[AUX]Please input the current flowing through the sensor starting with a 'C'\n");
+    uint32_t Request() { return 0; }
 
-            }
+    bool Read(Sample& sample) {
+        sample = { (uint16_t)analogRead(battery_voltage_pin), (uint16_t)analogRead(battery_current_pin) };
+        return true;
+    }
+};
 
-            float current = (float)notification_value;
-            DEBUG_PRINTF("[AUX]CAL-Current: %.3f\n", current);
+struct AuxiliaryBatteryConverter {
+    struct Value {
+        float voltage;
+        float current;
+    };
 
-            for (uint32_t i = 0; i < number_samples; i++) {
-                measured_adc += analogRead(pin);
-                vTaskDelay(pdMS_TO_TICKS(sample_interval));
-            }
-            measured_adc = measured_adc / number_samples;
-            sensitivity_adc_slope = current / (measured_adc - adc_zero_current_intercept);
-            Serial.printf("\n[AUX]Offset adc: %.2f\n", adc_zero_current_intercept);
-            Serial.printf("[AUX]Measured adc: %.2f\n", measured_adc);
-            Serial.printf("[AUX]Sensitivity adc: %.2f\n", sensitivity_adc_slope);
-            preferences.putFloat("offset", adc_zero_current_intercept);
-            preferences.putFloat("sensitivity", sensitivity_adc_slope);    
-            systemData.debug_print = previous_print_state;
-            xTaskNotify(ledBlinkerTaskHandle, BlinkRate::Slow, eSetValueWithOverwrite);
+    /// @brief Offers a raw reading to the calibration engine, which samples it in the background while its channel is being calibrated, and returns the calibrated value.
+    static float Calibrate(CalibrationChannel channel, float raw) {
+        calibrationEngine.Feed(channel, raw);
+        return calibrationEngine.Apply(channel, raw);
+    }
+
+    Value Convert(const AuxiliaryBatteryDriver::Sample& sample) {
+        // The ACS712 output is calibrated straight from the ADC counts, since its zero current offset and sensitivity both drift with its supply.
+        return { Calibrate(AuxiliaryVoltageChannel, ToDividedVoltage(sample.voltage)), Calibrate(AuxiliaryCurrentChannel, sample.current) };
+    }
+};
+
+struct AuxiliaryBatteryPublisher {
+    uint32_t send_timer = 0;
+
+    void Publish(const AuxiliaryBatteryConverter::Value& value, uint32_t sample_time) {
+        systemData.auxiliarySystem.voltage = value.voltage;
+        systemData.auxiliarySystem.current = value.current;
+        alarmEngine.Check(AlarmField::AuxiliaryVoltage, value.voltage);
+        alarmEngine.Check(AlarmField::AuxiliaryCurrent, value.current);
+
+        if (sample_time - send_timer < auxiliary_send_interval) return;
+        send_timer = sample_time;
+        if (systemData.debug_print & SystemData::debug_print_flags::Auxiliary) {
+            DEBUG_PRINTF("\n[AUX]Battery voltage: %.2fV\n", value.voltage);
+            DEBUG_PRINTF("[AUX]Battery current: %.2fA\n", value.current);
         }
-            preferences.end();
-    };
 
-    static bool asked_to_calibrate = false;
-    constexpr float error_value = -1.0f;
-    float adc_zero_current_intercept = error_value;
-    float sensitivity_adc_slope = error_value;
-    CalibrateCurrentSensor(battery_current_pin, adc_zero_current_intercept, sensitivity_adc_slope, asked_to_calibrate);
+        // Prepare and send mavlink message
+        statusIndicator.Post(BlinkRate::Pulse); // Blink LED to indicate that a message has been sent.
+        SendTelemetrySubsystem(AuxiliarySubsystem, sample_time);
+    }
+};
 
-    while (true) {
-        float battery_voltage_reading = (analogRead(battery_voltage_pin) * adc_reference_voltage) / (adc_resolution * battery_voltage_divider_ratio);
-        battery_voltage_reading = LinearCorrection(battery_voltage_reading, 1.3009f, -2.5583f); // Calibrate voltage reading by using a linear equation obtained by comparing the readings with a multimeter.
-        aux_battery_voltage = (battery_voltage_reading + aux_battery_voltage * number_samples_filter) / (number_samples_filter + 1);
+/// @brief Reads the voltage across the bilge pumps.
+struct PumpDriver {
+    struct Sample {
+        uint16_t port; // ADC counts
+        uint16_t starboard;
+    };
 
-        float battery_current_reading = ReadBatteryCurrent(battery_current_pin, adc_zero_current_intercept, sensitivity_adc_slope);
-        aux_battery_current = (battery_current_reading + aux_battery_current * number_samples_filter) / (number_samples_filter + 1);
+    bool Begin() {
+        pinMode(port_pump_pin, INPUT);
+        pinMode(starboard_pump_pin, INPUT);
+        pumpMonitor.Begin();
+        return true;
+    }
+
+    uint32_t Request() { return 0; }
 
-        float port_pump_voltage_reading = (analogRead(port_pump_pin) * adc_reference_voltage) / (adc_resolution * battery_voltage_divider_ratio);
-        port_pump_voltage = (port_pump_voltage_reading + port_pump_voltage * number_samples_filter) / (number_samples_filter + 1);
+    bool Read(Sample& sample) {
+        sample = { (uint16_t)analogRead(port_pump_pin), (uint16_t)analogRead(starboard_pump_pin) };
+        return true;
+    }
+};
 
-        float starboard_pump_voltage_reading = (analogRead(starboard_pump_pin) * adc_reference_voltage) / (adc_resolution * battery_voltage_divider_ratio);
-        starboard_pump_voltage = (starboard_pump_voltage_reading + starboard_pump_voltage * number_samples_filter) / (number_samples_filter + 1);
+struct PumpConverter {
+    struct Value {
+        float port; // V
+        float starboard;
+    };
 
-        bool is_port_pump_on = port_pump_voltage_reading > pump_threshold_voltage;
-        bool is_starboard_pump_on = starboard_pump_voltage_reading > pump_threshold_voltage;
+    Value Convert(const PumpDriver::Sample& sample) {
+        return { ToDividedVoltage(sample.port), ToDividedVoltage(sample.starboard) };
+    }
+};
 
-        systemData.auxiliarySystem.voltage = aux_battery_voltage;
-        systemData.auxiliarySystem.current = aux_battery_current;
-        systemData.auxiliarySystem.pumps = (is_port_pump_on << 1) | is_starboard_pump_on;
+struct PumpPublisher {
+    static constexpr uint32_t save_interval = 500; // ms
+    uint32_t save_timer = 0;
+    uint32_t send_timer = 0;
 
-        static uint32_t print_timer = 0;
-        if (millis() - print_timer > 8000) {
-            print_timer = millis();
+    void Publish(const PumpConverter::Value& value, uint32_t sample_time) {
+        bool has_port_pump_changed = pumpMonitor.Update(0, value.port, sample_time);
+        bool has_starboard_pump_changed = pumpMonitor.Update(1, value.starboard, sample_time);
+        if (has_port_pump_changed || has_starboard_pump_changed) {
+            systemData.auxiliarySystem.pumps = (pumpMonitor.IsOn(0) << 1) | pumpMonitor.IsOn(1);
             if (systemData.debug_print & SystemData::debug_print_flags::Auxiliary) {
-                DEBUG_PRINTF("\n[AUX]Battery voltage: %.2fV\n", aux_battery_voltage);
-                DEBUG_PRINTF("[AUX]Battery current: %.2fA\n", aux_battery_current);
-                DEBUG_PRINTF("[AUX]Port pump: %s\n", is_port_pump_on ? "ON" : "OFF");
-                DEBUG_PRINTF("[AUX]Starboard pump: %s\n", is_starboard_pump_on ? "ON" : "OFF");
+                DEBUG_PRINTF("\n[AUX]Port pump: %s, starboard pump: %s\n", pumpMonitor.IsOn(0) ? "ON" : "OFF", pumpMonitor.IsOn(1) ? "ON" : "OFF");
             }
+        }
+        alarmEngine.Check(AlarmField::Pumps, systemData.auxiliarySystem.pumps);
 
-            // Prepare and send mavlink message
-            mavlink_message_t message;
-            mavlink_aux_system_t aux_system = systemData.auxiliarySystem;
+        if (sample_time - save_timer >= save_interval) {
+            save_timer = sample_time;
+            alarmEngine.Check(AlarmField::PumpDutyCycle, pumpMonitor.GetMaxDutyCycle());
+            pumpMonitor.Save();
+        }
 
-            mavlink_msg_aux_system_encode_chan(1, MAV_COMP_ID_ONBOARD_COMPUTER, MAVLINK_COMM_0, &message, &aux_system);
-            uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
-            uint16_t len = mavlink_msg_to_send_buffer(buffer, &message);
-            xTaskNotify(ledBlinkerTaskHandle, BlinkRate::Pulse, eSetValueWithOverwrite); // Blink LED to indicate that a message has been sent.
-            Serial.write(buffer, len);
+        if (sample_time - send_timer < auxiliary_send_interval) return;
+        send_timer = sample_time;
+        if (systemData.debug_print & SystemData::debug_print_flags::Auxiliary) {
+            DEBUG_PRINTF("\n[AUX]Port pump: %s, duty cycle %.1f%%\n", pumpMonitor.IsOn(0) ? "ON" : "OFF", pumpMonitor.GetDutyCycle(0));
+            DEBUG_PRINTF("[AUX]Starboard pump: %s, duty cycle %.1f%%\n", pumpMonitor.IsOn(1) ? "ON" : "OFF", pumpMonitor.GetDutyCycle(1));
         }
 
-        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(500))) {
-            asked_to_calibrate = true;
-            CalibrateCurrentSensor(battery_current_pin, adc_zero_current_intercept, sensitivity_adc_slope, asked_to_calibrate);
+        mavlink_pump_status_t pump_status = {};
+        pump_status.time_boot_ms = sample_time;
+        pump_status.state = systemData.auxiliarySystem.pumps;
+        for (uint8_t i = 0; i < PumpMonitor::number_pumps; i++) {
+            const PumpMonitor::Counters& counters = pumpMonitor.GetCounters(i);
+            pump_status.on_time[i] = counters.on_time / 1000;
+            pump_status.longest_run[i] = max(counters.longest_run, pumpMonitor.GetCurrentRun(i, sample_time)) / 1000;
+            pump_status.cycles[i] = min(counters.cycles, (uint32_t)UINT16_MAX);
+            pump_status.duty_cycle[i] = pumpMonitor.GetDutyCycle(i);
         }
+        mavlink_message_t message;
+        mavlink_msg_pump_status_encode_chan(1, MAV_COMP_ID_ONBOARD_COMPUTER, MAVLINK_COMM_0, &message, &pump_status);
+        SendTelemetry(message, PumpStream, pump_status.time_boot_ms);
     }
-}
+};
 
-/// @brief Auxiliary task to measure free stack memory of each task and free heap of the system.
+using AuxiliaryBatteryPipeline = SensorPipeline<AuxiliaryBatteryDriver, AuxiliaryBatteryConverter, ExponentialFilter<AuxiliaryBatteryConverter::Value, 4>,
+                                                AuxiliaryBatteryPublisher, 500>;
+// Pumps are sampled every 20 ms, fast enough to catch the short runs of a float switch cycling on a slow leak.
+using PumpPipeline = SensorPipeline<PumpDriver, PumpConverter, NoFilter, PumpPublisher, 20>;
+AuxiliaryBatteryPipeline auxiliaryBatteryPipeline("auxiliaryBattery", esp_timer_get_time);
+PumpPipeline pumpPipeline("pumps", esp_timer_get_time);
+
+/// @brief Auxiliary job to measure free stack memory of each task and free heap of the system.
 /// Useful to detect possible stack overflows on a task and allocate more stack memory for it if necessary.
 /// @param parameter Unused. Just here to comply with the task function signature.
-void StackHighWaterMeasurerTask(void* parameter) {
-    while (true) {
-        if (systemData.debug_print & SystemData::debug_print_flags::Temperature) {
-            Serial.printf("\n");
-            for (int i = 0; i < taskHandlesSize; i++) {
-                Serial.printf("[Task]%s has %d bytes of free stack\n", pcTaskGetTaskName(*taskHandles[i]), uxTaskGetStackHighWaterMark(*taskHandles[i]));
-            }
-            Serial.printf("[Task]System free heap: %d\n", esp_get_free_heap_size());            
+uint32_t StackHighWaterMeasurerJob(void* parameter, uint32_t now) {
+    if (systemData.debug_print & SystemData::debug_print_flags::Temperature) {
+        Serial.printf("\n");
+        for (int i = 0; i < taskHandlesSize; i++) {
+            if (!*taskHandles[i]) continue; // Tasks disabled in setup(), whose null handle would name the calling task.
+            Serial.printf("[Task]%s has %d bytes of free stack\n", pcTaskGetTaskName(*taskHandles[i]), uxTaskGetStackHighWaterMark(*taskHandles[i]));
+        }
+        Serial.printf("[Task]System free heap: %d, lowest %d\n", esp_get_free_heap_size(), esp_get_minimum_free_heap_size());
+        for (uint8_t i = 0; i < jobExecutor.GetNumberJobs(); i++) {
+            const auto& job = jobExecutor.GetStatistics(i);
+            Serial.printf("[Job]%s ran %d times, %lluus in all, at most %dus, at most %dms late\n", job.name, job.runs, job.total_time, job.max_time, job.max_lateness);
         }
-        vTaskDelay(pdMS_TO_TICKS(25000));
+        Serial.printf("[Task]Dropped status events: %d\n", statusIndicator.GetDroppedEvents());
+        Serial.printf("[Task]Dropped mavlink messages: %d\n", transmitQueueDrops);
+        Serial.printf("[Task]Spectrum frame analyzed in %dus\n", spectrumFrameTime);
+        Serial.printf("[Task]Over-current trips: %d, worst latency %.0fus\n", overcurrentProtection.GetTripCount(), overcurrentProtection.GetMaxLatency());
     }
+    return 25000;
 }
 
+
 void setup() {\
 
     Serial.begin(9600);
-    Wire.begin(); // Master mode
-    xTaskCreate(LedBlinkerTask, "ledBlinker", 2048, NULL, 1, &ledBlinkerTaskHandle);
-    xTaskCreate(WifiConnectionTask, "wifiConnection", 4096, NULL, 1, &wifiConnectionTaskHandle);
+    // Above the instrumentation reader and on its core, so a conversion it starts is on the wire as soon as it is submitted.
+    i2cBus.Begin(3, 1);
+    i2cBusTaskHandle = i2cBus.GetTaskHandle();
+    // Here rather than in the encoder control task, so the pin is driven by LEDC, and at zero, before the instrumentation reader arms the
+    // over-current protection, whose trip only takes the pin back through the GPIO matrix.
+    throttleOutput.Begin();
+    motorCurrentQueue = xQueueCreate(1, sizeof(MotorCurrentSample));
+    throttleCalibrationQueue = xQueueCreate(4, sizeof(ThrottleCalibrationRequest));
+    transmitQueue = xQueueCreate(8, sizeof(OutgoingFrame));
+    ipTransmitQueue = xQueueCreate(12, sizeof(OutgoingFrame));
+    reliableMutex = xSemaphoreCreateMutex();
+    spectrumSampleQueue = xQueueCreate(64, sizeof(CurrentSamplePair));
+    alarmEngine.Begin();
+
+    // Calibrations of the auxiliary current sensor saved before the calibration engine existed are carried over as its default.
+    Preferences preferences;
+    preferences.begin("aux", true);
+    float legacy_offset = preferences.getFloat("offset", -1.0f);
+    float legacy_sensitivity = preferences.getFloat("sensitivity", -1.0f);
+    preferences.end();
+    if (legacy_offset != -1.0f && legacy_sensitivity != -1.0f) {
+        calibrationEngine.SetDefault(AuxiliaryCurrentChannel, { legacy_sensitivity, -legacy_offset * legacy_sensitivity });
+    }
+    calibrationEngine.Begin();
+    preferences.begin("fec", true);
+    isFecEnabled = preferences.getBool("enabled", isFecEnabled);
+    fecDataFrames = preferences.getUChar("k", fecDataFrames);
+    fecParityFrames = preferences.getUChar("m", fecParityFrames);
+    preferences.end();
+    preferences.begin("iplink", true);
+    isIpTelemetryEnabled = preferences.getBool("enabled", isIpTelemetryEnabled);
+    groundAddress.fromString(preferences.getString("host", "0.0.0.0"));
+    groundPort = preferences.getUShort("port", groundPort);
+    preferences.end();
+    statusIndicator.Begin();
     xTaskCreate(VPNConnectionTask, "vpnConnection", 4096, NULL, 1, &vpnConnectionTaskHandle);
-    xTaskCreate(ServerTask, "server", 4096, NULL, 3, &serverTaskHandle);
+    xTaskCreate(ServerTask, "server", 4096, NULL, 1, &serverTaskHandle); // Only sets up the routes, which are served by the AsyncTCP task.
     xTaskCreate(SerialReaderTask, "serialReader", 4096, NULL, 1, &serialReaderTaskHandle);
-    //xTaskCreate(TemperatureReaderTask, "temperatureReader", 4096, NULL, 1, &temperatureReaderTaskHandle);
-    //xTaskCreate(GpsReaderTask, "gpsReader", 4096, NULL, 2, &gpsReaderTaskHandle);
-    xTaskCreate(InstrumentationReaderTask, "instrumentationReader", 4096, NULL, 2, &instrumentationReaderTaskHandle);
-    //xTaskCreate(AuxiliaryReaderTask, "auxiliaryReader", 4096, NULL, 1, &auxiliaryReaderTaskHandle);
-    //xTaskCreate(EncoderControlTask, "encoderControl", 4096, NULL, 1, &encoderControlTaskHandle);
-    //xTaskCreate(StackHighWaterMeasurerTask, "measurer", 2048, NULL, 1, NULL);  
+    xTaskCreate(SerialTransmitterTask, "serialTransmitter", 4096, NULL, 4, &serialTransmitterTaskHandle); // The parity of a group of frames is kept on its stack.
+    xTaskCreate(IpTransmitterTask, "ipTransmitter", 4096, NULL, 2, &ipTransmitterTaskHandle);
+    xTaskCreate(RaceLogTask, "raceLog", 4096, NULL, 1, &raceLogTaskHandle);
+    //xTaskCreate(GpsReaderTask, "gpsReader", 4096, NULL, 2, &gpsReaderTaskHandle); // Also disciplines the clock to NMEA and PPS once enabled.
+    // Pinned so that the over-current interrupt, attached by the task, and the conversions it times share a core and its cycle counter.
+    xTaskCreatePinnedToCore(InstrumentationReaderTask, "instrumentationReader", 4096, NULL, 2, &instrumentationReaderTaskHandle, 1);
+    xTaskCreatePinnedToCore(SpectrumAnalyzerTask, "spectrumAnalyzer", 4096, NULL, 1, &spectrumAnalyzerTaskHandle, 1);
+    xTaskCreate(EncoderControlTask, "encoderControl", 4096, NULL, 1, &encoderControlTaskHandle); // Runs the current limiter on the throttle.
+
+    // The low-rate jobs share the stack of one task. The priority of the temperature reader is raised around the bus transactions, and
+    // must come back to the priority of this task.
+    uint32_t now = millis();
+    jobExecutor.Add("wifiConnection", WifiConnectionJob, NULL, 0, now);
+    //temperatureReaderJobId = AddSensorJob(temperaturePipeline, now);
+    //AddSensorJob(auxiliaryBatteryPipeline, now);
+    //AddSensorJob(pumpPipeline, now);
+    //jobExecutor.Add("measurer", StackHighWaterMeasurerJob, NULL, 25000, now);
+    xTaskCreate(JobExecutorTask, "jobExecutor", 4096, NULL, 1, &jobExecutorTaskHandle);
 }
 
 void loop() {
@@ -0,0 +1,15 @@
+#pragma once
+// Just enough of the Arduino core and FreeRTOS for the portable headers that use them, so their logic can be tested on the host.
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+// Time seen by millis(), set by the tests.
+inline uint32_t native_millis = 0;
+inline uint32_t millis() { return native_millis; }
+
+// A single thread needs no lock.
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
@@ -0,0 +1,12 @@
+#pragma once
+// Non volatile storage that holds nothing, so every test starts from the defaults.
+#include <cstddef>
+
+class Preferences {
+public:
+    bool begin(const char*, bool = false) { return true; }
+    void end() {}
+    size_t getBytesLength(const char*) { return 0; }
+    size_t getBytes(const char*, void*, size_t) { return 0; }
+    size_t putBytes(const char*, const void*, size_t length) { return length; }
+};
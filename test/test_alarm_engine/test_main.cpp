@@ -0,0 +1,127 @@
+#include <unity.h>
+#include "AlarmEngine.hpp"
+
+static AlarmEvent events[8];
+static uint8_t number_events;
+
+static void OnTransition(const AlarmEvent& event) {
+    if (number_events < sizeof(events) / sizeof(events[0])) events[number_events] = event;
+    number_events++;
+}
+
+static AlarmEngine engine(OnTransition);
+static constexpr uint8_t rule_index = AlarmEngine::max_rules - 1;
+
+// Auxiliary current has no default rule, so this one is the only rule that sees the values.
+static void SetRule(AlarmComparator comparator, float threshold) {
+    AlarmRule rule = {};
+    rule.threshold = threshold;
+    rule.hysteresis = 2;
+    rule.debounce = 100;
+    rule.field = AlarmField::AuxiliaryCurrent;
+    rule.comparator = comparator;
+    rule.severity = AlarmSeverity::Critical;
+    rule.enabled = true;
+    TEST_ASSERT_TRUE(engine.SetRule(rule_index, rule));
+}
+
+static void CheckAt(uint32_t time, float value) {
+    native_millis = time;
+    engine.Check(AlarmField::AuxiliaryCurrent, value);
+}
+
+void setUp() {
+    native_millis = 1000;
+    number_events = 0;
+    engine.Begin();
+}
+
+void tearDown() {}
+
+void test_raise_waits_for_debounce() {
+    SetRule(AlarmComparator::Above, 10);
+    CheckAt(1000, 11);
+    CheckAt(1099, 11);
+    TEST_ASSERT_FALSE(engine.IsActive(rule_index));
+    CheckAt(1100, 11);
+    TEST_ASSERT_TRUE(engine.IsActive(rule_index));
+    TEST_ASSERT_EQUAL(1, number_events);
+    TEST_ASSERT_TRUE(events[0].is_active);
+    TEST_ASSERT_EQUAL(rule_index, events[0].rule);
+    TEST_ASSERT_EQUAL_UINT32(1100, events[0].timestamp);
+}
+
+void test_short_excursion_is_ignored() {
+    SetRule(AlarmComparator::Above, 10);
+    CheckAt(1000, 11);
+    CheckAt(1050, 9); // Back below before the debounce, which restarts it.
+    CheckAt(1120, 11);
+    CheckAt(1200, 11);
+    TEST_ASSERT_FALSE(engine.IsActive(rule_index));
+    CheckAt(1220, 11);
+    TEST_ASSERT_TRUE(engine.IsActive(rule_index));
+    TEST_ASSERT_EQUAL(1, number_events);
+}
+
+void test_clear_needs_hysteresis_and_debounce() {
+    SetRule(AlarmComparator::Above, 10);
+    CheckAt(1000, 11);
+    CheckAt(1100, 11);
+    TEST_ASSERT_TRUE(engine.IsActive(rule_index));
+
+    // Below the threshold but within the hysteresis: still active however long it stays.
+    CheckAt(1200, 9);
+    CheckAt(2000, 8.5f);
+    TEST_ASSERT_TRUE(engine.IsActive(rule_index));
+
+    CheckAt(2100, 7.9f);
+    CheckAt(2199, 7.9f);
+    TEST_ASSERT_TRUE(engine.IsActive(rule_index));
+    CheckAt(2200, 7.9f);
+    TEST_ASSERT_FALSE(engine.IsActive(rule_index));
+    TEST_ASSERT_EQUAL(2, number_events);
+    TEST_ASSERT_FALSE(events[1].is_active);
+}
+
+void test_below_comparator_mirrors_above() {
+    SetRule(AlarmComparator::Below, 10);
+    CheckAt(1000, 9);
+    CheckAt(1100, 9);
+    TEST_ASSERT_TRUE(engine.IsActive(rule_index));
+    CheckAt(1200, 11.5f);
+    CheckAt(1400, 11.5f);
+    TEST_ASSERT_TRUE(engine.IsActive(rule_index));
+    CheckAt(1500, 12.1f);
+    CheckAt(1600, 12.1f);
+    TEST_ASSERT_FALSE(engine.IsActive(rule_index));
+}
+
+void test_changed_rule_starts_from_scratch() {
+    SetRule(AlarmComparator::Above, 10);
+    CheckAt(1000, 11);
+    CheckAt(1100, 11);
+    TEST_ASSERT_TRUE(engine.IsActive(rule_index));
+    SetRule(AlarmComparator::Above, 20);
+    TEST_ASSERT_FALSE(engine.IsActive(rule_index));
+    CheckAt(1200, 11);
+    CheckAt(1300, 11);
+    TEST_ASSERT_FALSE(engine.IsActive(rule_index));
+}
+
+void test_out_of_range_index() {
+    TEST_ASSERT_FALSE(engine.IsActive(AlarmEngine::max_rules));
+    TEST_ASSERT_FALSE(engine.GetRule(AlarmEngine::max_rules).enabled);
+    AlarmRule rule = {};
+    TEST_ASSERT_FALSE(engine.SetRule(AlarmEngine::max_rules, rule));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_raise_waits_for_debounce);
+    RUN_TEST(test_short_excursion_is_ignored);
+    RUN_TEST(test_clear_needs_hysteresis_and_debounce);
+    RUN_TEST(test_below_comparator_mirrors_above);
+    RUN_TEST(test_changed_rule_starts_from_scratch);
+    RUN_TEST(test_out_of_range_index);
+    return UNITY_END();
+}
@@ -0,0 +1,97 @@
+#include <unity.h>
+#include "PacketFec.hpp"
+
+static constexpr uint8_t data_frames = 4;
+static constexpr uint8_t parity_frames = 2;
+
+static uint8_t frames[data_frames][PacketFec::max_frame_length];
+static uint16_t lengths[data_frames];
+static PacketFec::Decoder decoder; // Static, since it keeps a copy of every sequence number.
+
+// MAVLink 2 frames of different lengths, so the parity covers the longest and the short ones are padded.
+static void MakeFrames(uint8_t first_seq) {
+    for (uint8_t i = 0; i < data_frames; i++) {
+        uint8_t payload = 10 + 9 * i;
+        lengths[i] = 12 + payload;
+        memset(frames[i], 0, sizeof(frames[i]));
+        frames[i][0] = 0xFD;
+        frames[i][1] = payload;
+        frames[i][4] = first_seq + i;
+        for (uint16_t n = 5; n < lengths[i]; n++) frames[i][n] = n * 31 + i * 7;
+    }
+}
+
+// Sends a group through the encoder, drops the lost frames and gives the rest with the parity to the decoder.
+static uint8_t SendGroup(uint8_t first_seq, uint8_t lost_mask, uint8_t* recovered_mask) {
+    PacketFec::Encoder encoder;
+    encoder.Configure(data_frames, parity_frames);
+    MakeFrames(first_seq);
+    bool is_complete = false;
+    for (uint8_t i = 0; i < data_frames; i++) {
+        is_complete = encoder.Add(frames[i], lengths[i]);
+        if (!(lost_mask & (1 << i))) decoder.ReceiveData(frames[i], lengths[i]);
+    }
+    TEST_ASSERT_TRUE(is_complete);
+    TEST_ASSERT_EQUAL(parity_frames, encoder.GetNumberParity());
+
+    uint8_t number_recovered = 0;
+    *recovered_mask = 0;
+    for (uint8_t j = 0; j < encoder.GetNumberParity(); j++) {
+        decoder.ReceiveParity(encoder.GetParity(j), [&](const uint8_t* frame, uint16_t length) {
+            uint8_t i = frame[4] - first_seq;
+            TEST_ASSERT_LESS_THAN(data_frames, i);
+            TEST_ASSERT_EQUAL(lengths[i], length);
+            TEST_ASSERT_EQUAL_MEMORY(frames[i], frame, length);
+            *recovered_mask |= 1 << i;
+            number_recovered++;
+        });
+    }
+    return number_recovered;
+}
+
+void setUp() {
+    decoder = PacketFec::Decoder();
+}
+
+void tearDown() {}
+
+void test_no_loss_needs_no_recovery() {
+    uint8_t recovered_mask;
+    TEST_ASSERT_EQUAL(0, SendGroup(0, 0, &recovered_mask));
+    TEST_ASSERT_EQUAL(1, decoder.GetStatistics().groups_complete);
+}
+
+void test_recovers_one_lost_frame() {
+    uint8_t recovered_mask;
+    TEST_ASSERT_EQUAL(1, SendGroup(0, 0b0100, &recovered_mask));
+    TEST_ASSERT_EQUAL(0b0100, recovered_mask);
+}
+
+void test_recovers_as_many_lost_frames_as_parity_frames() {
+    uint8_t recovered_mask;
+    TEST_ASSERT_EQUAL(2, SendGroup(0, 0b1001, &recovered_mask));
+    TEST_ASSERT_EQUAL(0b1001, recovered_mask);
+    TEST_ASSERT_EQUAL(1, decoder.GetStatistics().groups_recovered);
+}
+
+void test_recovers_across_sequence_wrap() {
+    uint8_t recovered_mask;
+    TEST_ASSERT_EQUAL(2, SendGroup(254, 0b0110, &recovered_mask));
+    TEST_ASSERT_EQUAL(0b0110, recovered_mask);
+}
+
+void test_fails_with_more_losses_than_parity_frames() {
+    uint8_t recovered_mask;
+    TEST_ASSERT_EQUAL(0, SendGroup(0, 0b0111, &recovered_mask));
+    TEST_ASSERT_EQUAL(1, decoder.GetStatistics().groups_failed);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_no_loss_needs_no_recovery);
+    RUN_TEST(test_recovers_one_lost_frame);
+    RUN_TEST(test_recovers_as_many_lost_frames_as_parity_frames);
+    RUN_TEST(test_recovers_across_sequence_wrap);
+    RUN_TEST(test_fails_with_more_losses_than_parity_frames);
+    return UNITY_END();
+}
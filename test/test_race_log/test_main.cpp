@@ -0,0 +1,78 @@
+#include <unity.h>
+#include <cstdlib>
+#include "RaceLogExport.hpp"
+
+static uint8_t block[RaceLog::block_size];
+static uint8_t compressed[RaceLog::block_size + RaceLog::block_size / 255 + 16];
+static uint8_t decompressed[RaceLog::block_size];
+static uint16_t table[1 << RaceLog::compression_hash_bits];
+
+void setUp() {}
+void tearDown() {}
+
+void test_crc32_matches_zlib() {
+    const uint8_t check[] = "123456789";
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, RaceLog::Crc32(check, 9));
+    // Continued over two parts, as the block CRC skips its own field.
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, RaceLog::Crc32(check + 4, 5, RaceLog::Crc32(check, 4)));
+}
+
+void test_sealed_block_is_valid_until_changed() {
+    memset(block, 0, sizeof(block));
+    RaceLog::BlockHeader* header = reinterpret_cast<RaceLog::BlockHeader*>(block);
+    header->magic = RaceLog::magic;
+    header->used = 100;
+    for (int i = 0; i < 100; i++) block[sizeof(RaceLog::BlockHeader) + i] = i;
+    RaceLog::Seal(block);
+    TEST_ASSERT_TRUE(RaceLog::IsValid(block));
+
+    block[RaceLog::block_size - 1] ^= 0x01;
+    TEST_ASSERT_FALSE(RaceLog::IsValid(block));
+}
+
+// Records of a few repeated MAVLink frames with a changing counter, which is what the log compresses in practice.
+void test_lz4_round_trip_of_telemetry() {
+    for (uint32_t i = 0; i < sizeof(block); i++) block[i] = (i % 40 < 12) ? 0xFD : (i / 40) & 0x0F;
+    size_t length = RaceLog::Compress(block, sizeof(block), compressed, sizeof(compressed), table);
+    TEST_ASSERT_NOT_EQUAL(0, length);
+    TEST_ASSERT_LESS_THAN(sizeof(block) / 2, length);
+    TEST_ASSERT_EQUAL(sizeof(block), RaceLog::Decompress(compressed, length, decompressed, sizeof(decompressed)));
+    TEST_ASSERT_EQUAL_MEMORY(block, decompressed, sizeof(block));
+}
+
+void test_lz4_round_trip_of_random_data() {
+    srand(1);
+    for (uint32_t i = 0; i < sizeof(block); i++) block[i] = rand();
+    size_t length = RaceLog::Compress(block, sizeof(block), compressed, sizeof(compressed), table);
+    TEST_ASSERT_NOT_EQUAL(0, length);
+    TEST_ASSERT_EQUAL(sizeof(block), RaceLog::Decompress(compressed, length, decompressed, sizeof(decompressed)));
+    TEST_ASSERT_EQUAL_MEMORY(block, decompressed, sizeof(block));
+
+    // Random data does not shrink, so it is refused when the output must be smaller, and the block is then stored as is.
+    TEST_ASSERT_EQUAL(0, RaceLog::Compress(block, sizeof(block), compressed, sizeof(block) - 1, table));
+}
+
+void test_lz4_round_trip_of_short_input() {
+    const uint8_t text[] = "abcabcabcabc";
+    size_t length = RaceLog::Compress(text, sizeof(text), compressed, sizeof(compressed), table);
+    TEST_ASSERT_EQUAL(sizeof(text), RaceLog::Decompress(compressed, length, decompressed, sizeof(decompressed)));
+    TEST_ASSERT_EQUAL_MEMORY(text, decompressed, sizeof(text));
+}
+
+void test_lz4_rejects_damaged_input() {
+    for (uint32_t i = 0; i < sizeof(block); i++) block[i] = i % 7;
+    size_t length = RaceLog::Compress(block, sizeof(block), compressed, sizeof(compressed), table);
+    TEST_ASSERT_EQUAL(0, RaceLog::Decompress(compressed, length - 1, decompressed, sizeof(decompressed)));
+    TEST_ASSERT_EQUAL(0, RaceLog::Decompress(compressed, length, decompressed, sizeof(decompressed) / 2));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_crc32_matches_zlib);
+    RUN_TEST(test_sealed_block_is_valid_until_changed);
+    RUN_TEST(test_lz4_round_trip_of_telemetry);
+    RUN_TEST(test_lz4_round_trip_of_random_data);
+    RUN_TEST(test_lz4_round_trip_of_short_input);
+    RUN_TEST(test_lz4_rejects_damaged_input);
+    return UNITY_END();
+}